@@ -0,0 +1,68 @@
+;//###########################################################################
+;//
+;// FILE:  F2806x_CANBootStart.asm
+;//
+;// TITLE: Entry point of the CAN bootloader (CAN Library, CAN_boot.c).
+;//
+;// Use in place of F2806x_CodeStartBranch.asm, with F28069_CANBOOT.cmd.
+;// The boot ROM branches to codestart in BEGIN as usual; boot_start then
+;// disables the watchdog and copies the bootram group (code, constants and
+;// the Flash2806x API) from FLASHA to RAM before _c_int00 runs, because
+;// _c_int00 itself is in that group. Nothing executes from flash after this,
+;// so the bootloader can erase and program any sector with interrupts on.
+;//
+;//###########################################################################
+
+    .ref _c_int00
+    .ref _BootRamLoadStart
+    .ref _BootRamLoadSize
+    .ref _BootRamRunStart
+    .global code_start
+
+***********************************************************************
+* Function: codestart section
+*
+* Description: Branch to the RAM copy
+***********************************************************************
+
+    .sect "codestart"
+
+code_start:
+        LB boot_start       ;Branch to watchdog disable and RAM copy
+
+;end codestart section
+
+***********************************************************************
+* Function: boot_start
+*
+* Description: Disables the watchdog timer, copies the bootram group
+* to RAM and branches to the C environment setup there
+***********************************************************************
+
+    .sect "bootstart"
+boot_start:
+    SETC OBJMODE        ;Set OBJMODE for 28x object code
+    EALLOW              ;Enable EALLOW protected register access
+    MOVZ DP, #7029h>>6  ;Set data page for WDCR register
+    MOV @7029h, #0068h  ;Set WDDIS bit in WDCR to disable WD
+    EDIS                ;Disable EALLOW protected register access
+
+    MOVL XAR6, #_BootRamLoadStart
+    MOVL XAR7, #_BootRamRunStart
+    MOVL ACC, #_BootRamLoadSize
+    SB boot_done, EQ    ;Nothing to copy
+boot_copy:
+    MOV T, *XAR6++      ;One word from flash
+    MOV *XAR7++, T      ;to RAM
+    SUBB ACC, #1
+    SB boot_copy, NEQ
+boot_done:
+    LB _c_int00         ;Branch to start of boot.asm in RTS library, now in RAM
+
+;end boot_start
+
+	.end
+
+;//===========================================================================
+;// End of file.
+;//===========================================================================
@@ -0,0 +1,436 @@
+/**
+ * @file F2806x_Host.c
+ * @brief Host ("virtual F28069") CPU, PIE and register files
+ *
+ * Only built with DSP28_HOST; see F2806x_Host.h for how a host build is put
+ * together. This file replaces F2806x_GlobalVariableDefs.c, the CPU's IER/IFR
+ * and INTM, the PIE dispatcher and DSP28x_usDelay.
+ *
+ * Register watching works by keeping a watched register file's page
+ * PROT_NONE. A CPU access faults, the page is opened, the CPU single-steps
+ * the one instruction (trap flag) and the page is closed again, after which
+ * the model is told which register was touched and whether it was a write.
+ * Models themselves run with every page open ("model context"), so they read
+ * and write registers without tripping over their own traps.
+ */
+#ifdef DSP28_HOST
+
+#define _GNU_SOURCE
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#include "F2806x_Device.h"
+#include "F2806x_Examples.h"
+
+#if defined(__linux__) && defined(__x86_64__)
+#define HOST_WATCH 1
+#else
+#define HOST_WATCH 0
+#endif
+
+#define HOST_PAGE_SIZE	4096
+
+//---------------------------------------------------------------------------
+// Register files. Each one gets its own page(s) so it can be watched alone.
+//
+#define HOST_REGISTER_FILES(X) \
+	X(ADC_REGS, AdcRegs)				X(ADC_RESULT_REGS, AdcResult) \
+	X(CLA_REGS, Cla1Regs)				X(COMP_REGS, Comp1Regs) \
+	X(COMP_REGS, Comp2Regs)				X(COMP_REGS, Comp3Regs) \
+	X(CPUTIMER_REGS, CpuTimer0Regs)		X(CPUTIMER_REGS, CpuTimer1Regs) \
+	X(CPUTIMER_REGS, CpuTimer2Regs)		X(CSM_PWL, CsmPwl) \
+	X(CSM_REGS, CsmRegs)				X(DEV_EMU_REGS, DevEmuRegs) \
+	X(DMA_REGS, DmaRegs)				X(ECAN_REGS, ECanaRegs) \
+	X(ECAN_MBOXES, ECanaMboxes)			X(LAM_REGS, ECanaLAMRegs) \
+	X(MOTS_REGS, ECanaMOTSRegs)			X(MOTO_REGS, ECanaMOTORegs) \
+	X(EPWM_REGS, EPwm1Regs)				X(EPWM_REGS, EPwm2Regs) \
+	X(EPWM_REGS, EPwm3Regs)				X(EPWM_REGS, EPwm4Regs) \
+	X(EPWM_REGS, EPwm5Regs)				X(EPWM_REGS, EPwm6Regs) \
+	X(EPWM_REGS, EPwm7Regs)				X(EPWM_REGS, EPwm8Regs) \
+	X(ECAP_REGS, ECap1Regs)				X(ECAP_REGS, ECap2Regs) \
+	X(ECAP_REGS, ECap3Regs)				X(EQEP_REGS, EQep1Regs) \
+	X(EQEP_REGS, EQep2Regs)				X(FLASH_REGS, FlashRegs) \
+	X(GPIO_CTRL_REGS, GpioCtrlRegs)		X(GPIO_DATA_REGS, GpioDataRegs) \
+	X(GPIO_INT_REGS, GpioIntRegs)		X(HRCAP_REGS, HRCap1Regs) \
+	X(HRCAP_REGS, HRCap2Regs)			X(HRCAP_REGS, HRCap3Regs) \
+	X(HRCAP_REGS, HRCap4Regs)			X(I2C_REGS, I2caRegs) \
+	X(McBSP_REGS, McbspaRegs)			X(NMIINTRUPT_REGS, NmiIntruptRegs) \
+	X(PARTID_REGS, PartIdRegs)			X(PIE_CTRL_REGS, PieCtrlRegs) \
+	X(SCI_REGS, SciaRegs)				X(SCI_REGS, ScibRegs) \
+	X(SPI_REGS, SpiaRegs)				X(SPI_REGS, SpibRegs) \
+	X(SYS_CTRL_REGS, SysCtrlRegs)		X(SYS_PWR_CTRL_REGS, SysPwrCtrlRegs) \
+	X(USB_REGS, Usb0Regs)				X(XINTRUPT_REGS, XIntruptRegs)
+
+#define HOST_DEFINE(type, name) \
+	volatile struct type name __attribute__((aligned(HOST_PAGE_SIZE)));
+#define HOST_ENTRY(type, name) {&name, sizeof(name)},
+
+HOST_REGISTER_FILES(HOST_DEFINE)
+struct PIE_VECT_TABLE PieVectTable;
+
+static const struct {
+	volatile void* regs;
+	Uint32 size;
+} HostRegisterFiles[] = {
+	HOST_REGISTER_FILES(HOST_ENTRY)
+};
+
+//---------------------------------------------------------------------------
+// CPU and simulator state:
+//
+volatile unsigned int IFR;
+volatile unsigned int IER;
+Uint32 HostSimCyclesPerTick = 90;	//1us per tick at 90MHz
+
+static volatile Uint16 intm = 1;			//INTM is set out of reset
+static volatile Uint16 pie_blocked;			//groups waiting on a PIEACK write
+static volatile Uint16 raised;				//HostSimRaise since the last service
+static volatile Uint32 ticks;
+static volatile sig_atomic_t in_models;	//nesting depth of model context
+static HOST_MODEL* models;
+
+static HOST_MODEL* trap_model;				//model whose page is open for one instruction
+static volatile void* trap_reg;
+static Uint16 trap_write;
+
+static void HostProtect(HOST_MODEL* model, int prot) {
+#if HOST_WATCH
+	uintptr_t start = (uintptr_t)model->regs & ~(uintptr_t)(HOST_PAGE_SIZE - 1);
+	uintptr_t end = (uintptr_t)model->regs + model->size;
+	mprotect((void*)start, end - start, prot);
+#endif
+}
+
+static int HostWatched(HOST_MODEL* model) {
+	return HOST_WATCH && model->regs && model->access;
+}
+
+/*
+ * Model context: every watched page is open and interrupts are only latched.
+ */
+static void HostEnterModels(void) {
+	HOST_MODEL* model;
+	if (in_models++ == 0) {
+		for (model = models; model; model = model->next) {
+			if (HostWatched(model)) HostProtect(model, PROT_READ | PROT_WRITE);
+		}
+	}
+}
+
+static void HostLeaveModels(void) {
+	HOST_MODEL* model;
+	if (--in_models == 0) {
+		for (model = models; model; model = model->next) {
+			if (HostWatched(model)) HostProtect(model, PROT_NONE);
+		}
+	}
+}
+
+#if HOST_WATCH
+#define HOST_TRAP_FLAG	0x100	//EFLAGS.TF
+
+static void HostSegvHandler(int sig, siginfo_t* info, void* context) {
+	ucontext_t* uc = (ucontext_t*)context;
+	uintptr_t addr = (uintptr_t)info->si_addr;
+	HOST_MODEL* model;
+
+	(void)sig;
+	for (model = models; model; model = model->next) {
+		uintptr_t start = (uintptr_t)model->regs & ~(uintptr_t)(HOST_PAGE_SIZE - 1);
+		if (HostWatched(model) && addr >= start && addr < (uintptr_t)model->regs + model->size) {
+			break;
+		}
+	}
+	if (!model) {//a real crash: let it happen
+		signal(SIGSEGV, SIG_DFL);
+		return;
+	}
+
+	HostProtect(model, PROT_READ | PROT_WRITE);
+	trap_model = model;
+	trap_reg = info->si_addr;
+	trap_write = (uc->uc_mcontext.gregs[REG_ERR] & 2) != 0;
+	uc->uc_mcontext.gregs[REG_EFL] |= HOST_TRAP_FLAG;//run exactly one instruction
+	sigaddset(&uc->uc_sigmask, SIGALRM);//and do not tick in between
+}
+
+static void HostTrapHandler(int sig, siginfo_t* info, void* context) {
+	ucontext_t* uc = (ucontext_t*)context;
+	HOST_MODEL* model = trap_model;
+
+	(void)sig;
+	(void)info;
+	if (!model) {//not ours (debugger breakpoint etc.)
+		signal(SIGTRAP, SIG_DFL);
+		raise(SIGTRAP);
+		return;
+	}
+	uc->uc_mcontext.gregs[REG_EFL] &= ~HOST_TRAP_FLAG;
+	sigdelset(&uc->uc_sigmask, SIGALRM);
+	trap_model = 0;
+
+	in_models++;
+	model->access(trap_reg, trap_write);
+	in_models--;
+	if (in_models == 0) {
+		HostProtect(model, PROT_NONE);
+	}
+	sigprocmask(SIG_SETMASK, &uc->uc_sigmask, 0);//ISRs may wait on ticks
+	HostSimServiceInterrupts();
+}
+#endif
+
+static void HostTickHandler(int sig) {
+	(void)sig;
+	if (!in_models) {//a tick that lands inside a model is simply dropped
+		HostSimStep();
+	}
+}
+
+/**
+ * Put the whole device in its reset state: all register files zeroed, PIE
+ * vectors cleared, INTM set, then every model's reset hook. The stock
+ * models are added here, so call this before adding your own.
+ */
+void HostSimInit(void) {
+	static Uint16 installed = 0;
+	HOST_MODEL* model;
+	Uint16 i;
+
+	if (!installed) {
+#if HOST_WATCH
+		struct sigaction sa;
+		memset(&sa, 0, sizeof(sa));
+		sa.sa_flags = SA_SIGINFO | SA_NODEFER;//ISRs may run inside the trap handler
+		sigemptyset(&sa.sa_mask);
+		sigaddset(&sa.sa_mask, SIGALRM);//no ticks while a page is half-open
+		sa.sa_sigaction = HostSegvHandler;
+		sigaction(SIGSEGV, &sa, 0);
+		sa.sa_sigaction = HostTrapHandler;
+		sigaction(SIGTRAP, &sa, 0);
+#endif
+		signal(SIGALRM, HostTickHandler);
+		installed = 1;
+	}
+
+	HostAddStockModels();
+
+	HostEnterModels();
+	for (i = 0; i < sizeof(HostRegisterFiles)/sizeof(HostRegisterFiles[0]); i++) {
+		memset((void*)HostRegisterFiles[i].regs, 0, HostRegisterFiles[i].size);
+	}
+	memset(&PieVectTable, 0, sizeof(PieVectTable));
+	IER = 0;
+	IFR = 0;
+	intm = 1;
+	pie_blocked = 0;
+	ticks = 0;
+	for (model = models; model; model = model->next) {
+		if (model->reset) model->reset();
+	}
+	HostLeaveModels();
+}
+
+/**
+ * Add a peripheral model. Adding the same model twice is harmless. A model
+ * with both regs and access set has its register file watched from now on.
+ */
+void HostSimAddModel(HOST_MODEL* model) {
+	HOST_MODEL* m;
+	for (m = models; m; m = m->next) {
+		if (m == model) return;
+	}
+	model->next = models;
+	models = model;
+	if (HostWatched(model) && !in_models) {
+		HostProtect(model, PROT_NONE);
+	}
+}
+
+/**
+ * Advance every model by one tick, then take any interrupts that are due.
+ */
+void HostSimStep(void) {
+	HostSimRun(1);
+}
+
+/**
+ * Advance n ticks. The models stay in model context across ticks and only
+ * leave it when one of them raised an interrupt, since opening and closing
+ * the watched pages is by far the most expensive part of a tick.
+ */
+void HostSimRun(Uint32 n) {
+	HOST_MODEL* model;
+	HostEnterModels();
+	while (n--) {
+		for (model = models; model; model = model->next) {
+			if (model->step) model->step();
+		}
+		ticks++;
+		if (raised && n) {
+			HostLeaveModels();
+			HostSimServiceInterrupts();
+			HostEnterModels();
+		}
+	}
+	HostLeaveModels();
+	HostSimServiceInterrupts();
+}
+
+/**
+ * Tick the models from a timer every tick_us microseconds of wall time. This
+ * is what lets unmodified polling loops (while (!flag) {}) finish.
+ */
+void HostSimStart(Uint32 tick_us) {
+	struct itimerval it;
+	it.it_interval.tv_sec = tick_us / 1000000;
+	it.it_interval.tv_usec = tick_us % 1000000;
+	it.it_value = it.it_interval;
+	setitimer(ITIMER_REAL, &it, 0);
+}
+
+void HostSimStop(void) {
+	struct itimerval it;
+	memset(&it, 0, sizeof(it));
+	setitimer(ITIMER_REAL, &it, 0);
+}
+
+Uint32 HostSimTicks(void) {
+	return ticks;
+}
+
+/**
+ * Hand a register access made by a modelled bus master (the DMA) to the model
+ * watching that register, as if the CPU had made it. Call from model context.
+ */
+void HostSimBusAccess(volatile void* reg, Uint16 write) {
+	HOST_MODEL* model;
+	for (model = models; model; model = model->next) {
+		if (model->regs && model->access && (volatile char*)reg >= (volatile char*)model->regs &&
+				(volatile char*)reg < (volatile char*)model->regs + model->size) {
+			model->access(reg, write);
+			return;
+		}
+	}
+}
+
+//---------------------------------------------------------------------------
+// DMA addresses: a word offset from HostDmaBase, which lives among the
+// program's statics like the register files and any buffer the DMA may use.
+//
+static Uint16 HostDmaBase;
+
+Uint32 HostDmaAddress(volatile void* p) {
+	intptr_t words = ((intptr_t)p - (intptr_t)&HostDmaBase) / 2;
+
+	if (words != (int32)words) {//a stack or heap buffer, which the DMA could not reach on the chip either
+		fprintf(stderr, "HostDmaAddress: %p is out of the DMA's reach\n", (void*)p);
+		abort();
+	}
+	return (Uint32)words;
+}
+
+volatile Uint16* HostDmaPointer(Uint32 address) {
+	return (volatile Uint16*)((uintptr_t)&HostDmaBase + 2*(intptr_t)(int32)address);
+}
+
+//---------------------------------------------------------------------------
+// PIE and CPU interrupt handling:
+//
+static volatile Uint16* PieIer(Uint16 group) {
+	return &PieCtrlRegs.PIEIER1.all + 2*(group - 1);
+}
+
+static volatile Uint16* PieIfr(Uint16 group) {
+	return &PieCtrlRegs.PIEIFR1.all + 2*(group - 1);
+}
+
+/**
+ * Flag an interrupt. Groups 1-12 go through the PIE (intx is 1-8); 13 and 14
+ * are the CPU-timer 1 and 2 lines, which bypass it (intx is ignored).
+ */
+void HostSimRaise(Uint16 group, Uint16 intx) {
+	if (group >= 13) {
+		IFR |= 1 << (group - 1);
+	} else {
+		*PieIfr(group) |= 1 << (intx - 1);
+	}
+	raised = 1;
+	HostSimServiceInterrupts();
+}
+
+/**
+ * Take every interrupt the PIE and CPU would take right now. A write of 1 to
+ * PIEACKx is how the CPU releases group x; since nothing else writes PIEACK
+ * here, any 1 found in it is such an acknowledge.
+ */
+void HostSimServiceInterrupts(void) {
+	static volatile sig_atomic_t servicing = 0;
+	Uint16 group, intx, pending;
+	PINT isr;
+
+	if (in_models || servicing) return;//no nesting: the outer loop picks it up
+	servicing = 1;
+	raised = 0;
+
+	while (1) {
+		pie_blocked &= ~PieCtrlRegs.PIEACK.all;
+		PieCtrlRegs.PIEACK.all = 0;
+
+		//PIE: forward one interrupt per unblocked group into IFR
+		for (group = 1; group <= 12 && PieCtrlRegs.PIECTRL.bit.ENPIE; group++) {
+			if (!(pie_blocked & (1 << (group - 1))) && (*PieIfr(group) & *PieIer(group))) {
+				IFR |= 1 << (group - 1);
+			}
+		}
+		if (intm || !(IFR & IER)) break;
+
+		//CPU: lowest numbered INT line first
+		for (group = 1; !(IFR & IER & (1 << (group - 1))); group++) {}
+		IFR &= ~(1 << (group - 1));
+
+		if (group >= 13) {
+			isr = (group == 13) ? PieVectTable.TINT1 : PieVectTable.TINT2;
+		} else {
+			pending = *PieIfr(group) & *PieIer(group);
+			if (!pending) continue;//cleared by software in the meantime
+			for (intx = 1; !(pending & (1 << (intx - 1))); intx++) {}
+			*PieIfr(group) &= ~(1 << (intx - 1));
+			pie_blocked |= 1 << (group - 1);
+			isr = (&PieVectTable.ADCINT1)[8*(group - 1) + (intx - 1)];
+		}
+
+		if (isr) {
+			intm = 1;//hardware sets INTM for the ISR
+			isr();
+			intm = 0;
+		}
+	}
+	servicing = 0;
+}
+
+void HostSimEint(void) {
+	intm = 0;
+	HostSimServiceInterrupts();
+}
+
+void HostSimDint(void) {
+	intm = 1;
+}
+
+/**
+ * On the chip this spins for 5*Count+9 cycles. Here the peripherals get the
+ * equivalent number of ticks, so things waited for actually happen.
+ */
+void DSP28x_usDelay(Uint32 Count) {
+	Uint32 n = (5*(Uint64)Count + 9) / HostSimCyclesPerTick;
+	HostSimRun(n ? n : 1);
+}
+
+#endif  // DSP28_HOST
@@ -0,0 +1,1910 @@
+/**
+ * @file F2806x_HostModels.c
+ * @brief Stock peripheral models for the host ("virtual F28069") build
+ *
+ * Only built with DSP28_HOST. Each model keeps the hardware-owned state of
+ * its peripheral (write-1-to-clear flags, FIFOs, shift registers) in a
+ * private struct and copies it into the register file after every access,
+ * so the libraries see the same values they would read on the chip.
+ *
+ * What is modelled:
+ *  - PLL: always locked, LOSPCP at its reset value.
+ *  - GPIO: GPxSET/GPxCLEAR/GPxTOGGLE act on GPxDAT.
+ *  - CPU timers 0-2: prescaler, period reload, TIF, TINT0/1/2.
+ *  - ADC: software and CPU-timer triggered SOCs (results from
+ *    HostAdcSampleHook), ADCINT1-9 with overflow.
+ *  - eCAN-A: TRS/TRR/TA/AA/RMP/RML/RFP, transmit priority (TPL, then mailbox
+ *    number), acceptance masks, auto-answer, change-data requests (CDR),
+ *    self-test loopback, MOTS time stamps, CANTSC, both mailbox interrupt
+ *    lines and bit-accurate frame timing from CANBTC. Frames leave through
+ *    HostECanTxHook and arrive through HostECanInject.
+ *  - CAN bus: the eCAN shares the wire with HOST_CAN_NODEs (periodic, one-shot,
+ *    remote-answering or replayed from a candump log). Identifier arbitration,
+ *    ACK, TEC/REC with EW/EP/BO and their interrupts, bus-off recovery after
+ *    128 x 11 recessive bits, injected bit errors, per-ID latency statistics.
+ *  - SCI-A/B: 4-level FIFOs or single buffers, character timing from the baud
+ *    registers and LOSPCP, loopback, FIFO and non-FIFO interrupts. Bytes leave
+ *    through HostSciTxHook and arrive through HostSciInject.
+ *  - SPI-A/B master: 4-level FIFOs or single buffers, 1-16 bit characters
+ *    timed from SPIBRR and LOSPCP, loopback, FIFO interrupts and SPIINT.
+ *    Each character is exchanged with HostSpiTransferHook.
+ *  - I2C-A master: START/STOP, repeat and non-repeat mode, I2CCNT, ARDY, XRDY,
+ *    RRDY, NACK, SCD, BB and I2CINT1A; 4-level FIFOs with their I2CINT2A
+ *    threshold interrupts (a full RX FIFO stretches the clock). Slaves are HOST_I2C_SLAVEs; a slave
+ *    without handlers behaves like a register-file device (first byte written
+ *    is the register pointer, which auto-increments).
+ *  - DMA channels 1-6: bursts, transfers, wrapping, one-shot and continuous
+ *    mode, 16/32-bit data, interrupts at the start or end of a transfer and
+ *    event overflow. Triggered by the McBSP-A events and PERINTFRC; the
+ *    addresses come from DMA_ADDRESS (see HostDmaAddress).
+ *  - McBSP-A in clock stop mode as an SPI master, words up to 16 bits timed
+ *    from CLKGDV and LOSPCP, DRR1/DXR1 with RRDY/XRDY/RFULL, the DMA events
+ *    and MRINTA/MXINTA. Each word is exchanged with HostSpiTransferHook
+ *    ('M'), or looped back with DLB.
+ */
+#ifdef DSP28_HOST
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "F2806x_Device.h"
+#include "F2806x_Dma_defines.h"
+
+#define HOST_QUEUE_SIZE	256
+
+Uint16 (*HostAdcSampleHook)(Uint16 channel) = 0;
+void (*HostECanTxHook)(const HOST_CAN_FRAME* frame) = 0;
+void (*HostSciTxHook)(char scisys, Uint16 data) = 0;
+Uint16 (*HostSpiTransferHook)(char spisys, Uint16 data, Uint16 bits) = 0;
+
+static void AdcTrigger(Uint16 trigsel);
+
+static Uint32 Ticks(Uint64 cycles) {
+	Uint64 n = cycles / HostSimCyclesPerTick;
+	return n ? (Uint32)n : 1;
+}
+
+static Uint32 LspClkDivider(void) {
+	Uint16 lospcp = SysCtrlRegs.LOSPCP.bit.LSPCLK;
+	return lospcp ? 2*lospcp : 1;
+}
+
+//---------------------------------------------------------------------------
+// PLL
+//
+static void PllReset(void) {
+	SysCtrlRegs.LOSPCP.all = 0x0002;
+	SysCtrlRegs.PLLSTS.bit.PLLLOCKS = 1;
+	SysCtrlRegs.PLL2STS.bit.PLL2LOCKS = 1;
+}
+
+static void PllStep(void) {
+	SysCtrlRegs.PLLSTS.bit.PLLLOCKS = 1;//locks instantly
+	SysCtrlRegs.PLLSTS.bit.MCLKSTS = 0;
+}
+
+static HOST_MODEL PllModel = {0, 0, PllReset, PllStep, 0, 0};
+
+//---------------------------------------------------------------------------
+// GPIO
+//
+static void GpioAccess(volatile void* reg, Uint16 write) {
+	(void)reg;
+	if (!write) return;
+	GpioDataRegs.GPADAT.all |= GpioDataRegs.GPASET.all;
+	GpioDataRegs.GPADAT.all &= ~GpioDataRegs.GPACLEAR.all;
+	GpioDataRegs.GPADAT.all ^= GpioDataRegs.GPATOGGLE.all;
+	GpioDataRegs.GPBDAT.all |= GpioDataRegs.GPBSET.all;
+	GpioDataRegs.GPBDAT.all &= ~GpioDataRegs.GPBCLEAR.all;
+	GpioDataRegs.GPBDAT.all ^= GpioDataRegs.GPBTOGGLE.all;
+	GpioDataRegs.AIODAT.all |= GpioDataRegs.AIOSET.all;
+	GpioDataRegs.AIODAT.all &= ~GpioDataRegs.AIOCLEAR.all;
+	GpioDataRegs.AIODAT.all ^= GpioDataRegs.AIOTOGGLE.all;
+	GpioDataRegs.GPASET.all = 0;//these always read back as 0
+	GpioDataRegs.GPACLEAR.all = 0;
+	GpioDataRegs.GPATOGGLE.all = 0;
+	GpioDataRegs.GPBSET.all = 0;
+	GpioDataRegs.GPBCLEAR.all = 0;
+	GpioDataRegs.GPBTOGGLE.all = 0;
+	GpioDataRegs.AIOSET.all = 0;
+	GpioDataRegs.AIOCLEAR.all = 0;
+	GpioDataRegs.AIOTOGGLE.all = 0;
+}
+
+static HOST_MODEL GpioModel = {&GpioDataRegs, sizeof(GpioDataRegs), 0, 0, GpioAccess, 0};
+
+//---------------------------------------------------------------------------
+// CPU timers
+//
+typedef struct {
+	volatile struct CPUTIMER_REGS* regs;
+	Uint16 tif;
+	Uint32 cycles;				//SYSCLKOUT cycles not yet counted by the prescaler
+	HOST_MODEL model;
+} HOST_TIMER;
+
+static HOST_TIMER Timers[3];
+
+static HOST_TIMER* TimerOf(volatile void* reg) {
+	Uint16 i;
+	for (i = 0; i < 3; i++) {
+		if ((volatile char*)reg >= (volatile char*)Timers[i].regs &&
+				(volatile char*)reg < (volatile char*)(Timers[i].regs + 1)) {
+			return &Timers[i];
+		}
+	}
+	return &Timers[0];
+}
+
+static void TimerSync(HOST_TIMER* t) {
+	t->regs->TCR.bit.TIF = t->tif;
+	t->regs->TCR.bit.TRB = 0;
+}
+
+static void TimerReset(void) {
+	Uint16 i;
+	for (i = 0; i < 3; i++) {
+		Timers[i].regs->TIM.all = 0xFFFFFFFF;
+		Timers[i].regs->PRD.all = 0xFFFFFFFF;
+		Timers[i].tif = 0;
+		Timers[i].cycles = 0;
+		TimerSync(&Timers[i]);
+	}
+}
+
+static void TimerAccess(volatile void* reg, Uint16 write) {
+	HOST_TIMER* t = TimerOf(reg);
+	if (!write || reg != &t->regs->TCR) {
+		return;
+	}
+	if (t->regs->TCR.bit.TIF) {//write 1 to clear
+		t->tif = 0;
+	}
+	if (t->regs->TCR.bit.TRB) {
+		t->regs->TIM.all = t->regs->PRD.all;
+		t->regs->TPR.bit.PSC = t->regs->TPR.bit.TDDR;
+		t->regs->TPRH.bit.PSCH = t->regs->TPRH.bit.TDDRH;
+		t->cycles = 0;
+	}
+	TimerSync(t);
+}
+
+static void TimerStep(void) {
+	Uint16 i;
+	for (i = 0; i < 3; i++) {
+		HOST_TIMER* t = &Timers[i];
+		Uint32 prescale = ((Uint32)t->regs->TPRH.bit.TDDRH << 8 | t->regs->TPR.bit.TDDR) + 1;
+		Uint32 counts, tim;
+		Uint16 fired = 0;
+
+		if (t->regs->TCR.bit.TSS) continue;
+		t->cycles += HostSimCyclesPerTick;
+		counts = t->cycles / prescale;
+		t->cycles %= prescale;
+
+		tim = t->regs->TIM.all;
+		while (counts) {
+			if (tim >= counts) {
+				tim -= counts;
+				counts = 0;
+			} else {
+				counts -= tim + 1;
+				tim = t->regs->PRD.all;
+				fired = 1;
+			}
+		}
+		t->regs->TIM.all = tim;
+
+		if (fired) {
+			t->tif = 1;
+			TimerSync(t);
+			AdcTrigger(i + 1);//TRIGSEL 1-3 are TINT0-2
+			if (t->regs->TCR.bit.TIE) {
+				if (i == 0) HostSimRaise(1, 7);//TINT0
+				else HostSimRaise(12 + i, 0);//INT13, INT14
+			}
+		}
+	}
+}
+
+//---------------------------------------------------------------------------
+// ADC
+//
+static void AdcConvert(Uint16 soc) {
+	Uint16 channel = (&AdcRegs.ADCSOC0CTL)[soc].bit.CHSEL;
+	Uint16 n;
+
+	(&AdcResult.ADCRESULT0)[soc] = HostAdcSampleHook ? HostAdcSampleHook(channel) & 0x0FFF : 0;
+
+	for (n = 0; n < 9; n++) {//ADCINT1-9
+		Uint16 sel = (&AdcRegs.INTSEL1N2.all)[n/2] >> (8*(n%2));
+		Uint16 mask = 1 << n;
+		if (!(sel & 0x20) || (sel & 0x1F) != soc) continue;//INTxE, INTxSEL
+		if ((AdcRegs.ADCINTFLG.all & mask) && !(sel & 0x40)) {//INTxCONT
+			AdcRegs.ADCINTOVF.all |= mask;
+			continue;
+		}
+		AdcRegs.ADCINTFLG.all |= mask;
+		if (n < 2) {
+			HostSimRaise(1, n + 1);//ADCINT1/2 appear in group 1 and group 10
+			HostSimRaise(10, n + 1);
+		} else if (n < 8) {
+			HostSimRaise(10, n + 1);
+		} else {
+			HostSimRaise(1, 6);
+		}
+	}
+}
+
+static void AdcTrigger(Uint16 trigsel) {
+	Uint16 soc;
+	if (!AdcRegs.ADCCTL1.bit.ADCENABLE) return;
+	for (soc = 0; soc < 16; soc++) {
+		if ((&AdcRegs.ADCSOC0CTL)[soc].bit.TRIGSEL == trigsel) AdcConvert(soc);
+	}
+}
+
+static void AdcStep(void) {
+	Uint16 forced = AdcRegs.ADCSOCFRC1.all;
+	Uint16 soc;
+
+	AdcRegs.ADCINTFLG.all &= ~AdcRegs.ADCINTFLGCLR.all;
+	AdcRegs.ADCINTFLGCLR.all = 0;
+	AdcRegs.ADCINTOVF.all &= ~AdcRegs.ADCINTOVFCLR.all;
+	AdcRegs.ADCINTOVFCLR.all = 0;
+
+	AdcRegs.ADCSOCFRC1.all = 0;
+	for (soc = 0; soc < 16 && forced; soc++) {
+		if (forced & (1 << soc)) AdcConvert(soc);
+	}
+}
+
+static HOST_MODEL AdcModel = {0, 0, 0, AdcStep, 0, 0};
+
+//---------------------------------------------------------------------------
+// eCAN-A and the bus it sits on
+//
+// The bus carries frames from the eCAN, from every HOST_CAN_NODE and from
+// HostECanInject. Each time it goes idle all of them offer their best frame
+// and the lowest arbitration field wins, as bitwise arbitration would decide.
+//
+#define CAN_IDE		0x80000000
+#define CAN_AME		0x40000000
+#define CAN_AAM		0x20000000
+#define CAN_ID_MASK	0x1FFFFFFF
+#define CAN_STD_MASK	0x1FFC0000
+#define CAN_GIF_W1C	0x00037F00	//system flags; MIV and GMIF are derived
+#define CAN_ES_W1C	0x01FF0000	//error and status flags in CANES
+#define CAN_ES_EW	0x00010000
+#define CAN_ES_EP	0x00020000
+#define CAN_ES_BO	0x00040000
+#define CAN_ES_ACKE	0x00080000
+#define CAN_ES_BE	0x00800000
+#define CAN_ERROR_BITS	20			//error flag, delimiter and intermission
+#define CAN_CYCLES_PER_US	90		//SYSCLKOUT
+#define HOST_CAN_IDS	64
+
+enum { FROM_NOBODY, FROM_ECAN, FROM_INJECT, FROM_NODE };
+
+static struct {//controller state; SRES clears it
+	Uint32 trs, ta, aa, rmp, rml, rfp;
+	Uint32 gif[2];				//system interrupt flags of CANGIF0/CANGIF1
+	Uint32 pending;				//mailbox interrupts already signalled
+	Uint32 tsc_cycles;			//cycles not yet counted by CANTSC
+	Uint32 es;					//CANES error flags
+	Uint64 trs_since[32];		//bus time each TRS bit was set
+	Uint16 tec, rec;			//error counters; tec > 255 is bus-off
+	Uint32 recessive;			//cycles of idle bus seen while bus-off
+	Uint16 sequences;			//11-recessive-bit sequences seen while bus-off
+} ecan;
+
+static struct {//the wire; only HostSimInit clears it
+	Uint64 now;					//bus time in SYSCLKOUT cycles
+	Uint32 busy;				//ticks left on the frame on the wire
+	Uint16 from;				//FROM_*: who is sending it
+	int16 mbox;					//eCAN mailbox sending it
+	HOST_CAN_NODE* node;		//node sending it
+	HOST_CAN_MESSAGE* message;
+	Uint64 ready;				//when it became ready to send
+	Uint16 error;				//being destroyed by an error frame
+	volatile Uint16 errors;		//frames HostCanBusErrors still has to destroy
+	volatile Uint16 force_off;	//HostCanBusOff was called
+	HOST_CAN_FRAME frame;
+	HOST_CAN_FRAME queue[HOST_QUEUE_SIZE];
+	Uint64 queued[HOST_QUEUE_SIZE];
+	volatile Uint16 head, tail;
+	HOST_CAN_ID_STATS ids[HOST_CAN_IDS];
+	Uint16 nids;
+} bus;
+
+static HOST_CAN_NODE* CanNodes;
+Uint16 HostCanBusAck = 1;
+
+static volatile struct MBOX* Mbox(Uint16 n) {
+	return &ECanaMboxes.MBOX0 + n;
+}
+
+static Uint32 ECanBitCycles(void) {//eCAN runs from SYSCLKOUT/2
+	return 2*((Uint32)ECanaRegs.CANBTC.bit.BRPREG + 1) *
+			(ECanaRegs.CANBTC.bit.TSEG1REG + ECanaRegs.CANBTC.bit.TSEG2REG + 3);
+}
+
+static Uint32 ECanFrameBits(const HOST_CAN_FRAME* frame) {
+	Uint32 bits = (frame->id & CAN_IDE) ? 67 : 47;//no stuff bits
+	if (!frame->rtr) bits += 8*frame->dlc;
+	return bits;
+}
+
+/*
+ * Arbitration field as it goes out MSB first: base ID, RTR (SRR when
+ * extended), IDE, ID extension, RTR. Lower wins.
+ */
+static Uint32 CanArbitration(const HOST_CAN_FRAME* frame) {
+	Uint32 id = frame->id & CAN_ID_MASK;
+	if (frame->id & CAN_IDE) {
+		return ((id >> 18) << 21) | ((Uint32)3 << 19) | ((id & 0x3FFFF) << 1) | (frame->rtr ? 1 : 0);
+	}
+	return ((id >> 18) << 21) | (frame->rtr ? (Uint32)1 << 20 : 0);
+}
+
+static Uint16 CanSameId(const HOST_CAN_FRAME* a, const HOST_CAN_FRAME* b) {
+	Uint32 care = (a->id & CAN_IDE) ? (CAN_IDE | CAN_ID_MASK) : (CAN_IDE | CAN_STD_MASK);
+	return ((a->id ^ b->id) & care) == 0;
+}
+
+static HOST_CAN_ID_STATS* CanIdStats(const HOST_CAN_FRAME* frame) {
+	Uint32 id = frame->id & (CAN_IDE | ((frame->id & CAN_IDE) ? CAN_ID_MASK : CAN_STD_MASK));
+	Uint16 i;
+
+	for (i = 0; i < bus.nids; i++) {
+		if (bus.ids[i].id == id) return &bus.ids[i];
+	}
+	if (bus.nids == HOST_CAN_IDS) return 0;
+	memset(&bus.ids[i], 0, sizeof(bus.ids[i]));
+	bus.ids[i].id = id;
+	bus.nids++;
+	return &bus.ids[i];
+}
+
+/*
+ * Bring the flag registers in line with the private state and raise a
+ * mailbox interrupt for every line with something new to report.
+ */
+static void ECanSync(Uint16 resignal) {
+	Uint32 flags = (ecan.ta | ecan.rmp) & ECanaRegs.CANMIM.all;
+	Uint32 level[2];
+	Uint16 i, n;
+
+	ECanaRegs.CANTRS.all = ecan.trs;
+	ECanaRegs.CANTRR.all = 0;
+	ECanaRegs.CANTA.all = ecan.ta;
+	ECanaRegs.CANAA.all = ecan.aa;
+	ECanaRegs.CANRMP.all = ecan.rmp;
+	ECanaRegs.CANRML.all = ecan.rml;
+	ECanaRegs.CANRFP.all = ecan.rfp;
+	ECanaRegs.CANES.all = ecan.es | (ECanaRegs.CANMC.bit.CCR ? 0x10 : 0);//CCE follows CCR
+	ECanaRegs.CANTEC.all = ecan.tec > 255 ? 255 : ecan.tec;
+	ECanaRegs.CANREC.all = ecan.rec > 255 ? 255 : ecan.rec;
+
+	level[0] = flags & ~ECanaRegs.CANMIL.all;
+	level[1] = flags & ECanaRegs.CANMIL.all;
+	for (i = 0; i < 2; i++) {
+		Uint32 gif = ecan.gif[i];
+		if (level[i]) {
+			for (n = 31; !(level[i] & ((Uint32)1 << n)); n--) {}
+			gif |= 0x8000 | n;//GMIF, MIV
+		}
+		if (i == 0) ECanaRegs.CANGIF0.all = gif;
+		else ECanaRegs.CANGIF1.all = gif;
+
+		if ((level[i] & ~ecan.pending) || (resignal && level[i])) {
+			if (ECanaRegs.CANGIM.all & (1 << i)) HostSimRaise(9, 5 + i);//ECAN0INTA, ECAN1INTA
+		}
+	}
+	ecan.pending = flags;
+}
+
+static void ECanSystemInterrupt(Uint32 flag, Uint32 mask) {
+	if (ECanaRegs.CANGIM.all & mask) {
+		Uint16 line = ECanaRegs.CANGIM.bit.GIL;
+		ecan.gif[line] |= flag;
+		if (ECanaRegs.CANGIM.all & (1 << line)) HostSimRaise(9, 5 + line);
+	}
+}
+
+/*
+ * Recompute EW/EP/BO from the error counters and raise WLIF, EPIF and BOIF
+ * on the way in. Going bus-off sets CCR unless ABO is set.
+ */
+static void ECanErrorState(void) {
+	Uint32 es = 0;
+
+	if (ecan.tec >= 96 || ecan.rec >= 96) es |= CAN_ES_EW;
+	if (ecan.tec >= 128 || ecan.rec >= 128) es |= CAN_ES_EP;
+	if (ecan.tec > 255) es = CAN_ES_EW | CAN_ES_EP | CAN_ES_BO;
+
+	if ((es & ~ecan.es) & CAN_ES_EW) ECanSystemInterrupt(0x0100, 0x0100);//WLIF, WLIM
+	if ((es & ~ecan.es) & CAN_ES_EP) ECanSystemInterrupt(0x0200, 0x0200);//EPIF, EPIM
+	if ((es & ~ecan.es) & CAN_ES_BO) {
+		ECanSystemInterrupt(0x0400, 0x0400);//BOIF, BOIM
+		if (!ECanaRegs.CANMC.bit.ABO) ECanaRegs.CANMC.bit.CCR = 1;
+		ecan.recessive = 0;
+		ecan.sequences = 0;
+	}
+	ecan.es = (ecan.es & ~(CAN_ES_EW | CAN_ES_EP | CAN_ES_BO)) | es;
+}
+
+static Uint16 ECanOnBus(void) {
+	return !ECanaRegs.CANMC.bit.CCR && !(ecan.es & CAN_ES_BO);
+}
+
+/*
+ * Count 11-recessive-bit sequences while bus-off. After 128 of them, with
+ * ABO set or CCR cleared again, the controller is error active with both
+ * counters at zero.
+ */
+static void ECanRecover(Uint32 idle_cycles, Uint16 frame_ends) {
+	Uint32 sequence = 11 * ECanBitCycles();
+
+	ecan.recessive += idle_cycles;
+	ecan.sequences += frame_ends + ecan.recessive / sequence;
+	ecan.recessive %= sequence;
+	if (ecan.sequences >= 128 && (ECanaRegs.CANMC.bit.ABO || !ECanaRegs.CANMC.bit.CCR)) {
+		ecan.tec = 0;
+		ecan.rec = 0;
+		ECanaRegs.CANMC.bit.CCR = 0;
+		ECanErrorState();
+	}
+}
+
+static Uint16 ECanMatch(Uint16 n, Uint32 id) {
+	Uint32 mid = Mbox(n)->MSGID.all;
+	Uint32 care = CAN_ID_MASK;
+	Uint32 lam = (&ECanaLAMRegs.LAM0)[n].all;
+
+	if (mid & CAN_AME) {
+		care &= ~lam;
+		if (!(lam & 0x80000000) && ((mid ^ id) & CAN_IDE)) return 0;//LAMI
+	} else if ((mid ^ id) & CAN_IDE) {
+		return 0;
+	}
+	if (!(id & CAN_IDE)) care &= CAN_STD_MASK;
+	return ((mid ^ id) & care) == 0;
+}
+
+static void ECanReceive(const HOST_CAN_FRAME* frame) {
+	Uint32 enabled = ECanaRegs.CANME.all;
+	Uint32 rx = ECanaRegs.CANMD.all;
+	int16 n;
+
+	for (n = 31; n >= 0; n--) {
+		Uint32 bit = (Uint32)1 << n;
+		volatile struct MBOX* mbox = Mbox(n);
+		if (!(enabled & bit) || !ECanMatch(n, frame->id)) continue;
+
+		if (frame->rtr) {//remote frames only concern transmit mailboxes
+			if (rx & bit) continue;
+			ecan.rfp |= bit;
+			if (mbox->MSGID.all & CAN_AAM) {
+				mbox->MSGCTRL.bit.DLC = frame->dlc;
+				if (!(ecan.trs & bit)) ecan.trs_since[n] = bus.now;
+				ecan.trs |= bit;
+			}
+			return;
+		}
+		if (!(rx & bit)) continue;
+		if (ecan.rmp & bit) {
+			if (ECanaRegs.CANOPC.all & bit) continue;//protected: try the next one
+			ecan.rml |= bit;
+			ECanSystemInterrupt(0x0800, 0x0800);//RMLIF, RMLIM
+		}
+		mbox->MSGID.all = (mbox->MSGID.all & (CAN_AME | CAN_AAM)) | (frame->id & ~(CAN_AME | CAN_AAM));
+		mbox->MSGCTRL.bit.DLC = frame->dlc;
+		mbox->MDL.all = frame->mdl;
+		mbox->MDH.all = frame->mdh;
+		(&ECanaMOTSRegs.MOTS0)[n] = ECanaRegs.CANTSC;
+		ecan.rmp |= bit;
+		return;
+	}
+}
+
+static int16 ECanNextTransmit(void) {
+	Uint32 ready = ecan.trs & ECanaRegs.CANME.all;
+	int16 best = -1, n;
+	Uint16 best_tpl = 0;
+
+	if (ECanaRegs.CANMC.bit.CDR) ready &= ~((Uint32)1 << ECanaRegs.CANMC.bit.MBNR);//data being changed
+
+	for (n = 31; n >= 0; n--) {//equal TPL: highest mailbox first
+		if ((ready & ((Uint32)1 << n)) && (best < 0 || Mbox(n)->MSGCTRL.bit.TPL > best_tpl)) {
+			best = n;
+			best_tpl = Mbox(n)->MSGCTRL.bit.TPL;
+		}
+	}
+	return best;
+}
+
+/*
+ * Mark node messages whose time has come as pending. A message that is
+ * still pending when it falls due again counts an overrun.
+ */
+static void CanNodesSchedule(void) {
+	HOST_CAN_NODE* node;
+	Uint16 i;
+
+	for (node = CanNodes; node; node = node->next) {
+		if (bus.now < node->next_due) continue;
+		node->next_due = (Uint64)-1;
+		for (i = 0; i < node->count; i++) {
+			HOST_CAN_MESSAGE* m = &node->messages[i];
+			if (!m->scheduled) continue;
+			if (bus.now >= m->due) {
+				if (m->pending) {
+					m->overruns++;
+				} else {
+					m->pending = 1;
+					m->ready = m->due;
+					node->pending++;
+				}
+				if (m->period_us) m->due += (Uint64)m->period_us * CAN_CYCLES_PER_US;
+				else m->scheduled = 0;
+			}
+			if (m->scheduled && m->due < node->next_due) node->next_due = m->due;
+		}
+	}
+}
+
+static void CanNodeStart(HOST_CAN_NODE* node) {
+	Uint16 i;
+
+	node->pending = 0;
+	node->next_due = (Uint64)-1;
+	for (i = 0; i < node->count; i++) {
+		HOST_CAN_MESSAGE* m = &node->messages[i];
+		m->pending = 0;
+		m->overruns = 0;
+		m->scheduled = m->period_us || !m->answer;
+		m->due = bus.now + (Uint64)m->phase_us * CAN_CYCLES_PER_US;
+		if (m->scheduled && m->due < node->next_due) node->next_due = m->due;
+	}
+}
+
+static HOST_CAN_MESSAGE* CanNodeNext(HOST_CAN_NODE* node) {
+	HOST_CAN_MESSAGE* best = 0;
+	Uint32 best_key = 0;
+	Uint16 i;
+
+	if (!node->pending) return 0;
+	for (i = 0; i < node->count; i++) {
+		HOST_CAN_MESSAGE* m = &node->messages[i];
+		Uint32 key;
+		if (!m->pending) continue;
+		key = CanArbitration(&m->frame);
+		if (!best || key < best_key) {
+			best = m;
+			best_key = key;
+		}
+	}
+	return best;
+}
+
+/*
+ * Start the next frame if anyone has one. Injected frames wait for the eCAN
+ * to be on the bus, as they are meant for it.
+ */
+static void CanArbitrate(void) {
+	Uint32 best_key = 0;
+	HOST_CAN_NODE* node;
+
+	bus.from = FROM_NOBODY;
+	if (bus.head != bus.tail && ECanOnBus()) {
+		bus.from = FROM_INJECT;
+		bus.frame = bus.queue[bus.tail];
+		bus.ready = bus.queued[bus.tail];
+		best_key = CanArbitration(&bus.frame);
+	}
+	if (ECanOnBus()) {
+		int16 n = ECanNextTransmit();
+		if (n >= 0) {
+			volatile struct MBOX* mbox = Mbox(n);
+			HOST_CAN_FRAME frame;
+			frame.id = mbox->MSGID.all;
+			frame.dlc = mbox->MSGCTRL.bit.DLC;
+			frame.rtr = mbox->MSGCTRL.bit.RTR || (ECanaRegs.CANMD.all & ((Uint32)1 << n));
+			frame.mdl = mbox->MDL.all;
+			frame.mdh = mbox->MDH.all;
+			if (bus.from == FROM_NOBODY || CanArbitration(&frame) < best_key) {
+				bus.from = FROM_ECAN;
+				bus.mbox = n;
+				bus.frame = frame;
+				bus.ready = ecan.trs_since[n];
+				best_key = CanArbitration(&frame);
+			}
+		}
+	}
+	for (node = CanNodes; node; node = node->next) {
+		HOST_CAN_MESSAGE* m = CanNodeNext(node);
+		if (m && (bus.from == FROM_NOBODY || CanArbitration(&m->frame) < best_key)) {
+			bus.from = FROM_NODE;
+			bus.node = node;
+			bus.message = m;
+			bus.frame = m->frame;
+			bus.ready = m->ready;
+			best_key = CanArbitration(&m->frame);
+		}
+	}
+	if (bus.from == FROM_NOBODY) return;
+
+	bus.error = 0;
+	if (bus.errors) {//destroyed halfway through, then the error frame
+		bus.errors--;
+		bus.error = 1;
+		bus.busy = Ticks((Uint64)(ECanFrameBits(&bus.frame) / 2 + CAN_ERROR_BITS) * ECanBitCycles());
+	} else {
+		bus.busy = Ticks((Uint64)ECanFrameBits(&bus.frame) * ECanBitCycles());
+	}
+}
+
+static Uint16 CanAcked(void) {
+	HOST_CAN_NODE* node;
+
+	if (HostCanBusAck) return 1;
+	if (bus.from != FROM_ECAN && ECanOnBus()) return 1;
+	if (bus.from == FROM_ECAN && ECanaRegs.CANMC.bit.STM) return 1;
+	for (node = CanNodes; node; node = node->next) {
+		if (node->ack && !(bus.from == FROM_NODE && bus.node == node)) return 1;
+	}
+	return 0;
+}
+
+/*
+ * The frame on the wire has ended. Errors leave it with its sender for a
+ * retransmission; a good frame reaches every receiver and answers remote
+ * requests.
+ */
+static void CanEndOfFrame(void) {
+	HOST_CAN_ID_STATS* stats = CanIdStats(&bus.frame);
+	Uint16 ecan_rx = bus.from != FROM_ECAN && ECanOnBus();
+	HOST_CAN_NODE* node;
+	Uint16 i;
+
+	if (bus.from == FROM_ECAN && !(ecan.trs & ((Uint32)1 << bus.mbox))) return;//aborted on the wire
+	if (ecan.es & CAN_ES_BO) ECanRecover(0, 1);
+
+	if (bus.error || !CanAcked()) {
+		if (stats) stats->errors++;
+		if (bus.from == FROM_ECAN) {
+			if (bus.error) {
+				ecan.es |= CAN_ES_BE;
+				ecan.tec += 8;
+			} else {
+				ecan.es |= CAN_ES_ACKE;
+				if (ecan.tec < 128) ecan.tec += 8;//no ACK while error passive: no increment
+			}
+		} else if (ecan_rx && bus.error) {
+			ecan.es |= CAN_ES_BE;
+			ecan.rec++;
+		}
+		ECanErrorState();
+		return;
+	}
+
+	if (stats) {
+		Uint64 latency = (bus.now - bus.ready) / CAN_CYCLES_PER_US;
+		stats->frames++;
+		stats->total_us += latency;
+		if (latency > stats->worst_us) stats->worst_us = (Uint32)latency;
+	}
+	switch (bus.from) {
+	case FROM_ECAN: {
+		Uint32 bit = (Uint32)1 << bus.mbox;
+		ecan.trs &= ~bit;
+		if (!(ECanaRegs.CANMD.all & bit)) {//receive mailboxes only send remote requests: no TA
+			ecan.ta |= bit;
+			(&ECanaMOTSRegs.MOTS0)[bus.mbox] = ECanaRegs.CANTSC;
+		}
+		if (ecan.tec) ecan.tec--;
+		if (HostECanTxHook) HostECanTxHook(&bus.frame);
+		if (ECanaRegs.CANMC.bit.STM) ECanReceive(&bus.frame);//self-test loopback
+		break;
+	}
+	case FROM_INJECT:
+		bus.tail = (bus.tail + 1) % HOST_QUEUE_SIZE;
+		break;
+	case FROM_NODE:
+		bus.message->pending = 0;
+		bus.node->pending--;
+		break;
+	}
+	if (ecan_rx) {
+		if (ecan.rec > 127) ecan.rec = 120;
+		else if (ecan.rec) ecan.rec--;
+		ECanReceive(&bus.frame);
+	}
+	ECanErrorState();
+
+	for (node = CanNodes; node; node = node->next) {
+		if (bus.from == FROM_NODE && bus.node == node) continue;
+		if (node->receive) node->receive(node, &bus.frame);
+		if (!bus.frame.rtr) continue;
+		for (i = 0; i < node->count; i++) {
+			HOST_CAN_MESSAGE* m = &node->messages[i];
+			if (m->answer && !m->pending && CanSameId(&m->frame, &bus.frame)) {
+				m->pending = 1;
+				m->ready = bus.now;
+				node->pending++;
+			}
+		}
+	}
+}
+
+static void ECanReset(void) {//SRES
+	memset((void*)&ecan, 0, sizeof(ecan));
+	ECanaRegs.CANMC.all = 0x00001000;//CCR set out of reset
+	ECanSync(0);
+}
+
+static void CanBusReset(void) {
+	HOST_CAN_NODE* node;
+
+	memset((void*)&bus, 0, sizeof(bus));
+	for (node = CanNodes; node; node = node->next) CanNodeStart(node);
+	ECanReset();
+}
+
+static void ECanAccess(volatile void* reg, Uint16 write) {
+	Uint32 offset = (volatile char*)reg - (volatile char*)&ECanaRegs;
+	volatile union CANTA_REG* r = (volatile union CANTA_REG*)((volatile char*)&ECanaRegs + (offset & ~3));
+	Uint32 value = r->all;
+
+	if (!write) return;
+	if (r == (volatile void*)&ECanaRegs.CANTRS) {
+		Uint32 started = value & ~ecan.trs;
+		Uint16 n;
+		for (n = 0; started; n++, started >>= 1) {
+			if (started & 1) ecan.trs_since[n] = bus.now;
+		}
+		ecan.trs |= value;
+	} else if (r == (volatile void*)&ECanaRegs.CANTRR) {
+		Uint32 aborted = ecan.trs & value;
+		ecan.trs &= ~aborted;
+		ecan.aa |= aborted;
+		if (aborted) ECanSystemInterrupt(0x4000, 0x4000);//AAIF, AAIM
+	} else if (r == (volatile void*)&ECanaRegs.CANTA) {
+		ecan.ta &= ~value;
+	} else if (r == (volatile void*)&ECanaRegs.CANAA) {
+		ecan.aa &= ~value;
+	} else if (r == (volatile void*)&ECanaRegs.CANRMP) {
+		ecan.rmp &= ~value;
+		ecan.rml &= ~value;
+	} else if (r == (volatile void*)&ECanaRegs.CANRFP) {
+		ecan.rfp &= ~value;
+	} else if (r == (volatile void*)&ECanaRegs.CANES) {
+		ecan.es &= ~(value & CAN_ES_W1C & ~(CAN_ES_EW | CAN_ES_EP | CAN_ES_BO));
+	} else if (r == (volatile void*)&ECanaRegs.CANGIF0) {
+		ecan.gif[0] &= ~(value & CAN_GIF_W1C);
+	} else if (r == (volatile void*)&ECanaRegs.CANGIF1) {
+		ecan.gif[1] &= ~(value & CAN_GIF_W1C);
+	} else if (r == (volatile void*)&ECanaRegs.CANMC) {
+		if (ECanaRegs.CANMC.bit.SRES) {
+			ECanReset();
+			return;
+		}
+		if (ECanaRegs.CANMC.bit.TCC) {
+			ECanaRegs.CANTSC &= 0x7FFFFFFF;
+			ECanaRegs.CANMC.bit.TCC = 0;
+		}
+		if ((ecan.es & CAN_ES_BO) && !ECanaRegs.CANMC.bit.CCR) ECanRecover(0, 0);
+	}
+	ECanSync(1);
+}
+
+static void ECanStep(void) {
+	Uint32 bit = ECanBitCycles();
+
+	ecan.tsc_cycles += HostSimCyclesPerTick;
+	ECanaRegs.CANTSC += ecan.tsc_cycles / bit;
+	ecan.tsc_cycles %= bit;
+	bus.now += HostSimCyclesPerTick;
+
+	if (bus.force_off) {
+		bus.force_off = 0;
+		ecan.tec = 256;
+		ECanErrorState();
+		ECanSync(0);
+	}
+	CanNodesSchedule();
+
+	if (bus.busy && --bus.busy == 0) {
+		CanEndOfFrame();
+		ECanSync(0);
+	}
+	if (bus.busy) return;
+
+	if (ecan.es & CAN_ES_BO) {
+		ECanRecover(HostSimCyclesPerTick, 0);
+		if (!(ecan.es & CAN_ES_BO)) ECanSync(0);
+	}
+	CanArbitrate();
+}
+
+/**
+ * Queue a frame to go out on the simulated bus. It arbitrates like any other
+ * frame and is received by the eCAN (acceptance filtering, RMP, interrupts)
+ * and every node once it has spent its bit time on the wire.
+ */
+void HostECanInject(const HOST_CAN_FRAME* frame) {
+	Uint16 next = (bus.head + 1) % HOST_QUEUE_SIZE;
+	if (next == bus.tail) return;//bus saturated: drop
+	bus.queue[bus.head] = *frame;
+	bus.queued[bus.head] = bus.now;
+	bus.head = next;
+}
+
+/**
+ * Put a virtual node on the bus. Its periodic and one-shot messages are
+ * scheduled from now; adding a node twice is harmless.
+ */
+void HostCanAddNode(HOST_CAN_NODE* node) {
+	HOST_CAN_NODE* n;
+	for (n = CanNodes; n; n = n->next) {
+		if (n == node) return;
+	}
+	CanNodeStart(node);
+	node->next = CanNodes;
+	CanNodes = node;
+}
+
+/**
+ * Destroy the next frames frames on the bus with bit errors. Every sender
+ * retransmits; the eCAN's TEC or REC counts each one.
+ */
+void HostCanBusErrors(Uint16 frames) {
+	bus.errors += frames;
+}
+
+/**
+ * Drive the eCAN straight to bus-off, as if its TEC had passed 255.
+ */
+void HostCanBusOff(void) {
+	bus.force_off = 1;
+}
+
+/**
+ * Fill node with one one-shot message per line of a candump -l log
+ * ("(1436509052.249713) can0 123#DEADBEEF", "R" for remote frames), timed
+ * relative to the first line. The messages array is malloc'd.
+ * @return number of frames read, or -1 if the file cannot be opened or the
+ * messages do not fit in memory (node is then left empty)
+ */
+int HostCanReplay(HOST_CAN_NODE* node, const char* candump_log) {
+	FILE* f = fopen(candump_log, "r");
+	char line[256], id[16], data[80];
+	double t, t0 = 0;
+	Uint16 size = 0, i;
+
+	if (!f) return -1;
+	node->messages = 0;
+	node->count = 0;
+	while (fgets(line, sizeof(line), f)) {
+		HOST_CAN_MESSAGE* m;
+		Uint32 raw;
+		data[0] = 0;
+		if (sscanf(line, " (%lf) %*s %15[0-9A-Fa-f]#%79s", &t, id, data) < 2) continue;
+		if (node->count == size) {
+			HOST_CAN_MESSAGE* grown = 0;
+			if (size < 0x8000) {//count is a Uint16
+				size = size ? 2*size : 64;
+				grown = realloc(node->messages, size * sizeof(HOST_CAN_MESSAGE));
+			}
+			if (!grown) {
+				free(node->messages);
+				node->messages = 0;
+				node->count = 0;
+				fclose(f);
+				return -1;
+			}
+			node->messages = grown;
+		}
+		if (node->count == 0) t0 = t;
+		m = &node->messages[node->count++];
+		memset(m, 0, sizeof(*m));
+		raw = strtoul(id, 0, 16);
+		m->frame.id = strlen(id) > 3 ? (CAN_IDE | (raw & CAN_ID_MASK)) : ((raw & 0x7FF) << 18);
+		m->phase_us = (Uint32)((t - t0) * 1e6 + 0.5);
+		if (data[0] == 'R' || data[0] == 'r') {
+			m->frame.rtr = 1;
+			m->frame.dlc = data[1] ? data[1] - '0' : 0;
+			continue;
+		}
+		for (i = 0; i < 8 && isxdigit((unsigned char)data[2*i]) && isxdigit((unsigned char)data[2*i + 1]); i++) {
+			char byte[3] = {data[2*i], data[2*i + 1], 0};
+			Uint32 b = strtoul(byte, 0, 16);
+			if (i < 4) m->frame.mdl |= b << (24 - 8*i);//byte 0 in bits 31-24 (DBO = 0)
+			else m->frame.mdh |= b << (24 - 8*(i - 4));
+		}
+		m->frame.dlc = i;
+	}
+	fclose(f);
+	return node->count;
+}
+
+/**
+ * Per-ID bus statistics since HostSimInit: frames, error frames, mean and
+ * worst latency from ready-to-send to end of frame.
+ */
+const HOST_CAN_ID_STATS* HostCanBusStats(Uint16* count) {
+	*count = bus.nids;
+	return bus.ids;
+}
+
+void HostCanBusReport(void) {
+	Uint16 i;
+
+	printf("%-10s %8s %8s %10s %10s\n", "id", "frames", "errors", "mean us", "worst us");
+	for (i = 0; i < bus.nids; i++) {
+		const HOST_CAN_ID_STATS* s = &bus.ids[i];
+		char id[12];
+		if (s->id & CAN_IDE) sprintf(id, "%08lX", (unsigned long)(s->id & CAN_ID_MASK));
+		else sprintf(id, "%03lX", (unsigned long)(s->id >> 18));
+		printf("%-10s %8lu %8lu %10lu %10lu\n", id, (unsigned long)s->frames, (unsigned long)s->errors,
+				(unsigned long)(s->frames ? s->total_us / s->frames : 0), (unsigned long)s->worst_us);
+	}
+}
+
+static HOST_MODEL ECanModel = {&ECanaRegs, sizeof(ECanaRegs), CanBusReset, ECanStep, ECanAccess, 0};
+
+//---------------------------------------------------------------------------
+// SCI-A/B
+//
+typedef struct {
+	char scisys;
+	volatile struct SCI_REGS* regs;
+	Uint16 group_rx, intx_rx;	//PIE position of SCIRXINTx; SCITXINTx follows it
+	Uint16 tx[4], txn;			//transmit FIFO (TXBUF when FIFOs are off)
+	Uint16 shift, shifting;		//transmit shift register
+	Uint32 tx_busy;
+	Uint16 rx[4], rxn;			//receive FIFO (RXBUF when FIFOs are off)
+	Uint32 rx_busy;
+	Uint16 txint, rxint, ovf, oe;
+	Uint16 tx_out, rx_out;		//interrupt lines into the PIE
+	Uint16 queue[HOST_QUEUE_SIZE];
+	volatile Uint16 head, tail;
+	HOST_MODEL model;
+} HOST_SCI;
+
+static HOST_SCI Scis[2];
+
+static HOST_SCI* SciOf(volatile void* reg) {
+	if ((volatile char*)reg >= (volatile char*)&ScibRegs &&
+			(volatile char*)reg < (volatile char*)(&ScibRegs + 1)) {
+		return &Scis[1];
+	}
+	return &Scis[0];
+}
+
+static Uint16 SciFifo(HOST_SCI* s) {
+	return s->regs->SCIFFTX.bit.SCIFFENA && s->regs->SCIFFTX.bit.SCIRST;
+}
+
+static Uint16 SciDepth(HOST_SCI* s) {
+	return SciFifo(s) ? 4 : 1;
+}
+
+static Uint32 SciCharTicks(HOST_SCI* s) {
+	Uint32 brr = (Uint32)s->regs->SCIHBAUD << 8 | s->regs->SCILBAUD;
+	Uint32 bit = (brr ? (brr + 1)*8 : 16) * LspClkDivider();
+	union SCICCR_REG ccr = s->regs->SCICCR;
+	Uint32 bits = 1 + (ccr.bit.SCICHAR + 1) + ccr.bit.PARITYENA + ccr.bit.STOPBITS + 1;
+	return Ticks((Uint64)bits * bit);
+}
+
+static void SciSync(HOST_SCI* s) {
+	Uint16 tx_out, rx_out;
+
+	if (SciFifo(s)) {
+		if (s->txn <= s->regs->SCIFFTX.bit.TXFFIL) s->txint = 1;
+		if (s->rxn >= s->regs->SCIFFRX.bit.RXFFIL) s->rxint = 1;
+	}
+	s->regs->SCIFFTX.bit.TXFFST = s->txn;
+	s->regs->SCIFFTX.bit.TXFFINT = s->txint;
+	s->regs->SCIFFTX.bit.TXFFINTCLR = 0;
+	s->regs->SCIFFRX.bit.RXFFST = s->rxn;
+	s->regs->SCIFFRX.bit.RXFFINT = s->rxint;
+	s->regs->SCIFFRX.bit.RXFFINTCLR = 0;
+	s->regs->SCIFFRX.bit.RXFFOVRCLR = 0;
+	s->regs->SCIFFRX.bit.RXFFOVF = s->ovf;
+	s->regs->SCICTL2.bit.TXRDY = s->txn < SciDepth(s);
+	s->regs->SCICTL2.bit.TXEMPTY = !s->txn && !s->shifting;
+	s->regs->SCIRXST.bit.RXRDY = s->rxn > 0;
+	s->regs->SCIRXST.bit.OE = s->oe;
+	s->regs->SCIRXST.bit.RXERROR = s->oe;
+	if (s->rxn) s->regs->SCIRXBUF.all = s->rx[0];
+
+	if (SciFifo(s)) {
+		tx_out = s->txint && s->regs->SCIFFTX.bit.TXFFIENA;
+		rx_out = s->rxint && s->regs->SCIFFRX.bit.RXFFIENA;
+	} else {
+		tx_out = s->regs->SCICTL2.bit.TXRDY && s->regs->SCICTL2.bit.TXINTENA;
+		rx_out = s->rxn && s->regs->SCICTL2.bit.RXBKINTENA;
+	}
+	if (rx_out && !s->rx_out) HostSimRaise(s->group_rx, s->intx_rx);
+	if (tx_out && !s->tx_out) HostSimRaise(s->group_rx, s->intx_rx + 1);
+	s->rx_out = rx_out;
+	s->tx_out = tx_out;
+}
+
+static void SciFlush(HOST_SCI* s) {
+	s->txn = s->rxn = 0;
+	s->shifting = 0;
+	s->txint = s->rxint = s->ovf = s->oe = 0;
+}
+
+static void SciReset(void) {
+	Uint16 i;
+	for (i = 0; i < 2; i++) {
+		HOST_SCI* s = &Scis[i];
+		SciFlush(s);
+		s->head = s->tail = 0;
+		s->tx_out = s->rx_out = 0;
+		s->regs->SCIFFTX.all = 0xA000;
+		s->regs->SCIFFRX.all = 0x201F;
+		SciSync(s);
+	}
+}
+
+static void SciAccess(volatile void* reg, Uint16 write) {
+	HOST_SCI* s = SciOf(reg);
+
+	if (!write) {
+		if (reg == &s->regs->SCIRXBUF && s->rxn) {//a read pops the FIFO
+			memmove(s->rx, s->rx + 1, --s->rxn * sizeof(s->rx[0]));
+			if (!SciFifo(s)) s->oe = 0;
+			SciSync(s);
+		}
+		return;
+	}
+
+	if (reg == &s->regs->SCITXBUF) {
+		if (s->txn < SciDepth(s)) s->tx[s->txn++] = s->regs->SCITXBUF & 0xFF;
+	} else if (reg == &s->regs->SCIFFTX) {
+		if (s->regs->SCIFFTX.bit.TXFFINTCLR) s->txint = 0;
+		if (!s->regs->SCIFFTX.bit.TXFIFOXRESET) s->txn = 0;
+	} else if (reg == &s->regs->SCIFFRX) {
+		if (s->regs->SCIFFRX.bit.RXFFINTCLR) s->rxint = 0;
+		if (s->regs->SCIFFRX.bit.RXFFOVRCLR) s->ovf = 0;
+		if (!s->regs->SCIFFRX.bit.RXFIFORESET) s->rxn = 0;
+	} else if (reg == &s->regs->SCICTL1) {
+		if (!s->regs->SCICTL1.bit.SWRESET) SciFlush(s);
+	}
+	SciSync(s);
+}
+
+static void SciReceive(HOST_SCI* s, Uint16 data) {
+	if (s->rxn < SciDepth(s)) {
+		s->rx[s->rxn++] = data & 0xFF;
+	} else if (SciFifo(s)) {
+		s->ovf = 1;
+	} else {
+		s->rx[0] = data & 0xFF;//overrun: the new character wins
+		s->oe = 1;
+	}
+}
+
+static void SciStep(HOST_SCI* s) {
+	Uint16 running = s->regs->SCICTL1.bit.SWRESET;
+
+	if (running && s->regs->SCICTL1.bit.TXENA) {
+		if (s->shifting && --s->tx_busy == 0) {
+			s->shifting = 0;
+			if (HostSciTxHook) HostSciTxHook(s->scisys, s->shift);
+			if (s->regs->SCICCR.bit.LOOPBKENA) SciReceive(s, s->shift);
+		}
+		if (!s->shifting && s->txn) {
+			s->shift = s->tx[0];
+			memmove(s->tx, s->tx + 1, --s->txn * sizeof(s->tx[0]));
+			s->shifting = 1;
+			s->tx_busy = SciCharTicks(s);
+		}
+	}
+
+	if (s->rx_busy) {
+		s->rx_busy--;
+	} else if (s->head != s->tail) {
+		if (running && s->regs->SCICTL1.bit.RXENA) SciReceive(s, s->queue[s->tail]);
+		s->tail = (s->tail + 1) % HOST_QUEUE_SIZE;
+		s->rx_busy = SciCharTicks(s) - 1;//the next one is a character time away
+	}
+	SciSync(s);
+}
+
+static void SciaStep(void) {
+	SciStep(&Scis[0]);
+}
+
+static void ScibStep(void) {
+	SciStep(&Scis[1]);
+}
+
+/**
+ * Send a byte to SCI-A ('A') or SCI-B ('B'). Bytes arrive one character time
+ * apart at whatever baud rate the port is set to.
+ */
+void HostSciInject(char scisys, Uint16 data) {
+	HOST_SCI* s = (scisys == 'b' || scisys == 'B') ? &Scis[1] : &Scis[0];
+	Uint16 next = (s->head + 1) % HOST_QUEUE_SIZE;
+	if (next == s->tail) return;
+	s->queue[s->head] = data;
+	s->head = next;
+}
+
+//---------------------------------------------------------------------------
+// SPI-A/B
+//
+typedef struct {
+	char spisys;
+	volatile struct SPI_REGS* regs;
+	Uint16 intx_rx;				//PIE position of SPIRXINTx in group 6; SPITXINTx follows it
+	Uint16 tx[4], txn;			//transmit FIFO (TXBUF when FIFOs are off)
+	Uint16 shift, shifting;
+	Uint32 busy;
+	Uint16 rx[4], rxn;			//receive FIFO (RXBUF when FIFOs are off)
+	Uint16 txint, rxint, ovf;	//FIFO interrupt and overflow flags
+	Uint16 flag, overrun;		//SPISTS, without FIFOs
+	Uint16 tx_out, rx_out;		//interrupt lines into the PIE
+	HOST_MODEL model;
+} HOST_SPI;
+
+static HOST_SPI Spis[2];
+
+static HOST_SPI* SpiOf(volatile void* reg) {
+	if ((volatile char*)reg >= (volatile char*)&SpibRegs &&
+			(volatile char*)reg < (volatile char*)(&SpibRegs + 1)) {
+		return &Spis[1];
+	}
+	return &Spis[0];
+}
+
+static Uint16 SpiFifo(HOST_SPI* s) {
+	return s->regs->SPIFFTX.bit.SPIFFENA && s->regs->SPIFFTX.bit.SPIRST;
+}
+
+static Uint16 SpiDepth(HOST_SPI* s) {
+	return SpiFifo(s) ? 4 : 1;
+}
+
+static Uint16 SpiBits(HOST_SPI* s) {
+	return s->regs->SPICCR.bit.SPICHAR + 1;
+}
+
+static Uint32 SpiCharTicks(HOST_SPI* s) {
+	Uint16 brr = s->regs->SPIBRR & 0x7F;
+	return Ticks((Uint64)SpiBits(s) * (brr < 3 ? 4 : brr + 1) * LspClkDivider());
+}
+
+static void SpiSync(HOST_SPI* s) {
+	Uint16 tx_out, rx_out;
+
+	if (SpiFifo(s)) {
+		if (s->txn <= s->regs->SPIFFTX.bit.TXFFIL) s->txint = 1;
+		if (s->rxn >= s->regs->SPIFFRX.bit.RXFFIL) s->rxint = 1;
+	}
+	s->regs->SPIFFTX.bit.TXFFST = s->txn;
+	s->regs->SPIFFTX.bit.TXFFINT = s->txint;
+	s->regs->SPIFFTX.bit.TXFFINTCLR = 0;
+	s->regs->SPIFFRX.bit.RXFFST = s->rxn;
+	s->regs->SPIFFRX.bit.RXFFINT = s->rxint;
+	s->regs->SPIFFRX.bit.RXFFINTCLR = 0;
+	s->regs->SPIFFRX.bit.RXFFOVFCLR = 0;
+	s->regs->SPIFFRX.bit.RXFFOVF = s->ovf;
+	s->regs->SPISTS.bit.INT_FLAG = s->flag;
+	s->regs->SPISTS.bit.OVERRUN_FLAG = s->overrun;
+	s->regs->SPISTS.bit.BUFFULL_FLAG = !SpiFifo(s) && s->txn;
+	if (s->rxn) s->regs->SPIRXBUF = s->rx[0];
+
+	if (SpiFifo(s)) {
+		tx_out = s->txint && s->regs->SPIFFTX.bit.TXFFIENA;
+		rx_out = s->rxint && s->regs->SPIFFRX.bit.RXFFIENA;
+	} else {
+		tx_out = 0;
+		rx_out = s->flag && s->regs->SPICTL.bit.SPIINTENA;
+	}
+	if (rx_out && !s->rx_out) HostSimRaise(6, s->intx_rx);
+	if (tx_out && !s->tx_out) HostSimRaise(6, s->intx_rx + 1);
+	s->rx_out = rx_out;
+	s->tx_out = tx_out;
+}
+
+static void SpiReset(void) {
+	Uint16 i;
+	for (i = 0; i < 2; i++) {
+		HOST_SPI* s = &Spis[i];
+		s->txn = s->rxn = 0;
+		s->shifting = 0;
+		s->txint = s->rxint = s->ovf = s->flag = s->overrun = 0;
+		s->tx_out = s->rx_out = 0;
+		s->regs->SPIFFTX.all = 0xA000;
+		s->regs->SPIFFRX.all = 0x201F;
+		SpiSync(s);
+	}
+}
+
+static void SpiAccess(volatile void* reg, Uint16 write) {
+	HOST_SPI* s = SpiOf(reg);
+
+	if (!write) {
+		if (reg == &s->regs->SPIRXBUF && s->rxn) {//a read pops the FIFO
+			memmove(s->rx, s->rx + 1, --s->rxn * sizeof(s->rx[0]));
+			s->flag = 0;
+			SpiSync(s);
+		}
+		return;
+	}
+
+	if (reg == &s->regs->SPITXBUF || reg == &s->regs->SPIDAT) {
+		Uint16 data = reg == &s->regs->SPITXBUF ? s->regs->SPITXBUF : s->regs->SPIDAT;
+		if (s->txn < SpiDepth(s)) s->tx[s->txn++] = data;
+	} else if (reg == &s->regs->SPIFFTX) {
+		if (s->regs->SPIFFTX.bit.TXFFINTCLR) s->txint = 0;
+		if (!s->regs->SPIFFTX.bit.TXFIFO) s->txn = 0;
+	} else if (reg == &s->regs->SPIFFRX) {
+		if (s->regs->SPIFFRX.bit.RXFFINTCLR) s->rxint = 0;
+		if (s->regs->SPIFFRX.bit.RXFFOVFCLR) s->ovf = 0;
+		if (!s->regs->SPIFFRX.bit.RXFIFORESET) s->rxn = 0;
+	} else if (reg == &s->regs->SPICCR) {
+		if (!s->regs->SPICCR.bit.SPISWRESET) {//clears the flags, not the FIFOs
+			s->shifting = 0;
+			s->flag = s->overrun = 0;
+		}
+	}
+	SpiSync(s);
+}
+
+static void SpiStep(HOST_SPI* s) {
+	if (!s->regs->SPICCR.bit.SPISWRESET || !s->regs->SPICTL.bit.MASTER_SLAVE) return;
+
+	if (s->shifting && --s->busy == 0) {
+		Uint16 bits = SpiBits(s);
+		Uint16 mask = bits == 16 ? 0xFFFF : (1 << bits) - 1;
+		Uint16 out = (s->shift >> (16 - bits)) & mask;//characters are sent MSB first, left-justified
+		Uint16 in = s->regs->SPICCR.bit.SPILBK ? out :
+				HostSpiTransferHook ? HostSpiTransferHook(s->spisys, out, bits) : 0xFFFF;
+
+		s->shifting = 0;
+		if (s->rxn < SpiDepth(s)) {
+			s->rx[s->rxn++] = in & mask;
+		} else if (SpiFifo(s)) {
+			s->ovf = 1;
+		} else {
+			s->rx[0] = in & mask;//overrun: the new character wins
+			s->overrun = 1;
+		}
+		s->flag = 1;
+	}
+	if (!s->shifting && s->txn) {
+		s->shift = s->tx[0];
+		memmove(s->tx, s->tx + 1, --s->txn * sizeof(s->tx[0]));
+		s->shifting = 1;
+		s->busy = SpiCharTicks(s);
+	}
+	SpiSync(s);
+}
+
+static void SpiaStep(void) {
+	SpiStep(&Spis[0]);
+}
+
+static void SpibStep(void) {
+	SpiStep(&Spis[1]);
+}
+
+//---------------------------------------------------------------------------
+// DMA
+//
+#define DMA_CHANNELS	6
+
+typedef struct {
+	volatile struct CH_REGS* regs;
+	Uint16 running;				//RUNSTS
+	Uint16 active;				//TRANSFERSTS: the shadow addresses have been taken
+	Uint16 flag, overflow;		//PERINTFLG, OVRFLG
+	Uint16 bursts;				//left in the current transfer
+	Uint16 src_wrap, dst_wrap;	//bursts left before the addresses wrap
+} HOST_DMA;
+
+static HOST_DMA Dmas[DMA_CHANNELS];
+
+static void DmaSync(HOST_DMA* c) {
+	c->regs->CONTROL.all = 0;//RUN, HALT, SOFTRESET, PERINTFRC, PERINTCLR and ERRCLR read as 0
+	c->regs->CONTROL.bit.PERINTFLG = c->flag;
+	c->regs->CONTROL.bit.TRANSFERSTS = c->active;
+	c->regs->CONTROL.bit.RUNSTS = c->running;
+	c->regs->CONTROL.bit.OVRFLG = c->overflow;
+	c->regs->TRANSFER_COUNT = c->bursts ? c->bursts - 1 : 0;
+	c->regs->SRC_WRAP_COUNT = c->src_wrap;
+	c->regs->DST_WRAP_COUNT = c->dst_wrap;
+}
+
+static void DmaReset(void) {
+	Uint16 i;
+	for (i = 0; i < DMA_CHANNELS; i++) {
+		HOST_DMA* c = &Dmas[i];
+		c->running = c->active = 0;
+		c->flag = c->overflow = 0;
+		c->bursts = 0;
+		c->src_wrap = c->dst_wrap = 0;
+		DmaSync(c);
+	}
+}
+
+//One word (two with DATASIZE), moved like the CPU would: the models of both ends see the access.
+static void DmaMove(volatile struct CH_REGS* ch) {
+	volatile Uint16* src = HostDmaPointer(ch->SRC_ADDR_ACTIVE);
+	volatile Uint16* dst = HostDmaPointer(ch->DST_ADDR_ACTIVE);
+	Uint16 n = ch->MODE.bit.DATASIZE ? 2 : 1, i;
+
+	for (i = 0; i < n; i++) {
+		Uint16 data = src[i];
+		HostSimBusAccess(&src[i], 0);
+		dst[i] = data;
+		HostSimBusAccess(&dst[i], 1);
+	}
+}
+
+static void DmaBurst(HOST_DMA* c) {
+	volatile struct CH_REGS* ch = c->regs;
+	Uint16 channel = c - Dmas + 1;//DINTCHn is PIE 7.n
+	Uint16 words = ch->BURST_SIZE.bit.BURSTSIZE + 1, i;
+
+	if (!c->active) {
+		ch->SRC_BEG_ADDR_ACTIVE = ch->SRC_BEG_ADDR_SHADOW;
+		ch->SRC_ADDR_ACTIVE = ch->SRC_ADDR_SHADOW;
+		ch->DST_BEG_ADDR_ACTIVE = ch->DST_BEG_ADDR_SHADOW;
+		ch->DST_ADDR_ACTIVE = ch->DST_ADDR_SHADOW;
+		c->bursts = ch->TRANSFER_SIZE + 1;
+		c->src_wrap = ch->SRC_WRAP_SIZE;
+		c->dst_wrap = ch->DST_WRAP_SIZE;
+		c->active = 1;
+		if (ch->MODE.bit.CHINTE && !ch->MODE.bit.CHINTMODE) HostSimRaise(7, channel);
+	}
+
+	for (i = 0; i < words; i += ch->MODE.bit.DATASIZE ? 2 : 1) {
+		DmaMove(ch);
+		if (i + 1 < words) {
+			ch->SRC_ADDR_ACTIVE += ch->SRC_BURST_STEP;
+			ch->DST_ADDR_ACTIVE += ch->DST_BURST_STEP;
+		}
+	}
+	if (c->src_wrap) {
+		c->src_wrap--;
+		ch->SRC_ADDR_ACTIVE += ch->SRC_TRANSFER_STEP;
+	} else {
+		ch->SRC_BEG_ADDR_ACTIVE += ch->SRC_WRAP_STEP;
+		ch->SRC_ADDR_ACTIVE = ch->SRC_BEG_ADDR_ACTIVE;
+		c->src_wrap = ch->SRC_WRAP_SIZE;
+	}
+	if (c->dst_wrap) {
+		c->dst_wrap--;
+		ch->DST_ADDR_ACTIVE += ch->DST_TRANSFER_STEP;
+	} else {
+		ch->DST_BEG_ADDR_ACTIVE += ch->DST_WRAP_STEP;
+		ch->DST_ADDR_ACTIVE = ch->DST_BEG_ADDR_ACTIVE;
+		c->dst_wrap = ch->DST_WRAP_SIZE;
+	}
+
+	if (--c->bursts == 0) {
+		c->active = 0;
+		if (!ch->MODE.bit.CONTINUOUS) c->running = 0;
+		if (ch->MODE.bit.CHINTE && ch->MODE.bit.CHINTMODE) HostSimRaise(7, channel);
+	}
+}
+
+//A pending event is served as soon as the channel runs: one burst, or the whole transfer with ONESHOT.
+static void DmaService(HOST_DMA* c) {
+	if (c->running && c->flag) {
+		c->flag = 0;
+		do {
+			DmaBurst(c);
+		} while (c->regs->MODE.bit.ONESHOT && c->active);
+	}
+	DmaSync(c);
+}
+
+static void DmaTrigger(HOST_DMA* c) {
+	if (c->flag) {
+		c->overflow = 1;
+		if (c->regs->MODE.bit.OVRINTE) HostSimRaise(7, c - Dmas + 1);
+	}
+	c->flag = 1;
+	DmaService(c);
+}
+
+//A peripheral interrupt (PERINTSEL value) reaches every channel listening for it.
+static void DmaEvent(Uint16 perintsel) {
+	Uint16 i;
+	for (i = 0; i < DMA_CHANNELS; i++) {
+		if (Dmas[i].regs->MODE.bit.PERINTE && Dmas[i].regs->MODE.bit.PERINTSEL == perintsel) {
+			DmaTrigger(&Dmas[i]);
+		}
+	}
+}
+
+static void DmaAccess(volatile void* reg, Uint16 write) {
+	Uint16 i;
+
+	if (!write) return;
+	if (reg == &DmaRegs.DMACTRL) {
+		if (DmaRegs.DMACTRL.bit.HARDRESET) DmaReset();
+		DmaRegs.DMACTRL.all = 0;
+		return;
+	}
+	for (i = 0; i < DMA_CHANNELS; i++) {
+		HOST_DMA* c = &Dmas[i];
+		union CONTROL_REG control;
+
+		if (reg != &c->regs->CONTROL) continue;
+		control.all = c->regs->CONTROL.all;
+		if (control.bit.SOFTRESET) {
+			c->active = 0;
+			c->bursts = 0;
+		}
+		if (control.bit.PERINTCLR) c->flag = 0;
+		if (control.bit.ERRCLR) c->overflow = 0;
+		if (control.bit.HALT) c->running = 0;
+		if (control.bit.RUN) c->running = 1;
+		if (control.bit.PERINTFRC) {
+			DmaTrigger(c);
+		} else {
+			DmaService(c);
+		}
+	}
+}
+
+static HOST_MODEL DmaModel = {&DmaRegs, sizeof(DmaRegs), DmaReset, 0, DmaAccess, 0};
+
+//---------------------------------------------------------------------------
+// McBSP-A
+//
+static struct {
+	Uint16 dxr_full;			//DXR1 waiting for the shift register
+	Uint16 shift, shifting;
+	Uint32 busy;
+	Uint16 rrdy, rfull;
+	Uint16 xrdy_out, rrdy_out;	//events already given to the DMA and the PIE
+} mcbsp;
+
+static Uint16 McbspBits(void) {
+	static const Uint16 bits[8] = {8, 12, 16, 20, 24, 32, 16, 16};
+	Uint16 n = bits[McbspaRegs.XCR1.bit.XWDLEN1];
+	return n > 16 ? 16 : n;//only DXR1/DRR1 are modelled
+}
+
+static Uint16 McbspClockStop(void) {
+	return McbspaRegs.SPCR1.bit.CLKSTP >= 2 && McbspaRegs.PCR.bit.CLKXM;
+}
+
+static void McbspSync(void) {
+	Uint16 xrdy = McbspaRegs.SPCR2.bit.XRST && !mcbsp.dxr_full;
+	Uint16 rrdy = McbspaRegs.SPCR1.bit.RRST && mcbsp.rrdy;
+	Uint16 xrise = xrdy && !mcbsp.xrdy_out, rrise = rrdy && !mcbsp.rrdy_out;
+
+	McbspaRegs.SPCR2.bit.XRDY = xrdy;
+	McbspaRegs.SPCR2.bit.XEMPTY = mcbsp.dxr_full || mcbsp.shifting;//active low
+	McbspaRegs.SPCR1.bit.RRDY = rrdy;
+	McbspaRegs.SPCR1.bit.RFULL = mcbsp.rfull;
+	mcbsp.xrdy_out = xrdy;
+	mcbsp.rrdy_out = rrdy;
+
+	//Last, since the DMA answers right away and that comes back in here
+	if (rrise) {
+		if (McbspaRegs.MFFINT.bit.RINT) HostSimRaise(6, 5);//MRINTA
+		DmaEvent(DMA_MREVTA);
+	}
+	if (xrise) {
+		if (McbspaRegs.MFFINT.bit.XINT) HostSimRaise(6, 6);//MXINTA
+		DmaEvent(DMA_MXEVTA);
+	}
+}
+
+static void McbspReset(void) {
+	memset(&mcbsp, 0, sizeof(mcbsp));
+	McbspSync();
+}
+
+static void McbspAccess(volatile void* reg, Uint16 write) {
+	if (!write) {
+		if (reg == &McbspaRegs.DRR1) {
+			mcbsp.rrdy = 0;
+			mcbsp.rfull = 0;
+			McbspSync();
+		}
+		return;
+	}
+
+	if (reg == &McbspaRegs.DXR1) {
+		if (McbspaRegs.SPCR2.bit.XRST) mcbsp.dxr_full = 1;
+	} else if (reg == &McbspaRegs.SPCR2) {
+		if (!McbspaRegs.SPCR2.bit.XRST) mcbsp.dxr_full = mcbsp.shifting = 0;
+	} else if (reg == &McbspaRegs.SPCR1) {
+		if (!McbspaRegs.SPCR1.bit.RRST) mcbsp.rrdy = mcbsp.rfull = 0;
+	}
+	McbspSync();
+}
+
+static void McbspStep(void) {
+	Uint16 bits = McbspBits();
+	Uint16 mask = bits == 16 ? 0xFFFF : (1 << bits) - 1;
+
+	if (!McbspaRegs.SPCR2.bit.XRST || !McbspaRegs.SPCR2.bit.GRST || !McbspaRegs.SPCR2.bit.FRST ||
+			!McbspClockStop()) {
+		return;
+	}
+
+	if (mcbsp.shifting && --mcbsp.busy == 0) {
+		Uint16 out = mcbsp.shift & mask;
+		Uint16 in = McbspaRegs.SPCR1.bit.DLB ? out :
+				HostSpiTransferHook ? HostSpiTransferHook('M', out, bits) : 0xFFFF;
+
+		mcbsp.shifting = 0;
+		if (McbspaRegs.SPCR1.bit.RRST) {
+			if (mcbsp.rrdy) {
+				mcbsp.rfull = 1;//DRR1 was not read in time: the new word is lost
+			} else {
+				McbspaRegs.DRR1.all = in & mask;
+				mcbsp.rrdy = 1;
+			}
+		}
+	}
+	if (!mcbsp.shifting && mcbsp.dxr_full) {
+		mcbsp.shift = McbspaRegs.DXR1.all;
+		mcbsp.dxr_full = 0;
+		mcbsp.shifting = 1;
+		mcbsp.busy = Ticks((Uint64)bits * (McbspaRegs.SRGR1.bit.CLKGDV + 1) * LspClkDivider());
+	}
+	McbspSync();
+}
+
+static HOST_MODEL McbspModel = {&McbspaRegs, sizeof(McbspaRegs), McbspReset, McbspStep, McbspAccess, 0};
+
+//---------------------------------------------------------------------------
+// I2C-A
+//
+#define I2C_ARBL	0x0001
+#define I2C_NACK	0x0002
+#define I2C_ARDY	0x0004
+#define I2C_RRDY	0x0008
+#define I2C_XRDY	0x0010
+#define I2C_SCD		0x0020
+#define I2C_XSMT	0x0400
+#define I2C_BB		0x1000
+#define I2C_W1C		(I2C_ARBL | I2C_NACK | I2C_ARDY | I2C_RRDY | I2C_SCD)
+
+enum {I2C_IDLE, I2C_ADDRESS, I2C_TRANSMIT, I2C_RECEIVE};
+
+static struct {
+	Uint16 str;					//I2CSTR as the hardware sees it
+	Uint16 state;
+	Uint32 busy;				//ticks left on the byte being shifted
+	Uint16 shifting;
+	Uint16 dxr_full;
+	Uint16 shift;
+	Uint16 active;				//enabled flags already signalled on I2CINT1A
+	Uint16 count;				//internal data counter (non-repeat mode)
+	Uint16 nacked;
+	Uint16 first;				//next byte written is the register pointer
+	Uint16 txf[4], txn;			//FIFOs, used while I2CFFEN is set
+	Uint16 rxf[4], rxn;
+	Uint16 txint, rxint;		//FIFO interrupt flags
+	Uint16 fifo_out;			//I2CINT2A line into the PIE
+	HOST_I2C_SLAVE* slave;
+	HOST_I2C_SLAVE* slaves;
+} i2c;
+
+static Uint16 I2cFifo(void) {
+	return I2caRegs.I2CFFTX.bit.I2CFFEN;
+}
+
+static Uint32 I2cByteTicks(void) {
+	Uint16 ipsc = I2caRegs.I2CPSC.bit.IPSC;
+	Uint16 d = ipsc == 0 ? 7 : (ipsc == 1 ? 6 : 5);
+	Uint32 bit = ((Uint32)ipsc + 1) * (I2caRegs.I2CCLKL + d + I2caRegs.I2CCLKH + d);
+	return Ticks(9 * (Uint64)bit);//8 data bits and the acknowledge
+}
+
+static void I2cStatus(Uint16 set, Uint16 clear) {
+	Uint16 code, active;
+
+	i2c.str = (i2c.str & ~clear) | set;
+	I2caRegs.I2CSTR.all = i2c.str;
+	I2caRegs.I2CISRC.all = 0;
+	for (code = 6; code >= 1; code--) {//lowest code has the highest priority
+		if (i2c.str & I2caRegs.I2CIER.all & (1 << (code - 1))) I2caRegs.I2CISRC.all = code;
+	}
+	active = i2c.str & I2caRegs.I2CIER.all & 0x7F;
+	if (active & ~i2c.active) HostSimRaise(8, 1);//I2CINT1A
+	i2c.active = active;
+
+	if (I2cFifo()) {
+		if (i2c.txn <= I2caRegs.I2CFFTX.bit.TXFFIL) i2c.txint = 1;
+		if (i2c.rxn >= I2caRegs.I2CFFRX.bit.RXFFIL) i2c.rxint = 1;
+	}
+	I2caRegs.I2CFFTX.bit.TXFFST = i2c.txn;
+	I2caRegs.I2CFFTX.bit.TXFFINT = i2c.txint;
+	I2caRegs.I2CFFTX.bit.TXFFINTCLR = 0;
+	I2caRegs.I2CFFRX.bit.RXFFST = i2c.rxn;
+	I2caRegs.I2CFFRX.bit.RXFFINT = i2c.rxint;
+	I2caRegs.I2CFFRX.bit.RXFFINTCLR = 0;
+	if (i2c.rxn) I2caRegs.I2CDRR = i2c.rxf[0];
+	active = I2cFifo() && ((i2c.txint && I2caRegs.I2CFFTX.bit.TXFFIENA) ||
+			(i2c.rxint && I2caRegs.I2CFFRX.bit.RXFFIENA));
+	if (active && !i2c.fifo_out) HostSimRaise(8, 2);//I2CINT2A
+	i2c.fifo_out = active;
+}
+
+//A byte is waiting to be sent: in the TX FIFO, or in I2CDXR without FIFOs.
+static Uint16 I2cTxPending(void) {
+	return I2cFifo() ? i2c.txn != 0 : i2c.dxr_full;
+}
+
+static Uint16 I2cTxTake(void) {
+	Uint16 data;
+	if (!I2cFifo()) {
+		i2c.dxr_full = 0;
+		return I2caRegs.I2CDXR & 0xFF;
+	}
+	data = i2c.txf[0];
+	memmove(i2c.txf, i2c.txf + 1, --i2c.txn * sizeof(i2c.txf[0]));
+	return data & 0xFF;
+}
+
+static void I2cSlaveStart(HOST_I2C_SLAVE* slave, Uint16 read) {
+	i2c.first = !read;
+	if (slave->start) slave->start(slave, read);
+}
+
+static Uint16 I2cSlaveWrite(HOST_I2C_SLAVE* slave, Uint16 data) {
+	if (slave->write) return slave->write(slave, data);
+	if (i2c.first) {
+		slave->pointer = data & 0xFF;
+		i2c.first = 0;
+	} else {
+		slave->regs[slave->pointer] = data & 0xFF;
+		slave->pointer = (slave->pointer + 1) & 0xFF;
+	}
+	return 1;
+}
+
+static Uint16 I2cSlaveRead(HOST_I2C_SLAVE* slave) {
+	Uint16 data;
+	if (slave->read) return slave->read(slave) & 0xFF;
+	data = slave->regs[slave->pointer];
+	slave->pointer = (slave->pointer + 1) & 0xFF;
+	return data;
+}
+
+static void I2cReset(void) {//IRS = 0; the FIFO registers keep their settings
+	HOST_I2C_SLAVE* slaves = i2c.slaves;
+	memset(&i2c, 0, sizeof(i2c));
+	i2c.slaves = slaves;
+	I2cStatus(I2C_XRDY | I2C_XSMT, 0xFFFF);
+}
+
+static void I2cPowerOn(void) {
+	I2caRegs.I2CFFTX.all = 0;
+	I2caRegs.I2CFFRX.all = 0;
+	I2cReset();
+}
+
+static void I2cStop(void) {
+	if (i2c.slave && !i2c.nacked && i2c.slave->stop) i2c.slave->stop(i2c.slave);
+	I2caRegs.I2CMDR.all &= ~0x0C00;//STP, MST
+	i2c.state = I2C_IDLE;
+	i2c.slave = 0;
+	i2c.shifting = 0;
+	I2cStatus(I2C_SCD, I2C_BB);
+}
+
+static void I2cStart(void) {
+	HOST_I2C_SLAVE* slave;
+	for (slave = i2c.slaves; slave && slave->address != (I2caRegs.I2CSAR & 0x7F); slave = slave->next) {}
+	I2caRegs.I2CMDR.bit.STT = 0;
+	i2c.slave = slave;
+	i2c.state = I2C_ADDRESS;
+	i2c.nacked = 0;
+	i2c.shifting = 1;
+	i2c.busy = I2cByteTicks();
+	i2c.count = I2caRegs.I2CCNT;
+	I2cStatus(I2C_BB, I2C_ARDY | I2C_NACK);
+}
+
+static void I2cByteDone(void) {
+	Uint16 rm = I2caRegs.I2CMDR.bit.RM;
+
+	i2c.shifting = 0;
+	switch (i2c.state) {
+	case I2C_ADDRESS:
+		if (!i2c.slave) {
+			i2c.nacked = 1;
+			i2c.state = I2C_TRANSMIT;
+			I2cStatus(I2C_NACK | I2C_ARDY, 0);
+			return;
+		}
+		I2cSlaveStart(i2c.slave, !I2caRegs.I2CMDR.bit.TRX);
+		if (I2caRegs.I2CMDR.bit.TRX) {
+			i2c.state = I2C_TRANSMIT;
+			if (!I2cTxPending() && (rm || !i2c.count)) I2cStatus(I2C_ARDY, 0);
+		} else {
+			i2c.state = I2C_RECEIVE;
+		}
+		break;
+	case I2C_TRANSMIT:
+		if (!I2cSlaveWrite(i2c.slave, i2c.shift)) {
+			i2c.nacked = 1;
+			I2cStatus(I2C_NACK | I2C_ARDY, 0);
+			return;
+		}
+		if (!rm && i2c.count) I2caRegs.I2CCNT = --i2c.count;
+		if (!I2cTxPending() && (rm || !i2c.count)) I2cStatus(I2C_ARDY, 0);
+		break;
+	case I2C_RECEIVE:
+		if (I2cFifo()) {
+			i2c.rxf[i2c.rxn++] = I2cSlaveRead(i2c.slave);
+		} else {
+			I2caRegs.I2CDRR = I2cSlaveRead(i2c.slave);
+		}
+		if (!rm && i2c.count) I2caRegs.I2CCNT = --i2c.count;
+		I2cStatus((I2cFifo() ? 0 : I2C_RRDY) | ((!rm && !i2c.count) ? I2C_ARDY : 0), 0);
+		break;
+	}
+}
+
+static void I2cStep(void) {
+	Uint16 rm = I2caRegs.I2CMDR.bit.RM;
+
+	if (i2c.state == I2C_IDLE) return;
+	if (i2c.shifting) {
+		if (--i2c.busy) return;
+		I2cByteDone();
+	}
+
+	if (i2c.state == I2C_TRANSMIT && !i2c.nacked && I2cTxPending() && (rm || i2c.count)) {
+		i2c.shift = I2cTxTake();
+		i2c.shifting = 1;
+		i2c.busy = I2cByteTicks();
+		I2cStatus(I2cFifo() ? 0 : I2C_XRDY, 0);
+		return;
+	}
+	if (i2c.state == I2C_RECEIVE && (I2cFifo() ? i2c.rxn < 4 : !(i2c.str & I2C_RRDY)) && (rm || i2c.count)) {
+		i2c.shifting = 1;//the slave holds the next byte until there is room for it
+		i2c.busy = I2cByteTicks();
+		return;
+	}
+	if (I2caRegs.I2CMDR.bit.STP && (i2c.nacked || (!I2cTxPending() && (rm || !i2c.count)))) {
+		I2cStop();
+	}
+}
+
+static void I2cAccess(volatile void* reg, Uint16 write) {
+	if (!write) {
+		if (reg == &I2caRegs.I2CDRR && I2cFifo()) {
+			if (i2c.rxn) memmove(i2c.rxf, i2c.rxf + 1, --i2c.rxn * sizeof(i2c.rxf[0]));//a read pops the FIFO
+			I2cStatus(0, 0);
+		} else if (reg == &I2caRegs.I2CDRR) {
+			I2cStatus(0, I2C_RRDY);
+		} else if (reg == &I2caRegs.I2CISRC && I2caRegs.I2CISRC.all) {
+			Uint16 flag = 1 << (I2caRegs.I2CISRC.all - 1);
+			I2cStatus(0, flag & ~(I2C_RRDY | I2C_XRDY));//reading the code clears its flag
+		}
+		return;
+	}
+
+	if (reg == &I2caRegs.I2CSTR) {
+		I2cStatus(0, I2caRegs.I2CSTR.all & I2C_W1C);
+	} else if (reg == &I2caRegs.I2CDXR && I2cFifo()) {
+		if (i2c.txn < 4) i2c.txf[i2c.txn++] = I2caRegs.I2CDXR;
+		I2cStatus(0, I2C_ARDY);
+	} else if (reg == &I2caRegs.I2CDXR) {
+		i2c.dxr_full = 1;
+		I2cStatus(0, I2C_XRDY | I2C_ARDY);
+	} else if (reg == &I2caRegs.I2CFFTX) {
+		if (I2caRegs.I2CFFTX.bit.TXFFINTCLR) i2c.txint = 0;
+		if (!I2caRegs.I2CFFTX.bit.TXFFRST) i2c.txn = 0;
+		I2cStatus(0, 0);
+	} else if (reg == &I2caRegs.I2CFFRX) {
+		if (I2caRegs.I2CFFRX.bit.RXFFINTCLR) i2c.rxint = 0;
+		if (!I2caRegs.I2CFFRX.bit.RXFFRST) i2c.rxn = 0;
+		I2cStatus(0, 0);
+	} else if (reg == &I2caRegs.I2CMDR) {
+		if (!I2caRegs.I2CMDR.bit.IRS) {
+			I2cReset();
+		} else if (I2caRegs.I2CMDR.bit.STT && I2caRegs.I2CMDR.bit.MST) {
+			I2cStart();
+		}
+	} else {
+		I2cStatus(0, 0);
+	}
+}
+
+/**
+ * Put a slave on the I2C-A bus. A slave with no handlers answers as a
+ * register-file device backed by its regs[] array.
+ */
+void HostI2cAddSlave(HOST_I2C_SLAVE* slave) {
+	HOST_I2C_SLAVE* s;
+	for (s = i2c.slaves; s; s = s->next) {
+		if (s == slave) return;
+	}
+	slave->next = i2c.slaves;
+	i2c.slaves = slave;
+}
+
+static HOST_MODEL I2cModel = {&I2caRegs, sizeof(I2caRegs), I2cPowerOn, I2cStep, I2cAccess, 0};
+
+//---------------------------------------------------------------------------
+
+/**
+ * Add every stock model. Called by HostSimInit; calling it again is harmless.
+ */
+void HostAddStockModels(void) {
+	static volatile struct CPUTIMER_REGS* const timer_regs[3] = {&CpuTimer0Regs, &CpuTimer1Regs, &CpuTimer2Regs};
+	Uint16 i;
+
+	for (i = 0; i < 3; i++) {
+		Timers[i].regs = timer_regs[i];
+		Timers[i].model.regs = timer_regs[i];
+		Timers[i].model.size = sizeof(*timer_regs[i]);
+		Timers[i].model.reset = i ? 0 : TimerReset;
+		Timers[i].model.step = i ? 0 : TimerStep;
+		Timers[i].model.access = TimerAccess;
+	}
+	Scis[0].scisys = 'A';
+	Scis[0].regs = &SciaRegs;
+	Scis[0].group_rx = 9;
+	Scis[0].intx_rx = 1;//SCIRXINTA 9.1, SCITXINTA 9.2
+	Scis[0].model.step = SciaStep;
+	Scis[1].scisys = 'B';
+	Scis[1].regs = &ScibRegs;
+	Scis[1].group_rx = 9;
+	Scis[1].intx_rx = 3;//SCIRXINTB 9.3, SCITXINTB 9.4
+	Scis[1].model.step = ScibStep;
+	for (i = 0; i < 2; i++) {
+		Scis[i].model.regs = Scis[i].regs;
+		Scis[i].model.size = sizeof(*Scis[i].regs);
+		Scis[i].model.reset = i ? 0 : SciReset;
+		Scis[i].model.access = SciAccess;
+	}
+
+	Spis[0].spisys = 'A';
+	Spis[0].regs = &SpiaRegs;
+	Spis[0].intx_rx = 1;//SPIRXINTA 6.1, SPITXINTA 6.2
+	Spis[0].model.step = SpiaStep;
+	Spis[1].spisys = 'B';
+	Spis[1].regs = &SpibRegs;
+	Spis[1].intx_rx = 3;//SPIRXINTB 6.3, SPITXINTB 6.4
+	Spis[1].model.step = SpibStep;
+	for (i = 0; i < 2; i++) {
+		Spis[i].model.regs = Spis[i].regs;
+		Spis[i].model.size = sizeof(*Spis[i].regs);
+		Spis[i].model.reset = i ? 0 : SpiReset;
+		Spis[i].model.access = SpiAccess;
+	}
+
+	for (i = 0; i < DMA_CHANNELS; i++) {
+		Dmas[i].regs = &DmaRegs.CH1 + i;
+	}
+
+	HostSimAddModel(&PllModel);
+	HostSimAddModel(&GpioModel);
+	for (i = 0; i < 3; i++) HostSimAddModel(&Timers[i].model);
+	HostSimAddModel(&AdcModel);
+	HostSimAddModel(&ECanModel);
+	for (i = 0; i < 2; i++) HostSimAddModel(&Scis[i].model);
+	for (i = 0; i < 2; i++) HostSimAddModel(&Spis[i].model);
+	HostSimAddModel(&I2cModel);
+	HostSimAddModel(&DmaModel);
+	HostSimAddModel(&McbspModel);
+}
+
+#endif  // DSP28_HOST
@@ -3,9 +3,91 @@
  *
  *  Created on: Jun 12, 2014
  *      Author: Alex
+ *
+ * A record is file << 8 | argument count, the line, then each argument as two
+ * words, high first. Records are only ever whole in the ring: LogWrite
+ * reserves and fills one with interrupts masked and publishes it by moving
+ * the head, LogDrain alone moves the tail.
  */
 #include "logging.h"
 
+static Uint16 LogRing[LOG_RING_WORDS];
+static volatile Uint16 LogHead = 0;
+static volatile Uint16 LogTail = 0;
+static volatile Uint32 LogDrops = 0;
+
+/**
+ * \brief Store one record. Called through the LOGn macros, from any context.
+ */
+void LogWrite(Uint16 file, Uint16 line, Uint16 count, Uint32 a, Uint32 b, Uint32 c, Uint32 d) {
+	Uint32 args[4];
+	Uint16 ier = IER;
+	Uint16 head, i;
+
+	args[0] = a;
+	args[1] = b;
+	args[2] = c;
+	args[3] = d;
+	IER = 0;
+	head = LogHead;
+	if ((Uint16)(LOG_RING_WORDS - (Uint16)(head - LogTail)) < 2 + 2*count) {
+		LogDrops++;
+		IER |= ier;
+		return;
+	}
+	LogRing[head++ & (LOG_RING_WORDS - 1)] = (file << 8) | count;
+	LogRing[head++ & (LOG_RING_WORDS - 1)] = line;
+	for (i = 0; i < count; i++) {
+		LogRing[head++ & (LOG_RING_WORDS - 1)] = args[i] >> 16;
+		LogRing[head++ & (LOG_RING_WORDS - 1)] = args[i] & 0xFFFF;
+	}
+	LogHead = head;
+	IER |= ier;
+}
+
+/**
+ * \brief The IEEE-754 bits of x, for LOG_FLOAT.
+ */
+Uint32 LogFloatBits(float32 x) {
+	union {
+		float32 f;
+		Uint32 u;
+	} bits;
+	bits.f = x;
+	return bits.u;
+}
+
+/**
+ * \brief Hand stored records, oldest first, to sink until it returns 0 or the
+ * ring is empty. A record sink refuses stays for the next call. Main loop only.
+ * \return The number of records handed over.
+ */
+Uint16 LogDrain(char (*sink)(const Uint16* record, Uint16 words)) {
+	Uint16 record[LOG_RECORD_MAX];
+	Uint16 n = 0;
+
+	while (LogTail != LogHead) {
+		Uint16 tail = LogTail;
+		Uint16 words = 2 + 2*(LogRing[tail & (LOG_RING_WORDS - 1)] & 0xFF);
+		Uint16 i;
+
+		for (i = 0; i < words; i++) {
+			record[i] = LogRing[tail++ & (LOG_RING_WORDS - 1)];
+		}
+		if (!sink(record, words)) break;
+		LogTail = tail;
+		n++;
+	}
+	return n;
+}
+
+/**
+ * \brief Records lost to a full ring since reset.
+ */
+Uint32 LogDropped(void) {
+	return LogDrops;
+}
+
 /**
  * \brief Log a string.
  */
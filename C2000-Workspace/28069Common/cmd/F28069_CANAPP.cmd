@@ -0,0 +1,115 @@
+/*
+//###########################################################################
+//
+// FILE:    F28069_CANAPP.cmd
+//
+// TITLE:   Linker Command File For applications loaded by the CAN bootloader
+//
+//###########################################################################
+*/
+
+/* ======================================================
+// Use with F2806x_Headers_nonBIOS.cmd and F2806x_CodeStartBranch.asm, in
+// place of F28069_FLASH.cmd, for an application that CAN_boot.c programs.
+//
+// FLASHA belongs to the bootloader and is left out. The bootloader jumps
+// to APP_BEGIN, the first two words of FLASHH, where codestart goes just
+// as it goes to BEGIN in F28069_FLASH.cmd. The last 8 words of FLASHB hold
+// the header the bootloader writes once the image checks out; nothing may
+// be linked there. Flash the image with the bootloader, not the debugger,
+// or the header is never written and the bootloader will not start it.
+========================================================= */
+
+MEMORY
+{
+PAGE 0 :   /* Program Memory */
+   RAML0       : origin = 0x008000, length = 0x000800     /* on-chip RAM block L0 */
+   RAML1       : origin = 0x008800, length = 0x000400     /* on-chip RAM block L1 */
+   OTP         : origin = 0x3D7800, length = 0x000400     /* on-chip OTP */
+
+   APP_BEGIN   : origin = 0x3D8000, length = 0x000002     /* Part of FLASHH.  CAN_BOOT_APP_ENTRY */
+   FLASHH      : origin = 0x3D8002, length = 0x003FFE     /* on-chip FLASH */
+   FLASHG      : origin = 0x3DC000, length = 0x004000     /* on-chip FLASH */
+   FLASHF      : origin = 0x3E0000, length = 0x004000     /* on-chip FLASH */
+   FLASHE      : origin = 0x3E4000, length = 0x004000     /* on-chip FLASH */
+   FLASHD      : origin = 0x3E8000, length = 0x004000     /* on-chip FLASH */
+   FLASHC      : origin = 0x3EC000, length = 0x004000     /* on-chip FLASH */
+
+   FPUTABLES   : origin = 0x3FD860, length = 0x0006A0	  /* FPU Tables in Boot ROM */
+   IQTABLES    : origin = 0x3FDF00, length = 0x000B50     /* IQ Math Tables in Boot ROM */
+   IQTABLES2   : origin = 0x3FEA50, length = 0x00008C     /* IQ Math Tables in Boot ROM */
+   IQTABLES3   : origin = 0x3FEADC, length = 0x0000AA	  /* IQ Math Tables in Boot ROM */
+
+   ROM         : origin = 0x3FF3B0, length = 0x000C10     /* Boot ROM */
+   RESET       : origin = 0x3FFFC0, length = 0x000002     /* part of boot ROM  */
+   VECTORS     : origin = 0x3FFFC2, length = 0x00003E     /* part of boot ROM  */
+
+PAGE 1 :   /* Data Memory */
+   BOOT_RSVD   : origin = 0x000000, length = 0x000050     /* Part of M0, BOOT rom will use this for stack */
+   RAMM0       : origin = 0x000050, length = 0x0003B0     /* on-chip RAM block M0 */
+   RAMM1       : origin = 0x000400, length = 0x000400     /* on-chip RAM block M1 */
+   RAML2       : origin = 0x008C00, length = 0x000400     /* on-chip RAM block L2 */
+   RAML3       : origin = 0x009000, length = 0x001000	  /* on-chip RAM block L3 */
+   RAML4       : origin = 0x00A000, length = 0x002000     /* on-chip RAM block L4 */
+   RAML5       : origin = 0x00C000, length = 0x002000     /* on-chip RAM block L5 */
+   RAML6       : origin = 0x00E000, length = 0x002000     /* on-chip RAM block L6 */
+   RAML7       : origin = 0x010000, length = 0x002000     /* on-chip RAM block L7 */
+   RAML8       : origin = 0x012000, length = 0x002000     /* on-chip RAM block L8 */
+   USB_RAM     : origin = 0x040000, length = 0x000800     /* USB RAM		  */
+   FLASHB      : origin = 0x3F0000, length = 0x003FF8     /* on-chip FLASH, less the CAN_BOOT_HEADER */
+}
+
+SECTIONS
+{
+
+   /* Allocate program areas: */
+   .cinit              : > FLASHC,     PAGE = 0
+   .pinit              : > FLASHC,     PAGE = 0
+   .text               : >> FLASHH | FLASHG | FLASHF | FLASHE,     PAGE = 0
+   codestart           : > APP_BEGIN,  PAGE = 0
+   ramfuncs            : LOAD = FLASHD,
+                         RUN = RAML0,
+                         LOAD_START(_RamfuncsLoadStart),
+                         LOAD_END(_RamfuncsLoadEnd),
+                         RUN_START(_RamfuncsRunStart),
+                         PAGE = 0
+
+   secureRamFuncs	   : LOAD = FLASHD, PAGE = 0
+ 						 RUN = RAML0, PAGE = 0
+ 						 LOAD_START(_secureRamFuncs_loadstart),
+   						 LOAD_SIZE(_secureRamFuncs_loadsize),
+ 						 RUN_START(_secureRamFuncs_runstart),
+ 						 PAGE = 0
+
+   /* Allocate uninitalized data sections: */
+   .stack              : > RAMM0 | RAMM1,      PAGE = 1
+   .ebss               : > RAML3,      PAGE = 1
+   .esysmem            : > RAML2,      PAGE = 1
+   .sysmem			   : > RAML4,	   PAGE = 1
+   .cio				   : > RAML4,	   PAGE = 1
+   /* Initalized sections to go in Flash */
+   .econst             : > FLASHC,     PAGE = 0
+   .switch             : > FLASHC,     PAGE = 0
+
+   /* Allocate IQ math areas: */
+   IQmath              : > FLASHC,     PAGE = 0            /* Math Code */
+   IQmathTables        : > IQTABLES,   PAGE = 0, TYPE = NOLOAD
+
+   /* Allocate FPU math areas: */
+   FPUmathTables       : > FPUTABLES,  PAGE = 0, TYPE = NOLOAD
+
+   DMARAML5	           : > RAML5,      PAGE = 1
+   DMARAML6	           : > RAML6,      PAGE = 1
+   DMARAML7	           : > RAML7,      PAGE = 1
+   DMARAML8	           : > RAML8,      PAGE = 1
+
+   .reset              : > RESET,      PAGE = 0, TYPE = DSECT
+   vectors             : > VECTORS,    PAGE = 0, TYPE = DSECT
+
+}
+
+/*
+//===========================================================================
+// End of file.
+//===========================================================================
+*/
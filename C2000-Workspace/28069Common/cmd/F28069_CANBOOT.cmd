@@ -0,0 +1,95 @@
+/*
+//###########################################################################
+//
+// FILE:    F28069_CANBOOT.cmd
+//
+// TITLE:   Linker Command File For the CAN bootloader (CAN_boot.c)
+//
+//###########################################################################
+*/
+
+/* ======================================================
+// Use with F2806x_Headers_nonBIOS.cmd and F2806x_CANBootStart.asm in place
+// of F28069_FLASH.cmd and F2806x_CodeStartBranch.asm.
+//
+// The bootloader owns FLASHA and nothing else, so the boot-to-flash
+// entry (BEGIN) and the CSM passwords stay with it. Its code, constants
+// and the Flash2806x API are loaded to FLASHA and copied to RAML4-L5 by
+// F2806x_CANBootStart.asm before _c_int00; the application image goes to
+// sectors H to B (see F28069_CANAPP.cmd).
+//
+// Link the Flash2806x API library and the CAN, CAN_transport, CAN_boot
+// and clocks sources.
+========================================================= */
+
+MEMORY
+{
+PAGE 0 :   /* Program Memory */
+   RAML4_5     : origin = 0x00A000, length = 0x004000     /* on-chip RAM blocks L4 and L5, the bootloader runs here */
+   OTP         : origin = 0x3D7800, length = 0x000400     /* on-chip OTP */
+
+   FLASHA      : origin = 0x3F4000, length = 0x003F80     /* on-chip FLASH */
+   CSM_RSVD    : origin = 0x3F7F80, length = 0x000076     /* Part of FLASHA.  Program with all 0x0000 when CSM is in use. */
+   BEGIN       : origin = 0x3F7FF6, length = 0x000002     /* Part of FLASHA.  Used for "boot to Flash" bootloader mode. */
+   CSM_PWL_P0  : origin = 0x3F7FF8, length = 0x000008     /* Part of FLASHA.  CSM password locations in FLASHA */
+
+   FPUTABLES   : origin = 0x3FD860, length = 0x0006A0	  /* FPU Tables in Boot ROM */
+   IQTABLES    : origin = 0x3FDF00, length = 0x000B50     /* IQ Math Tables in Boot ROM */
+
+   ROM         : origin = 0x3FF3B0, length = 0x000C10     /* Boot ROM */
+   RESET       : origin = 0x3FFFC0, length = 0x000002     /* part of boot ROM  */
+   VECTORS     : origin = 0x3FFFC2, length = 0x00003E     /* part of boot ROM  */
+
+PAGE 1 :   /* Data Memory */
+   BOOT_RSVD   : origin = 0x000000, length = 0x000050     /* Part of M0, BOOT rom will use this for stack */
+   RAMM0       : origin = 0x000050, length = 0x0003B0     /* on-chip RAM block M0 */
+   RAMM1       : origin = 0x000400, length = 0x000400     /* on-chip RAM block M1 */
+   RAML2       : origin = 0x008C00, length = 0x000400     /* on-chip RAM block L2 */
+   RAML3       : origin = 0x009000, length = 0x001000	  /* on-chip RAM block L3 */
+   RAML6_8     : origin = 0x00E000, length = 0x006000     /* on-chip RAM blocks L6 to L8: block buffers */
+}
+
+SECTIONS
+{
+   codestart           : > BEGIN,      PAGE = 0
+   bootstart           : > FLASHA,     PAGE = 0
+   .cinit              : > FLASHA,     PAGE = 0
+   .pinit              : > FLASHA,     PAGE = 0
+
+   /* Everything that executes, or is read while a sector is erased or programmed */
+   GROUP               : LOAD = FLASHA, PAGE = 0
+                         RUN = RAML4_5, PAGE = 0
+                         LOAD_START(_BootRamLoadStart),
+                         LOAD_SIZE(_BootRamLoadSize),
+                         RUN_START(_BootRamRunStart)
+   {
+      .text
+      .econst
+      .switch
+      ramfuncs
+      secureRamFuncs
+      Flash28_API
+   }
+
+   csmpasswds          : > CSM_PWL_P0, PAGE = 0
+   csm_rsvd            : > CSM_RSVD,   PAGE = 0
+
+   /* Allocate uninitalized data sections: */
+   .stack              : > RAMM0 | RAMM1,      PAGE = 1
+   .ebss               : > RAML6_8 | RAML3,    PAGE = 1
+   .esysmem            : > RAML2,      PAGE = 1
+   .sysmem             : > RAML2,      PAGE = 1
+   .cio                : > RAML3,      PAGE = 1
+
+   FPUmathTables       : > FPUTABLES,  PAGE = 0, TYPE = NOLOAD
+   IQmathTables        : > IQTABLES,   PAGE = 0, TYPE = NOLOAD
+
+   .reset              : > RESET,      PAGE = 0, TYPE = DSECT
+   vectors             : > VECTORS,    PAGE = 0, TYPE = DSECT
+}
+
+/*
+//===========================================================================
+// End of file.
+//===========================================================================
+*/
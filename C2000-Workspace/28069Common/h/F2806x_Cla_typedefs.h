@@ -13,6 +13,8 @@
 #ifndef F2806X_CLA_TYPEDEFS_H_
 #define F2806X_CLA_TYPEDEFS_H_
 
+#include "F2806x_Host.h"               // Host build definitions (DSP28_HOST only)
+
 //---------------------------------------------------------------------------
 // For Portability, User Is Recommended To Use Following Data Type Size
 // Definitions For 16-bit and 32-Bit Signed/Unsigned Integers:
@@ -12,6 +12,8 @@
 #ifndef F2806x_DEVICE_H
 #define F2806x_DEVICE_H
 
+#include "F2806x_Host.h"               // Host build definitions (DSP28_HOST only)
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -74,6 +76,7 @@ extern "C" {
 // Common CPU Definitions:
 //
 
+#ifndef DSP28_HOST
 extern __cregister volatile unsigned int IFR;
 extern __cregister volatile unsigned int IER;
 
@@ -84,6 +87,7 @@ extern __cregister volatile unsigned int IER;
 #define  EALLOW __asm(" EALLOW")
 #define  EDIS   __asm(" EDIS")
 #define  ESTOP0 __asm(" ESTOP0")
+#endif
 
 #define M_INT1  0x0001
 #define M_INT2  0x0002
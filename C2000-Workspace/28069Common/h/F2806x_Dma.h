@@ -173,6 +173,14 @@ struct DMA_REGS {
 //
 extern volatile struct DMA_REGS DmaRegs;
 
+// A buffer or register as the address registers take it: its data address on
+// the chip, a stand-in the DMA model understands in a host build.
+#ifdef DSP28_HOST
+#define DMA_ADDRESS(p)	HostDmaAddress(p)
+#else
+#define DMA_ADDRESS(p)	((Uint32)(p))
+#endif
+
 #ifdef __cplusplus
 }
 #endif /* extern "C" */
@@ -0,0 +1,229 @@
+/**
+ * @file F2806x_Host.h
+ * @brief Host ("virtual F28069") build definitions
+ *
+ * Define DSP28_HOST to build the C2000 libraries as an ordinary Linux program.
+ * F2806x_Device.h and F2806x_Cla_typedefs.h pull this file in first, so the
+ * DSP28 integer types keep their on-chip widths (Uint16 is 16 bits, Uint32 is
+ * 32 bits) and the register bit-field layouts match the TI headers exactly.
+ *
+ * The peripheral register files (AdcRegs, ECanaRegs, SciaRegs, ...) become
+ * plain RAM, defined in F2806x_Host.c in place of F2806x_GlobalVariableDefs.c.
+ * Peripheral behaviour comes from HOST_MODELs: a model is stepped on every
+ * simulator tick and may watch its register file, in which case it is told
+ * about every CPU read and write of it. That is how write-1-to-clear flags,
+ * FIFO data registers and "write 1 to start" bits behave like silicon.
+ * F2806x_HostModels.c has the stock models (PLL, GPIO, CPU timers, ADC, eCAN,
+ * SCI, SPI, I2C, DMA, McBSP); add your own with HostSimAddModel.
+ *
+ * Time moves in ticks of HostSimCyclesPerTick SYSCLKOUT cycles. HostSimRun
+ * steps explicitly; HostSimStart steps from SIGALRM, which is what lets
+ * unmodified polling loops finish. Each timer tick opens and closes the
+ * watched pages, so keep tick_us at a few hundred microseconds and raise
+ * HostSimCyclesPerTick instead if simulated time moves too slowly.
+ *
+ * Interrupts are dispatched on the calling thread exactly like the PIE does
+ * it: PIEIFR -> PIEIER -> PIEACK -> IFR/IER -> INTM, lowest group and lowest
+ * INTx first. INTM is DINT/EINT. Forgetting to write PIEACK blocks the group,
+ * same as on the chip.
+ *
+ * Typical build (from the workspace root):
+ *
+ *   gcc -DDSP28_HOST -I28069Common/h -I"C2000 Libraries/CAN Library" \
+ *       app.c "C2000 Libraries/CAN Library/CAN.c" 28069Common/c/F2806x_ECan.c \
+ *       28069Common/c/F2806x_Host.c 28069Common/c/F2806x_HostModels.c
+ *
+ * Do not link F2806x_GlobalVariableDefs.c, F2806x_SysCtrl.c or any .asm file
+ * into a host build. Register watching needs x86-64 Linux; elsewhere models
+ * are still stepped but never see individual register accesses.
+ */
+#ifndef F2806x_HOST_H
+#define F2806x_HOST_H
+
+#ifdef DSP28_HOST
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//---------------------------------------------------------------------------
+// DSP28 data types with their C28x widths:
+//
+#ifndef DSP28_DATA_TYPES
+#define DSP28_DATA_TYPES
+typedef int16_t				int16;
+typedef int32_t				int32;
+typedef long long			int64;
+typedef unsigned long long	Uint64;
+typedef float				float32;
+typedef long double			float64;
+#endif
+
+#ifndef _TI_STD_TYPES
+#define _TI_STD_TYPES
+typedef int					Int;
+typedef unsigned			Uns;
+typedef char				Char;
+typedef char				*String;
+typedef void				*Ptr;
+typedef unsigned short		Bool;
+typedef uint32_t			Uint32;
+typedef uint16_t			Uint16;
+typedef uint8_t				Uint8;
+typedef int32_t				Int32;
+typedef int16_t				Int16;
+typedef char				Int8;
+#endif
+
+//---------------------------------------------------------------------------
+// C28x compiler keywords and intrinsics:
+//
+#define interrupt
+#define __interrupt
+#define __cregister
+// asm(" NOP") is left alone: NOP is a valid x86 mnemonic as well.
+
+extern volatile unsigned int IFR;
+extern volatile unsigned int IER;
+
+#define  EINT   HostSimEint()
+#define  DINT   HostSimDint()
+#define  ERTM   ((void)0)
+#define  DRTM   ((void)0)
+#define  EALLOW ((void)0)
+#define  EDIS   ((void)0)
+#define  ESTOP0 __builtin_trap()
+
+//---------------------------------------------------------------------------
+// Peripheral behaviour models:
+//
+typedef struct HOST_MODEL {
+	volatile void* regs;		// register file to watch, or 0
+	Uint32 size;				// size of that register file in bytes
+	void (*reset)(void);		// HostSimInit: put registers in their reset state
+	void (*step)(void);			// advance the peripheral by one tick
+	void (*access)(volatile void* reg, Uint16 write);//CPU just read/wrote reg
+	struct HOST_MODEL* next;
+} HOST_MODEL;
+
+void HostSimInit(void);
+void HostSimAddModel(HOST_MODEL* model);
+void HostSimStep(void);
+void HostSimRun(Uint32 ticks);
+void HostSimStart(Uint32 tick_us);
+void HostSimStop(void);
+Uint32 HostSimTicks(void);
+
+// Simulated SYSCLKOUT cycles per tick. Models use this to pace themselves.
+extern Uint32 HostSimCyclesPerTick;
+
+// Bus masters other than the CPU (the DMA model) report their register
+// accesses here so the owning model sees them.
+void HostSimBusAccess(volatile void* reg, Uint16 write);
+
+// The DMA address registers hold a word address, which a host pointer does not
+// fit in. DMA_ADDRESS (F2806x_Dma.h) gives a buffer's stand-in address; the DMA
+// model turns it back with HostDmaPointer. Only static and global data can be
+// given to the DMA, which is no stricter than DMARAML5-8 on the chip.
+Uint32 HostDmaAddress(volatile void* p);
+volatile Uint16* HostDmaPointer(Uint32 address);
+
+// Latch a PIE interrupt (group 1-12, INTx 1-8) and dispatch whatever is due.
+void HostSimRaise(Uint16 group, Uint16 intx);
+void HostSimServiceInterrupts(void);
+void HostSimEint(void);
+void HostSimDint(void);
+
+// Stock models, all added by HostSimInit. Hooks may be left 0.
+typedef struct {
+	Uint32 id;					// MSGID.all image: IDE, AME, AAM and the identifier
+	Uint16 dlc;
+	Uint16 rtr;
+	Uint32 mdl;
+	Uint32 mdh;
+} HOST_CAN_FRAME;
+
+extern void (*HostECanTxHook)(const HOST_CAN_FRAME* frame);
+void HostECanInject(const HOST_CAN_FRAME* frame);
+
+// Virtual nodes sharing the bus with the eCAN. A message with a period is
+// sent every period_us starting at phase_us; one without a period is sent
+// once at phase_us, unless it is an answer, which is sent whenever a remote
+// frame with its ID goes by.
+typedef struct {
+	HOST_CAN_FRAME frame;
+	Uint32 period_us;
+	Uint32 phase_us;
+	Uint16 answer;
+	// Kept by the bus
+	Uint16 scheduled, pending;
+	Uint64 due, ready;
+	Uint32 overruns;			// periods that came round while still pending
+} HOST_CAN_MESSAGE;
+
+typedef struct HOST_CAN_NODE {
+	const char* name;
+	HOST_CAN_MESSAGE* messages;
+	Uint16 count;
+	Uint16 ack;					// acknowledges every frame it does not send
+	void (*receive)(struct HOST_CAN_NODE* self, const HOST_CAN_FRAME* frame);
+	// Kept by the bus
+	Uint16 pending;
+	Uint64 next_due;
+	struct HOST_CAN_NODE* next;
+} HOST_CAN_NODE;
+
+typedef struct {
+	Uint32 id;					// IDE and the identifier, as in HOST_CAN_FRAME
+	Uint32 frames;
+	Uint32 errors;				// error frames and missing ACKs
+	Uint64 total_us;
+	Uint32 worst_us;			// ready to send -> end of frame
+} HOST_CAN_ID_STATS;
+
+// Something on the bus always acknowledges while this is 1. Clear it to
+// leave the acknowledging to nodes with ack set (and the eCAN itself).
+extern Uint16 HostCanBusAck;
+
+void HostCanAddNode(HOST_CAN_NODE* node);
+int HostCanReplay(HOST_CAN_NODE* node, const char* candump_log);
+void HostCanBusErrors(Uint16 frames);
+void HostCanBusOff(void);
+const HOST_CAN_ID_STATS* HostCanBusStats(Uint16* count);
+void HostCanBusReport(void);
+
+extern void (*HostSciTxHook)(char scisys, Uint16 data);
+void HostSciInject(char scisys, Uint16 data);
+
+// One SPI character, data right-justified, MSB first on the wire: return what
+// the slave shifts back. spisys is 'A' or 'B', or 'M' for McBSP-A in clock
+// stop mode. Which slave is selected is up to the chip-select GPIOs in
+// GpioDataRegs.
+extern Uint16 (*HostSpiTransferHook)(char spisys, Uint16 data, Uint16 bits);
+
+typedef struct HOST_I2C_SLAVE {
+	Uint16 address;
+	void (*start)(struct HOST_I2C_SLAVE* self, Uint16 read);
+	Uint16 (*write)(struct HOST_I2C_SLAVE* self, Uint16 data);//returns 1 for ACK
+	Uint16 (*read)(struct HOST_I2C_SLAVE* self);
+	void (*stop)(struct HOST_I2C_SLAVE* self);
+	Uint16 regs[256];			// register file used by the default handlers
+	Uint16 pointer;				// register pointer used by the default handlers
+	struct HOST_I2C_SLAVE* next;
+} HOST_I2C_SLAVE;
+
+void HostI2cAddSlave(HOST_I2C_SLAVE* slave);
+
+extern Uint16 (*HostAdcSampleHook)(Uint16 channel);
+
+void HostAddStockModels(void);
+
+#ifdef __cplusplus
+}
+#endif /* extern "C" */
+
+#endif  // DSP28_HOST
+
+#endif  // end of F2806x_HOST_H definition
@@ -11,6 +11,8 @@
 #ifndef F2806x_DEVICE_H
 #define F2806x_DEVICE_H 1
 
+#include "F2806x_Host.h"               // Host build definitions (DSP28_HOST only)
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -41,6 +43,7 @@ extern "C" {
 //---------------------------------------------------------------------------
 // Common CPU Definitions:
 //
+#ifndef DSP28_HOST
 extern cregister volatile unsigned int IFR;
 extern cregister volatile unsigned int IER;
 
@@ -51,6 +54,7 @@ extern cregister volatile unsigned int IER;
 #define  EALLOW asm(" EALLOW")
 #define  EDIS   asm(" EDIS")
 #define  ESTOP0 asm(" ESTOP0")
+#endif
 
 #define M_INT1  0x0001
 #define M_INT2  0x0002
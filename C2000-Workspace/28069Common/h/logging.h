@@ -3,16 +3,68 @@
  *
  *  Created on: Jun 12, 2014
  *      Author: Alex
+ *
+ * Deferred logging. A call such as
+ *
+ *   LOG2("cell %d at %f V", cell, LOG_FLOAT(v));
+ *
+ * compiles to a record of the call site (LOG_FILE and the line number) and
+ * the raw arguments in a RAM ring, a few dozen cycles even inside an ISR.
+ * The format string is never compiled in: "Host Tools/Logging/logstrings"
+ * pulls it out of the sources at build time and log2txt puts the text back
+ * together on a PC. Empty the ring from the main loop with LogDrain, for
+ * instance into SCI telemetry frames:
+ *
+ *   char log_to_sci(const Uint16* record, Uint16 words){
+ *       char buf[2*LOG_RECORD_MAX];
+ *       Uint16 i, n = 0;
+ *       if(SciWritable('A') < 2*words + TELEMETRY_OVERHEAD) return 0;//try again later
+ *       for(i = 0; i < words; i++) n += TelemetryPackU16(&buf[n], record[i]);
+ *       return TelemetrySend('A', LOG_TELEMETRY_TYPE, buf, n);
+ *   }
+ *       LogDrain(&log_to_sci);
+ *
+ * Rules for call sites, so logstrings can find them:
+ *  - #define LOG_FILE before including this header, a number from 1 to 255
+ *    that no other file in the program uses (see the list below);
+ *  - keep each LOGn call, format string included, on one line;
+ *  - arguments are 32-bit integers, printed with %d %u %x %c or %b (binary);
+ *    pass floats through LOG_FLOAT and print them with %f %e or %g. There
+ *    is no %s: a string cannot be deferred.
+ *
+ * LOG_FILE numbers in use: 1 I2CFuncs.c, 2 IMU_Interface.c, 3 MPUFuncs.c
  */
-
 #include <stdio.h>
 #include <string.h>
 
 #ifndef LOGGING_H_
 #define LOGGING_H_
 
-// Use for debugging with a computer, disable for production build:
-#define STDIODEBUG 1
+#include "F2806x_Device.h"
+
+#define LOG_RING_WORDS 1024//power of two
+#define LOG_RECORD_MAX 10//words: call site, argument count and 4 arguments
+#define LOG_TELEMETRY_TYPE 0x7F//frame type log2txt looks for
+
+#ifndef LOG_FILE
+#define LOG_FILE 0
+#endif
+
+#define LOG0(fmt)				LogWrite(LOG_FILE, __LINE__, 0, 0, 0, 0, 0)
+#define LOG1(fmt, a)			LogWrite(LOG_FILE, __LINE__, 1, (Uint32)(a), 0, 0, 0)
+#define LOG2(fmt, a, b)			LogWrite(LOG_FILE, __LINE__, 2, (Uint32)(a), (Uint32)(b), 0, 0)
+#define LOG3(fmt, a, b, c)		LogWrite(LOG_FILE, __LINE__, 3, (Uint32)(a), (Uint32)(b), (Uint32)(c), 0)
+#define LOG4(fmt, a, b, c, d)	LogWrite(LOG_FILE, __LINE__, 4, (Uint32)(a), (Uint32)(b), (Uint32)(c), (Uint32)(d))
+#define LOG_FLOAT(x)			LogFloatBits(x)
+
+void LogWrite(Uint16 file, Uint16 line, Uint16 count, Uint32 a, Uint32 b, Uint32 c, Uint32 d);
+Uint32 LogFloatBits(float32 x);
+Uint16 LogDrain(char (*sink)(const Uint16* record, Uint16 words));
+Uint32 LogDropped(void);
+
+// Old immediate CIO logging. Each call halts the CPU for milliseconds while the
+// debugger services it; define STDIODEBUG to turn them back on.
+//#define STDIODEBUG 1
 
 void stdiologstr(char *str);
 void stdiolog1int(char* format, int num);
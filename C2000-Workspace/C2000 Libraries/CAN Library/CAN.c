@@ -27,13 +27,44 @@
 #include "CAN.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 //Global variables
 int DEBUG = 1;
 int bus_error = 0;
 CAN_INFO* CAN_INFO_ARRAY;
 Uint32 CAN_ARRAY_LENGTH;
+CAN_INFO* CAN_MBOX_INFO[32];//dispatch table: mailbox number -> CAN_INFO of the ID it carries
+
+//Transmit queue: main loop produces into the ring, the TA interrupt consumes
+CAN_FRAME CAN_TX_QUEUE[CAN_TX_QUEUE_SIZE];
+volatile Uint16 CAN_tx_head = 0;//next free slot, written by CAN_queue_send only
+volatile Uint16 CAN_tx_tail = 0;//next frame to load, written with INT9 masked only
+volatile Uint32 CAN_tx_pool = 0;//mailboxes owned by the queue
+volatile Uint32 CAN_tx_free = 0;//pool mailboxes not holding a frame
+volatile CAN_QUEUE_STATS CAN_tx_stats;
+
+//Receive ring: ecan_isr is the only producer, the main loop the only consumer
+CAN_FRAME CAN_RX_RING[CAN_RX_RING_SIZE];
+volatile Uint16 CAN_rx_head = 0;//written by ecan_isr only
+volatile Uint16 CAN_rx_tail = 0;//written by the main loop only
+volatile Uint32 CAN_rx_dropped = 0;//frames lost because the ring was full
+char CAN_rx_ring_on = 0;
+
+//Timing statistics, all in CANTSC bit times
+CAN_STATS CAN_stats;
+Uint32 CAN_stats_since = 0;//CANTSC at CAN_stats_reset
+Uint32 CAN_tx_stamp[32];//CANTSC when the frame in each mailbox was queued or started
+volatile Uint32 CAN_tx_timed = 0;//mailboxes whose CAN_tx_stamp belongs to the frame in them; INT9 masked to change it outside ecan_isr
+
+//Bus health, updated on warning/passive/bus-off interrupts and while not error-active
+CAN_BUS_STATUS CAN_bus;
+Uint32 CAN_bus_off_since = 0;//CANTSC when the last bus-off started
+
+//Blocking calls (block = 1)
+volatile Uint32 CAN_done = 0;//mailboxes ecan_isr has taken a TA or RMP bit from since CAN_done_arm
 
 #define CAN_TX_WAIT_CYCLES 150e3
+#define CAN_BLOCK_TIMEOUT_US 100000UL//block = 1 gives up after this: room for many frames that win arbitration first
 __interrupt void ecan_isr(void);
 
 
@@ -80,6 +111,130 @@ void main(void){
 
 
 char interruptsEnabled;
+
+/*
+ * @brief Points the dispatch table entries of the given mailboxes at the CAN_INFO for ID.
+ * Called whenever mailboxes are (re)configured, so ecan_isr never has to search.
+ * Mailboxes whose ID is not in CAN_INFO_ARRAY get no callbacks.
+ */
+static void CAN_bind(CAN_ID ID, Uint32 mbox_num, Uint32 numMbox){
+	CAN_INFO* info = 0;
+	Uint32 i;
+	Uint16 ier9;
+
+	for (i = 0; i < CAN_ARRAY_LENGTH; i++){
+		if (CAN_INFO_ARRAY[i].ID == ID){
+			info = &CAN_INFO_ARRAY[i];
+			break;
+		}
+	}
+	ier9 = IER & M_INT9;
+	IER &= ~M_INT9; //CAN_tx_timed is also updated by ecan_isr
+	for (i = 0; i < numMbox; i++){
+		CAN_MBOX_INFO[(i + mbox_num) % 32] = info;
+		CAN_tx_timed &= ~((Uint32)1 << ((i + mbox_num) % 32));
+	}
+	IER |= ier9;
+}
+
+/*
+ * @brief Binds a transmit mailbox that CAN_mbox_send loads to the CAN_INFO for ID, so
+ * ecan_isr calls its upon_sent_isr. Call once when the mailbox is given its job.
+ */
+void CAN_mbox_bind(CAN_ID ID, Uint32 mbox_num){
+	CAN_bind(ID, mbox_num, 1);
+}
+
+/*
+ * @brief Starts watching the mailboxes in mask for a blocking call: clears their TA/RMP bits
+ * and CAN_done bits, so CAN_wait_done only sees frames that come after this.
+ */
+static void CAN_done_arm(Uint32 mask){
+	Uint16 ier9 = IER & M_INT9;
+
+	IER &= ~M_INT9;
+	ECanaRegs.CANTA.all = mask;
+	ECanaRegs.CANRMP.all = mask;
+	CAN_done &= ~mask;
+	IER |= ier9;
+}
+
+/*
+ * @brief Waits until every mailbox in mask has sent (TA) or received (RMP) a frame since
+ * CAN_done_arm. With interrupts on, ecan_isr clears those bits first and records the mailbox
+ * in CAN_done instead; without them the bits stay set.
+ * @return 1 once they all have, 0 after CAN_BLOCK_TIMEOUT_US.
+ */
+static char CAN_wait_done(Uint32 mask, char rx){
+	Uint32 waited;
+
+	for(waited = 0; ((CAN_done | (rx ? ECanaRegs.CANRMP.all : ECanaRegs.CANTA.all)) & mask) != mask; waited++){
+		if(waited >= CAN_BLOCK_TIMEOUT_US){
+			return 0;
+		}
+		DELAY_US(1);
+	}
+	return 1;
+}
+
+/*
+ * @brief Bits one frame occupies on the bus, including the 3-bit intermission, assuming
+ * worst-case bit stuffing. An upper bound, good for load estimates and budgets.
+ */
+Uint16 CAN_frame_bits(CAN_ID ID, Uint16 length){
+	Uint16 bits = CAN_IS_EXT(ID) ? 54 : 34;//bits covered by stuffing, without data
+
+	if(length > 8) length = 8;
+	bits += 8*length;
+	return bits + (bits - 1)/4 + 13;//stuff bits, CRC delimiter, ACK, EOF, intermission
+}
+
+/*
+ * @brief Adds one latency sample (bit times) to stats. Histogram bin n counts samples
+ * in [2^n, 2^(n+1)); bin 0 also takes 0 and the last bin everything longer.
+ */
+static void CAN_latency_add(CAN_LATENCY* stats, Uint32 latency){
+	Uint16 bin = 0;
+	Uint32 v = latency;
+
+	while((v >>= 1) != 0 && bin < CAN_LATENCY_BINS - 1) bin++;
+	stats->histogram[bin]++;
+	if(stats->count == 0 || latency < stats->min) stats->min = latency;
+	if(latency > stats->max) stats->max = latency;
+	stats->total += latency;
+	stats->count++;
+}
+
+/*
+ * @brief MSGID register image for ID: standard IDs go in STDMSGID (bits 28-18),
+ * CAN_EXT IDs fill all 29 bits with IDE set. AME and AAM are left 0.
+ */
+Uint32 CAN_msgid(CAN_ID ID){
+	if(CAN_IS_EXT(ID)){
+		return (ID & 0x1FFFFFFF) | 0x80000000;//IDE
+	}
+	return (ID & 0x7FF) << 18;
+}
+
+/*
+ * @brief Inverse of CAN_msgid: the CAN_ID of a received MSGID image.
+ */
+CAN_ID CAN_id_from_msgid(Uint32 msgid){
+	if(msgid & 0x80000000){
+		return CAN_EXT(msgid);
+	}
+	return (msgid >> 18) & 0x7FF;
+}
+
+/*
+ * @brief Transmit priority level for ID. Pool mailboxes are started together, so give
+ * the lower (higher-priority) identifier the higher TPL and it leaves the node first,
+ * the same order bus arbitration would pick.
+ */
+static Uint16 CAN_tpl(CAN_ID ID){
+	return 31 - (Uint16)((CAN_msgid(ID) >> 24) & 0x1F);
+}
+
 /*
 @brief Initializes the CAN module
  */
@@ -88,8 +243,12 @@ void CAN_init(CAN_INFO* can_array, Uint32 can_length, char enableInterrupts){
 	interruptsEnabled = enableInterrupts;
 	struct ECAN_REGS ECanaShadow;
 	Uint16 IERShadow;
+	Uint16 i;
 	CAN_INFO_ARRAY = can_array;
 	CAN_ARRAY_LENGTH = can_length;
+	for (i = 0; i < 32; i++){
+		CAN_MBOX_INFO[i] = 0;//no mailbox is configured yet
+	}
 
 	// Step 1. Initialize System Control:
 	// PLL, WatchDog, enable Peripheral Clocks
@@ -140,9 +299,9 @@ void CAN_init(CAN_INFO* can_array, Uint32 can_length, char enableInterrupts){
 		ECanaRegs.CANMIM.all = 0xFFFFFFFF;
 		//Using level 1 CAN interrupts  for mboxes
 		ECanaRegs.CANMIL.all = 0xFFFFFFFF;
-		//From all system interrupts only use bus-off (not recommended)
+		//System interrupts on line 0: warning level, error passive and bus-off
 		//Enable level 0, 1 interrupts
-		ECanaRegs.CANGIM.all = 0x00000403;
+		ECanaRegs.CANGIM.all = 0x00000703;
 
 		//CAN interrupts are part of IER 9
 		IER = IERShadow | M_INT9;
@@ -153,9 +312,16 @@ void CAN_init(CAN_INFO* can_array, Uint32 can_length, char enableInterrupts){
 		PieCtrlRegs.PIEIER9.bit.INTx6 = 1;
 	}
 
+	EALLOW;
 	ECanaShadow.CANMC.all = ECanaRegs.CANMC.all;
 	ECanaShadow.CANMC.bit.STM = 0;    // Disable CAN self-test mode (0=off)
+	ECanaShadow.CANMC.bit.ABO = 1;    // Leave bus-off by itself after 128 x 11 recessive bits
 	ECanaRegs.CANMC.all = ECanaShadow.CANMC.all;
+	EDIS;
+
+	memset(&CAN_bus, 0, sizeof(CAN_bus));
+	bus_error = 0;
+	CAN_stats_reset();
 
 	if (enableInterrupts) {
 		// Enable global Interrupts and higher priority real-time debug events:
@@ -172,7 +338,8 @@ void CAN_init(CAN_INFO* can_array, Uint32 can_length, char enableInterrupts){
 //Data is sent starting from lower 4 bytes.
 //	Ex: PEDALS sends out 4 bytes of data from mailbox 4 + 5
 //	CAN_SEND(data_array_pointer, 4, PEDALS, 4);
-void CAN_send(Uint32* data, int length, CAN_ID ID, Uint32 mbox_num, char block){
+//With block set, waits for the frames to be acknowledged; returns 0 if that takes over 100 ms, else 1.
+char CAN_send(Uint32* data, int length, CAN_ID ID, Uint32 mbox_num, char block){
 	struct ECAN_REGS ECanaShadow;
 	volatile struct MBOX *Mailbox;
 	Uint32 wait_cycles;
@@ -233,33 +400,35 @@ void CAN_send(Uint32* data, int length, CAN_ID ID, Uint32 mbox_num, char block){
 			Mailbox->MDH.all = 0;
 		}
 
-		// The ID is only the last 29 bits. ID cannot be greater than 2^29-1.
-		// I am using the extended identifier only.
-		Mailbox->MSGID.bit.STDMSGID = (Uint32)ID;
-		Mailbox->MSGID.bit.AAM = 0;
-		Mailbox->MSGID.bit.AME = 0;
-		Mailbox->MSGID.bit.IDE = 0;
+		// Standard or extended, see CAN_ID. AAM and AME are off.
+		Mailbox->MSGID.all = CAN_msgid(ID);
 	}
+	CAN_bind(ID, mbox_num, numMbox);
+
 	//ECanaRegs.CANME.all |= bitMaskOfOnes; //Enable the mailboxes
 	ECanaShadow.CANME.all = ECanaRegs.CANME.all;
 	ECanaShadow.CANME.all |= bitMaskOfOnes;
 	ECanaRegs.CANME.all = ECanaShadow.CANME.all;
 
+	CAN_done_arm(bitMaskOfOnes);
+
 	//ECanaRegs.CANTRS.all |= bitMaskOfOnes; //Send the data all at once!
 	ECanaShadow.CANTRS.all = ECanaRegs.CANTRS.all;
 	ECanaShadow.CANTRS.all |= bitMaskOfOnes;
 	ECanaRegs.CANTRS.all = ECanaShadow.CANTRS.all;
 
 	if(block) {
-		while(ECanaRegs.CANTA.all != ~bitMaskOfOnes ) {}  // Wait for all TAn bits to be set..
+		return CAN_wait_done(bitMaskOfOnes, 0); // Wait for all frames to be acknowledged.
 	}
+	return 1;
 }
 
 /*
  * @brief Configure mailboxes to receive *length* bytes from desired CAN ID
  * If mailbox number exceeds 31, then it will wrap around starting at 0.
+ * With block set, waits for every mailbox to receive a frame; returns 0 if that takes over 100 ms, else 1.
  */
-void CAN_receive(CAN_ID ID, int length, Uint32 mbox_num, char block){
+char CAN_receive(CAN_ID ID, int length, Uint32 mbox_num, char block){
 	struct ECAN_REGS ECanaShadow;
 	volatile struct MBOX *Mailbox;
 
@@ -298,28 +467,29 @@ void CAN_receive(CAN_ID ID, int length, Uint32 mbox_num, char block){
 			Mailbox->MSGCTRL.bit.DLC = length;
 		}
 
-		// The ID is only the last 29 bits. ID cannot be greater than 2^29-1.
-		// I am using the extended identifier only.
-		Mailbox->MSGID.all = (Uint32)ID<<18;
-		Mailbox->MSGID.bit.AAM = 0;
-		Mailbox->MSGID.bit.AME = 0;
-		Mailbox->MSGID.bit.IDE = 0;
+		// Standard or extended, see CAN_ID. AAM and AME are off.
+		Mailbox->MSGID.all = CAN_msgid(ID);
 	}
 
+	CAN_bind(ID, mbox_num, numMbox);
+	CAN_done_arm(bitMaskOfOnes);
+
 	//ECanaRegs.CANME.all |= mbox_mask; //Enable the mailboxes
 	ECanaShadow.CANME.all = ECanaRegs.CANME.all;
 	ECanaShadow.CANME.all |= bitMaskOfOnes;
 	ECanaRegs.CANME.all = ECanaShadow.CANME.all;
 
 	if(block){
-		while(ECanaRegs.CANRMP.all ^ bitMaskOfOnes ){}
+		return CAN_wait_done(bitMaskOfOnes, 1);
 	}
+	return 1;
 }
 /*
  * @brief Request data from specified mailbox
  * length is in bytes
+ * With block set, waits for the remote frames to be acknowledged; returns 0 if that takes over 100 ms, else 1.
  */
-void CAN_request(CAN_ID ID, int length, Uint32 mbox_num, char block){
+char CAN_request(CAN_ID ID, int length, Uint32 mbox_num, char block){
 	struct ECAN_REGS ECanaShadow;
 	volatile struct MBOX *Mailbox;
 
@@ -359,32 +529,76 @@ void CAN_request(CAN_ID ID, int length, Uint32 mbox_num, char block){
 		}
 		Mailbox->MSGCTRL.bit.RTR = 1;// Set request flag
 
-		// The ID is only the last 29 bits. ID cannot be greater than 2^29-1.
-		// I am using the extended identifier only.
-		Mailbox->MSGID.all = (Uint32)ID<<18;
-		Mailbox->MSGID.bit.AAM = 0;
-		Mailbox->MSGID.bit.AME = 0;
-		Mailbox->MSGID.bit.IDE = 0;
+		// Standard or extended, see CAN_ID. AAM and AME are off.
+		Mailbox->MSGID.all = CAN_msgid(ID);
 	}
 
+	CAN_bind(ID, mbox_num, numMbox);
+
 	//ECanaRegs.CANME.all |= mbox_mask; // Enable the mailboxes
 	ECanaShadow.CANME.all = ECanaRegs.CANME.all;
 	ECanaShadow.CANME.all |= bitMaskOfOnes;
 	ECanaRegs.CANME.all = ECanaShadow.CANME.all;
 
+	CAN_done_arm(bitMaskOfOnes);
+
 	//ECanaRegs.CANTRS.all |= mbox_mask;// Request!
 	ECanaShadow.CANTRS.all = ECanaRegs.CANTRS.all;
 	ECanaShadow.CANTRS.all |= bitMaskOfOnes;
 	ECanaRegs.CANTRS.all = ECanaShadow.CANTRS.all;
 
 	if(block){
-		while(ECanaRegs.CANTA.all != ~bitMaskOfOnes ) {}  // Wait for all TAn bits to be set..
+		return CAN_wait_done(bitMaskOfOnes, 0);
 	}
+	return 1;
 }
 
-// @brief Set up a mailbox to automatically send data upon request. Length in bytes.
+/*
+ * @brief Replaces the data of an enabled transmit (autoreply) mailbox without taking it
+ * off the bus. The change-data request (CANMC.CDR with MBNR) stops the eCAN from starting
+ * that mailbox while MDL/MDH change, so a remote frame arriving meanwhile is answered right
+ * afterwards with the new data: never missed, never half old and half new. A reply already
+ * on the wire was copied out before and is not affected.
+ * Only one frame is consistent at a time; values that must agree belong in the same frame.
+ * @return 1 if updated, 0 if mbox_num is not an enabled transmit mailbox.
+ */
+char CAN_autoreply_update(Uint32 mbox_num, Uint32 dataH, Uint32 dataL){
+	struct ECAN_REGS ECanaShadow;
+	volatile struct MBOX *Mailbox = &ECanaMboxes.MBOX0 + mbox_num;
+	Uint32 mbox_mask = (Uint32)1 << mbox_num;
+	Uint16 ier;
+
+	if(!(ECanaRegs.CANME.all & mbox_mask) || (ECanaRegs.CANMD.all & mbox_mask)){
+		return 0;
+	}
+	ier = IER & (M_INT1 | M_INT9);
+	IER &= ~(M_INT1 | M_INT9); //CDR/MBNR cover one mailbox, so one update at a time
+
+	EALLOW;
+	ECanaShadow.CANMC.all = ECanaRegs.CANMC.all;
+	ECanaShadow.CANMC.bit.MBNR = mbox_num;
+	ECanaShadow.CANMC.bit.CDR = 1;
+	ECanaRegs.CANMC.all = ECanaShadow.CANMC.all;
+
+	Mailbox->MDL.all = dataL;
+	Mailbox->MDH.all = dataH;
+
+	ECanaShadow.CANMC.bit.CDR = 0;
+	ECanaRegs.CANMC.all = ECanaShadow.CANMC.all;
+	EDIS;
 
-void CAN_autoreply(Uint32* data, int length, CAN_ID ID, Uint32 mbox_num, char block){
+	IER |= ier;
+	return 1;
+}
+
+/*
+ * @brief Set up mailboxes to automatically send data upon request. Length in bytes.
+ * Calling it again for the same ID, mailboxes and length only refreshes the data through
+ * CAN_autoreply_update, so the mailboxes keep answering while the values change.
+ * With block set, waits for the first reply to go out; returns 0 if no request is answered
+ * within 100 ms, else 1.
+ */
+char CAN_autoreply(Uint32* data, int length, CAN_ID ID, Uint32 mbox_num, char block){
 	struct ECAN_REGS ECanaShadow;
 	volatile struct MBOX *Mailbox;
 
@@ -399,6 +613,26 @@ void CAN_autoreply(Uint32* data, int length, CAN_ID ID, Uint32 mbox_num, char bl
 
 	Uint32 bitMaskOfOnes = (((Uint32)1 << (numMbox)) - (Uint32)1) << (mbox_num);
 
+	if((ECanaRegs.CANME.all & bitMaskOfOnes) == bitMaskOfOnes && !(ECanaRegs.CANMD.all & bitMaskOfOnes)){
+		Uint32 msgid = CAN_msgid(ID) | 0x20000000UL; //AAM
+		int left = length;
+		Uint32 i;
+
+		for(i = 0; i < numMbox; i++){
+			Mailbox = &ECanaMboxes.MBOX0 + i + mbox_num;
+			if(Mailbox->MSGID.all != msgid || Mailbox->MSGCTRL.bit.DLC != (left >= 8 ? 8 : left)){
+				break;
+			}
+			left -= 8;
+		}
+		if(i == numMbox){ //already serving this ID: update in place
+			for(i = 0; i < numMbox; i++){
+				CAN_autoreply_update(mbox_num + i, (length - 8*(int)i > 4) ? data[2*i+1] : 0, data[2*i]);
+			}
+			return 1;
+		}
+	}
+
 	//ECanaRegs.CANTRR.all |= bitMaskOfOnes; //Clear TRS bits
 	ECanaShadow.CANTRR.all = ECanaRegs.CANTRR.all;
 	ECanaShadow.CANTRR.all |= bitMaskOfOnes;
@@ -416,7 +650,7 @@ void CAN_autoreply(Uint32* data, int length, CAN_ID ID, Uint32 mbox_num, char bl
 	ECanaShadow.CANMD.all &= ~bitMaskOfOnes;
 	ECanaRegs.CANMD.all = ECanaShadow.CANMD.all;
 
-	int i;
+	Uint32 i;
 	for (i=0; i< numMbox; i++){
 		Mailbox = &ECanaMboxes.MBOX0 + i + mbox_num;
 
@@ -437,69 +671,632 @@ void CAN_autoreply(Uint32* data, int length, CAN_ID ID, Uint32 mbox_num, char bl
 			Mailbox->MDH.all = 0;
 		}
 
-		// The ID is only the last 29 bits. ID cannot be greater than 2^29-1.
-		// I am using the extended identifier only.
-		Mailbox->MSGID.all = (Uint32) ID;
+		// Same identifier format as CAN_send, so a CAN_request for ID is answered.
+		Mailbox->MSGID.all = CAN_msgid(ID);
 		Mailbox->MSGID.bit.AAM = 1; // Auto answer mode is on
-		Mailbox->MSGID.bit.AME = 0;
-		Mailbox->MSGID.bit.IDE = 1;
 	}
+	CAN_bind(ID, mbox_num, numMbox);
+	CAN_done_arm(bitMaskOfOnes);
+
 	//ECanaRegs.CANME.all |= bitMaskOfOnes; //Enable the mailboxes
 	ECanaShadow.CANME.all = ECanaRegs.CANME.all;
 	ECanaShadow.CANME.all |= bitMaskOfOnes;
 	ECanaRegs.CANME.all = ECanaShadow.CANME.all;
 
 	if(block){
-		while(ECanaRegs.CANTA.all != ~bitMaskOfOnes ) {}  // Wait for all TAn bits to be set..
+		return CAN_wait_done(bitMaskOfOnes, 0);
 	}
+	return 1;
+}
+
+/*
+ * @brief Loads one frame (length 0-8 bytes) into a single transmit mailbox and starts it.
+ * Never waits: if the mailbox still has a frame pending it is left alone. ecan_isr reports
+ * the frame to the CAN_INFO bound with CAN_mbox_bind; no search is done per frame.
+ * @return 1 if the frame was started, 0 if the mailbox was busy.
+ */
+char CAN_mbox_send(CAN_ID ID, Uint32 dataH, Uint32 dataL, Uint16 length, Uint32 mbox_num){
+	struct ECAN_REGS ECanaShadow;
+	volatile struct MBOX *Mailbox = &ECanaMboxes.MBOX0 + mbox_num;
+	Uint32 mbox_mask = (Uint32)1 << mbox_num;
+	Uint16 ier9;
+
+	if((ECanaRegs.CANTRS.all & mbox_mask) || CAN_bus.state == CAN_BUS_OFF){
+		return 0;
+	}
+	ECanaRegs.CANTA.all = mbox_mask; //not waited on, so clear it in case nothing else did
+
+	ECanaShadow.CANME.all = ECanaRegs.CANME.all;
+	ECanaShadow.CANME.all &= ~mbox_mask;
+	ECanaRegs.CANME.all = ECanaShadow.CANME.all;
+
+	ECanaShadow.CANMD.all = ECanaRegs.CANMD.all;
+	ECanaShadow.CANMD.all &= ~mbox_mask;// 0 for transmit
+	ECanaRegs.CANMD.all = ECanaShadow.CANMD.all;
+
+	Mailbox->MSGCTRL.bit.DLC = length > 8 ? 8 : length;
+	Mailbox->MDL.all = dataL;
+	Mailbox->MDH.all = dataH;
+	Mailbox->MSGID.all = CAN_msgid(ID);
+	ier9 = IER & M_INT9;
+	IER &= ~M_INT9; //CAN_tx_timed is also updated by ecan_isr
+	CAN_tx_stamp[mbox_num] = ECanaRegs.CANTSC;
+	CAN_tx_timed |= mbox_mask;
+	IER |= ier9;
+
+	ECanaShadow.CANME.all = ECanaRegs.CANME.all;
+	ECanaShadow.CANME.all |= mbox_mask;
+	ECanaRegs.CANME.all = ECanaShadow.CANME.all;
+
+	ECanaRegs.CANTRS.all = mbox_mask;
+	return 1;
+}
+
+/*
+ * @brief Folds filters into as few (ID, don't-care mask) pairs as the LAM registers can
+ * represent exactly: two entries with the same mask whose IDs differ in one bit become
+ * one entry with that bit masked, and entries covered by another entry are dropped.
+ * Works in place on ids/masks and returns the new count.
+ */
+static Uint16 CAN_filter_merge(Uint32* ids, Uint32* masks, Uint16 count){
+	Uint16 i, j;
+	char merged;
+
+	do{
+		merged = 0;
+		for(i = 0; i < count; i++){
+			for(j = i + 1; j < count; j++){
+				Uint32 diff = ids[i] ^ ids[j];
+
+				if(masks[i] == masks[j] && diff && !(diff & (diff - 1))){
+					ids[i] &= ~diff;
+					masks[i] |= diff;
+				}
+				else if((masks[j] & ~masks[i]) == 0 && ((ids[j] ^ ids[i]) & ~masks[i]) == 0){
+					//j is inside i: nothing to do
+				}
+				else if((masks[i] & ~masks[j]) == 0 && ((ids[i] ^ ids[j]) & ~masks[j]) == 0){
+					ids[i] = ids[j];
+					masks[i] = masks[j];
+				}
+				else{
+					continue;
+				}
+				count--;
+				ids[j] = ids[count];
+				masks[j] = masks[count];
+				merged = 1;
+				j = i; //i changed, so compare it against everything again
+			}
+		}
+	}while(merged);
+
+	return count;
+}
+
+/*
+ * @brief Copies a filter table into ids/masks, normalized so masked ID bits are 0.
+ * @return The number of entries copied, or 0 if count exceeds CAN_FILTER_MAX.
+ */
+static Uint16 CAN_filter_load(const CAN_FILTER* filters, Uint16 count, Uint32* ids, Uint32* masks){
+	Uint16 i;
+
+	if(count > CAN_FILTER_MAX) return 0;
+	for(i = 0; i < count; i++){ //work on MSGID/LAM images so both ID formats merge alike
+		Uint32 mask = CAN_IS_EXT(filters[i].ID) ? CAN_EXT(filters[i].mask) : CAN_STD(filters[i].mask);
+		masks[i] = CAN_msgid(mask) & 0x1FFFFFFF;//no IDE bit: LAMI = 0 keeps the formats apart
+		ids[i] = CAN_msgid(filters[i].ID) & ~masks[i];
+	}
+	return CAN_filter_merge(ids, masks, count);
+}
+
+/*
+ * @brief How many receive mailboxes CAN_filter_init would use for this table,
+ * without touching the hardware. 0 if the table has more than CAN_FILTER_MAX entries.
+ */
+Uint16 CAN_filter_mailboxes(const CAN_FILTER* filters, Uint16 count){
+	Uint32 ids[CAN_FILTER_MAX];
+	Uint32 masks[CAN_FILTER_MAX];
+
+	return CAN_filter_load(filters, count, ids, masks);
+}
+
+/*
+ * @brief Sets up receive mailboxes from a table of ID/mask filters, using the local
+ * acceptance masks so one mailbox takes a whole group of IDs (e.g. every MPPT frame)
+ * and the eCAN drops everything else without interrupting the CPU.
+ * Filters are merged first, so the result may need fewer mailboxes than entries.
+ * Mailboxes are used from mbox_num upwards (wrapping after 31) and are bound to the
+ * CAN_INFO of the filter's base ID; upon_receive_isr gets the ID actually received.
+ * @return Mailboxes consumed, or 0 (nothing changed) if they would not fit in 32.
+ */
+Uint16 CAN_filter_init(const CAN_FILTER* filters, Uint16 count, Uint32 mbox_num){
+	struct ECAN_REGS ECanaShadow;
+	volatile struct MBOX *Mailbox;
+	Uint32 ids[CAN_FILTER_MAX];
+	Uint32 masks[CAN_FILTER_MAX];
+	Uint32 bitMaskOfOnes = 0;
+	Uint16 numMbox = CAN_filter_load(filters, count, ids, masks);
+	Uint16 i, j;
+
+	if(numMbox == 0 || numMbox > 32) return 0;
+	for(i = 0; i < numMbox; i++){
+		bitMaskOfOnes |= (Uint32)1 << ((i + mbox_num) % 32);
+	}
+
+	//ECanaRegs.CANME.all &= ~bitMaskOfOnes; //LAMn and MSGIDn only change while disabled
+	ECanaShadow.CANME.all = ECanaRegs.CANME.all;
+	ECanaShadow.CANME.all &= ~bitMaskOfOnes;
+	ECanaRegs.CANME.all = ECanaShadow.CANME.all;
+
+	//ECanaRegs.CANMD.all |= bitMaskOfOnes; //Configure mailboxes for receive
+	ECanaShadow.CANMD.all = ECanaRegs.CANMD.all;
+	ECanaShadow.CANMD.all |= bitMaskOfOnes;
+	ECanaRegs.CANMD.all = ECanaShadow.CANMD.all;
+
+	for(i = 0; i < numMbox; i++){
+		Uint16 n = (i + mbox_num) % 32;
+		Mailbox = &ECanaMboxes.MBOX0 + n;
+
+		(&ECanaLAMRegs.LAM0)[n].all = masks[i];//1 = don't care, LAMI = 0: IDE must match
+		Mailbox->MSGCTRL.bit.DLC = 8;
+		Mailbox->MSGID.all = ids[i];
+		Mailbox->MSGID.bit.AME = 1;
+
+		for(j = 0; j < count; j++){ //bind to the first table entry the group covers
+			if(((CAN_msgid(filters[j].ID) ^ ids[i]) & ~masks[i]) == 0) break;
+		}
+		CAN_bind(filters[j].ID, n, 1);
+	}
+
+	//ECanaRegs.CANME.all |= bitMaskOfOnes; //Enable the mailboxes
+	ECanaShadow.CANME.all = ECanaRegs.CANME.all;
+	ECanaShadow.CANME.all |= bitMaskOfOnes;
+	ECanaRegs.CANME.all = ECanaShadow.CANME.all;
+
+	return numMbox;
+}
+
+/*
+ * @brief Books a completed transmission: its bits and, if CAN_tx_stamp is valid, how long
+ * it took from queueing (or starting) to acknowledge. MOTS holds the CANTSC of the ACK.
+ */
+static void CAN_tx_sent(Uint16 mbox_num){
+	volatile struct MBOX *Mailbox = &ECanaMboxes.MBOX0 + mbox_num;
+	Uint32 mbox_mask = (Uint32)1 << mbox_num;
+
+	CAN_stats.tx_bits += CAN_frame_bits(CAN_id_from_msgid(Mailbox->MSGID.all), Mailbox->MSGCTRL.bit.DLC);
+	if(CAN_tx_timed & mbox_mask){
+		CAN_latency_add(&CAN_stats.tx, *(&ECanaMOTSRegs.MOTS0 + mbox_num) - CAN_tx_stamp[mbox_num]);
+		CAN_tx_timed &= ~mbox_mask;
+	}
+}
+
+/*
+ * @brief Moves queued frames into free pool mailboxes and starts them.
+ * Also takes back pool mailboxes whose TA is set, so the queue keeps moving when
+ * CAN interrupts are off. Callers must keep ecan_isr out (INT9 masked, or be it).
+ */
+static void CAN_queue_refill(void){
+	struct ECAN_REGS ECanaShadow;
+	volatile struct MBOX *Mailbox;
+	Uint32 done = ECanaRegs.CANTA.all & CAN_tx_pool & ~CAN_tx_free;
+
+	if(done){
+		Uint16 n;
+		ECanaRegs.CANTA.all = done; //Clear only these TA bits
+		CAN_tx_free |= done;
+		for(n = 0; done; n++){
+			if(done & ((Uint32)1 << n)){
+				CAN_tx_sent(n);
+				CAN_tx_stats.sent++;
+				done &= ~((Uint32)1 << n);
+			}
+		}
+	}
+
+	while(CAN_tx_free && CAN_tx_tail != CAN_tx_head){
+		CAN_FRAME* frame = &CAN_TX_QUEUE[CAN_tx_tail];
+		Uint16 mbox_num = 0;
+		Uint32 mbox_mask;
+
+		if(CAN_bus.state == CAN_BUS_OFF){
+			break; //frames wait in the ring; CAN_bus_update drains it once we are back
+		}
+		if(CAN_bus.state == CAN_BUS_PASSIVE && CAN_tx_free != CAN_tx_pool){
+			break; //error passive: one frame in flight at a time
+		}
+
+		while(!(CAN_tx_free & ((Uint32)1 << mbox_num))) mbox_num++; //lowest free mailbox
+		mbox_mask = (Uint32)1 << mbox_num;
+		Mailbox = &ECanaMboxes.MBOX0 + mbox_num;
+
+		ECanaShadow.CANME.all = ECanaRegs.CANME.all;
+		ECanaShadow.CANME.all &= ~mbox_mask;
+		ECanaRegs.CANME.all = ECanaShadow.CANME.all;
+
+		Mailbox->MSGCTRL.bit.DLC = frame->length;
+		Mailbox->MDL.all = frame->dataL;
+		Mailbox->MDH.all = frame->dataH;
+		Mailbox->MSGID.all = CAN_msgid(frame->ID);
+		Mailbox->MSGCTRL.bit.TPL = CAN_tpl(frame->ID);
+		CAN_tx_stamp[mbox_num] = frame->timestamp;//latency counts the time spent in the ring
+		CAN_tx_timed |= mbox_mask;
+
+		ECanaShadow.CANME.all = ECanaRegs.CANME.all;
+		ECanaShadow.CANME.all |= mbox_mask;
+		ECanaRegs.CANME.all = ECanaShadow.CANME.all;
+
+		ECanaRegs.CANTRS.all = mbox_mask; //TRS is write-1-to-set: zeros leave other requests alone
+
+		CAN_tx_free &= ~mbox_mask;
+		CAN_tx_tail = (CAN_tx_tail + 1) & (CAN_TX_QUEUE_SIZE - 1);
+	}
+}
+
+/*
+ * @brief Brings CAN_bus up to date with CANES, CANTEC and CANREC.
+ * Error counters only move while frames go by, so this is called from the system
+ * interrupts, from every mailbox interrupt while not error-active and from CAN_bus_poll.
+ * Coming back from bus-off (the eCAN does that by itself, CANMC.ABO = 1) restarts the
+ * transmit queue. Callers must keep ecan_isr out.
+ */
+static void CAN_bus_update(void){
+	struct ECAN_REGS ECanaShadow;
+	CAN_BUS_STATE state;
+
+	ECanaShadow.CANES.all = ECanaRegs.CANES.all;
+	CAN_bus.tec = ECanaRegs.CANTEC.bit.TEC;
+	CAN_bus.rec = ECanaRegs.CANREC.bit.REC;
+	if(CAN_bus.tec > CAN_bus.max_tec) CAN_bus.max_tec = CAN_bus.tec;
+	if(CAN_bus.rec > CAN_bus.max_rec) CAN_bus.max_rec = CAN_bus.rec;
+
+	if(ECanaShadow.CANES.bit.BO){
+		state = CAN_BUS_OFF;
+	}
+	else if(ECanaShadow.CANES.bit.EP){
+		state = CAN_BUS_PASSIVE;
+	}
+	else if(ECanaShadow.CANES.bit.EW){
+		state = CAN_BUS_WARNING;
+	}
+	else{
+		state = CAN_BUS_ACTIVE;
+	}
+	if(state == CAN_bus.state){
+		return;
+	}
+
+	if(state == CAN_BUS_OFF){
+		CAN_bus.bus_offs++;
+		CAN_bus_off_since = ECanaRegs.CANTSC;
+		bus_error = 1;
+	}
+	else if(state == CAN_BUS_PASSIVE && CAN_bus.state != CAN_BUS_OFF){
+		CAN_bus.passives++;
+	}
+	else if(state == CAN_BUS_WARNING && CAN_bus.state == CAN_BUS_ACTIVE){
+		CAN_bus.warnings++;
+	}
+
+	if(CAN_bus.state == CAN_BUS_OFF){
+		CAN_bus.recovery = ECanaRegs.CANTSC - CAN_bus_off_since;
+		if(CAN_bus.recovery > CAN_bus.max_recovery) CAN_bus.max_recovery = CAN_bus.recovery;
+		bus_error = 0;
+	}
+	CAN_bus.state = state;
+	if(state != CAN_BUS_OFF){
+		CAN_queue_refill(); //back, or less passive: fill the mailboxes we held back
+	}
+}
+
+/*
+ * @brief Checks the error state from the main loop, which is the only way to notice
+ * recovery when nothing is being sent or received.
+ * @return The current state.
+ */
+CAN_BUS_STATE CAN_bus_poll(void){
+	Uint16 ier9 = IER & M_INT9;
+	IER &= ~M_INT9;
+	CAN_bus_update();
+	IER |= ier9;
+	return CAN_bus.state;
+}
+
+/*
+ * @brief Copies the error state and counters into status.
+ */
+void CAN_bus_status(CAN_BUS_STATUS* status){
+	Uint16 ier9 = IER & M_INT9;
+	IER &= ~M_INT9;
+	*status = CAN_bus;
+	IER |= ier9;
+}
+
+/*
+ * @brief Hands the mailboxes in mbox_mask to the transmit queue.
+ * Call after CAN_init. Those mailboxes must not be used with CAN_send and friends.
+ * Frames loaded into different pool mailboxes at the same time go out lowest
+ * identifier first (see CAN_tpl), so use a single mailbox if order matters.
+ */
+void CAN_queue_init(Uint32 mbox_mask){
+	struct ECAN_REGS ECanaShadow;
+	Uint16 i;
+
+	CAN_tx_pool = 0;
+
+	//ECanaRegs.CANTRR.all |= mbox_mask; //Abort anything still pending
+	ECanaRegs.CANTRR.all = mbox_mask;
+	while(ECanaRegs.CANTRS.all & mbox_mask);
+
+	ECanaShadow.CANME.all = ECanaRegs.CANME.all;
+	ECanaShadow.CANME.all &= ~mbox_mask;
+	ECanaRegs.CANME.all = ECanaShadow.CANME.all;
+
+	ECanaShadow.CANMD.all = ECanaRegs.CANMD.all;
+	ECanaShadow.CANMD.all &= ~mbox_mask;// 0 for transmit
+	ECanaRegs.CANMD.all = ECanaShadow.CANMD.all;
+
+	ECanaRegs.CANTA.all = mbox_mask;
+	for(i = 0; i < 32; i++){
+		if(mbox_mask & ((Uint32)1 << i)) CAN_MBOX_INFO[i] = 0;
+	}
+
+	CAN_tx_head = 0;
+	CAN_tx_tail = 0;
+	CAN_tx_stats.depth = 0;
+	CAN_tx_stats.max_depth = 0;
+	CAN_tx_stats.queued = 0;
+	CAN_tx_stats.sent = 0;
+	CAN_tx_stats.dropped = 0;
+	CAN_tx_free = mbox_mask;
+	CAN_tx_pool = mbox_mask;
+}
+
+/*
+ * @brief Queues one frame (length in bytes, 0-8) and returns immediately.
+ * @return 1 if queued, 0 if the ring was full and the frame was dropped.
+ * Safe to call from an upon_sent_isr/upon_receive_isr or a CPU timer ISR
+ * (CAN_schedule) as well as the main loop.
+ */
+char CAN_queue_send(CAN_ID ID, Uint32 dataH, Uint32 dataL, Uint16 length){
+	Uint16 ier = IER & (M_INT1 | M_INT9);
+	Uint16 next, depth;
+
+	IER &= ~(M_INT1 | M_INT9); //one producer at a time, and keep ecan_isr out while mailboxes change hands
+	next = (CAN_tx_head + 1) & (CAN_TX_QUEUE_SIZE - 1);
+	if(next == CAN_tx_tail){
+		CAN_tx_stats.dropped++;
+		IER |= ier;
+		return 0;
+	}
+	CAN_TX_QUEUE[CAN_tx_head].ID = ID;
+	CAN_TX_QUEUE[CAN_tx_head].length = length > 8 ? 8 : length;
+	CAN_TX_QUEUE[CAN_tx_head].dataL = dataL;
+	CAN_TX_QUEUE[CAN_tx_head].dataH = dataH;
+	CAN_TX_QUEUE[CAN_tx_head].timestamp = ECanaRegs.CANTSC;
+	CAN_tx_head = next;
+
+	CAN_tx_stats.queued++;
+	depth = (CAN_tx_head - CAN_tx_tail) & (CAN_TX_QUEUE_SIZE - 1);
+	if(depth > CAN_tx_stats.max_depth) CAN_tx_stats.max_depth = depth;
+
+	CAN_queue_refill();
+	IER |= ier;
+	return 1;
+}
+
+/*
+ * @brief Keeps the queue moving when CAN_init was called without interrupts.
+ * Call it from the main loop; with interrupts on, ecan_isr does this by itself.
+ */
+void CAN_queue_poll(void){
+	Uint16 ier9 = IER & M_INT9;
+	IER &= ~M_INT9;
+	CAN_queue_refill();
+	IER |= ier9;
+}
+
+/*
+ * @brief Copies the transmit queue counters into stats.
+ */
+void CAN_queue_stats(CAN_QUEUE_STATS* stats){
+	Uint16 ier9 = IER & M_INT9;
+	IER &= ~M_INT9;
+	stats->depth = (CAN_tx_head - CAN_tx_tail) & (CAN_TX_QUEUE_SIZE - 1);
+	stats->max_depth = CAN_tx_stats.max_depth;
+	stats->queued = CAN_tx_stats.queued;
+	stats->sent = CAN_tx_stats.sent;
+	stats->dropped = CAN_tx_stats.dropped;
+	IER |= ier9;
+}
+
+/*
+ * @brief Routes every received frame into the receive ring instead of upon_receive_isr.
+ * ecan_isr then only copies the mailbox and clears RMP; the main loop drains the
+ * ring with CAN_rx_peek/CAN_rx_release or CAN_rx_dispatch.
+ */
+void CAN_rx_ring_init(void){
+	CAN_rx_ring_on = 0;
+	CAN_rx_head = 0;
+	CAN_rx_tail = 0;
+	CAN_rx_dropped = 0;
+	CAN_rx_ring_on = 1;
+}
+
+/*
+ * @brief Gives a view of the oldest received frames without copying them.
+ * @return How many frames *frames points at (contiguous, so a batch may stop at
+ * the end of the ring; the rest comes on the next call). They stay valid until
+ * CAN_rx_release.
+ */
+Uint16 CAN_rx_peek(CAN_FRAME** frames){
+	Uint16 head = CAN_rx_head;
+	Uint16 tail = CAN_rx_tail;
+
+	*frames = &CAN_RX_RING[tail];
+	if(head >= tail){
+		return head - tail;
+	}
+	return CAN_RX_RING_SIZE - tail;
+}
+
+/*
+ * @brief Hands count frames from the last CAN_rx_peek back to ecan_isr.
+ */
+void CAN_rx_release(Uint16 count){
+	CAN_rx_tail = (CAN_rx_tail + count) & (CAN_RX_RING_SIZE - 1);
+}
+
+/*
+ * @brief Runs upon_receive_isr for up to max waiting frames, from the main loop.
+ * @return The number of frames handled.
+ */
+Uint16 CAN_rx_dispatch(Uint16 max){
+	CAN_FRAME* frames;
+	Uint16 handled = 0;
+	Uint16 n, i;
+
+	while(handled < max && (n = CAN_rx_peek(&frames)) != 0){
+		if(n > max - handled) n = max - handled;
+		for(i = 0; i < n; i++){
+			CAN_INFO* info = CAN_MBOX_INFO[frames[i].mbox_num];
+			CAN_latency_add(&CAN_stats.rx, ECanaRegs.CANTSC - frames[i].timestamp);
+			if(info && info->upon_receive_isr){
+				info->upon_receive_isr(frames[i].ID, frames[i].dataH, frames[i].dataL, frames[i].length, frames[i].mbox_num);
+			}
+		}
+		CAN_rx_release(n);
+		handled += n;
+	}
+	return handled;
+}
+
+/*
+ * @return Frames dropped because the receive ring was full.
+ */
+Uint32 CAN_rx_lost(void){
+	return CAN_rx_dropped;
+}
+
+static Uint32 CAN_sat16(Uint32 v){
+	return v > 0xFFFF ? 0xFFFF : v;
+}
+
+/*
+ * @brief Clears the latency statistics and restarts the bus load window.
+ */
+void CAN_stats_reset(void){
+	Uint16 ier9 = IER & M_INT9;
+	IER &= ~M_INT9;
+	memset(&CAN_stats, 0, sizeof(CAN_stats));
+	CAN_stats_since = ECanaRegs.CANTSC;
+	IER |= ier9;
+}
+
+/*
+ * @brief Copies the statistics since CAN_stats_reset into stats and fills in elapsed
+ * and load. The load only counts frames this node sent or accepted into a mailbox, so
+ * it is a lower bound on the real bus load unless the filters take everything.
+ */
+void CAN_stats_get(CAN_STATS* stats){
+	Uint16 ier9 = IER & M_INT9;
+	IER &= ~M_INT9;
+	*stats = CAN_stats;
+	stats->elapsed = ECanaRegs.CANTSC - CAN_stats_since;
+	IER |= ier9;
+
+	stats->load = 0;
+	if(stats->elapsed){
+		stats->load = (Uint16)(((float32)(stats->tx_bits + stats->rx_bits) * 1000.0f) / (float32)stats->elapsed);
+	}
+}
+
+/*
+ * @brief Queues a summary frame on ID: bytes 0-1 load (0.1 %), 2-3 worst TX latency,
+ * 4-5 worst RX latency, 6-7 mean TX latency, latencies in bit times saturated at 0xFFFF.
+ * Call it at whatever rate the statistics should be published.
+ * @return What CAN_queue_send returned.
+ */
+char CAN_stats_publish(CAN_ID ID){
+	CAN_STATS stats;
+	Uint32 mean = 0;
+
+	CAN_stats_get(&stats);
+	if(stats.tx.count) mean = stats.tx.total / stats.tx.count;
+	return CAN_queue_send(ID,
+			(CAN_sat16(stats.rx.max) << 16) | CAN_sat16(mean),
+			((Uint32)stats.load << 16) | CAN_sat16(stats.tx.max), 8);
+}
+
+/*
+ * @brief Copies a receive mailbox into the ring. Called from ecan_isr only.
+ */
+static void CAN_rx_push(Uint16 mbox_num, volatile struct MBOX *Mailbox){
+	Uint16 next = (CAN_rx_head + 1) & (CAN_RX_RING_SIZE - 1);
+	CAN_FRAME* frame = &CAN_RX_RING[CAN_rx_head];
+
+	if(next == CAN_rx_tail){
+		CAN_rx_dropped++;
+		return;
+	}
+	frame->ID = CAN_id_from_msgid(Mailbox->MSGID.all);
+	frame->length = Mailbox->MSGCTRL.bit.DLC;
+	frame->dataL = Mailbox->MDL.all;
+	frame->dataH = Mailbox->MDH.all;
+	frame->timestamp = *(&ECanaMOTSRegs.MOTS0 + mbox_num);
+	frame->mbox_num = mbox_num;
+	CAN_rx_head = next; //publish only once the frame is complete
 }
 
 //@brief Based on the the event which triggered the interrupt (sent or received), calls the user specified function
+//The mailbox number in MIV1 indexes CAN_MBOX_INFO directly, so the cost does not grow with CAN_ARRAY_LENGTH.
+//No stdio in here: puts takes milliseconds and would stall every other interrupt.
 
 //checks what threw the interrupt (after a send or receive)
 __interrupt void ecan_isr(void){
-	puts("ecan_isr called");
-	//Extract mailbox number, CAN ID, data, execute desired user function
 	struct ECAN_REGS ECanaShadow;
 
 	ECanaShadow.CANGIF0.all = ECanaRegs.CANGIF0.all;
-	if(ECanaShadow.CANGIF0.bit.BOIF0){
-		bus_error = 1;
-		if(DEBUG)
-			puts("CAN BUS ERROR");
-		ECanaShadow.CANGIF0.bit.BOIF0 |= 1; // Clear bus off interrupt flag by writing a 1. Doesn't seem to actually reset.
-		EALLOW;
-		ECanaRegs.CANGIF0.all = ECanaShadow.CANGIF0.all;
-		ECanaRegs.CANMC.bit.CCR = 0;
-		EDIS;
+	if(ECanaShadow.CANGIF0.all & 0x00000700){ //WLIF0, EPIF0 or BOIF0
+		//Clear just those flags with a 32-bit write of 1s. No CCR poking needed: ABO
+		//brings the module back on the bus after 128 x 11 recessive bits.
+		ECanaRegs.CANGIF0.all = ECanaShadow.CANGIF0.all & 0x00000700;
+		CAN_bus_update();
 	}
 	else{
-		Uint32 i;
-		Uint32 ID;
-		volatile struct MBOX *Mailbox;
-
 		//Determine which mailbox generated the interrupt
 		Uint16 mbox_num = ECanaRegs.CANGIF1.bit.MIV1;
-		Mailbox = &ECanaMboxes.MBOX0 + mbox_num;
+		volatile struct MBOX *Mailbox = &ECanaMboxes.MBOX0 + mbox_num;
 		Uint32 mbox_mask = (Uint32) 1 << (Uint32) mbox_num;
+		CAN_INFO* info = CAN_MBOX_INFO[mbox_num];
 
-		ID = Mailbox->MSGID.bit.STDMSGID; //The ID is only the last 29 bits.
-		for(i=0; i< CAN_ARRAY_LENGTH; i++){
-			if(CAN_INFO_ARRAY[i].ID == (Uint32)ID){
-				if(ECanaRegs.CANTA.all & mbox_mask){ //If TA bit is set
-					CAN_INFO_ARRAY[i].upon_sent_isr(CAN_INFO_ARRAY[i].ID,Mailbox->MDH.all, Mailbox->MDL.all,Mailbox->MSGCTRL.bit.DLC,mbox_num);
-					ECanaRegs.CANTA.all |= mbox_mask; //Clear TA bit by writing 1
-					if(DEBUG) {
-						puts("CAN sent ISR");
-					}
-				}
-				else if(ECanaRegs.CANRMP.all & mbox_mask){ //If RMP bit is set
-					CAN_INFO_ARRAY[i].upon_receive_isr(CAN_INFO_ARRAY[i].ID, Mailbox->MDH.all, Mailbox->MDL.all,Mailbox->MSGCTRL.bit.DLC, mbox_num);
-					ECanaRegs.CANRMP.all |= mbox_mask; //Clear RMP bit by writing 1
-				}
+		if(CAN_tx_pool & mbox_mask){ //A queued frame went out: reload the mailbox
+			CAN_queue_refill();
+		}
+		else if(ECanaRegs.CANTA.all & mbox_mask){ //If TA bit is set
+			CAN_tx_sent(mbox_num);
+			CAN_done |= mbox_mask; //for a blocking call waiting on this mailbox
+			if(info && info->upon_sent_isr){
+				info->upon_sent_isr(info->ID, Mailbox->MDH.all, Mailbox->MDL.all, Mailbox->MSGCTRL.bit.DLC, mbox_num);
 			}
+			ECanaRegs.CANTA.all = mbox_mask; //Clear only this TA bit by writing 1 (|= would clear all of them)
+		}
+		else if(ECanaRegs.CANRMP.all & mbox_mask){ //If RMP bit is set
+			CAN_stats.rx_bits += CAN_frame_bits(CAN_id_from_msgid(Mailbox->MSGID.all), Mailbox->MSGCTRL.bit.DLC);
+			if(CAN_rx_ring_on){
+				CAN_rx_push(mbox_num, Mailbox);
+			}
+			else if(info && info->upon_receive_isr){
+				CAN_latency_add(&CAN_stats.rx, ECanaRegs.CANTSC - *(&ECanaMOTSRegs.MOTS0 + mbox_num));
+				info->upon_receive_isr(CAN_id_from_msgid(Mailbox->MSGID.all), Mailbox->MDH.all, Mailbox->MDL.all, Mailbox->MSGCTRL.bit.DLC, mbox_num);
+			}
+			CAN_done |= mbox_mask;
+			ECanaRegs.CANRMP.all = mbox_mask; //Clear only this RMP bit by writing 1
+		}
+		if(CAN_bus.state != CAN_BUS_ACTIVE){ //traffic is moving again: counters may have dropped
+			CAN_bus_update();
 		}
 	}
 	PieCtrlRegs.PIEACK.bit.ACK9 = 1; //Acknowledge interrupt
 }
-
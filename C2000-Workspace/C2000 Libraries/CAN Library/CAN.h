@@ -10,19 +10,126 @@ typedef enum{
 	SCREEN,
 	MPPT=0x600
 	//Number of CAN nodes must be less than 2^29! Not going to be a problem...ever
-} CAN_ID;
+} CAN_NODE;
 
 #include "F2806x_Cla_typedefs.h"
+
+//A CAN identifier. Plain values (the CAN_NODE names, or anything up to 0x7FF) are
+//11-bit standard IDs. CAN_EXT marks a 29-bit extended ID. A Uint32, not an enum:
+//on the C28x an enum is only 16 bits wide, which cannot hold a 29-bit identifier.
+//Lower identifiers win arbitration, so the priority lives in the top bits.
+typedef Uint32 CAN_ID;
+
+#define CAN_ID_EXTENDED 0x80000000UL
+#define CAN_STD(id) ((CAN_ID)(id) & 0x7FFUL)
+#define CAN_EXT(id) (CAN_ID_EXTENDED | ((CAN_ID)(id) & 0x1FFFFFFFUL))
+#define CAN_IS_EXT(id) (((id) & CAN_ID_EXTENDED) != 0)
+
+//J1939 layout of a 29-bit ID: priority (0 highest - 7), 18-bit PGN, source address
+#define CAN_J1939(priority, pgn, source) CAN_EXT(((Uint32)(priority) & 7) << 26 | ((Uint32)(pgn) & 0x3FFFFUL) << 8 | ((Uint32)(source) & 0xFF))
+#define CAN_J1939_PRIORITY(id) ((Uint16)(((id) >> 26) & 7))
+#define CAN_J1939_PGN(id) (((id) >> 8) & 0x3FFFFUL)
+#define CAN_J1939_SOURCE(id) ((Uint16)((id) & 0xFF))
+
+//Same idea for 11-bit IDs: priority (0 highest - 7) in bits 10-8, node/message in 7-0
+#define CAN_STD_PRIO(priority, id) CAN_STD(((Uint32)(priority) & 7) << 8 | ((Uint32)(id) & 0xFF))
+
 typedef struct{
 	CAN_ID ID;
 	void (*upon_sent_isr)(CAN_ID ID, Uint32 dataH, Uint32 dataL, Uint16 length, int mbox_num);
 	void (*upon_receive_isr)(CAN_ID ID, Uint32 dataH, Uint32 dataL, Uint16 length, int mbox_num);
 }CAN_INFO;
 
-void CAN_send(Uint32* data, int length, CAN_ID ID, Uint32 mbox_num, char block);
-void CAN_receive(CAN_ID ID, int length, Uint32 mbox_num, char block);
-void CAN_request(CAN_ID ID, int length, Uint32 mbox_num, char block);
-void CAN_autoreply(Uint32* data, int length, CAN_ID ID, Uint32 mbox_num, char block);
+typedef struct{
+	CAN_ID ID;
+	Uint16 length;//DLC, 0-8 bytes
+	Uint32 dataL;//MDL: bytes 0-3
+	Uint32 dataH;//MDH: bytes 4-7
+	Uint32 timestamp;//received frames: CANTSC value when the frame arrived (MOTS)
+	Uint16 mbox_num;//received frames: mailbox it arrived in
+}CAN_FRAME;
+
+typedef struct{
+	Uint16 depth;//frames waiting in the ring right now
+	Uint16 max_depth;//high-water mark since CAN_queue_init
+	Uint32 queued;//frames accepted by CAN_queue_send
+	Uint32 sent;//frames the bus has acknowledged
+	Uint32 dropped;//frames refused because the ring was full
+}CAN_QUEUE_STATS;
+
+typedef struct{
+	CAN_ID ID;//identifier to accept, standard or CAN_EXT
+	Uint32 mask;//identifier bits that may differ from ID (1 = don't care), 0 for exactly ID.
+	//Same bit numbering as the identifier; a filter never matches the other ID format.
+}CAN_FILTER;
+
+#define CAN_LATENCY_BINS 16
+
+typedef struct{
+	Uint32 count;
+	Uint32 min;//bit times
+	Uint32 max;
+	Uint32 total;//sum of all samples, for the mean
+	Uint32 histogram[CAN_LATENCY_BINS];//bin n: [2^n, 2^(n+1)) bit times, last bin open-ended
+}CAN_LATENCY;
+
+typedef struct{
+	CAN_LATENCY tx;//queued (CAN_queue_send) or started (CAN_mbox_send) -> acknowledged
+	CAN_LATENCY rx;//arrived in the mailbox -> handed to upon_receive_isr
+	Uint32 tx_bits;//bus bits of frames sent, see CAN_frame_bits
+	Uint32 rx_bits;//bus bits of frames received
+	Uint32 elapsed;//bit times since CAN_stats_reset
+	Uint16 load;//(tx_bits + rx_bits) / elapsed, in 0.1 %
+}CAN_STATS;
+
+typedef enum{
+	CAN_BUS_ACTIVE,//error counters below 96
+	CAN_BUS_WARNING,//a counter reached 96
+	CAN_BUS_PASSIVE,//a counter reached 128: the queue keeps one frame in flight
+	CAN_BUS_OFF//TEC passed 255: nothing is sent until the eCAN is back on the bus
+} CAN_BUS_STATE;
+
+typedef struct{
+	CAN_BUS_STATE state;
+	Uint16 tec, rec;//error counters at the last update
+	Uint16 max_tec, max_rec;
+	Uint32 warnings;//times the warning level was reached from error-active
+	Uint32 passives;//times error-passive was entered (not counting on the way back from bus-off)
+	Uint32 bus_offs;
+	Uint32 recovery;//bit times the last bus-off lasted
+	Uint32 max_recovery;
+}CAN_BUS_STATUS;
+
+#define CAN_FILTER_MAX 32//entries in one CAN_filter_init table, before merging
+#define CAN_TX_QUEUE_SIZE 32//frames; must be a power of 2
+#define CAN_RX_RING_SIZE 64//frames; must be a power of 2
+
+char CAN_send(Uint32* data, int length, CAN_ID ID, Uint32 mbox_num, char block);
+char CAN_receive(CAN_ID ID, int length, Uint32 mbox_num, char block);
+char CAN_request(CAN_ID ID, int length, Uint32 mbox_num, char block);
+char CAN_autoreply(Uint32* data, int length, CAN_ID ID, Uint32 mbox_num, char block);
+char CAN_autoreply_update(Uint32 mbox_num, Uint32 dataH, Uint32 dataL);
 void CAN_init(CAN_INFO* can_array, Uint32 can_length, char enableInterrupts);
+void CAN_mbox_bind(CAN_ID ID, Uint32 mbox_num);
+char CAN_mbox_send(CAN_ID ID, Uint32 dataH, Uint32 dataL, Uint16 length, Uint32 mbox_num);
+Uint16 CAN_filter_init(const CAN_FILTER* filters, Uint16 count, Uint32 mbox_num);
+Uint16 CAN_filter_mailboxes(const CAN_FILTER* filters, Uint16 count);
+Uint32 CAN_msgid(CAN_ID ID);
+CAN_ID CAN_id_from_msgid(Uint32 msgid);
+void CAN_queue_init(Uint32 mbox_mask);
+char CAN_queue_send(CAN_ID ID, Uint32 dataH, Uint32 dataL, Uint16 length);
+void CAN_queue_poll(void);
+void CAN_queue_stats(CAN_QUEUE_STATS* stats);
+void CAN_rx_ring_init(void);
+Uint16 CAN_rx_peek(CAN_FRAME** frames);
+void CAN_rx_release(Uint16 count);
+Uint16 CAN_rx_dispatch(Uint16 max);
+Uint32 CAN_rx_lost(void);
+Uint16 CAN_frame_bits(CAN_ID ID, Uint16 length);
+void CAN_stats_reset(void);
+void CAN_stats_get(CAN_STATS* stats);
+char CAN_stats_publish(CAN_ID ID);
+CAN_BUS_STATE CAN_bus_poll(void);
+void CAN_bus_status(CAN_BUS_STATUS* status);
 
 #endif
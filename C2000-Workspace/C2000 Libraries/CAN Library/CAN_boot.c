@@ -0,0 +1,359 @@
+/*
+ * CAN_boot.c
+ *
+ * Two contexts share the work. ecan_isr (through CAN_transport) copies DATA
+ * blocks into free RAM buffers and answers them; the main loop programs full
+ * buffers and handles every other command. A DATA block that finds all buffers
+ * full is left in the transport's receive buffer for the main loop, which
+ * takes it as soon as a buffer has been programmed. The host waits for each
+ * answer, so that receive buffer is never overwritten meanwhile.
+ *
+ * Everything, the Flash2806x API included, runs from RAM (see
+ * F28069_CANBOOT.cmd), so interrupts stay enabled during erase and program.
+ */
+#include "DSP28x_Project.h"
+#include "CAN_boot.h"
+#include "Flash2806x_API_Library.h"//its CPU_RATE matches F2806x_Examples.h; the API's own delays use Flash_CPUScaleFactor
+#include "clocks.h"
+
+#define CAN_BOOT_TX_MBOX	0
+#define CAN_BOOT_RX_MBOX	1
+#define CAN_BOOT_SECTOR_WORDS 0x4000UL
+
+static const Uint32 CAN_boot_crc_table[16] = {
+	0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+	0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+static CAN_TP CAN_boot_tp;
+static Uint16 CAN_boot_rx[5 + 2*CAN_BOOT_BLOCK];//one byte per word, as CAN_transport hands them
+static Uint16 CAN_boot_buffer[CAN_BOOT_BUFFERS][CAN_BOOT_BLOCK];
+static Uint16 CAN_boot_buffer_words[CAN_BOOT_BUFFERS];
+static Uint32 CAN_boot_buffer_offset[CAN_BOOT_BUFFERS];
+static volatile Uint16 CAN_boot_head = 0;//buffers filled, written by CAN_boot_accept only
+static volatile Uint16 CAN_boot_tail = 0;//buffers programmed, written by the main loop only
+static Uint16 CAN_boot_answer_buffer[6];
+static volatile Uint16 CAN_boot_answer_length = 0;//answer still waiting for the transport
+static volatile Uint16 CAN_boot_request = 0;//length of a message left for the main loop
+static volatile Uint32 CAN_boot_ms = 0;
+
+static Uint32 CAN_boot_start;//image being received
+static Uint32 CAN_boot_words;
+static Uint32 CAN_boot_expected;//its CRC, from START
+static volatile Uint32 CAN_boot_received;//words accepted into buffers
+static volatile char CAN_boot_active = 0;//START accepted, END not yet
+static Uint16 CAN_boot_status;//first error since START
+static Uint16 CAN_boot_erased;//sector mask erased since START
+
+//Word address to pointer. Written this way it is also right where pointers count bytes (host build).
+static Uint16* CAN_boot_flash(Uint32 addr){
+	return (Uint16*)0 + addr;
+}
+
+static Uint32 CAN_boot_be32(const Uint16* bytes){
+	return ((Uint32)(bytes[0] & 0xFF) << 24) | ((Uint32)(bytes[1] & 0xFF) << 16) |
+			((Uint32)(bytes[2] & 0xFF) << 8) | (bytes[3] & 0xFF);
+}
+
+/*
+ * @brief Continues a CRC-32 over count words, high byte first. Start with crc = 0;
+ * the result of one call can be passed to the next.
+ */
+Uint32 CAN_boot_crc(Uint32 crc, const Uint16* words, Uint32 count){
+	Uint32 i;
+	Uint16 b;
+
+	crc = ~crc;
+	for(i = 0; i < count; i++){
+		for(b = 0; b < 2; b++){
+			crc ^= b ? (words[i] & 0xFF) : (words[i] >> 8);
+			crc = (crc >> 4) ^ CAN_boot_crc_table[crc & 0xF];
+			crc = (crc >> 4) ^ CAN_boot_crc_table[crc & 0xF];
+		}
+	}
+	return ~crc;
+}
+
+/*
+ * @return 1 if the header names an image inside the application sectors and the
+ * flash still holds it.
+ */
+char CAN_boot_app_valid(void){
+	const Uint32* header = (const Uint32*)CAN_boot_flash(CAN_BOOT_HEADER);
+
+	if(header[0] != CAN_BOOT_MAGIC || header[1] < CAN_BOOT_APP_START || header[1] >= CAN_BOOT_APP_END || header[2] == 0 ||
+			header[2] > CAN_BOOT_APP_END - header[1]){
+		return 0;
+	}
+	return CAN_boot_crc(0, CAN_boot_flash(header[1]), header[2]) == header[3];
+}
+
+/*
+ * @brief Sends an answer: command | 0x80, status and, if has_value, a 32-bit value.
+ * Runs in either context; if the transport is still busy the main loop sends it later.
+ */
+static void CAN_boot_answer(Uint16 command, Uint16 status, Uint32 value, char has_value){
+	Uint16 ier9 = IER & M_INT9;
+	Uint16 length = 2;
+
+	IER &= ~M_INT9;
+	CAN_boot_answer_buffer[0] = command | 0x80;
+	CAN_boot_answer_buffer[1] = status;
+	if(has_value){
+		CAN_boot_answer_buffer[2] = (value >> 24) & 0xFF;
+		CAN_boot_answer_buffer[3] = (value >> 16) & 0xFF;
+		CAN_boot_answer_buffer[4] = (value >> 8) & 0xFF;
+		CAN_boot_answer_buffer[5] = value & 0xFF;
+		length = 6;
+	}
+	CAN_boot_answer_length = CAN_tp_send(&CAN_boot_tp, CAN_boot_answer_buffer, length) ? 0 : length;
+	IER |= ier9;
+}
+
+/*
+ * @brief Takes a DATA message into the next free buffer and answers it.
+ * @return 0 if every buffer is still waiting to be programmed, 1 otherwise.
+ */
+static char CAN_boot_accept(const Uint16* data, Uint16 length){
+	Uint16 slot, words, i;
+	Uint32 offset;
+	Uint16* buffer;
+
+	if(length < 5 || ((length - 5) & 1)){
+		CAN_boot_answer(CAN_BOOT_DATA, CAN_BOOT_BAD_COMMAND, CAN_boot_received, 1);
+		return 1;
+	}
+	words = (length - 5) / 2;
+	offset = CAN_boot_be32(&data[1]);
+	if(!CAN_boot_active || offset != CAN_boot_received || words > CAN_BOOT_BLOCK ||
+			words > CAN_boot_words - offset){
+		CAN_boot_answer(CAN_BOOT_DATA, CAN_BOOT_BAD_ORDER, CAN_boot_received, 1);
+		return 1;
+	}
+	if((Uint16)(CAN_boot_head - CAN_boot_tail) == CAN_BOOT_BUFFERS){
+		return 0;
+	}
+
+	slot = CAN_boot_head & (CAN_BOOT_BUFFERS - 1);
+	buffer = CAN_boot_buffer[slot];
+	for(i = 0; i < words; i++){
+		buffer[i] = ((data[5 + 2*i] & 0xFF) << 8) | (data[6 + 2*i] & 0xFF);
+	}
+	CAN_boot_buffer_words[slot] = words;
+	CAN_boot_buffer_offset[slot] = offset;
+	CAN_boot_received += words;
+	CAN_boot_head++;
+	CAN_boot_answer(CAN_BOOT_DATA, CAN_BOOT_OK, CAN_boot_received, 1);
+	return 1;
+}
+
+static void CAN_boot_on_message(CAN_TP* tp, Uint16* data, Uint16 length){
+	if(!CAN_boot_request && data[0] == CAN_BOOT_DATA && CAN_boot_accept(data, length)){
+		return;
+	}
+	CAN_boot_request = length;
+}
+
+static void CAN_boot_sent_isr(CAN_ID ID, Uint32 dataH, Uint32 dataL, Uint16 length, int mbox_num){
+	CAN_tp_on_sent(&CAN_boot_tp);
+}
+
+static void CAN_boot_receive_isr(CAN_ID ID, Uint32 dataH, Uint32 dataL, Uint16 length, int mbox_num){
+	CAN_tp_on_receive(&CAN_boot_tp, dataH, dataL, length);
+}
+
+static CAN_INFO CAN_boot_info[2] = {
+	{0, &CAN_boot_sent_isr, 0},
+	{0, 0, &CAN_boot_receive_isr}
+};
+
+__interrupt void CAN_boot_tick(void){
+	CAN_boot_ms++;
+	PieCtrlRegs.PIEACK.all = PIEACK_GROUP1;
+}
+
+/*
+ * @brief Erases every sector of [addr, addr + words) not erased since START.
+ */
+static Uint16 CAN_boot_erase(Uint32 addr, Uint32 words){
+	Uint16 mask = 0;
+	Uint32 sector;
+	FLASH_ST status;
+
+	for(sector = (addr - CAN_BOOT_APP_START) / CAN_BOOT_SECTOR_WORDS;
+			sector <= (addr + words - 1 - CAN_BOOT_APP_START) / CAN_BOOT_SECTOR_WORDS; sector++){
+		mask |= SECTORH >> sector;//H at 0x3D8000 up to B at 0x3F0000
+	}
+	mask &= ~CAN_boot_erased;
+	if(!mask){
+		return STATUS_SUCCESS;
+	}
+	CAN_boot_erased |= mask;
+	return Flash_Erase(mask, &status);
+}
+
+//Main loop: program the oldest full buffer
+static void CAN_boot_program(void){
+	Uint16 slot = CAN_boot_tail & (CAN_BOOT_BUFFERS - 1);
+	Uint32 addr = CAN_boot_start + CAN_boot_buffer_offset[slot];
+	Uint16 words = CAN_boot_buffer_words[slot];
+	FLASH_ST status;
+
+	if(CAN_boot_status == CAN_BOOT_OK){
+		if(CAN_boot_erase(addr, words) != STATUS_SUCCESS ||
+				Flash_Program(CAN_boot_flash(addr), CAN_boot_buffer[slot], words, &status) != STATUS_SUCCESS){
+			CAN_boot_status = CAN_BOOT_FLASH_FAIL;
+			CAN_boot_active = 0;//further DATA is refused, END reports the failure
+		}
+	}
+	CAN_boot_tail++;
+}
+
+static void CAN_boot_jump(void){
+	DINT;
+	CpuTimer0Regs.TCR.bit.TSS = 1;
+	IER = 0x0000;
+	IFR = 0x0000;
+	((void (*)(void))CAN_boot_flash(CAN_BOOT_APP_ENTRY))();
+}
+
+//Main loop: everything but DATA that found a free buffer
+static void CAN_boot_command(const Uint16* data, Uint16 length, char* stay){
+	Uint32 header[4];
+	FLASH_ST status;
+	Uint16 ier9;
+
+	switch(data[0]){
+	case CAN_BOOT_HELLO:
+		*stay = 1;
+		CAN_boot_answer(CAN_BOOT_HELLO, CAN_BOOT_OK,
+				((Uint32)CAN_boot_app_valid() << 8) | CAN_BOOT_VERSION, 1);
+		break;
+
+	case CAN_BOOT_START:
+		*stay = 1;
+		if(length != 13){
+			CAN_boot_answer(CAN_BOOT_START, CAN_BOOT_BAD_COMMAND, 0, 0);
+			break;
+		}
+		ier9 = IER & M_INT9;
+		IER &= ~M_INT9;
+		CAN_boot_active = 0;
+		CAN_boot_head = 0;
+		CAN_boot_tail = 0;
+		CAN_boot_received = 0;
+		IER |= ier9;
+		CAN_boot_start = CAN_boot_be32(&data[1]);
+		CAN_boot_words = CAN_boot_be32(&data[5]);
+		CAN_boot_expected = CAN_boot_be32(&data[9]);
+		if(CAN_boot_start < CAN_BOOT_APP_START || CAN_boot_start >= CAN_BOOT_APP_END || CAN_boot_words == 0 ||
+				CAN_boot_words > CAN_BOOT_APP_END - CAN_boot_start){
+			CAN_boot_answer(CAN_BOOT_START, CAN_BOOT_BAD_RANGE, 0, 0);
+			break;
+		}
+		CAN_boot_erased = 0;
+		CAN_boot_status = CAN_BOOT_OK;
+		if(CAN_boot_erase(CAN_BOOT_HEADER, 8) != STATUS_SUCCESS){//the old application is gone from here on
+			CAN_boot_answer(CAN_BOOT_START, CAN_BOOT_FLASH_FAIL, 0, 0);
+			break;
+		}
+		CAN_boot_active = 1;
+		CAN_boot_answer(CAN_BOOT_START, CAN_BOOT_OK, 0, 0);
+		break;
+
+	case CAN_BOOT_DATA:
+		if(!CAN_boot_accept(data, length)){
+			return;//still no free buffer: try again after the next one is programmed
+		}
+		break;
+
+	case CAN_BOOT_END:
+		if(CAN_boot_status != CAN_BOOT_OK){
+			CAN_boot_answer(CAN_BOOT_END, CAN_boot_status, 0, 1);
+			break;
+		}
+		if(!CAN_boot_active || CAN_boot_received != CAN_boot_words){
+			CAN_boot_answer(CAN_BOOT_END, CAN_BOOT_BAD_ORDER, 0, 1);
+			break;
+		}
+		CAN_boot_active = 0;
+		header[0] = CAN_BOOT_MAGIC;
+		header[1] = CAN_boot_start;
+		header[2] = CAN_boot_words;
+		header[3] = CAN_boot_crc(0, CAN_boot_flash(CAN_boot_start), CAN_boot_words);
+		if(header[3] != CAN_boot_expected){
+			CAN_boot_answer(CAN_BOOT_END, CAN_BOOT_BAD_CRC, header[3], 1);
+			break;
+		}
+		if(Flash_Program(CAN_boot_flash(CAN_BOOT_HEADER), (Uint16*)header, 8, &status) != STATUS_SUCCESS){
+			CAN_boot_answer(CAN_BOOT_END, CAN_BOOT_FLASH_FAIL, header[3], 1);
+			break;
+		}
+		CAN_boot_answer(CAN_BOOT_END, CAN_BOOT_OK, header[3], 1);
+		break;
+
+	case CAN_BOOT_RUN:
+		if(!CAN_boot_app_valid()){
+			CAN_boot_answer(CAN_BOOT_RUN, CAN_BOOT_NO_APP, 0, 0);
+			break;
+		}
+		CAN_boot_answer(CAN_BOOT_RUN, CAN_BOOT_OK, 0, 0);
+		while(CAN_boot_answer_length || CAN_boot_tp.tx_state != CAN_TP_IDLE || (ECanaRegs.CANTRS.all & (1UL << CAN_BOOT_TX_MBOX))){}
+		CAN_boot_jump();
+		break;
+
+	default:
+		CAN_boot_answer(data[0], CAN_BOOT_BAD_COMMAND, 0, 0);
+		break;
+	}
+	CAN_boot_request = 0;
+}
+
+/*
+ * @brief The bootloader's main loop. Sets the clock to 90 MHz, listens on rx_id and
+ * answers on tx_id. Starts a valid application CAN_BOOT_WINDOW_MS after reset unless
+ * a HELLO or START came in first.
+ */
+void CAN_boot_run(CAN_ID tx_id, CAN_ID rx_id){
+	char stay = 0;
+	char valid;
+
+	SysClkInit(NINETY);
+	EALLOW;
+	Flash_CPUScaleFactor = (Uint32)(1048576.0f * 0.2f * getfclk());//SCALE_FACTOR for this SYSCLKOUT
+	Flash_CallbackPtr = 0;
+	EDIS;
+
+	CAN_boot_info[0].ID = tx_id;
+	CAN_boot_info[1].ID = rx_id;
+	CAN_init(CAN_boot_info, 2, 1);
+	CAN_tp_init(&CAN_boot_tp, tx_id, rx_id, CAN_BOOT_TX_MBOX, CAN_BOOT_RX_MBOX,
+			CAN_boot_rx, sizeof(CAN_boot_rx) / sizeof(CAN_boot_rx[0]), &CAN_boot_on_message);
+
+	EALLOW;
+	PieVectTable.TINT0 = &CAN_boot_tick;
+	EDIS;
+	PieCtrlRegs.PIEIER1.bit.INTx7 = 1;
+	TimerInit(1);//1 kHz
+	IER |= M_INT1;
+	EINT;
+
+	valid = CAN_boot_app_valid();
+	while(1){
+		if(CAN_boot_tail != CAN_boot_head){
+			CAN_boot_program();
+		}
+		if(CAN_boot_request && (CAN_boot_tail == CAN_boot_head || CAN_boot_rx[0] == CAN_BOOT_DATA)){
+			CAN_boot_command(CAN_boot_rx, CAN_boot_request, &stay);
+		}
+		if(CAN_boot_answer_length && CAN_boot_tp.tx_state == CAN_TP_IDLE){
+			CAN_boot_answer(CAN_boot_answer_buffer[0] & 0x7F, CAN_boot_answer_buffer[1],
+					CAN_boot_be32(&CAN_boot_answer_buffer[2]), CAN_boot_answer_length > 2);
+		}
+		CAN_tp_poll(&CAN_boot_tp, CAN_boot_ms);
+
+		if(!stay && valid && CAN_boot_ms >= CAN_BOOT_WINDOW_MS){
+			CAN_boot_jump();
+		}
+	}
+}
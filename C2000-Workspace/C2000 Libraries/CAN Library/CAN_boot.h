@@ -0,0 +1,81 @@
+/*
+ * CAN_boot.h
+ *
+ * Flash bootloader over CAN. It lives in FLASHA (28069Common/cmd/F28069_CANBOOT.cmd
+ * with 28069Common/asm/F2806x_CANBootStart.asm) and runs entirely from RAM, so
+ * ecan_isr keeps receiving while the Flash2806x API erases and programs. The
+ * application is linked with 28069Common/cmd/F28069_CANAPP.cmd: sectors H to B,
+ * entry point at CAN_BOOT_APP_ENTRY, last 8 words of FLASHB left for the header.
+ *
+ * Messages are CAN_transport messages from the host on rx_id, answered on tx_id.
+ * Multi-byte fields are big-endian; image words go high byte first.
+ *
+ *   0x00 HELLO                     -> 80 status, app_valid, version
+ *   0x01 START addr(4) words(4) crc(4)   erases FLASHB (the header) and expects
+ *                                    the image for [addr, addr + words)
+ *                                  -> 81 status
+ *   0x02 DATA offset(4) word...    up to CAN_BOOT_BLOCK words at word offset,
+ *                                    in order from 0
+ *                                  -> 82 status, next offset(4)
+ *   0x03 END                       once everything is programmed: CRC-32 of the
+ *                                    flash contents, header written if it matches
+ *                                  -> 83 status, crc(4)
+ *   0x04 RUN                       -> 84 status, then jumps to the application
+ *
+ * A DATA block is answered as soon as it is in one of CAN_BOOT_BUFFERS RAM
+ * buffers, not when it is programmed, so the next block crosses the bus while
+ * this one is written to flash: a transfer is paced by the bus unless flash
+ * programming is slower, in which case the answers wait for a free buffer.
+ * Sectors are erased the first time a block reaches them.
+ *
+ * CRC-32 is the usual one (reflected 0x04C11DB7, initial and final XOR
+ * 0xFFFFFFFF) over the image bytes in transfer order.
+ *
+ * After reset the bootloader waits CAN_BOOT_WINDOW_MS for a HELLO and then
+ * starts a valid application; without one it waits forever. An application
+ * that receives an update request can simply let the watchdog reset the chip.
+ */
+#ifndef CAN_BOOT_H_
+#define CAN_BOOT_H_
+
+#include "CAN_transport.h"
+
+/*
+EXAMPLE: the bootloader project's main.c, node 3
+
+void main(void){
+	CAN_boot_run(0x7F3, 0x7E3);	//never returns
+}
+*/
+
+#define CAN_BOOT_APP_START	0x3D8000UL//FLASHH
+#define CAN_BOOT_APP_END	0x3F3FF8UL//end of FLASHB, less the header
+#define CAN_BOOT_APP_ENTRY	0x3D8000UL//application's codestart (APP_BEGIN)
+#define CAN_BOOT_HEADER		0x3F3FF8UL//magic, start, words, crc: 4 x Uint32
+#define CAN_BOOT_MAGIC		0x43414E42UL//"CANB"
+#define CAN_BOOT_VERSION	1
+
+#define CAN_BOOT_BLOCK		1024//words per DATA message
+#define CAN_BOOT_BUFFERS	4
+#define CAN_BOOT_WINDOW_MS	200
+
+#define CAN_BOOT_HELLO		0x00
+#define CAN_BOOT_START		0x01
+#define CAN_BOOT_DATA		0x02
+#define CAN_BOOT_END		0x03
+#define CAN_BOOT_RUN		0x04
+
+//status byte of every answer
+#define CAN_BOOT_OK			0
+#define CAN_BOOT_BAD_COMMAND 1//unknown command or wrong length
+#define CAN_BOOT_BAD_RANGE	2//START outside the application sectors
+#define CAN_BOOT_BAD_ORDER	3//DATA without START, or not at the next offset
+#define CAN_BOOT_FLASH_FAIL	4//the Flash2806x API returned an error
+#define CAN_BOOT_BAD_CRC	5//END: flash contents do not match START's CRC
+#define CAN_BOOT_NO_APP		6//RUN without a valid application
+
+Uint32 CAN_boot_crc(Uint32 crc, const Uint16* words, Uint32 count);
+char CAN_boot_app_valid(void);
+void CAN_boot_run(CAN_ID tx_id, CAN_ID rx_id);
+
+#endif /* CAN_BOOT_H_ */
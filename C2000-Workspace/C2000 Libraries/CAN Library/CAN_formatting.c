@@ -5,7 +5,6 @@
  *      Author: Andrey
  */
 #include "CAN_formatting.h"
-#include <stdlib.h>
 
 typedef union ufloat {
 	float32 f;
@@ -37,20 +36,17 @@ float32 convertInt(Uint32 i){
 	return convert.f;
 }
 
-Uint32* convertFloats(float32* floats, int length){
+//Converts length floats into ints. The caller owns both arrays, so nothing is allocated.
+void convertFloats(const float32* floats, Uint32* ints, int length){
 	int i;
-	Uint32* ints=(Uint32*)malloc(4*length);
 	for(i=0;i<length;i++)
 		ints[i] = convertFloat(floats[i]);
-	return ints;
 }
 
-float32* convertInts(Uint32* ints, int length){
+void convertInts(const Uint32* ints, float32* floats, int length){
 	int i;
-	float32* floats=(float32*)malloc(4*length);
 	for(i=0;i<length;i++)
 		floats[i] = convertInt(ints[i]);
-	return floats;
 }
 
 Uint16 getFirstHalf(Uint32 v){
@@ -61,9 +57,8 @@ Uint16 getSecondHalf(Uint32 v){
 	return (Uint16) (v >>16);
 }
 
-Uint32* putIntoBuffer(Uint32 DataH, Uint32 DataL){
-	Uint32 buffer[2];
+//Fills buffer[0..1] in the CAN_send data order: {DataL, DataH}.
+void putIntoBuffer(Uint32 DataH, Uint32 DataL, Uint32* buffer){
 	buffer[0] = DataL;
 	buffer[1] = DataH;
-	return buffer;
 }
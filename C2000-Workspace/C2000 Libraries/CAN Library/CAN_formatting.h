@@ -11,11 +11,11 @@
 
 Uint32 convertFloat(float32 f);
 float32 convertInt(Uint32 i);
-Uint32* convertFloats(float32* floats, int length);
-float32* convertInts(Uint32* ints, int length);
+void convertFloats(const float32* floats, Uint32* ints, int length);
+void convertInts(const Uint32* ints, float32* floats, int length);
 Uint32 combineChars(char last, char third, char second, char first);
 Uint32 combineIntHalves(Uint16 dataH, Uint16 dataL);
 Uint16 getFirstHalf(Uint32 v);
 Uint16 getSecondHalf(Uint32 v);
-Uint32* putIntoBuffer(Uint32 DataH, Uint32 DataL);
+void putIntoBuffer(Uint32 DataH, Uint32 DataL, Uint32* buffer);
 #endif /* CAN_FORMATTING_H_ */
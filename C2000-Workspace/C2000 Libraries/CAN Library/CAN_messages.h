@@ -0,0 +1,59 @@
+/*
+ * CAN_messages.h
+ *
+ * Message definitions for the car, DBC style: one line per message (BO_) and
+ * one line per signal (SG_). CAN_signals.h turns these lines into a struct and
+ * static inline pack/unpack functions for every message, so edit this file
+ * only; nothing here is compiled on its own.
+ *
+ * EXAMPLE LAYOUTS ONLY. The messages below use the CAN_IDs from CAN.h, but their
+ * lengths, signal positions, scales and offsets are placeholders that show the
+ * format; they are not what the pedal board, BMS, IMU or MPPTs actually send.
+ * Replace each one with the sending board's real layout (or its DBC) before
+ * packing or unpacking live traffic with it.
+ *
+ * CAN_MESSAGE(name, id, length)
+ *   id      CAN_ID, standard or CAN_EXT(...)
+ *   length  DLC in bytes
+ *
+ * CAN_SIGNAL(message, signal, start, bits, is_signed, scale, offset)
+ *   start   Intel (little-endian) start bit, as in a DBC "start|bits@1":
+ *           bit k of data byte n is bit 8n+k. Byte 0 is the first byte on the wire.
+ *   bits    1-32
+ *   value = raw * scale + offset
+ *
+ * Every message gets a <message>_SIGNALS(SIG) list and one entry in CAN_MESSAGES.
+ */
+#ifndef CAN_MESSAGES_H_
+#define CAN_MESSAGES_H_
+
+#define CAN_MESSAGES(CAN_MESSAGE) \
+	CAN_MESSAGE(PEDALS_STATUS,	PEDALS,		4) \
+	CAN_MESSAGE(BMS_PACK,		BMS,		8) \
+	CAN_MESSAGE(IMU_ACCEL,		IMU,		6) \
+	CAN_MESSAGE(MPPT_STATUS,	MPPT,		8)
+
+#define PEDALS_STATUS_SIGNALS(CAN_SIGNAL) \
+	CAN_SIGNAL(PEDALS_STATUS,	throttle,	0,	12,	0,	0.025,	0)		/* % */ \
+	CAN_SIGNAL(PEDALS_STATUS,	brake,		12,	12,	0,	0.025,	0)		/* % */ \
+	CAN_SIGNAL(PEDALS_STATUS,	regen,		24,	8,	0,	0.5,	0)		/* % */
+
+#define BMS_PACK_SIGNALS(CAN_SIGNAL) \
+	CAN_SIGNAL(BMS_PACK,		voltage,	0,	16,	0,	0.01,	0)		/* V */ \
+	CAN_SIGNAL(BMS_PACK,		current,	16,	16,	1,	0.01,	0)		/* A, + = discharge */ \
+	CAN_SIGNAL(BMS_PACK,		soc,		32,	8,	0,	0.5,	0)		/* % */ \
+	CAN_SIGNAL(BMS_PACK,		max_temp,	40,	8,	0,	1,		-40)	/* deg C */ \
+	CAN_SIGNAL(BMS_PACK,		min_cell,	48,	16,	0,	0.0001,	0)		/* V */
+
+#define IMU_ACCEL_SIGNALS(CAN_SIGNAL) \
+	CAN_SIGNAL(IMU_ACCEL,		x,			0,	16,	1,	0.001,	0)		/* g */ \
+	CAN_SIGNAL(IMU_ACCEL,		y,			16,	16,	1,	0.001,	0)		/* g */ \
+	CAN_SIGNAL(IMU_ACCEL,		z,			32,	16,	1,	0.001,	0)		/* g */
+
+#define MPPT_STATUS_SIGNALS(CAN_SIGNAL) \
+	CAN_SIGNAL(MPPT_STATUS,		voltage_in,	0,	16,	0,	0.01,	0)		/* V */ \
+	CAN_SIGNAL(MPPT_STATUS,		current_in,	16,	16,	0,	0.001,	0)		/* A */ \
+	CAN_SIGNAL(MPPT_STATUS,		voltage_out,32,	16,	0,	0.01,	0)		/* V */ \
+	CAN_SIGNAL(MPPT_STATUS,		temperature,48,	8,	0,	1,		-40)	/* deg C */
+
+#endif /* CAN_MESSAGES_H_ */
@@ -0,0 +1,178 @@
+/*
+ * CAN_schedule.c
+ *
+ * Message m goes out on every timer tick t with t % m.period == m.phase.
+ * Rather than dividing on every tick, each message counts down to its next
+ * slot; the division only happens when a message is registered.
+ *
+ * The tick runs in the CpuTimer0 ISR (INT1) and CAN_schedule_add masks INT1
+ * while it changes the table, so the table needs no other locking.
+ */
+#include "DSP28x_Project.h"
+#include "CAN_schedule.h"
+#include "clocks.h"
+
+CAN_PERIODIC CAN_SCHEDULE[CAN_SCHEDULE_MAX];
+volatile Uint16 CAN_schedule_count = 0;
+volatile Uint32 CAN_schedule_ticks = 0;//ticks since CAN_schedule_init
+float32 CAN_schedule_ftmr = 1;//tick rate in kHz
+
+static Uint16 CAN_gcd(Uint16 a, Uint16 b){
+	while(b){
+		Uint16 t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+/*
+ * @brief Phase for a new message of the given period that shares the fewest bits with
+ * the messages already scheduled. A message with period p and phase q lands on the same
+ * tick as the new one at phase r whenever r and q agree modulo g = gcd(period, p), and
+ * then on one in p/g of the new message's frames.
+ */
+static Uint16 CAN_schedule_stagger(Uint16 period){
+	float32 weight[CAN_SCHEDULE_MAX];
+	Uint16 g[CAN_SCHEDULE_MAX];
+	float32 best_cost = 0;
+	Uint16 best = 0, r, i;
+
+	for(i = 0; i < CAN_schedule_count; i++){
+		g[i] = CAN_gcd(period, CAN_SCHEDULE[i].period);
+		weight[i] = (float32)CAN_SCHEDULE[i].bits * g[i] / CAN_SCHEDULE[i].period;
+	}
+	for(r = 0; r < period; r++){
+		float32 cost = 0;
+		for(i = 0; i < CAN_schedule_count; i++){
+			if(r % g[i] == CAN_SCHEDULE[i].phase % g[i]) cost += weight[i];
+		}
+		if(r == 0 || cost < best_cost){
+			best_cost = cost;
+			best = r;
+			if(cost == 0) break;
+		}
+	}
+	return best;
+}
+
+/*
+ * @brief Starts CpuTimer0 at ftmr kHz through TimerInit and empties the schedule.
+ * Call after SysClkInit and route TINT0 to CAN_schedule_isr (IsrInit) or call
+ * CAN_schedule_tick from your own TINT0 ISR. Messages can be added once CAN_init
+ * and CAN_queue_init have run. If the application already uses TimerInit, pass
+ * the same rate.
+ */
+void CAN_schedule_init(float32 ftmr){
+	Uint16 ier1 = IER & M_INT1;
+
+	IER &= ~M_INT1;
+	CAN_schedule_count = 0;
+	CAN_schedule_ticks = 0;
+	CAN_schedule_ftmr = ftmr;
+	TimerInit(ftmr);
+	IER |= ier1;
+}
+
+/*
+ * @brief Registers a message sent every period_ms, starting phase_ms into the period
+ * (CAN_SCHEDULE_AUTO to have it staggered). Both are rounded to whole timer ticks.
+ * provider fills the data each time; with provider 0 the frame carries zeros.
+ * @return The projected bus load of the whole schedule in 0.1 %, or CAN_SCHEDULE_FULL
+ * if the table is full or the period is not 1 to 65535 ticks.
+ */
+Uint16 CAN_schedule_add(CAN_ID ID, Uint16 length, float32 period_ms, float32 phase_ms, CAN_PROVIDER provider){
+	float32 ticks = period_ms * CAN_schedule_ftmr + 0.5f;
+	CAN_PERIODIC* m;
+	Uint16 ier1;
+	Uint32 next;
+
+	if(CAN_schedule_count == CAN_SCHEDULE_MAX || ticks < 1 || ticks > 65535.0f){
+		return CAN_SCHEDULE_FULL;
+	}
+
+	m = &CAN_SCHEDULE[CAN_schedule_count];
+	m->ID = ID;
+	m->length = length > 8 ? 8 : length;
+	m->period = (Uint16)ticks;
+	m->bits = CAN_frame_bits(ID, m->length);
+	m->provider = provider;
+	m->sent = 0;
+	m->skipped = 0;
+	m->dropped = 0;
+	if(phase_ms < 0){
+		m->phase = CAN_schedule_stagger(m->period);
+	}
+	else{
+		m->phase = (Uint32)(phase_ms * CAN_schedule_ftmr + 0.5f) % m->period;
+	}
+
+	ier1 = IER & M_INT1;
+	IER &= ~M_INT1;
+	next = CAN_schedule_ticks + 1;//the next tick CAN_schedule_tick will see
+	m->countdown = ((Uint32)m->phase + m->period - next % m->period) % m->period + 1;
+	CAN_schedule_count++;
+	IER |= ier1;
+
+	return CAN_schedule_load();
+}
+
+/*
+ * @brief Bus load the schedule adds up to, in 0.1 %, from CAN_frame_bits (worst-case
+ * stuffing) and the bit rate in CANBTC at the clock SysClkInit set.
+ */
+Uint16 CAN_schedule_load(void){
+	float32 bit_rate = getfclk() * 1e6f / (2.0f * (ECanaRegs.CANBTC.bit.BRPREG + 1) *
+			(ECanaRegs.CANBTC.bit.TSEG1REG + ECanaRegs.CANBTC.bit.TSEG2REG + 3));
+	float32 bits_per_tick = 0;
+	float32 load;
+	Uint16 i;
+
+	for(i = 0; i < CAN_schedule_count; i++){
+		bits_per_tick += (float32)CAN_SCHEDULE[i].bits / CAN_SCHEDULE[i].period;
+	}
+	load = 1000.0f * bits_per_tick * CAN_schedule_ftmr * 1000.0f / bit_rate;
+	return load > 65534.0f ? 65534 : (Uint16)(load + 0.5f);
+}
+
+/*
+ * @return Registered message n (in the order added) with its counters, or 0.
+ */
+const CAN_PERIODIC* CAN_schedule_get(Uint16 n){
+	return n < CAN_schedule_count ? &CAN_SCHEDULE[n] : 0;
+}
+
+/*
+ * @brief Queues every message whose slot is this tick. Call once per CpuTimer0 interrupt.
+ */
+void CAN_schedule_tick(void){
+	Uint16 i;
+
+	CAN_schedule_ticks++;
+	for(i = 0; i < CAN_schedule_count; i++){
+		CAN_PERIODIC* m = &CAN_SCHEDULE[i];
+		Uint32 dataH = 0, dataL = 0;
+
+		if(--m->countdown){
+			continue;
+		}
+		m->countdown = m->period;
+		if(m->provider && !m->provider(m->ID, &dataH, &dataL)){
+			m->skipped++;
+		}
+		else if(CAN_queue_send(m->ID, dataH, dataL, m->length)){
+			m->sent++;
+		}
+		else{
+			m->dropped++;
+		}
+	}
+}
+
+/*
+ * @brief TINT0 handler for applications that leave CpuTimer0 to the scheduler.
+ */
+__interrupt void CAN_schedule_isr(void){
+	CAN_schedule_tick();
+	PieCtrlRegs.PIEACK.all = PIEACK_GROUP1;
+}
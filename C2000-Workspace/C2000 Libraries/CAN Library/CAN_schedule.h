@@ -0,0 +1,64 @@
+/*
+ * CAN_schedule.h
+ *
+ * Cyclic transmit scheduler. Each registered message has a period, a phase
+ * and a provider that fills in its data; CAN_schedule_tick, run from the
+ * CpuTimer0 interrupt that TimerInit (Clock Library) sets up, hands every
+ * message that is due to CAN_queue_send. Nothing here blocks or polls.
+ *
+ * Messages registered with CAN_SCHEDULE_AUTO get the phase that puts the
+ * fewest frame bits on the same timer tick as the messages already there,
+ * so a dozen 10 ms messages spread over the 10 ms instead of going out in
+ * one burst.
+ */
+#ifndef CAN_SCHEDULE_H_
+#define CAN_SCHEDULE_H_
+
+#include "CAN.h"
+
+/*
+EXAMPLE: pack status every 100 ms, pedals every 10 ms, on a 1 kHz tick
+
+char fill_bms(CAN_ID ID, Uint32* dataH, Uint32* dataL){
+	BMS_PACK_pack(&pack, dataH, dataL);
+	return 1;
+}
+
+	SysClkInit(NINETY);
+	CAN_schedule_init(1);							//1 kHz, programs CpuTimer0
+	IsrInit(TINT0, &CAN_schedule_isr);				//or call CAN_schedule_tick from your own TINT0 ISR
+	CAN_init(CAN_INFO_ARRAY, 2, 1);					//after IsrInit, whose first call overwrites IER
+	CAN_queue_init(0x000000F0);
+	load = CAN_schedule_add(BMS, 8, 100, CAN_SCHEDULE_AUTO, &fill_bms);
+	load = CAN_schedule_add(PEDALS, 4, 10, CAN_SCHEDULE_AUTO, &fill_pedals);//load is now the projected bus load in 0.1 %
+	EINT;
+*/
+
+//Fills the frame's data; runs in the timer ISR. Return 0 to skip this period.
+typedef char (*CAN_PROVIDER)(CAN_ID ID, Uint32* dataH, Uint32* dataL);
+
+typedef struct{
+	CAN_ID ID;
+	Uint16 length;
+	Uint16 period;			//timer ticks
+	Uint16 phase;			//timer tick, 0 to period - 1, the message goes out on
+	Uint16 bits;			//CAN_frame_bits of one frame
+	volatile Uint16 countdown;//ticks until the next one
+	CAN_PROVIDER provider;
+	Uint32 sent;			//frames handed to CAN_queue_send
+	Uint32 skipped;			//periods the provider declined
+	Uint32 dropped;			//periods lost to a full transmit queue
+} CAN_PERIODIC;
+
+#define CAN_SCHEDULE_MAX 32
+#define CAN_SCHEDULE_AUTO (-1.0f)//phase: let the scheduler stagger it
+#define CAN_SCHEDULE_FULL 0xFFFF//CAN_schedule_add could not register the message
+
+void CAN_schedule_init(float32 ftmr);
+Uint16 CAN_schedule_add(CAN_ID ID, Uint16 length, float32 period_ms, float32 phase_ms, CAN_PROVIDER provider);
+Uint16 CAN_schedule_load(void);
+const CAN_PERIODIC* CAN_schedule_get(Uint16 n);
+void CAN_schedule_tick(void);
+__interrupt void CAN_schedule_isr(void);
+
+#endif /* CAN_SCHEDULE_H_ */
@@ -0,0 +1,120 @@
+/*
+ * CAN_signals.h
+ *
+ * Generates the encode/decode code for the messages in CAN_messages.h. For a
+ * message FOO with signals a and b this header defines
+ *
+ *   typedef struct{ float32 a; float32 b; } FOO_MSG;
+ *   void    FOO_pack(const FOO_MSG* m, Uint32* dataH, Uint32* dataL);
+ *   void    FOO_unpack(FOO_MSG* m, Uint32 dataH, Uint32 dataL);
+ *   char    FOO_queue(const FOO_MSG* m);          CAN_queue_send with FOO's ID and length
+ *   char    FOO_serve(const FOO_MSG* m, Uint32 mbox_num);  CAN_autoreply_update of FOO's mailbox
+ *   float32 FOO_a_get(Uint32 dataH, Uint32 dataL);  one signal straight from a frame
+ *
+ * all static inline. Bit positions, masks and scale factors are constants, so
+ * each signal compiles down to a few shifts and a multiply: no tables, no
+ * loops, no malloc. dataH/dataL are the MDH/MDL words CAN.c hands around.
+ * Raw values that do not fit in their bits are truncated, not saturated.
+ */
+#ifndef CAN_SIGNALS_H_
+#define CAN_SIGNALS_H_
+
+#include "CAN.h"
+#include "CAN_messages.h"
+
+#define CAN_SIGNAL_INLINE static inline
+
+//MDL/MDH hold byte 0 in bits 31-24 (DBO = 0). Swapped, the two words are frame bits 0-31 and 32-63.
+CAN_SIGNAL_INLINE Uint32 CAN_swap32(Uint32 v){
+	return (v >> 24) | ((v >> 8) & 0xFF00) | ((v << 8) & 0xFF0000) | (v << 24);
+}
+
+CAN_SIGNAL_INLINE Uint32 CAN_get_raw(Uint32 lo, Uint32 hi, Uint16 start, Uint16 bits){
+	Uint32 raw;
+
+	if(start >= 32){
+		raw = hi >> (start - 32);
+	}
+	else if(start + bits <= 32){
+		raw = lo >> start;
+	}
+	else{
+		raw = (lo >> start) | (hi << (32 - start));
+	}
+	return raw & (0xFFFFFFFFUL >> (32 - bits));
+}
+
+CAN_SIGNAL_INLINE void CAN_set_raw(Uint32* lo, Uint32* hi, Uint16 start, Uint16 bits, Uint32 raw){
+	Uint32 mask = 0xFFFFFFFFUL >> (32 - bits);
+
+	raw &= mask;
+	if(start >= 32){
+		*hi |= raw << (start - 32);
+	}
+	else if(start + bits <= 32){
+		*lo |= raw << start;
+	}
+	else{
+		*lo |= raw << start;
+		*hi |= raw >> (32 - start);
+	}
+}
+
+CAN_SIGNAL_INLINE float32 CAN_from_raw(Uint32 raw, Uint16 bits, Uint16 is_signed, float32 scale, float32 offset){
+	if(is_signed){
+		Uint32 sign = (Uint32)1 << (bits - 1);
+		return (float32)(int32)((raw ^ sign) - sign) * scale + offset;
+	}
+	return (float32)raw * scale + offset;
+}
+
+//inverse_scale is 1/scale, folded at compile time so there is no division here
+CAN_SIGNAL_INLINE Uint32 CAN_to_raw(float32 value, float32 inverse_scale, float32 offset){
+	float32 raw = (value - offset) * inverse_scale;
+	return (Uint32)(int32)(raw >= 0 ? raw + 0.5f : raw - 0.5f);
+}
+
+#define CAN_GEN_FIELD(message, signal, start, bits, is_signed, scale, offset) \
+	float32 signal;
+
+#define CAN_GEN_PACK(message, signal, start, bits, is_signed, scale, offset) \
+	CAN_set_raw(&lo, &hi, start, bits, CAN_to_raw(m->signal, (float32)(1.0 / (scale)), (float32)(offset)));
+
+#define CAN_GEN_UNPACK(message, signal, start, bits, is_signed, scale, offset) \
+	m->signal = CAN_from_raw(CAN_get_raw(lo, hi, start, bits), bits, is_signed, (float32)(scale), (float32)(offset));
+
+#define CAN_GEN_GET(message, signal, start, bits, is_signed, scale, offset) \
+	CAN_SIGNAL_INLINE float32 message##_##signal##_get(Uint32 dataH, Uint32 dataL){ \
+		return CAN_from_raw(CAN_get_raw(CAN_swap32(dataL), CAN_swap32(dataH), start, bits), \
+				bits, is_signed, (float32)(scale), (float32)(offset)); \
+	}
+
+#define CAN_GEN_MESSAGE(name, id, length) \
+	typedef struct{ \
+		name##_SIGNALS(CAN_GEN_FIELD) \
+	} name##_MSG; \
+	CAN_SIGNAL_INLINE void name##_pack(const name##_MSG* m, Uint32* dataH, Uint32* dataL){ \
+		Uint32 lo = 0, hi = 0; \
+		name##_SIGNALS(CAN_GEN_PACK) \
+		*dataL = CAN_swap32(lo); \
+		*dataH = CAN_swap32(hi); \
+	} \
+	CAN_SIGNAL_INLINE void name##_unpack(name##_MSG* m, Uint32 dataH, Uint32 dataL){ \
+		Uint32 lo = CAN_swap32(dataL), hi = CAN_swap32(dataH); \
+		name##_SIGNALS(CAN_GEN_UNPACK) \
+	} \
+	CAN_SIGNAL_INLINE char name##_queue(const name##_MSG* m){ \
+		Uint32 dataH, dataL; \
+		name##_pack(m, &dataH, &dataL); \
+		return CAN_queue_send(id, dataH, dataL, length); \
+	} \
+	CAN_SIGNAL_INLINE char name##_serve(const name##_MSG* m, Uint32 mbox_num){ \
+		Uint32 dataH, dataL; \
+		name##_pack(m, &dataH, &dataL); \
+		return CAN_autoreply_update(mbox_num, dataH, dataL); \
+	} \
+	name##_SIGNALS(CAN_GEN_GET)
+
+CAN_MESSAGES(CAN_GEN_MESSAGE)
+
+#endif /* CAN_SIGNALS_H_ */
@@ -0,0 +1,301 @@
+/*
+ * CAN_transport.c
+ *
+ * ISO-TP style segmentation and reassembly. Frame layout (byte 0 high nibble):
+ *   0 single frame       0L  d d d d d d d    L = 1-7 bytes
+ *   1 first frame        1L LL d d d d d d    LLL = 8-4095 bytes
+ *   2 consecutive frame  2S  d d d d d d d    S = sequence number 0-15
+ *   3 flow control       3F BS ST             F = 0 continue, 1 wait, 2 overflow
+ *
+ * The sender only ever uses tx_mbox, reloading it from its TA interrupt, so a
+ * message of any length streams at bus speed through one mailbox. Everything
+ * that changes state runs either in ecan_isr (CAN_tp_on_sent/on_receive) or
+ * with INT9 masked (CAN_tp_send/poll).
+ */
+#include "DSP28x_Project.h"
+#include "CAN_transport.h"
+#include <string.h>
+
+#define TP_SINGLE		0x0
+#define TP_FIRST		0x1
+#define TP_CONSECUTIVE	0x2
+#define TP_FLOW			0x3
+
+#define TP_FC_CONTINUE	0
+#define TP_FC_WAIT		1
+#define TP_FC_OVERFLOW	2
+#define TP_FC_NONE		0xFF
+
+//Byte n of a frame. With DBO = 0 byte 0 is MDL bits 31-24 and byte 4 is MDH bits 31-24.
+static Uint16 CAN_tp_byte(Uint32 dataH, Uint32 dataL, Uint16 n){
+	if(n < 4){
+		return (dataL >> (24 - 8*n)) & 0xFF;
+	}
+	return (dataH >> (24 - 8*(n - 4))) & 0xFF;
+}
+
+static void CAN_tp_pack(const Uint16* bytes, Uint16 length, Uint32* dataH, Uint32* dataL){
+	Uint16 n;
+
+	*dataL = 0;
+	*dataH = 0;
+	for(n = 0; n < length; n++){
+		if(n < 4){
+			*dataL |= (Uint32)(bytes[n] & 0xFF) << (24 - 8*n);
+		}
+		else{
+			*dataH |= (Uint32)(bytes[n] & 0xFF) << (24 - 8*(n - 4));
+		}
+	}
+}
+
+/*
+ * @brief Puts the next frame in tx_mbox if it is free: a pending flow control first,
+ * then the next piece of the outgoing message. Frames use the shortest DLC.
+ */
+static void CAN_tp_pump(CAN_TP* tp){
+	Uint16 bytes[8];
+	Uint16 length, n, i;
+	Uint32 dataH, dataL;
+
+	if(tp->fc_pending != TP_FC_NONE){
+		bytes[0] = (TP_FLOW << 4) | tp->fc_pending;
+		bytes[1] = tp->block_size;
+		bytes[2] = tp->st_min;
+		CAN_tp_pack(bytes, 3, &dataH, &dataL);
+		if(CAN_mbox_send(tp->tx_id, dataH, dataL, 3, tp->tx_mbox)){
+			tp->fc_pending = TP_FC_NONE;
+		}
+		return; //anything else goes out from the next TA
+	}
+
+	if(tp->tx_state != CAN_TP_SENDING){
+		return;
+	}
+	if(tp->tx_offset && tp->tx_st_min && (tp->now_ms - tp->tx_last_ms) <= tp->tx_st_min){
+		return; //CAN_tp_poll sends it once the gap has passed
+	}
+
+	if(tp->tx_offset == 0 && tp->tx_length <= 7){
+		bytes[0] = (TP_SINGLE << 4) | tp->tx_length;
+		length = tp->tx_length;
+		n = 1;
+	}
+	else if(tp->tx_offset == 0){
+		bytes[0] = (TP_FIRST << 4) | (tp->tx_length >> 8);
+		bytes[1] = tp->tx_length & 0xFF;
+		length = 6;
+		n = 2;
+	}
+	else{
+		bytes[0] = (TP_CONSECUTIVE << 4) | tp->tx_seq;
+		length = tp->tx_length - tp->tx_offset;
+		if(length > 7) length = 7;
+		n = 1;
+	}
+	for(i = 0; i < length; i++){
+		bytes[n + i] = tp->tx_data[tp->tx_offset + i];
+	}
+	CAN_tp_pack(bytes, n + length, &dataH, &dataL);
+	if(!CAN_mbox_send(tp->tx_id, dataH, dataL, n + length, tp->tx_mbox)){
+		return;
+	}
+
+	if((bytes[0] >> 4) == TP_FIRST){
+		tp->tx_state = CAN_TP_WAIT_FC;
+		tp->tx_wait_since = tp->now_ms;
+		tp->tx_seq = 1;
+	}
+	else if(tp->tx_offset != 0){
+		tp->tx_seq = (tp->tx_seq + 1) & 0xF;
+		tp->tx_last_ms = tp->now_ms;
+	}
+	tp->tx_offset += length;
+
+	if(tp->tx_offset >= tp->tx_length){
+		tp->tx_state = CAN_TP_IDLE;
+	}
+	else if(tp->tx_state == CAN_TP_SENDING && tp->tx_block_left && --tp->tx_block_left == 0){
+		tp->tx_state = CAN_TP_WAIT_FC;
+		tp->tx_wait_since = tp->now_ms;
+	}
+}
+
+/*
+ * @brief Sets up one end of a transport connection and its receive mailbox.
+ * tx_id must be in the CAN_INFO array with an upon_sent_isr calling CAN_tp_on_sent,
+ * rx_id with an upon_receive_isr calling CAN_tp_on_receive. rx_buffer must hold
+ * rx_size bytes (one per word) and outlive the connection.
+ */
+void CAN_tp_init(CAN_TP* tp, CAN_ID tx_id, CAN_ID rx_id, Uint32 tx_mbox, Uint32 rx_mbox,
+		Uint16* rx_buffer, Uint16 rx_size, void (*upon_message)(CAN_TP* tp, Uint16* data, Uint16 length)){
+	memset(tp, 0, sizeof(CAN_TP));
+	tp->tx_id = tx_id;
+	tp->rx_id = rx_id;
+	tp->tx_mbox = tx_mbox;
+	tp->rx_mbox = rx_mbox;
+	tp->rx_buffer = rx_buffer;
+	tp->rx_size = rx_size;
+	tp->upon_message = upon_message;
+	tp->tx_state = CAN_TP_IDLE;
+	tp->fc_pending = TP_FC_NONE;
+
+	CAN_mbox_bind(tx_id, tx_mbox); //once, so sending a frame never searches CAN_INFO_ARRAY
+	CAN_receive(rx_id, 8, rx_mbox, 0);
+}
+
+/*
+ * @brief Starts sending length bytes (1-4095) of data, which must stay untouched until
+ * tx_state is back to CAN_TP_IDLE.
+ * @return 1 if started, 0 if a message is still going out or length is out of range.
+ */
+char CAN_tp_send(CAN_TP* tp, const Uint16* data, Uint16 length){
+	Uint16 ier9;
+
+	if(length == 0 || length > CAN_TP_MAX_LENGTH || tp->tx_state != CAN_TP_IDLE){
+		return 0;
+	}
+	ier9 = IER & M_INT9;
+	IER &= ~M_INT9;
+	tp->tx_data = data;
+	tp->tx_length = length;
+	tp->tx_offset = 0;
+	tp->tx_block_left = 0;
+	tp->tx_st_min = 0;
+	tp->tx_state = CAN_TP_SENDING;
+	CAN_tp_pump(tp);
+	IER |= ier9;
+	return 1;
+}
+
+/*
+ * @brief Call from the upon_sent_isr of tx_id: tx_mbox is free again.
+ */
+void CAN_tp_on_sent(CAN_TP* tp){
+	CAN_tp_pump(tp);
+}
+
+/*
+ * @brief Call from the upon_receive_isr of rx_id with the frame it was given.
+ */
+void CAN_tp_on_receive(CAN_TP* tp, Uint32 dataH, Uint32 dataL, Uint16 length){
+	Uint16 pci = CAN_tp_byte(dataH, dataL, 0);
+	Uint16 n, i;
+
+	if(length == 0) return;
+
+	switch(pci >> 4){
+	case TP_FLOW:
+		if(tp->tx_state != CAN_TP_WAIT_FC || length < 3) return;
+		if((pci & 0xF) == TP_FC_CONTINUE){
+			Uint16 st = CAN_tp_byte(dataH, dataL, 2);
+			tp->tx_block_left = CAN_tp_byte(dataH, dataL, 1);
+			if(st <= 0x7F) tp->tx_st_min = st;
+			else if(st >= 0xF1 && st <= 0xF9) tp->tx_st_min = 1;//100-900 us, rounded up to our 1 ms clock
+			else tp->tx_st_min = 0x7F;
+			tp->tx_last_ms = tp->now_ms - tp->tx_st_min - 1;//no gap before the first frame of a block
+			tp->tx_state = CAN_TP_SENDING;
+			CAN_tp_pump(tp);
+		}
+		else if((pci & 0xF) == TP_FC_WAIT){
+			tp->tx_wait_since = tp->now_ms;
+		}
+		else{
+			tp->tx_state = CAN_TP_IDLE; //overflow: the receiver cannot take it
+			tp->errors++;
+		}
+		break;
+
+	case TP_SINGLE:
+		n = pci & 0xF;
+		if(n == 0 || n > length - 1) return;
+		if(tp->rx_active){
+			tp->rx_active = 0; //a new message aborts the one in progress
+			tp->errors++;
+		}
+		if(n > tp->rx_size){
+			tp->errors++;
+			return;
+		}
+		for(i = 0; i < n; i++){
+			tp->rx_buffer[i] = CAN_tp_byte(dataH, dataL, 1 + i);
+		}
+		if(tp->upon_message) tp->upon_message(tp, tp->rx_buffer, n);
+		break;
+
+	case TP_FIRST:
+		if(length < 8) return;
+		if(tp->rx_active){
+			tp->rx_active = 0;
+			tp->errors++;
+		}
+		tp->rx_length = ((pci & 0xF) << 8) | CAN_tp_byte(dataH, dataL, 1);
+		if(tp->rx_length > tp->rx_size){
+			tp->errors++;
+			tp->fc_pending = TP_FC_OVERFLOW;
+			CAN_tp_pump(tp);
+			return;
+		}
+		for(i = 0; i < 6; i++){
+			tp->rx_buffer[i] = CAN_tp_byte(dataH, dataL, 2 + i);
+		}
+		tp->rx_offset = 6;
+		tp->rx_seq = 1;
+		tp->rx_block_left = tp->block_size;
+		tp->rx_wait_since = tp->now_ms;
+		tp->rx_active = 1;
+		tp->fc_pending = TP_FC_CONTINUE;
+		CAN_tp_pump(tp);
+		break;
+
+	case TP_CONSECUTIVE:
+		if(!tp->rx_active) return;
+		if((pci & 0xF) != tp->rx_seq){
+			tp->rx_active = 0; //lost or repeated frame: drop the message
+			tp->errors++;
+			return;
+		}
+		n = tp->rx_length - tp->rx_offset;
+		if(n > 7) n = 7;
+		if(n > length - 1) n = length - 1;
+		for(i = 0; i < n; i++){
+			tp->rx_buffer[tp->rx_offset + i] = CAN_tp_byte(dataH, dataL, 1 + i);
+		}
+		tp->rx_offset += n;
+		tp->rx_seq = (tp->rx_seq + 1) & 0xF;
+		tp->rx_wait_since = tp->now_ms;
+
+		if(tp->rx_offset >= tp->rx_length){
+			tp->rx_active = 0;
+			if(tp->upon_message) tp->upon_message(tp, tp->rx_buffer, tp->rx_length);
+		}
+		else if(tp->block_size && --tp->rx_block_left == 0){
+			tp->rx_block_left = tp->block_size;
+			tp->fc_pending = TP_FC_CONTINUE;
+			CAN_tp_pump(tp);
+		}
+		break;
+	}
+}
+
+/*
+ * @brief Call from the main loop with a millisecond clock. Enforces the receiver's
+ * minimum frame gap, gives up on a silent peer after CAN_TP_TIMEOUT_MS and retries a
+ * frame that found tx_mbox busy.
+ */
+void CAN_tp_poll(CAN_TP* tp, Uint32 now_ms){
+	Uint16 ier9 = IER & M_INT9;
+
+	IER &= ~M_INT9;
+	tp->now_ms = now_ms;
+	if(tp->tx_state == CAN_TP_WAIT_FC && now_ms - tp->tx_wait_since > CAN_TP_TIMEOUT_MS){
+		tp->tx_state = CAN_TP_IDLE;
+		tp->errors++;
+	}
+	if(tp->rx_active && now_ms - tp->rx_wait_since > CAN_TP_TIMEOUT_MS){
+		tp->rx_active = 0;
+		tp->errors++;
+	}
+	CAN_tp_pump(tp);
+	IER |= ier9;
+}
@@ -0,0 +1,95 @@
+/*
+ * CAN_transport.h
+ *
+ * Segmented transfers (ISO 15765-2 / ISO-TP framing) on top of CAN.c.
+ * A message of up to 4095 bytes goes out as a first frame plus numbered
+ * consecutive frames through one transmit mailbox, paced by flow control
+ * frames from the receiver, and is reassembled into a caller-owned buffer.
+ *
+ * Payload bytes are passed one per Uint16 (low 8 bits), because a char is
+ * 16 bits wide on the C28x.
+ */
+#ifndef CAN_TRANSPORT_H_
+#define CAN_TRANSPORT_H_
+
+#include "CAN.h"
+
+/*
+EXAMPLE: BMS cell voltages to the screen, mailbox 10 sends and mailbox 11 receives
+
+CAN_TP bms_tp;
+Uint16 bms_rx[256];
+
+void bms_sent_isr(CAN_ID ID, Uint32 dataH, Uint32 dataL, Uint16 length, int mbox_num){
+	CAN_tp_on_sent(&bms_tp);
+}
+void bms_receive_isr(CAN_ID ID, Uint32 dataH, Uint32 dataL, Uint16 length, int mbox_num){
+	CAN_tp_on_receive(&bms_tp, dataH, dataL, length);
+}
+CAN_INFO CAN_INFO_ARRAY[] = {
+	{0x7E0, &bms_sent_isr, 0},			//our transmit ID
+	{0x7E8, 0, &bms_receive_isr}		//the peer's transmit ID
+};
+
+	CAN_init(CAN_INFO_ARRAY, 2, 1);
+	CAN_tp_init(&bms_tp, 0x7E0, 0x7E8, 10, 11, bms_rx, 256, &cells_received);
+	CAN_tp_send(&bms_tp, cells, 96);
+	while(1) CAN_tp_poll(&bms_tp, milliseconds);
+*/
+
+typedef enum{
+	CAN_TP_IDLE,
+	CAN_TP_SENDING,		//consecutive frames may go out
+	CAN_TP_WAIT_FC		//waiting for the receiver's flow control
+} CAN_TP_STATE;
+
+typedef struct CAN_TP{
+	//Set by CAN_tp_init
+	CAN_ID tx_id;			//ID of our data and flow control frames
+	CAN_ID rx_id;			//ID the peer uses for its frames
+	Uint32 tx_mbox;
+	Uint32 rx_mbox;
+	Uint16* rx_buffer;		//reassembly buffer, one byte per word
+	Uint16 rx_size;
+	void (*upon_message)(struct CAN_TP* tp, Uint16* data, Uint16 length);//complete message, ISR context
+
+	//Flow control we hand to a sender; may be changed after CAN_tp_init. Consecutive frames
+	//share rx_mbox, so if ecan_isr can be held off for longer than a frame, ask for a gap.
+	Uint16 block_size;		//consecutive frames per flow control, 0 = all of them
+	Uint16 st_min;			//ms the sender must leave between consecutive frames
+
+	//Transmit side
+	volatile CAN_TP_STATE tx_state;
+	const Uint16* tx_data;
+	Uint16 tx_length;
+	Uint16 tx_offset;		//bytes already loaded into frames
+	Uint16 tx_seq;
+	Uint16 tx_block_left;	//frames until the next flow control, 0 = no limit
+	Uint16 tx_st_min;		//gap the receiver asked for, in ms
+	Uint32 tx_last_ms;		//when the last consecutive frame was started
+	Uint32 tx_wait_since;	//when we started waiting for flow control
+
+	//Receive side
+	volatile char rx_active;
+	Uint16 rx_length;
+	Uint16 rx_offset;
+	Uint16 rx_seq;
+	Uint16 rx_block_left;
+	Uint32 rx_wait_since;	//when the last frame of the message arrived
+	volatile Uint16 fc_pending;	//flow status byte waiting for the mailbox, 0xFF = none
+
+	Uint32 now_ms;			//time of the last CAN_tp_poll
+	Uint32 errors;			//timeouts, sequence errors, overflows
+} CAN_TP;
+
+#define CAN_TP_MAX_LENGTH 4095//12-bit first frame length
+#define CAN_TP_TIMEOUT_MS 1000//N_Bs / N_Cr
+
+void CAN_tp_init(CAN_TP* tp, CAN_ID tx_id, CAN_ID rx_id, Uint32 tx_mbox, Uint32 rx_mbox,
+		Uint16* rx_buffer, Uint16 rx_size, void (*upon_message)(CAN_TP* tp, Uint16* data, Uint16 length));
+char CAN_tp_send(CAN_TP* tp, const Uint16* data, Uint16 length);
+void CAN_tp_on_sent(CAN_TP* tp);
+void CAN_tp_on_receive(CAN_TP* tp, Uint32 dataH, Uint32 dataL, Uint16 length);
+void CAN_tp_poll(CAN_TP* tp, Uint32 now_ms);
+
+#endif /* CAN_TRANSPORT_H_ */
@@ -85,6 +85,7 @@ void TimerInit(float32 ftmr) {
 	CpuTimer0Regs.TCR.bit.TIE = 1;//enable timer-triggered interrupts
 	CpuTimer0Regs.PRD.all = prd;//should set to appropriate value
 	CpuTimer0Regs.TPR.all = 0;//the other divisor
+	CpuTimer0Regs.TCR.bit.TRB = 1;//load PRD now; otherwise the first period counts down from TIM's reset value of 2^32-1
 	CpuTimer0Regs.TCR.bit.TSS = 0;//start the timer
 }
 
@@ -95,6 +96,80 @@ float32 getfclk() {
 	return xfclk;
 }
 
+/**
+ * @return The current low-speed peripheral clock (SCI, SPI, McBSP) in MHz:
+ * fclk divided as LOSPCP says.
+ */
+float32 getlspclk() {
+	Uint16 lospcp = SysCtrlRegs.LOSPCP.bit.LSPCLK;
+	return lospcp ? xfclk/(2*lospcp) : xfclk;
+}
+
+/*
+ * The BRR nearest to baudrate (kHz) at lspclk (kHz) for one user, within the
+ * register's range. Stores the relative error of what it gives in *error.
+ */
+static Uint16 LspBrr(LSPUSER type, float32 lspclk, float32 baudrate, float32* error) {
+	float32 per_count = type == LSP_SCI ? 8 : 1;//clocks per bit per BRR + 1
+	float32 ideal = lspclk/(per_count*baudrate) - 1;
+	Uint16 max = type == LSP_SCI ? 65535 : 127;
+	Uint16 min = type == LSP_SCI ? 1 : 3;
+	Uint16 brr = ideal < min ? min : ideal > max ? max : (Uint16)(ideal + 0.5f);
+
+	*error = lspclk/(per_count*(brr + 1))/baudrate - 1;
+	return brr;
+}
+
+/**
+ * LspClkPlan picks the LOSPCP prescaler shared by every SCI and SPI port,
+ * and each port's BRR, so that the worst baud rate error among them is as
+ * small as it can be. Call it after SysClkInit with every port the program
+ * uses, then set the ports up as usual: SetSciBaudRate and SetSpiBaudRate
+ * work from the LSPCLK planned here and arrive at the same BRRs.
+ *
+ * Nothing changes if the best plan still misses a rate by more than
+ * tolerance; the rates are filled in either way, to show which port is the
+ * problem. Changing LOSPCP changes the rate of ports already running.
+ *
+ * @param rates The ports and their baud rates in kHz; brr and error are filled in.
+ * @param count How many.
+ * @param tolerance The largest acceptable error, e.g. 0.02 for 2%. SCI
+ * receivers typically manage 2-3% in total between the two ends.
+ * @return 1 if LOSPCP was set, 0 if no prescaler meets tolerance.
+ */
+char LspClkPlan(LSPRATE* rates, Uint16 count, float32 tolerance) {
+	float32 best_worst = 0, error;
+	Uint16 best = 0, lospcp, i;
+
+	for (lospcp = 0; lospcp < 8; lospcp++) {
+		float32 lspclk = xfclk*1000/(lospcp ? 2*lospcp : 1);
+		float32 worst = 0;
+		for (i = 0; i < count; i++) {
+			LspBrr(rates[i].type, lspclk, rates[i].baudrate, &error);
+			if (error < 0) error = -error;
+			if (error > worst) worst = error;
+		}
+		if (lospcp == 0 || worst < best_worst) {//ties go to the faster clock
+			best_worst = worst;
+			best = lospcp;
+		}
+	}
+
+	for (i = 0; i < count; i++) {
+		rates[i].brr = LspBrr(rates[i].type, xfclk*1000/(best ? 2*best : 1), rates[i].baudrate, &rates[i].error);
+	}
+	if (best_worst > tolerance) {
+		return 0;
+	}
+
+	EALLOW;
+	SysCtrlRegs.LOSPCP.all = best;
+	EDIS;
+	asm(" NOP");
+	asm(" NOP");
+	return 1;
+}
+
 /**
  * Services the watchdog
  */
@@ -19,9 +19,27 @@ typedef enum {
     ONEHUNDREDSIXTY = 33,   ONEHUNDREDSEVENTY = 34,	ONEHUNDREDEIGHTY = 35
 } FCLKS;
 
+/*
+ * One user of the low-speed clock for LspClkPlan: what it wants and, once
+ * planned, the BRR it gets and how far off that leaves it.
+ */
+typedef enum {
+    LSP_SCI,			//baud = LSPCLK / ((BRR + 1) * 8), BRR 1-65535
+    LSP_SPI				//baud = LSPCLK / (BRR + 1), BRR 3-127
+} LSPUSER;
+
+typedef struct {
+    LSPUSER type;
+    float32 baudrate;	//wanted, in kHz
+    Uint16 brr;			//set by LspClkPlan
+    float32 error;		//set by LspClkPlan: achieved / wanted - 1
+} LSPRATE;
+
 void serviceWatchog();
 void SysClkInit(FCLKS);
 void TimerInit(float32);
 float32 getfclk(void);
+float32 getlspclk(void);
+char LspClkPlan(LSPRATE* rates, Uint16 count, float32 tolerance);
 
 #endif
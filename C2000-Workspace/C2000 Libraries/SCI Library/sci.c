@@ -12,6 +12,79 @@
 #include "sci.h"
 #include "string.h"
 
+#define SCI_FIFO_DEPTH 4
+
+//Rings for EnableSciInterrupts, [0] for SCI-A and [1] for SCI-B. Head and tail run
+//freely and are masked on use; the producer owns the head, the consumer the tail.
+static char SciTxRing[2][SCI_TX_RING_SIZE];
+static char SciRxRing[2][SCI_RX_RING_SIZE];
+static volatile Uint16 SciTxHead[2], SciTxTail[2];
+static volatile Uint16 SciRxHead[2], SciRxTail[2];
+static volatile Uint32 SciRxLost[2];
+static char SciBuffered[2] = {0, 0};
+static Uint16 SciTxStage[2];//end of what SciTxPut has written, between SciTxOpen and SciTxClose
+static Uint16 SciTxIer[2];
+
+static Uint16 SciIndex(char scisys) {
+	return scisys == 'B';
+}
+
+static volatile struct SCI_REGS* SciRegsOf(char scisys) {
+	switch (scisys) {
+		case 'A': return &SciaRegs;
+		case 'B': return &ScibRegs;
+		default: return 0;
+	}
+}
+
+/**
+ * Moves queued bytes into the TX FIFO until it is full. Runs in the TX ISR; the
+ * interrupt is switched off once the ring is empty and SciWrite switches it back on.
+ */
+static void SciTxRefill(Uint16 i, volatile struct SCI_REGS* regs) {
+	Uint16 tail = SciTxTail[i];
+
+	while (tail != SciTxHead[i] && regs->SCIFFTX.bit.TXFFST < SCI_FIFO_DEPTH) {
+		regs->SCITXBUF = SciTxRing[i][tail & (SCI_TX_RING_SIZE - 1)];
+		tail++;
+	}
+	SciTxTail[i] = tail;
+	if (tail == SciTxHead[i]) regs->SCIFFTX.bit.TXFFIENA = 0;
+	regs->SCIFFTX.bit.TXFFINTCLR = 1;
+}
+
+/**
+ * Moves everything in the RX FIFO into the ring. Runs in the RX ISR, and from
+ * SciRead with the ISR masked.
+ */
+static void SciRxEmpty(Uint16 i, volatile struct SCI_REGS* regs) {
+	Uint16 head = SciRxHead[i];
+
+	while (regs->SCIFFRX.bit.RXFFST) {
+		char c = regs->SCIRXBUF.all & 0xFF;
+		if ((Uint16)(head - SciRxTail[i]) < SCI_RX_RING_SIZE) {
+			SciRxRing[i][head & (SCI_RX_RING_SIZE - 1)] = c;
+			head++;
+		} else {
+			SciRxLost[i]++;
+		}
+	}
+	SciRxHead[i] = head;
+	if (regs->SCIFFRX.bit.RXFFOVF) {
+		SciRxLost[i]++;//at least one
+		regs->SCIFFRX.bit.RXFFOVRCLR = 1;
+	}
+	regs->SCIFFRX.bit.RXFFINTCLR = 1;
+}
+
+static void SciDrain(char scisys) {
+	Uint16 ier9 = IER & M_INT9;
+
+	IER &= ~M_INT9;
+	SciRxEmpty(SciIndex(scisys), SciRegsOf(scisys));
+	IER |= ier9;
+}
+
 /**
  * Pass SCIPINs corresponding to GPIO pins you wish to make SCI .
  *
@@ -150,55 +223,61 @@ void SciInit(SCIPIN in, SCIPIN out) {
  * SciInit. Note this method requires knowledge of the system clock frequency (in MHz).
  * Make a call to getfclk from the Clock Library if needed.
  *
- * Note this method is not completely fool-proof: not all combinations of fclk and
- * baud rate are possible. For example, if baud needs to be < 350 Hz for fclk =
- * 180MHz (its max possible value), then the low-speed clock will need to be set
- * to some fraction of fclk. Here I have left the low-speed clock as large as
- * possible to increase fidelity between desired and actually-set baud rate.
+ * The baud rate comes from the low-speed clock, which SCI shares with SPI and
+ * McBSP, so its prescaler (LOSPCP) is left alone and read back. At its reset
+ * value LSPCLK is fclk/4. To get several ports close to their rates at once,
+ * let LspClkPlan in the Clock Library choose LOSPCP first; it chooses the
+ * same BRR this does.
  *
  * @param scisys A or B
  * @param fclk The system clock frequency in MHz as set with SysClkInit and obtained with getfclk
  * @param baudrate The desired baud rate of the sci module in kHz
+ * @return How far the rate set is off: achieved / desired - 1. Keep it within
+ * 				about 2% for reliable reception.
  */
-void SetSciBaudRate(char scisys, float32 fclk, float32 baudrate) {
-	SysCtrlRegs.LOSPCP.all = 0x0000;//low-speed clock = sysclk
-								//see Table 1-19 in Tech Ref Man
-	asm(" NOP");
-	asm(" NOP");
-
-	Uint16 brr = fclk*1000/(8*baudrate)-1;//find brr with formula from Table 13-11
-										//of Tech Ref Man. x1000 to put MHz in kHz.
+float32 SetSciBaudRate(char scisys, float32 fclk, float32 baudrate) {
+	Uint16 lospcp = SysCtrlRegs.LOSPCP.bit.LSPCLK;
+	float32 lspclk = fclk*1000/(lospcp ? 2*lospcp : 1);//in kHz; see Table 1-19 in Tech Ref Man
+	float32 ideal = lspclk/(8*baudrate) - 1;//formula from Table 13-11 of Tech Ref Man
+	Uint16 brr = ideal < 1 ? 1 : ideal > 65535.0f ? 65535 : (Uint16)(ideal + 0.5f);//nearest, not truncated
+
 	switch (scisys) {
 		case 'A':
 			SciaRegs.SCICTL1.bit.SWRESET = 0;//is this necessary? It works.
-			SciaRegs.SCILBAUD = brr;//truncated
+			SciaRegs.SCILBAUD = brr & 0xFF;
 			SciaRegs.SCIHBAUD = (brr >> 8);
 			SciaRegs.SCICTL1.bit.SWRESET = 1;//relinquish from reset mode
 			break;
 		case 'B':
 			ScibRegs.SCICTL1.bit.SWRESET = 0;
-			ScibRegs.SCILBAUD = brr;
+			ScibRegs.SCILBAUD = brr & 0xFF;
 			ScibRegs.SCIHBAUD = (brr >> 8);
 			ScibRegs.SCICTL1.bit.SWRESET = 1;
 			break;
 	}
 
+	return lspclk/(8*((float32)brr + 1))/baudrate - 1;
 }
 
 /**
- * Send a character to the SCI pin.
+ * Send a character to the SCI pin. Waits only while all 4 FIFO levels are
+ * taken, or, once EnableSciInterrupts has run, while the transmit ring is full.
  *
  * @param scisys A or B
  * @param c The character to send to the SCI module.
  */
 void sendCharacter(char scisys, char c) {
+	if (SciBuffered[SciIndex(scisys)]) {
+		while (!SciWrite(scisys, &c, 1)) {}//ring full: wait for the ISR to make room
+		return;
+	}
 	switch (scisys) {
 		case'A':
-			while (SciaRegs.SCIFFTX.bit.TXFFST != 0) {}//wait for current transmit to finish
+			while (SciaRegs.SCIFFTX.bit.TXFFST >= SCI_FIFO_DEPTH) {}//wait for a free FIFO level
 			SciaRegs.SCITXBUF = c;//write new message element
 			break;
 		case 'B':
-			while (ScibRegs.SCIFFTX.bit.TXFFST != 0) {}//wait for current transmit to finish
+			while (ScibRegs.SCIFFTX.bit.TXFFST >= SCI_FIFO_DEPTH) {}//wait for a free FIFO level
 			ScibRegs.SCITXBUF = c;//write new message element
 			break;
 	}
@@ -207,6 +286,7 @@ void sendCharacter(char scisys, char c) {
 /**
  * Send a byte array via SCI. Note this function is BLOCKING: no other code will be
  * executed while this function is running (unless that other code is an ISR).
+ * After EnableSciInterrupts it only waits while the transmit ring is full.
  *
  * @param scisys A or B
  * @param arr Data to be sent.
@@ -231,13 +311,19 @@ void sendString(char scisys, char* str) {
 }
 
 /**
- * Read from the RX register when its value changes.
+ * Read from the RX register when its value changes, or from the receive ring
+ * once EnableSciInterrupts has run.
  *
  * @param scisys A or B
  * @return The character read.
  */
 char recieveChar(char scisys) {
-		switch (scisys) {
+	char c;
+	if (SciBuffered[SciIndex(scisys)]) {
+		while (!SciRead(scisys, &c, 1)) {}//wait for the ISR to bring one in
+		return c;
+	}
+	switch (scisys) {
 		case 'A':
 			while (SciaRegs.SCIFFRX.bit.RXFFST == 0) {} //wait for a change
 			return SciaRegs.SCIRXBUF.all;
@@ -270,16 +356,19 @@ void recieveCharArray(char scisys, char* arr, Uint16 len) {
  * a string.
  *
  * @param scisys A or B
- * @param str A character array to be filled with null-terminated data. No
- * 				length specification necessary.
+ * @param str A character array to be filled with null-terminated data.
+ * @param size Its size in chars, terminator included.
  * @return -1 if the string recieved has not ended by the time the end of the
- * 				data-buffer is reached, +1 if there is no error
+ * 				data-buffer is reached, +1 if there is no error. Blocks until one
+ * 				of the two; ShellPoll (shell.h) reads lines without waiting.
  */
-signed char recieveString(char scisys, char* str) {
+signed char recieveString(char scisys, char* str, Uint16 size) {
 	Uint16 i = 0;
 	char c = 't';
+	if (!size) return -1;
 	while(c != '\0') {
-		if (i > strlen(str)) {//strlen("thing") = 5, and ['t','h','i','n','g','\0'] has indices 0->5
+		if (i == size) {
+			str[size - 1] = '\0';
 			return -1;
 		}
 		c = recieveChar(scisys);
@@ -290,30 +379,209 @@ signed char recieveString(char scisys, char* str) {
 }
 
 /**
- * UNTESTED
- * Enable interrupts from the SCI
+ * Switch a port to interrupt-driven, ring-buffered operation. Call after SciInit
+ * and SetSciBaudRate. From then on SciWrite and SciRead only copy to and from RAM:
+ * the TX ISR refills the whole 4-level FIFO each time it runs empty and the RX ISR
+ * empties it every SCI_RX_FIFO_LEVEL characters (SciRead collects any fewer left
+ * behind). sendCharArray, recieveChar and the rest go through the rings as well.
+ *
+ * Registers the ISRs in the PIE (group 9) and sets M_INT9 in IER; interrupts
+ * still need EINT.
  *
  * @param scisys A or B
- * @param sendISR A function pointer to an interrupt to be executed when data is sent
- * @param recieveISR A function pointer to an interrupt to be executed when data is recieved
  */
 void EnableSciInterrupts(char scisys) {
-	switch (scisys) {
-		case 'A':
-			SciaRegs.SCIFFTX.bit.SCIFFENA = 1;//enable SCIA FIFO
-			SciaRegs.SCIFFTX.bit.TXFFIENA = 1;//enable transmit interrupts from the SCI module
-			SciaRegs.SCIFFTX.bit.TXFFIL = 4;//interrupts occur when fifo holds 4 words.
-			SciaRegs.SCIFFRX.bit.RXFFIENA = 1;//enable recieve interrupts from the SCI module
-			SciaRegs.SCIFFRX.bit.RXFFIL = 4;//interrupts occur when fifo holds 4 words.
-			break;
-		case 'B':
-			ScibRegs.SCIFFTX.bit.SCIFFENA = 1;//enable SCIB FIFO
-			ScibRegs.SCIFFTX.bit.TXFFIENA = 1;//enable transmit interrupts from the SCI module
-			ScibRegs.SCIFFTX.bit.TXFFIL = 4;//interrupts occur when fifo holds 4 words.
-			ScibRegs.SCIFFRX.bit.RXFFIENA = 1;//enable recieve interrupts from the SCI module
-			ScibRegs.SCIFFRX.bit.RXFFIL = 4;//interrupts occur when fifo holds 4 words.
-			break;
+	Uint16 i = SciIndex(scisys);
+	volatile struct SCI_REGS* regs = SciRegsOf(scisys);
+
+	if (!regs) return;
+	SciBuffered[i] = 0;
+	regs->SCIFFTX.bit.TXFFIENA = 0;
+	regs->SCIFFRX.bit.RXFFIENA = 0;
+	SciTxHead[i] = SciTxTail[i] = 0;
+	SciRxHead[i] = SciRxTail[i] = 0;
+	SciRxLost[i] = 0;
+
+	EALLOW;
+	if (i == 0) {
+		PieVectTable.SCIRXINTA = &SciaRxIsr;
+		PieVectTable.SCITXINTA = &SciaTxIsr;
+	} else {
+		PieVectTable.SCIRXINTB = &ScibRxIsr;
+		PieVectTable.SCITXINTB = &ScibTxIsr;
+	}
+	EDIS;
+
+	regs->SCIFFTX.bit.SCIFFENA = 1;//enable the FIFO
+	regs->SCIFFTX.bit.TXFFIL = 0;//TX interrupt when the FIFO is empty (one character still shifting)
+	regs->SCIFFTX.bit.TXFFINTCLR = 1;
+	regs->SCIFFRX.bit.RXFFIL = SCI_RX_FIFO_LEVEL;
+	regs->SCIFFRX.bit.RXFFOVRCLR = 1;
+	regs->SCIFFRX.bit.RXFFINTCLR = 1;
+	regs->SCIFFRX.bit.RXFFIENA = 1;//TX stays off until there is something to send
+	SciBuffered[i] = 1;
+
+	PieCtrlRegs.PIECTRL.bit.ENPIE = 1;
+	if (i == 0) {
+		PieCtrlRegs.PIEIER9.bit.INTx1 = 1;//SCIRXINTA
+		PieCtrlRegs.PIEIER9.bit.INTx2 = 1;//SCITXINTA
+	} else {
+		PieCtrlRegs.PIEIER9.bit.INTx3 = 1;//SCIRXINTB
+		PieCtrlRegs.PIEIER9.bit.INTx4 = 1;//SCITXINTB
 	}
+	IER |= M_INT9;
 }
 
+/**
+ * Queue up to len bytes for transmission and return at once.
+ *
+ * @param scisys A or B
+ * @param data Bytes to send, one per char.
+ * @param len How many.
+ * @return How many were queued: fewer than len when the transmit ring fills up.
+ */
+Uint16 SciWrite(char scisys, const char* data, Uint16 len) {
+	Uint16 i = SciIndex(scisys);
+	volatile struct SCI_REGS* regs = SciRegsOf(scisys);
+	Uint16 ier9, head, n;
 
+	if (!regs || !SciBuffered[i]) return 0;
+	ier9 = IER & M_INT9;
+	IER &= ~M_INT9;//one producer at a time, ISRs included
+	head = SciTxHead[i];
+	for (n = 0; n < len && (Uint16)(head - SciTxTail[i]) < SCI_TX_RING_SIZE; n++) {
+		SciTxRing[i][head & (SCI_TX_RING_SIZE - 1)] = data[n];
+		head++;
+	}
+	SciTxHead[i] = head;
+	if (n) regs->SCIFFTX.bit.TXFFIENA = 1;//the ISR fires right away if the FIFO has room
+	IER |= ier9;
+	return n;
+}
+
+/**
+ * Staged writes, for encoders that produce a message byte by byte (telemetry.c).
+ * SciTxOpen checks for room and holds the port's other producers off (INT9);
+ * SciTxPut appends without waking the ISR; SciTxClose hands the lot over at once
+ * and lets interrupts back in. Keep what goes between them short.
+ *
+ * @param scisys A or B
+ * @param len The most bytes that will be put.
+ * @return 1 if open, 0 (and nothing held off) if the ring lacks len bytes.
+ */
+char SciTxOpen(char scisys, Uint16 len) {
+	Uint16 i = SciIndex(scisys);
+	Uint16 ier9;
+
+	if (!SciRegsOf(scisys) || !SciBuffered[i]) return 0;
+	ier9 = IER & M_INT9;
+	IER &= ~M_INT9;
+	if (SCI_TX_RING_SIZE - (Uint16)(SciTxHead[i] - SciTxTail[i]) < len) {
+		IER |= ier9;
+		return 0;
+	}
+	SciTxIer[i] = ier9;
+	SciTxStage[i] = SciTxHead[i];
+	return 1;
+}
+
+void SciTxPut(char scisys, char c) {
+	Uint16 i = SciIndex(scisys);
+	SciTxRing[i][SciTxStage[i]++ & (SCI_TX_RING_SIZE - 1)] = c;
+}
+
+void SciTxClose(char scisys) {
+	Uint16 i = SciIndex(scisys);
+
+	SciTxHead[i] = SciTxStage[i];
+	SciRegsOf(scisys)->SCIFFTX.bit.TXFFIENA = 1;
+	IER |= SciTxIer[i];
+}
+
+/**
+ * SciWrite for a null-terminated string. The terminator is not sent.
+ *
+ * @param scisys A or B
+ * @param str The string.
+ * @return How many characters were queued.
+ */
+Uint16 SciWriteString(char scisys, const char* str) {
+	return SciWrite(scisys, str, strlen(str));
+}
+
+/**
+ * Take up to len received bytes without waiting.
+ *
+ * @param scisys A or B
+ * @param data Buffer for the bytes.
+ * @param len Its size.
+ * @return How many bytes were copied, possibly 0.
+ */
+Uint16 SciRead(char scisys, char* data, Uint16 len) {
+	Uint16 i = SciIndex(scisys);
+	Uint16 tail, n;
+
+	if (!SciRegsOf(scisys) || !SciBuffered[i]) return 0;
+	SciDrain(scisys);//fewer than SCI_RX_FIFO_LEVEL may be waiting in the FIFO
+	tail = SciRxTail[i];
+	for (n = 0; n < len && tail != SciRxHead[i]; n++) {
+		data[n] = SciRxRing[i][tail & (SCI_RX_RING_SIZE - 1)];
+		tail++;
+	}
+	SciRxTail[i] = tail;
+	return n;
+}
+
+/**
+ * @param scisys A or B
+ * @return Bytes SciRead would return right now.
+ */
+Uint16 SciReadable(char scisys) {
+	Uint16 i = SciIndex(scisys);
+
+	if (!SciRegsOf(scisys) || !SciBuffered[i]) return 0;
+	SciDrain(scisys);
+	return SciRxHead[i] - SciRxTail[i];
+}
+
+/**
+ * @param scisys A or B
+ * @return Bytes SciWrite would accept right now.
+ */
+Uint16 SciWritable(char scisys) {
+	Uint16 i = SciIndex(scisys);
+
+	if (!SciRegsOf(scisys) || !SciBuffered[i]) return 0;
+	return SCI_TX_RING_SIZE - (Uint16)(SciTxHead[i] - SciTxTail[i]);
+}
+
+/**
+ * @param scisys A or B
+ * @return Received bytes lost so far, to a full receive ring or a FIFO overrun.
+ */
+Uint32 SciRxLostCount(char scisys) {
+	return SciRxLost[SciIndex(scisys)];
+}
+
+/**
+ * SCI-A and SCI-B transmit and receive ISRs, registered by EnableSciInterrupts.
+ */
+__interrupt void SciaTxIsr(void) {
+	SciTxRefill(0, &SciaRegs);
+	PieCtrlRegs.PIEACK.all = PIEACK_GROUP9;
+}
+
+__interrupt void SciaRxIsr(void) {
+	SciRxEmpty(0, &SciaRegs);
+	PieCtrlRegs.PIEACK.all = PIEACK_GROUP9;
+}
+
+__interrupt void ScibTxIsr(void) {
+	SciTxRefill(1, &ScibRegs);
+	PieCtrlRegs.PIEACK.all = PIEACK_GROUP9;
+}
+
+__interrupt void ScibRxIsr(void) {
+	SciRxEmpty(1, &ScibRegs);
+	PieCtrlRegs.PIEACK.all = PIEACK_GROUP9;
+}
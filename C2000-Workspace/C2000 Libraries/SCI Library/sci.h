@@ -15,14 +15,40 @@ typedef enum {
 } SCIPIN;
 
 void SciInit(SCIPIN in, SCIPIN out);
-void SetSciBaudRate(char scisys, float32 fclk, float32 baudrate);
+float32 SetSciBaudRate(char scisys, float32 fclk, float32 baudrate);
 
 void sendCharArray(char, char*, Uint16);
 void sendString(char, char*);
 void recieveCharArray(char, char*, Uint16);
-signed char recieveString(char, char*);
+signed char recieveString(char, char*, Uint16);
 
-//untested
-void EnableSciInterrupts(char);
+/*
+ * Interrupt-driven operation: EnableSciInterrupts after SciInit and
+ * SetSciBaudRate, then EINT. SciWrite/SciRead never wait.
+ *
+ *	SciInit(Ain28, Aout29);
+ *	SetSciBaudRate('A', getfclk(), 115.2);
+ *	EnableSciInterrupts('A');
+ *	EINT;
+ *	SciWriteString('A', "v=12.3\r\n");	//copies 8 bytes and returns
+ */
+#define SCI_TX_RING_SIZE 256//bytes, power of two
+#define SCI_RX_RING_SIZE 64//bytes, power of two
+#define SCI_RX_FIFO_LEVEL 3//RX interrupt at 3 characters: two more character times before an overrun
+
+void EnableSciInterrupts(char scisys);
+Uint16 SciWrite(char scisys, const char* data, Uint16 len);
+Uint16 SciWriteString(char scisys, const char* str);
+Uint16 SciRead(char scisys, char* data, Uint16 len);
+Uint16 SciReadable(char scisys);
+Uint16 SciWritable(char scisys);
+Uint32 SciRxLostCount(char scisys);
+char SciTxOpen(char scisys, Uint16 len);
+void SciTxPut(char scisys, char c);
+void SciTxClose(char scisys);
+__interrupt void SciaTxIsr(void);
+__interrupt void SciaRxIsr(void);
+__interrupt void ScibTxIsr(void);
+__interrupt void ScibRxIsr(void);
 
 #endif
@@ -0,0 +1,317 @@
+/*
+ * shell.c
+ *
+ * One line is collected at a time from the receive ring; it is only parsed
+ * once its line end arrives. Answers are formatted into ShellOut and queued
+ * whole with SciWrite once there is room, and nothing more is read until
+ * then. list keeps its place in ShellListNext and writes one line per call.
+ */
+#include "shell.h"
+#include "sci.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define SHELL_OUT_MAX 80
+
+static char ShellSci = 'A';
+static const SHELL_PARAM* ShellParams = 0;
+static Uint16 ShellCount = 0;
+
+static char ShellLine[SHELL_LINE_MAX + 1];
+static Uint16 ShellLength = 0;
+static char ShellOverlong = 0;//the current line has outgrown ShellLine: drop it at the line end
+static Uint32 ShellLastInput = 0;
+
+static char ShellOut[SHELL_OUT_MAX];
+static Uint16 ShellOutLength = 0;//waiting for room in the transmit ring
+static Uint16 ShellListNext = 0;
+static char ShellListing = 0;
+
+/**
+ * Start answering commands on scisys about the given parameters. The table is
+ * used in place, so it has to outlive the shell.
+ */
+void ShellInit(char scisys, const SHELL_PARAM* params, Uint16 count) {
+	ShellSci = scisys;
+	ShellParams = params;
+	ShellCount = count;
+	ShellLength = 0;
+	ShellOverlong = 0;
+	ShellOutLength = 0;
+	ShellListing = 0;
+}
+
+static void ShellAppend(const char* s) {
+	while (*s && ShellOutLength < SHELL_OUT_MAX - 2) {
+		ShellOut[ShellOutLength++] = *s++;
+	}
+}
+
+/* Ends the reply in the two bytes ShellAppend keeps free, so a truncated reply still ends its line. */
+static void ShellEndLine(void) {
+	ShellOut[ShellOutLength++] = '\r';
+	ShellOut[ShellOutLength++] = '\n';
+}
+
+static void ShellAppendUnsigned(Uint32 v) {
+	char digits[11];
+	Uint16 n = 0;
+
+	do {
+		digits[n++] = '0' + v % 10;
+		v /= 10;
+	} while (v);
+	while (n && ShellOutLength < SHELL_OUT_MAX - 2) {
+		ShellOut[ShellOutLength++] = digits[--n];
+	}
+}
+
+static void ShellAppendSigned(int32 v) {
+	if (v < 0) {
+		ShellAppend("-");
+		ShellAppendUnsigned((Uint32)0 - (Uint32)v);
+	} else {
+		ShellAppendUnsigned(v);
+	}
+}
+
+/*
+ * Six significant digits without trailing zeros, with an exponent outside
+ * 1e-4 to 1e7. Done by hand so the library does not depend on the project's
+ * printf support level.
+ */
+static void ShellAppendFloat(float32 x) {
+	Uint32 scaled, power = 100000;
+	Uint16 decimals = 5;
+	int exponent = 0;
+
+	if (x != x) {
+		ShellAppend("nan");
+		return;
+	}
+	if (x < 0) {
+		ShellAppend("-");
+		x = -x;
+	}
+	if (x > 3.4e38f) {
+		ShellAppend("inf");
+		return;
+	}
+	if (x != 0 && (x >= 1e7f || x < 1e-4f)) {
+		while (x >= 10) {
+			x /= 10;
+			exponent++;
+		}
+		while (x < 1) {
+			x *= 10;
+			exponent--;
+		}
+	} else {
+		float32 limit = 10;
+		while (decimals && x >= limit) {//fewer decimals as the whole part grows
+			limit *= 10;
+			power /= 10;
+			decimals--;
+		}
+	}
+	scaled = (Uint32)(x * power + 0.5f);
+	if (exponent && scaled >= 10 * power) {//9.999995 rounded up to 10
+		scaled /= 10;
+		exponent++;
+	}
+	ShellAppendUnsigned(scaled / power);
+	scaled %= power;
+	while (decimals && scaled % 10 == 0) {
+		scaled /= 10;
+		power /= 10;
+		decimals--;
+	}
+	if (decimals) {
+		ShellAppend(".");
+		while (power /= 10) {
+			char digit[2];
+			digit[0] = '0' + scaled / power % 10;
+			digit[1] = 0;
+			ShellAppend(digit);
+		}
+	}
+	if (exponent) {
+		ShellAppend("e");
+		ShellAppendSigned(exponent);
+	}
+}
+
+static void ShellAppendValue(const SHELL_PARAM* p) {
+	switch (p->type & ~SHELL_READONLY) {
+		case SHELL_FLOAT: ShellAppendFloat(*(float32*)p->value); break;
+		case SHELL_INT16: ShellAppendSigned(*(int16*)p->value); break;
+		case SHELL_UINT16: ShellAppendUnsigned(*(Uint16*)p->value); break;
+		case SHELL_INT32: ShellAppendSigned(*(int32*)p->value); break;
+		case SHELL_UINT32: ShellAppendUnsigned(*(Uint32*)p->value); break;
+		default: ShellAppend("?"); break;
+	}
+}
+
+static void ShellAppendParam(const SHELL_PARAM* p, char limits) {
+	ShellAppend(p->name);
+	ShellAppend(" = ");
+	ShellAppendValue(p);
+	if (limits && (p->type & SHELL_READONLY)) {
+		ShellAppend(" (read-only)");
+	} else if (limits && p->min != p->max) {
+		ShellAppend(" [");
+		ShellAppendFloat(p->min);
+		ShellAppend(", ");
+		ShellAppendFloat(p->max);
+		ShellAppend("]");
+	}
+	ShellEndLine();
+}
+
+static void ShellError(const char* message) {
+	ShellAppend("error: ");
+	ShellAppend(message);
+	ShellEndLine();
+}
+
+static const SHELL_PARAM* ShellFind(const char* name) {
+	Uint16 i;
+
+	for (i = 0; i < ShellCount; i++) {
+		if (!strcmp(ShellParams[i].name, name)) return &ShellParams[i];
+	}
+	ShellError("no such parameter");
+	return 0;
+}
+
+/*
+ * Parses text for p and stores it with interrupts masked, so an ISR using the
+ * parameter never sees half of a 32-bit value.
+ * @return 0 with an error in ShellOut if the text is not a value p can take.
+ */
+static char ShellStore(const SHELL_PARAM* p, const char* text) {
+	Uint16 type = p->type & ~SHELL_READONLY;
+	float32 f = 0;
+	int32 i = 0;
+	Uint32 u = 0;
+	char* end;
+	Uint16 ier;
+
+	if (type == SHELL_FLOAT) {
+		f = strtod(text, &end);
+	} else if (type == SHELL_INT16 || type == SHELL_INT32) {
+		i = strtol(text, &end, 0);
+		f = i;
+	} else {
+		u = strtoul(text, &end, 0);
+		f = u;
+	}
+	if (end == text || *end) {
+		ShellError("not a number");
+		return 0;
+	}
+	if ((type == SHELL_UINT16 || type == SHELL_UINT32) && *text == '-') {//strtoul takes "-1"
+		ShellError("out of range");
+		return 0;
+	}
+	if ((type == SHELL_INT16 && (i < -32768L || i > 32767L)) || (type == SHELL_UINT16 && u > 65535UL) ||
+			(p->min != p->max && (f < p->min || f > p->max))) {
+		ShellError("out of range");
+		return 0;
+	}
+
+	ier = IER;
+	IER = 0;
+	switch (type) {
+		case SHELL_FLOAT: *(float32*)p->value = f; break;
+		case SHELL_INT16: *(int16*)p->value = (int16)i; break;
+		case SHELL_UINT16: *(Uint16*)p->value = (Uint16)u; break;
+		case SHELL_INT32: *(int32*)p->value = i; break;
+		case SHELL_UINT32: *(Uint32*)p->value = u; break;
+	}
+	IER |= ier;
+	return 1;
+}
+
+static void ShellExecute(void) {
+	char* words[4];
+	Uint16 n = 0;
+	char* s = ShellLine;
+	const SHELL_PARAM* p;
+
+	while (n < 4) {
+		while (*s == ' ' || *s == '\t') *s++ = 0;
+		if (!*s) break;
+		words[n++] = s;
+		while (*s && *s != ' ' && *s != '\t') s++;
+	}
+	if (!n) return;//empty line, or the LF of a CR LF
+
+	if (!strcmp(words[0], "list") && n == 1) {
+		ShellListing = 1;
+		ShellListNext = 0;
+	} else if (!strcmp(words[0], "get") && n == 2) {
+		if ((p = ShellFind(words[1]))) ShellAppendParam(p, 0);
+	} else if (!strcmp(words[0], "set") && n == 3) {
+		if (!(p = ShellFind(words[1]))) return;
+		if (p->type & SHELL_READONLY) {
+			ShellError("read-only");
+		} else if (ShellStore(p, words[2])) {
+			if (p->changed) p->changed(p);
+			ShellAppendParam(p, 0);
+		}
+	} else {
+		ShellError("usage: list | get <name> | set <name> <value>");
+	}
+}
+
+/**
+ * Handle whatever has arrived since the last call. Call it from the main loop
+ * (not an ISR) as often as is convenient; parameters only change in here.
+ *
+ * @param now_ms A millisecond count, for SHELL_TIMEOUT_MS. Wrapping is fine.
+ */
+void ShellPoll(Uint32 now_ms) {
+	char c;
+
+	if (!ShellParams) return;
+	if ((ShellLength || ShellOverlong) && now_ms - ShellLastInput > SHELL_TIMEOUT_MS) {
+		ShellLength = 0;
+		ShellOverlong = 0;
+	}
+
+	while (1) {
+		if (ShellOutLength) {
+			if (SciWritable(ShellSci) < ShellOutLength) return;
+			SciWrite(ShellSci, ShellOut, ShellOutLength);
+			ShellOutLength = 0;
+		}
+		if (ShellListing) {
+			if (ShellListNext < ShellCount) {
+				ShellAppendParam(&ShellParams[ShellListNext++], 1);
+				continue;
+			}
+			ShellListing = 0;
+		}
+		if (!SciRead(ShellSci, &c, 1)) return;
+
+		ShellLastInput = now_ms;
+		c &= 0xFF;
+		if (c == '\r' || c == '\n') {
+			if (ShellOverlong) {
+				ShellError("line too long");
+			} else {
+				ShellLine[ShellLength] = 0;
+				ShellExecute();
+			}
+			ShellLength = 0;
+			ShellOverlong = 0;
+		} else if (c == '\b' || c == 0x7F) {
+			if (ShellLength) ShellLength--;
+		} else if (ShellLength < SHELL_LINE_MAX) {
+			ShellLine[ShellLength++] = c;
+		} else {
+			ShellOverlong = 1;
+		}
+	}
+}
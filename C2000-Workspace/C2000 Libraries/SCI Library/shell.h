@@ -0,0 +1,70 @@
+/*
+ * shell.h
+ *
+ * Line-oriented command shell on an interrupt-driven SCI port
+ * (EnableSciInterrupts), for reading and changing parameters while the
+ * program runs:
+ *
+ *   list                 every parameter, one per line
+ *   get kp               kp = 0.25
+ *   set kp 0.3           kp = 0.3            (the value as stored)
+ *
+ * Lines end in CR, LF or both; backspace works for people typing in a
+ * terminal. Errors come back as a line starting "error:". A line longer than
+ * SHELL_LINE_MAX is thrown away whole, as is a partial line left for
+ * SHELL_TIMEOUT_MS, so a half-sent command never sticks to the next one.
+ *
+ * ShellPoll never waits. It returns at once when no character has arrived
+ * and no answer is waiting, so it can sit in the main loop; an answer that
+ * does not fit in the transmit ring yet is held, and input is left in the
+ * receive ring, until it does.
+ */
+#ifndef SHELL_H_
+#define SHELL_H_
+
+#include "F2806x_Device.h"
+
+/*
+EXAMPLE: tune a PID loop over SCI-A
+
+	float32 kp = 0.25, ki = 0.01, kd = 0;
+	Uint16 rate_hz = 100;
+
+	const SHELL_PARAM params[] = {
+		{"kp", SHELL_FLOAT, &kp, 0, 10, 0},
+		{"ki", SHELL_FLOAT, &ki, 0, 1, 0},
+		{"kd", SHELL_FLOAT, &kd, 0, 1, 0},
+		{"rate", SHELL_UINT16 | SHELL_READONLY, &rate_hz, 0, 0, 0}
+	};
+
+	ShellInit('A', params, sizeof(params) / sizeof(params[0]));
+	while(1){
+		ShellPoll(ms);		//ms from whatever timer the application keeps
+		...
+	}
+*/
+
+#define SHELL_LINE_MAX 48//characters in a command line, without the line end
+#define SHELL_TIMEOUT_MS 2000//a partial line is dropped after this long without input
+
+typedef enum {
+	SHELL_FLOAT = 0,	//float32
+	SHELL_INT16 = 1,	//int
+	SHELL_UINT16 = 2,	//Uint16
+	SHELL_INT32 = 3,	//int32
+	SHELL_UINT32 = 4,	//Uint32
+	SHELL_READONLY = 0x80//OR into the type: get and list only
+} SHELL_TYPE;
+
+typedef struct SHELL_PARAM {
+	const char* name;
+	Uint16 type;		//SHELL_TYPE
+	void* value;
+	float32 min, max;	//set refuses values outside [min, max]; min == max means no limits
+	void (*changed)(const struct SHELL_PARAM* param);//called after a set, or 0
+} SHELL_PARAM;
+
+void ShellInit(char scisys, const SHELL_PARAM* params, Uint16 count);
+void ShellPoll(Uint32 now_ms);
+
+#endif /* SHELL_H_ */
@@ -0,0 +1,114 @@
+/*
+ * telemetry.c
+ *
+ * Frames are COBS-encoded straight into the SCI transmit ring: each block's code
+ * byte is found by looking ahead for the next zero, so bytes are only ever
+ * appended and nothing is copied on the way.
+ */
+#include "telemetry.h"
+#include "sci.h"
+
+static const Uint16 TelemetryCrcTable[16] = {
+	0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+	0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+};
+
+static Uint16 TelemetrySeq[2];
+static Uint32 TelemetryDrops[2];
+
+/**
+ * Continue a CRC-16/CCITT-FALSE with one byte. Start with 0xFFFF.
+ */
+Uint16 TelemetryCrc(Uint16 crc, Uint16 byte) {
+	crc = (crc << 4) ^ TelemetryCrcTable[((crc >> 12) ^ (byte >> 4)) & 0xF];
+	crc = (crc << 4) ^ TelemetryCrcTable[((crc >> 12) ^ byte) & 0xF];
+	return crc & 0xFFFF;
+}
+
+//Byte k of the unencoded frame: type, seq, data, crc
+static Uint16 TelemetryByte(Uint16 k, Uint16 type, Uint16 seq, const char* data, Uint16 len, Uint16 crc) {
+	if (k == 0) return type & 0xFF;
+	if (k == 1) return seq & 0xFF;
+	if (k < len + 2) return data[k - 2] & 0xFF;
+	return k == len + 2 ? crc >> 8 : crc & 0xFF;
+}
+
+/**
+ * Queue one frame on an SCI port set up with EnableSciInterrupts. Never waits: a
+ * frame that does not fit in the transmit ring is dropped whole and counted.
+ *
+ * @param scisys A or B
+ * @param type Message type, 0-255, for the receiver to tell layouts apart.
+ * @param data Payload, one byte per char.
+ * @param len Its length, at most TELEMETRY_MAX_DATA.
+ * @return 1 if queued, 0 if dropped.
+ */
+char TelemetrySend(char scisys, Uint16 type, const char* data, Uint16 len) {
+	Uint16 i = scisys == 'B';
+	Uint16 seq = TelemetrySeq[i];
+	Uint16 crc = 0xFFFF;
+	Uint16 total = len + 4;
+	Uint16 k, run;
+
+	if (len > TELEMETRY_MAX_DATA) {
+		TelemetryDrops[i]++;
+		return 0;
+	}
+	//Before SciTxOpen: INT9 stays masked from there to SciTxClose
+	for (k = 0; k < len + 2; k++) {
+		crc = TelemetryCrc(crc, TelemetryByte(k, type, seq, data, len, 0));
+	}
+	if (!SciTxOpen(scisys, len + TELEMETRY_OVERHEAD)) {
+		TelemetryDrops[i]++;
+		return 0;
+	}
+
+	k = 0;
+	while (1) {
+		for (run = 0; k + run < total && TelemetryByte(k + run, type, seq, data, len, crc); run++) {}
+		SciTxPut(scisys, run + 1);
+		for (; run; run--, k++) {
+			SciTxPut(scisys, TelemetryByte(k, type, seq, data, len, crc));
+		}
+		if (k == total) break;
+		k++;//the zero this block's code stands for
+	}
+	SciTxPut(scisys, 0);
+	SciTxClose(scisys);
+
+	TelemetrySeq[i] = (seq + 1) & 0xFF;
+	return 1;
+}
+
+/**
+ * @param scisys A or B
+ * @return Frames TelemetrySend had to drop for lack of room.
+ */
+Uint32 TelemetryDropped(char scisys) {
+	return TelemetryDrops[scisys == 'B'];
+}
+
+/**
+ * Big-endian field packers. Each writes one byte per char at p.
+ * @return The number of bytes written.
+ */
+Uint16 TelemetryPackU16(char* p, Uint16 value) {
+	p[0] = (value >> 8) & 0xFF;
+	p[1] = value & 0xFF;
+	return 2;
+}
+
+Uint16 TelemetryPackU32(char* p, Uint32 value) {
+	TelemetryPackU16(p, value >> 16);
+	TelemetryPackU16(p + 2, value & 0xFFFF);
+	return 4;
+}
+
+Uint16 TelemetryPackF32(char* p, float32 value) {
+	union {
+		float32 f;
+		Uint32 u;
+	} bits;
+	bits.f = value;
+	return TelemetryPackU32(p, bits.u);
+}
@@ -0,0 +1,42 @@
+/*
+ * telemetry.h
+ *
+ * Framed binary telemetry over an interrupt-driven SCI port (EnableSciInterrupts).
+ * A frame carries
+ *
+ *   type(1) seq(1) data(0-250) crc(2)
+ *
+ * COBS-encoded and ended by a 0x00, so the receiver finds the next frame after
+ * any lost or corrupted byte. crc is CRC-16/CCITT-FALSE (0x1021, initial 0xFFFF)
+ * of type, seq and data, high byte first. seq counts frames per port, so the
+ * receiver can tell how many it missed. Data fields are big-endian; use the
+ * TelemetryPack functions to lay them out.
+ *
+ * "Host Tools/Telemetry" decodes the stream on a PC and turns it into CSV.
+ */
+#ifndef TELEMETRY_H_
+#define TELEMETRY_H_
+
+#include "F2806x_Device.h"
+
+/*
+EXAMPLE: pack voltage and current as message type 1, 100 times a second
+
+	char buf[8];
+	Uint16 n = 0;
+	n += TelemetryPackF32(&buf[n], pack_voltage);
+	n += TelemetryPackF32(&buf[n], pack_current);
+	TelemetrySend('A', 1, buf, n);		//decoded with: tlm2csv -t 1=ff /dev/ttyUSB0
+*/
+
+#define TELEMETRY_MAX_DATA 250//keeps the frame in one COBS block
+#define TELEMETRY_OVERHEAD 6//type, seq, crc, COBS code and delimiter
+
+char TelemetrySend(char scisys, Uint16 type, const char* data, Uint16 len);
+Uint32 TelemetryDropped(char scisys);
+Uint16 TelemetryCrc(Uint16 crc, Uint16 byte);
+Uint16 TelemetryPackU16(char* p, Uint16 value);
+Uint16 TelemetryPackU32(char* p, Uint32 value);
+Uint16 TelemetryPackF32(char* p, float32 value);
+
+#endif /* TELEMETRY_H_ */
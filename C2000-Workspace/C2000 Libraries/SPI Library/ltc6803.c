@@ -0,0 +1,238 @@
+/*
+ * ltc6803.c
+ *
+ * Three SPI_XFERs, all mode 3 on the same chip select: the configuration write,
+ * the cell voltage read and the conversion start. Ltc6803Scan queues them in
+ * that order, the first only when Ltc6803Balance has changed something, so
+ * the read and the start always reach the bus one after the other.
+ *
+ * In a chain the LTC6803s pass data along: a read returns each IC's 18 bytes
+ * and PEC bottom IC first, and configuration is written top IC first.
+ */
+#include "ltc6803.h"
+#include "spi.h"
+
+//CRC-8, polynomial x^8 + x^2 + x + 1, of every byte value
+static const Uint16 Ltc6803PecTable[256] = {
+	0x00, 0x07, 0x0E, 0x09, 0x1C, 0x1B, 0x12, 0x15, 0x38, 0x3F, 0x36, 0x31, 0x24, 0x23, 0x2A, 0x2D,
+	0x70, 0x77, 0x7E, 0x79, 0x6C, 0x6B, 0x62, 0x65, 0x48, 0x4F, 0x46, 0x41, 0x54, 0x53, 0x5A, 0x5D,
+	0xE0, 0xE7, 0xEE, 0xE9, 0xFC, 0xFB, 0xF2, 0xF5, 0xD8, 0xDF, 0xD6, 0xD1, 0xC4, 0xC3, 0xCA, 0xCD,
+	0x90, 0x97, 0x9E, 0x99, 0x8C, 0x8B, 0x82, 0x85, 0xA8, 0xAF, 0xA6, 0xA1, 0xB4, 0xB3, 0xBA, 0xBD,
+	0xC7, 0xC0, 0xC9, 0xCE, 0xDB, 0xDC, 0xD5, 0xD2, 0xFF, 0xF8, 0xF1, 0xF6, 0xE3, 0xE4, 0xED, 0xEA,
+	0xB7, 0xB0, 0xB9, 0xBE, 0xAB, 0xAC, 0xA5, 0xA2, 0x8F, 0x88, 0x81, 0x86, 0x93, 0x94, 0x9D, 0x9A,
+	0x27, 0x20, 0x29, 0x2E, 0x3B, 0x3C, 0x35, 0x32, 0x1F, 0x18, 0x11, 0x16, 0x03, 0x04, 0x0D, 0x0A,
+	0x57, 0x50, 0x59, 0x5E, 0x4B, 0x4C, 0x45, 0x42, 0x6F, 0x68, 0x61, 0x66, 0x73, 0x74, 0x7D, 0x7A,
+	0x89, 0x8E, 0x87, 0x80, 0x95, 0x92, 0x9B, 0x9C, 0xB1, 0xB6, 0xBF, 0xB8, 0xAD, 0xAA, 0xA3, 0xA4,
+	0xF9, 0xFE, 0xF7, 0xF0, 0xE5, 0xE2, 0xEB, 0xEC, 0xC1, 0xC6, 0xCF, 0xC8, 0xDD, 0xDA, 0xD3, 0xD4,
+	0x69, 0x6E, 0x67, 0x60, 0x75, 0x72, 0x7B, 0x7C, 0x51, 0x56, 0x5F, 0x58, 0x4D, 0x4A, 0x43, 0x44,
+	0x19, 0x1E, 0x17, 0x10, 0x05, 0x02, 0x0B, 0x0C, 0x21, 0x26, 0x2F, 0x28, 0x3D, 0x3A, 0x33, 0x34,
+	0x4E, 0x49, 0x40, 0x47, 0x52, 0x55, 0x5C, 0x5B, 0x76, 0x71, 0x78, 0x7F, 0x6A, 0x6D, 0x64, 0x63,
+	0x3E, 0x39, 0x30, 0x37, 0x22, 0x25, 0x2C, 0x2B, 0x06, 0x01, 0x08, 0x0F, 0x1A, 0x1D, 0x14, 0x13,
+	0xAE, 0xA9, 0xA0, 0xA7, 0xB2, 0xB5, 0xBC, 0xBB, 0x96, 0x91, 0x98, 0x9F, 0x8A, 0x8D, 0x84, 0x83,
+	0xDE, 0xD9, 0xD0, 0xD7, 0xC2, 0xC5, 0xCC, 0xCB, 0xE6, 0xE1, 0xE8, 0xEF, 0xFA, 0xFD, 0xF4, 0xF3
+};
+
+#define LTC6803_CFG_BYTES 6
+#define LTC6803_CV_BYTES 18
+
+static SPI_XFER LtcConfig, LtcRead, LtcStart;
+static Uint16 LtcConfigTx[2 + (LTC6803_CFG_BYTES + 1)*LTC6803_MAX_ICS];
+static Uint16 LtcReadTx[2 + (LTC6803_CV_BYTES + 1)*LTC6803_MAX_ICS];
+static Uint16 LtcReadRx[2 + (LTC6803_CV_BYTES + 1)*LTC6803_MAX_ICS];
+static Uint16 LtcStartTx[2];
+
+static char LtcSpi = 'A';
+static Uint16 LtcIcs = 0;
+static Uint16 LtcCfg[LTC6803_MAX_ICS][LTC6803_CFG_BYTES];
+static char LtcConfigDirty = 0;
+static char LtcConverting = 0;//a conversion has been started, so a read returns something
+static char LtcUnparsed = 0;//LtcRead was queued and Ltc6803Update has not looked at it yet
+
+static float32 LtcVolts[LTC6803_MAX_ICS][LTC6803_CELLS];
+static Uint16 LtcValid = 0;
+static Uint32 LtcPecErrors[LTC6803_MAX_ICS];
+static Uint32 LtcOverruns = 0;
+
+/**
+ * PEC of a command or of an IC's data, one byte per word: CRC-8 from 0x41.
+ */
+Uint16 Ltc6803Pec(const Uint16* bytes, Uint16 count) {
+	Uint16 pec = 0x41;
+	Uint16 i;
+
+	for (i = 0; i < count; i++) {
+		pec = Ltc6803PecTable[(pec ^ bytes[i]) & 0xFF];
+	}
+	return pec;
+}
+
+static void LtcXfer(SPI_XFER* x, Uint16 cs, Uint16 brr, Uint16* tx, Uint16* rx, Uint16 length) {
+	x->cs = cs;
+	x->mode = 3;
+	x->brr = brr;
+	x->bits = 8;
+	x->tx = tx;
+	x->rx = rx;
+	x->length = length;
+	x->done = 0;
+	x->status = SPI_IDLE;
+}
+
+static void LtcCommand(Uint16* tx, Uint16 command) {
+	tx[0] = command;
+	tx[1] = Ltc6803Pec(tx, 1);
+}
+
+/**
+ * Set up a chain of LTC6803s and write their configuration: reference on,
+ * comparators off (CDC = 1), GPIO pull-downs off, nothing discharging. The
+ * SPI port must already be set up with SpiPortInit and the chip select with
+ * SpiCsInit; the clock is LTC6803_BAUD or the next slower one possible.
+ *
+ * @param spisys A or B
+ * @param cs The chip-select GPIO
+ * @param ics How many ICs are chained, 1 to LTC6803_MAX_ICS
+ * @param fclk The system clock frequency in MHz, from getfclk
+ * @return 1, or 0 if ics is out of range or the configuration could not be queued.
+ */
+char Ltc6803Init(char spisys, Uint16 cs, Uint16 ics, float32 fclk) {
+	Uint16 lospcp = SysCtrlRegs.LOSPCP.bit.LSPCLK;
+	float32 lspclk = fclk*1000/(lospcp ? 2*lospcp : 1);//in kHz
+	Uint16 brr = SpiBrr(fclk, LTC6803_BAUD);
+	Uint16 i, j;
+
+	if (ics < 1 || ics > LTC6803_MAX_ICS) return 0;
+	if (brr < 127 && lspclk/(brr + 1) > LTC6803_BAUD) brr++;//rounded to a faster clock than it takes
+
+	LtcSpi = spisys;
+	LtcIcs = ics;
+	LtcConverting = 0;
+	LtcUnparsed = 0;
+	LtcValid = 0;
+	for (i = 0; i < ics; i++) {
+		LtcCfg[i][0] = 0x61;//GPIO1, GPIO2 pull-downs off; CDC = 1
+		for (j = 1; j < LTC6803_CFG_BYTES; j++) LtcCfg[i][j] = 0;
+		LtcPecErrors[i] = 0;
+	}
+	LtcOverruns = 0;
+
+	LtcXfer(&LtcConfig, cs, brr, LtcConfigTx, 0, 2 + (LTC6803_CFG_BYTES + 1)*ics);
+	LtcXfer(&LtcRead, cs, brr, LtcReadTx, LtcReadRx, 2 + (LTC6803_CV_BYTES + 1)*ics);
+	LtcXfer(&LtcStart, cs, brr, LtcStartTx, 0, 2);
+	LtcCommand(LtcConfigTx, LTC6803_WRCFG);
+	LtcCommand(LtcReadTx, LTC6803_RDCV);
+	for (i = 2; i < LtcRead.length; i++) LtcReadTx[i] = 0xFF;//clocks the data out
+	LtcCommand(LtcStartTx, LTC6803_STCVAD);
+
+	LtcConfigDirty = 1;
+	return Ltc6803Scan();
+}
+
+/**
+ * Queue the read of the last conversion and the start of the next one, after
+ * the configuration if Ltc6803Balance changed it. Never waits. Call it at a
+ * steady rate, at least LTC6803_CONVERSION_MS apart (plus the read: about
+ * 0.15 ms per IC at 1 MHz), e.g. every 100 ms for 10 Hz.
+ *
+ * @return 1 if queued, 0 if the last scan is still on the bus (counted in
+ * Ltc6803Overruns) or the queue refused it.
+ */
+char Ltc6803Scan(void) {
+	if (!LtcIcs) return 0;
+	if (LtcConfig.status == SPI_QUEUED || LtcConfig.status == SPI_ACTIVE ||
+			LtcRead.status == SPI_QUEUED || LtcRead.status == SPI_ACTIVE ||
+			LtcStart.status == SPI_QUEUED || LtcStart.status == SPI_ACTIVE) {
+		LtcOverruns++;
+		return 0;
+	}
+	Ltc6803Update();//results not collected yet are about to be overwritten
+
+	if (LtcConfigDirty) {
+		Uint16* p = &LtcConfigTx[2];
+		Uint16 i, j;
+		for (i = LtcIcs; i-- > 0; ) {//top IC first
+			for (j = 0; j < LTC6803_CFG_BYTES; j++) p[j] = LtcCfg[i][j];
+			p[LTC6803_CFG_BYTES] = Ltc6803Pec(p, LTC6803_CFG_BYTES);
+			p += LTC6803_CFG_BYTES + 1;
+		}
+		if (!SpiSubmit(LtcSpi, &LtcConfig)) return 0;
+		LtcConfigDirty = 0;
+	}
+	if (LtcConverting) {
+		if (!SpiSubmit(LtcSpi, &LtcRead)) return 0;
+		LtcUnparsed = 1;
+	}
+	if (!SpiSubmit(LtcSpi, &LtcStart)) return 0;
+	LtcConverting = 1;
+	return 1;
+}
+
+/**
+ * Unpack the latest read once it is off the bus. An IC whose PEC does not
+ * match keeps its previous voltages, loses its bit in Ltc6803Valid and is
+ * counted in Ltc6803PecErrors. Main loop only.
+ *
+ * @return 1 if there were new results.
+ */
+char Ltc6803Update(void) {
+	Uint16 ic, cell;
+
+	if (!LtcUnparsed || LtcRead.status != SPI_DONE) return 0;
+	LtcUnparsed = 0;
+
+	for (ic = 0; ic < LtcIcs; ic++) {
+		const Uint16* b = &LtcReadRx[2 + (LTC6803_CV_BYTES + 1)*ic];//bottom IC first
+
+		if (Ltc6803Pec(b, LTC6803_CV_BYTES) != b[LTC6803_CV_BYTES]) {
+			LtcPecErrors[ic]++;
+			LtcValid &= ~(1 << ic);
+			continue;
+		}
+		for (cell = 0; cell < LTC6803_CELLS; cell += 2, b += 3) {//two 12-bit codes in three bytes
+			Uint16 odd = b[0] | (b[1] & 0x0F) << 8;
+			Uint16 even = b[1] >> 4 | b[2] << 4;
+			LtcVolts[ic][cell] = ((int16)odd - 512) * 0.0015f;
+			LtcVolts[ic][cell + 1] = ((int16)even - 512) * 0.0015f;
+		}
+		LtcValid |= 1 << ic;
+	}
+	return 1;
+}
+
+/**
+ * @return Cell cell (0-11) of IC ic in volts, as of the last Ltc6803Update
+ * that had a good PEC for that IC.
+ */
+float32 Ltc6803Cell(Uint16 ic, Uint16 cell) {
+	return ic < LTC6803_MAX_ICS && cell < LTC6803_CELLS ? LtcVolts[ic][cell] : 0;
+}
+
+/**
+ * @return Bit n set if IC n's last read was good.
+ */
+Uint16 Ltc6803Valid(void) {
+	return LtcValid;
+}
+
+Uint32 Ltc6803PecErrors(Uint16 ic) {
+	return ic < LTC6803_MAX_ICS ? LtcPecErrors[ic] : 0;
+}
+
+/**
+ * @return Scans skipped because the one before was still on the bus.
+ */
+Uint32 Ltc6803Overruns(void) {
+	return LtcOverruns;
+}
+
+/**
+ * Choose which cells of IC ic discharge (bit n for cell n + 1), from the
+ * next Ltc6803Scan on. The LTC6803 stops discharging by itself if it hears
+ * nothing for about 2.5 s (its watchdog), so keep scanning.
+ */
+void Ltc6803Balance(Uint16 ic, Uint16 cells) {
+	if (ic >= LtcIcs) return;
+	LtcCfg[ic][1] = cells & 0xFF;//DCC1-8
+	LtcCfg[ic][2] = (LtcCfg[ic][2] & 0xF0) | (cells >> 8 & 0x0F);//DCC9-12
+	LtcConfigDirty = 1;
+}
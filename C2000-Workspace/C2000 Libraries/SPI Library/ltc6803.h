@@ -0,0 +1,49 @@
+/*
+ * ltc6803.h
+ *
+ * LTC6803-1/-3 battery stack monitors, daisy-chained on one chip select of a
+ * port set up with SpiPortInit. IC 0 is the bottom of the stack, the one wired
+ * to the C2000.
+ *
+ * Ltc6803Scan queues, back to back on the SPI transaction queue, a read of
+ * every cell of every IC (RDCV, one pipelined transfer for the whole chain)
+ * and the start of the next conversion (STCVAD). The conversion therefore
+ * runs while Ltc6803Update checks and unpacks the results in the main loop.
+ * Each scan returns the voltages measured by the previous one.
+ *
+ *	Ltc6803Init('A', 19, 4, getfclk());	//4 ICs on SPI-A, chip select GPIO19
+ *	while(1){
+ *		if (tick_100ms) Ltc6803Scan();
+ *		if (Ltc6803Update()) {
+ *			float32 v = Ltc6803Cell(2, 11);	//IC 2, cell 12
+ *			...
+ *		}
+ *	}
+ */
+#ifndef LTC6803_H_
+#define LTC6803_H_
+
+#include "F2806x_Device.h"
+
+#define LTC6803_MAX_ICS 8
+#define LTC6803_CELLS 12
+#define LTC6803_BAUD 1000//kHz, the fastest the LTC6803 takes
+#define LTC6803_CONVERSION_MS 13//all 12 cells; Ltc6803Scan must be called further apart than this
+
+//commands, each followed by its PEC
+#define LTC6803_WRCFG	0x01
+#define LTC6803_RDCFG	0x02
+#define LTC6803_RDCV	0x04
+#define LTC6803_STCVAD	0x10
+
+Uint16 Ltc6803Pec(const Uint16* bytes, Uint16 count);
+char Ltc6803Init(char spisys, Uint16 cs, Uint16 ics, float32 fclk);
+char Ltc6803Scan(void);
+char Ltc6803Update(void);
+float32 Ltc6803Cell(Uint16 ic, Uint16 cell);
+Uint16 Ltc6803Valid(void);
+Uint32 Ltc6803PecErrors(Uint16 ic);
+Uint32 Ltc6803Overruns(void);
+void Ltc6803Balance(Uint16 ic, Uint16 cells);
+
+#endif /* LTC6803_H_ */
@@ -0,0 +1,267 @@
+/*
+ * mcbsp_spi.c
+ *
+ * The McBSP runs in clock stop mode, which is its SPI master mode: every word
+ * the TX DMA channel writes to DXR1 is clocked out and the word clocked in
+ * raises a receive event for the RX DMA channel. TX can only ever be a word
+ * or two ahead of RX, so neither side overruns the other.
+ *
+ * Both channels run in continuous mode, one DMA transfer per block, and
+ * interrupt at the start of each transfer. That is when the DMA has copied
+ * the shadow address registers into the active ones, so the ISR points the
+ * shadows at the buffer for the next block. At the start of the last block
+ * the channels are taken out of continuous mode, and the RX channel is told
+ * to interrupt at the end instead, which finishes the stream.
+ */
+#include "mcbsp_spi.h"
+#include "F2806x_Dma_defines.h"
+
+//Pins for McbspSpiInit, in MCBSPPIN order; all are mux setting 2
+static const Uint16 McbspPinGpio[6] = {20, 50, 21, 51, 22, 52};
+
+//What is sent when tx[0] is 0 and where unwanted data goes; the DMA can only reach L5-L8
+#pragma DATA_SECTION(McbspSpiFill, "DMARAML5")
+static Uint16 McbspSpiFill;
+#pragma DATA_SECTION(McbspSpiSink, "DMARAML5")
+static Uint16 McbspSpiSink;
+
+static MCBSP_STREAM* McbspSpiActive;
+static Uint32 McbspSpiRxStarted, McbspSpiTxStarted;//DMA transfers (blocks) begun
+static Uint16 McbspSpiRxLast;//the RX channel interrupts at the end of the last block
+
+/**
+ * Set McBSP-A up as an SPI master for McbspSpiStart: pins, clocks, and the
+ * DMA channel 1 and 2 interrupts (PIE group 7) with M_INT7 set in IER;
+ * interrupts still need EINT. Mode, clock and word length are set per stream.
+ * Chip selects are GPIOs made with SpiCsInit.
+ */
+void McbspSpiInit(MCBSPPIN mdx, MCBSPPIN mdr, MCBSPPIN mclkx) {
+	EALLOW;
+	SysCtrlRegs.PCLKCR0.bit.MCBSPAENCLK = 1;
+	SysCtrlRegs.PCLKCR3.bit.DMAENCLK = 1;
+	EDIS;
+	asm(" NOP");
+	asm(" NOP");
+
+	SpiGpioInit(McbspPinGpio[mdx], 2);
+	SpiGpioInit(McbspPinGpio[mdr], 2);
+	SpiGpioInit(McbspPinGpio[mclkx], 2);
+
+	McbspaRegs.SPCR2.all = 0;//everything in reset
+	McbspaRegs.SPCR1.all = 0;
+	McbspaRegs.MFFINT.all = 0;//the DMA takes the events, the CPU gets no McBSP interrupts
+	McbspSpiFill = 0xFFFF;
+	McbspSpiActive = 0;
+
+	EALLOW;
+	DmaRegs.DEBUGCTRL.bit.FREE = 1;
+	PieVectTable.DINTCH1 = &McbspSpiRxIsr;
+	PieVectTable.DINTCH2 = &McbspSpiTxIsr;
+	EDIS;
+	PieCtrlRegs.PIECTRL.bit.ENPIE = 1;
+	PieCtrlRegs.PIEIER7.bit.INTx1 = 1;
+	PieCtrlRegs.PIEIER7.bit.INTx2 = 1;
+	IER |= M_INT7;
+}
+
+/**
+ * The CLKGDV for a bit rate, at the low-speed clock LOSPCP gives now. The
+ * McBSP clocks at LSPCLK/(CLKGDV + 1); check the data sheet's limit for
+ * clock stop mode before going near LSPCLK/2.
+ *
+ * @param fclk The system clock frequency in MHz, from getfclk
+ * @param baudrate The desired bit rate in kHz; it is rounded to the nearest
+ * one possible, at most LSPCLK/2
+ */
+Uint16 McbspSpiClkgdv(float32 fclk, float32 baudrate) {
+	Uint16 lospcp = SysCtrlRegs.LOSPCP.bit.LSPCLK;
+	float32 ideal = fclk*1000/(lospcp ? 2*lospcp : 1)/baudrate - 1;
+	return ideal < 1 ? 1 : ideal > 255 ? 255 : (Uint16)(ideal + 0.5f);
+}
+
+//Clock stop mode for the stream's SPI mode and word length, transmitter and receiver left in reset.
+static void McbspSpiSetup(MCBSP_STREAM* s) {
+	Uint16 cpol = (s->mode >> 1) & 1, cpha = s->mode & 1;
+	Uint16 wdlen = s->bits == 8 ? 0 : s->bits == 12 ? 1 : 2;
+	Uint16 lospcp = SysCtrlRegs.LOSPCP.bit.LSPCLK;
+	Uint32 wait = 2UL*(s->clkgdv + 1)*(lospcp ? 2*lospcp : 1);//SYSCLKOUT cycles in two CLKG cycles
+
+	McbspaRegs.SPCR2.all = 0x0200;//FREE, all in reset
+	McbspaRegs.SPCR1.all = (cpha ? 2 : 3) << 11;//CLKSTP: "with delay" puts data out half a cycle early for CPHA = 0
+	//Master: CLKX, CLKR, FSX and FSR internal, FSX active low. CLKXP is CPOL;
+	//CLKRP makes the receiver sample on the other edge from the one data changes on.
+	McbspaRegs.PCR.all = 0x0F08 | (cpol ? 0x0002 : 0) | (cpol == cpha ? 0x0001 : 0);
+	McbspaRegs.RCR2.all = 0x0001;//single phase, one-bit data delay (required in clock stop master mode)
+	McbspaRegs.RCR1.all = wdlen << 5;
+	McbspaRegs.XCR2.all = 0x0001;
+	McbspaRegs.XCR1.all = wdlen << 5;
+	McbspaRegs.SRGR2.all = 0x2000;//CLKSM: CLKG from LSPCLK, FSX on every DXR to XSR copy
+	McbspaRegs.SRGR1.all = s->clkgdv;//FWID 0
+	McbspaRegs.SPCR2.bit.GRST = 1;
+	while (wait--) asm(" NOP");
+}
+
+/*
+ * One DMA channel for the stream: a burst is one word, a transfer is one
+ * block. Not started.
+ */
+static void McbspSpiDma(volatile struct CH_REGS* ch, Uint16 perintsel, Uint16 last, Uint16 size,
+		volatile Uint16* src, int16 srcstep, volatile Uint16* dst, int16 dststep) {
+	EALLOW;
+	//PERINTE, CHINTE, interrupt at the start of a transfer, CONTINUOUS unless this is the last block
+	ch->MODE.all = 0x8100 | perintsel | (last ? 0 : 0x0800);
+	ch->BURST_SIZE.all = 0;
+	ch->SRC_BURST_STEP = 0;
+	ch->DST_BURST_STEP = 0;
+	ch->TRANSFER_SIZE = size - 1;
+	ch->SRC_TRANSFER_STEP = srcstep;
+	ch->DST_TRANSFER_STEP = dststep;
+	ch->SRC_WRAP_SIZE = 0xFFFF;//no wrapping
+	ch->DST_WRAP_SIZE = 0xFFFF;
+	ch->SRC_WRAP_STEP = 0;
+	ch->DST_WRAP_STEP = 0;
+	ch->SRC_BEG_ADDR_SHADOW = DMA_ADDRESS(src);
+	ch->SRC_ADDR_SHADOW = DMA_ADDRESS(src);
+	ch->DST_BEG_ADDR_SHADOW = DMA_ADDRESS(dst);
+	ch->DST_ADDR_SHADOW = DMA_ADDRESS(dst);
+	ch->CONTROL.all = 0x0090;//PERINTCLR, ERRCLR
+	EDIS;
+}
+
+/**
+ * Start a stream; McBSP-A must be idle. Never waits. The stream and its
+ * buffers must stay put until its status is SPI_DONE. Safe to call from
+ * ready once the stream passed to it is SPI_DONE.
+ *
+ * @return 1 if started, 0 if a stream is already running or s is not valid.
+ */
+char McbspSpiStart(MCBSP_STREAM* s) {
+	Uint16 ier7;
+	Uint16 last = s->blocks == 1;
+
+	if (s->bits != 8 && s->bits != 12 && s->bits != 16) return 0;
+	if (s->block < (s->blocks == 1 ? 1 : 4) || s->clkgdv < 1 || s->clkgdv > 255) return 0;
+	ier7 = IER & M_INT7;
+	IER &= ~M_INT7;
+	if (McbspSpiActive) {
+		IER |= ier7;
+		return 0;
+	}
+	McbspSpiActive = s;
+	McbspSpiRxStarted = last;//a single block only interrupts at its end
+	McbspSpiTxStarted = 0;
+	McbspSpiRxLast = last;
+	s->received = 0;
+	s->overrun = 0;
+	s->status = SPI_ACTIVE;
+
+	McbspSpiSetup(s);
+	if (s->rx[0]) {
+		McbspSpiDma(&DmaRegs.CH1, DMA_MREVTA, last, s->block, &McbspaRegs.DRR1.all, 0, s->rx[0], 1);
+	} else {
+		McbspSpiDma(&DmaRegs.CH1, DMA_MREVTA, last, s->block, &McbspaRegs.DRR1.all, 0, &McbspSpiSink, 0);
+	}
+	if (s->tx[0]) {
+		McbspSpiDma(&DmaRegs.CH2, DMA_MXEVTA, last, s->block, s->tx[0], 1, &McbspaRegs.DXR1.all, 0);
+	} else {
+		McbspSpiDma(&DmaRegs.CH2, DMA_MXEVTA, last, s->block, &McbspSpiFill, 0, &McbspaRegs.DXR1.all, 0);
+	}
+	EALLOW;
+	if (last) DmaRegs.CH1.MODE.bit.CHINTMODE = 1;
+	DmaRegs.CH1.CONTROL.bit.RUN = 1;
+	DmaRegs.CH2.CONTROL.bit.RUN = 1;
+	EDIS;
+
+	if (s->cs != SPI_NO_CS) SpiCsWrite(s->cs, 0);
+	McbspaRegs.SPCR1.bit.RRST = 1;
+	McbspaRegs.SPCR2.bit.XRST = 1;//XRDY: the first transmit event
+	McbspaRegs.SPCR2.bit.FRST = 1;
+	IER |= ier7;
+	return 1;
+}
+
+/**
+ * End a stream early: at most one block is started after the one on the bus
+ * now, since the TX channel may already be into it. ready is still called
+ * for every block sent, the last one included.
+ */
+void McbspSpiStop(void) {
+	Uint16 ier7 = IER & M_INT7;
+	MCBSP_STREAM* s;
+
+	IER &= ~M_INT7;
+	s = McbspSpiActive;
+	if (s && (!s->blocks || s->blocks > McbspSpiTxStarted + 1)) {
+		s->blocks = McbspSpiTxStarted + 1;
+	}
+	IER |= ier7;
+}
+
+/**
+ * @return 1 while a stream is running.
+ */
+char McbspSpiBusy(void) {
+	return McbspSpiActive != 0;
+}
+
+static void McbspSpiReady(MCBSP_STREAM* s, Uint32 block) {
+	const Uint16* rx = s->rx[1] ? s->rx[block & 1] : s->rx[0];
+
+	s->received = block + 1;
+	if (s->ready) s->ready(s, rx, block);
+}
+
+//The last word is in: release the chip select and the McBSP.
+static void McbspSpiFinish(MCBSP_STREAM* s) {
+	s->overrun = McbspaRegs.SPCR1.bit.RFULL || DmaRegs.CH1.CONTROL.bit.OVRFLG || DmaRegs.CH2.CONTROL.bit.OVRFLG;
+	McbspaRegs.SPCR1.bit.RRST = 0;
+	McbspaRegs.SPCR2.bit.XRST = 0;
+	if (s->cs != SPI_NO_CS) SpiCsWrite(s->cs, 1);
+	McbspSpiActive = 0;
+	s->status = SPI_DONE;
+	McbspSpiReady(s, McbspSpiRxStarted - 1);
+}
+
+/**
+ * DMA channel 1 (RX) and 2 (TX) ISRs, registered by McbspSpiInit.
+ */
+__interrupt void McbspSpiRxIsr(void) {
+	MCBSP_STREAM* s = McbspSpiActive;
+
+	if (s && McbspSpiRxLast) {
+		McbspSpiFinish(s);
+	} else if (s) {
+		Uint32 started = ++McbspSpiRxStarted;
+
+		EALLOW;
+		if (s->blocks && started >= s->blocks) {
+			DmaRegs.CH1.MODE.bit.CONTINUOUS = 0;
+			DmaRegs.CH1.MODE.bit.CHINTMODE = 1;//next interrupt at the end of this block
+			McbspSpiRxLast = 1;
+		} else if (s->rx[0] && s->rx[1]) {
+			DmaRegs.CH1.DST_BEG_ADDR_SHADOW = DMA_ADDRESS(s->rx[started & 1]);
+			DmaRegs.CH1.DST_ADDR_SHADOW = DMA_ADDRESS(s->rx[started & 1]);
+		}
+		EDIS;
+		if (started >= 2) McbspSpiReady(s, started - 2);
+	}
+	PieCtrlRegs.PIEACK.all = PIEACK_GROUP7;
+}
+
+__interrupt void McbspSpiTxIsr(void) {
+	MCBSP_STREAM* s = McbspSpiActive;
+
+	if (s) {
+		Uint32 started = ++McbspSpiTxStarted;
+
+		EALLOW;
+		if (s->blocks && started >= s->blocks) {
+			DmaRegs.CH2.MODE.bit.CONTINUOUS = 0;//this block is the last
+		} else if (s->tx[0] && s->tx[1]) {
+			DmaRegs.CH2.SRC_BEG_ADDR_SHADOW = DMA_ADDRESS(s->tx[started & 1]);
+			DmaRegs.CH2.SRC_ADDR_SHADOW = DMA_ADDRESS(s->tx[started & 1]);
+		}
+		EDIS;
+	}
+	PieCtrlRegs.PIEACK.all = PIEACK_GROUP7;
+}
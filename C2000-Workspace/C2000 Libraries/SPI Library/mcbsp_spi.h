@@ -0,0 +1,70 @@
+/*
+ * mcbsp_spi.h
+ *
+ * McBSP-A as an SPI master, fed and drained by DMA. The F2806x DMA can reach
+ * the McBSP but not the SPI ports, so this is the way to stream: once a
+ * stream is started the CPU sees one interrupt per block, never one per word.
+ *
+ * A stream is blocks x block words. DMA channel 1 writes the received words
+ * into rx[0] and rx[1] in turn and channel 2 sends from tx[0] and tx[1] in
+ * turn; after each block ready is called with the block just received, while
+ * the DMA carries on with the other buffer. Each channel swaps buffers from an
+ * interrupt at the start of a block, so a block has to last longer on the bus
+ * than INT7 can be held off, and be at least 4 words (TX runs up to two words
+ * ahead of RX) unless the stream is a single block.
+ *
+ * Buffers must be in DMA-accessible RAM (L5-L8: the DMARAML5-8 sections).
+ *
+ *	#pragma DATA_SECTION(samples, "DMARAML5")
+ *	static Uint16 samples[2][256];
+ *	static MCBSP_STREAM adc = {19, 1, 0, 16, {0, 0}, {samples[0], samples[1]}, 256, 0, on_block};
+ *
+ *	McbspSpiInit(Mdx20, Mdr21, Mclkx22);
+ *	SpiCsInit(19);
+ *	EINT;
+ *	adc.clkgdv = McbspSpiClkgdv(getfclk(), 10000);	//10 MHz
+ *	McbspSpiStart(&adc);	//runs until McbspSpiStop
+ *
+ *	void on_block(MCBSP_STREAM* s, const Uint16* rx, Uint32 block) {
+ *		...	//256 samples at rx, from the ISR; the next block lands in the other buffer
+ *	}
+ */
+#ifndef MCBSP_SPI_H_
+#define MCBSP_SPI_H_
+
+#include "F2806x_Device.h"
+#include "spi.h"
+
+typedef enum {
+	Mdx20,		Mdx50,
+	Mdr21,		Mdr51,
+	Mclkx22,	Mclkx52
+} MCBSPPIN;
+
+typedef struct MCBSP_STREAM {
+	Uint16 cs;			//GPIO held low for the whole stream (SpiCsInit), or SPI_NO_CS
+	Uint16 mode;		//SPI mode 0-3: CPOL << 1 | CPHA
+	Uint16 clkgdv;		//from McbspSpiClkgdv
+	Uint16 bits;		//word length: 8, 12 or 16
+	Uint16* tx[2];		//block words each, right-justified; tx[0] = 0 sends all ones, tx[1] = 0 sends tx[0] every block
+	Uint16* rx[2];		//block words each; rx[0] = 0 throws the data away, rx[1] = 0 receives every block into rx[0]
+	Uint16 block;		//words per block, 4-65535 (1-65535 for a single block)
+	Uint32 blocks;		//blocks in the stream, 0 to run until McbspSpiStop
+	//Called from the DMA ISR once block number block is in rx (0 if thrown
+	//away). tx[block & 1] has been sent and may be refilled for block + 2.
+	//The stream is SPI_DONE before the last block's call, which may start another.
+	void (*ready)(struct MCBSP_STREAM* s, const Uint16* rx, Uint32 block);
+	volatile Uint16 status;//SPI_IDLE/ACTIVE/DONE, kept by the driver; start at SPI_IDLE
+	volatile Uint32 received;//blocks received so far
+	Uint16 overrun;		//set at the end if a word was lost: the DMA fell behind the McBSP
+} MCBSP_STREAM;
+
+void McbspSpiInit(MCBSPPIN mdx, MCBSPPIN mdr, MCBSPPIN mclkx);
+Uint16 McbspSpiClkgdv(float32 fclk, float32 baudrate);
+char McbspSpiStart(MCBSP_STREAM* s);
+void McbspSpiStop(void);
+char McbspSpiBusy(void);
+__interrupt void McbspSpiRxIsr(void);
+__interrupt void McbspSpiTxIsr(void);
+
+#endif /* MCBSP_SPI_H_ */
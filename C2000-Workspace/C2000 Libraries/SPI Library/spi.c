@@ -2,6 +2,8 @@
  * @author Drew Harris, soon to be refined by Pavel K
  * @version 0
  */
+#include "F2806x_Device.h"
+#include "spi.h"
 
 
 //Initialize SPI module to use GPIOs 16,17,18,19
@@ -62,3 +64,311 @@ void SpiInit()
 	SpiaRegs.SPICCR.bit.SPISWRESET = 1;  	//Step 3, Enable SPI
 	SpiaRegs.SPIPRI.bit.FREE = 1;
 }
+
+/**
+ * Set the SPI-A bit rate in kHz, after SpiInit. The rate comes from the
+ * low-speed clock, whose prescaler (LOSPCP) is left as it is; see LspClkPlan
+ * in the Clock Library for choosing it together with the SCI ports.
+ *
+ * @param fclk The system clock frequency in MHz, from getfclk
+ * @param baudrate The desired bit rate in kHz, at most LSPCLK/4
+ * @return How far the rate set is off: achieved / desired - 1
+ */
+float32 SetSpiBaudRate(float32 fclk, float32 baudrate) {
+	Uint16 lospcp = SysCtrlRegs.LOSPCP.bit.LSPCLK;
+	float32 lspclk = fclk*1000/(lospcp ? 2*lospcp : 1);//in kHz
+	Uint16 brr = SpiBrr(fclk, baudrate);//LSPCLK/(BRR + 1)
+
+	SpiaRegs.SPICCR.bit.SPISWRESET = 0;
+	SpiaRegs.SPIBRR = brr;
+	SpiaRegs.SPICCR.bit.SPISWRESET = 1;
+
+	return lspclk/(brr + 1)/baudrate - 1;
+}
+
+//Pins for SpiPortInit, in SPIPIN order: GPIO number and its GPxMUX setting
+static const Uint16 SpiPinGpio[14] = {16, 54, 5, 17, 55, 3, 18, 56, 12, 24, 13, 25, 14, 26};
+static const Uint16 SpiPinMux[14] = {1, 1, 2, 1, 1, 2, 1, 1, 3, 3, 3, 3, 3, 3};
+
+//Transfer queues, [0] for SPI-A and [1] for SPI-B. The head is the active transfer.
+static SPI_XFER* SpiHead[2];
+static SPI_XFER* SpiTail[2];
+static Uint16 SpiSent[2], SpiReceived[2];//words of the active transfer
+static char SpiRunning[2];//SpiRun is on the stack: SpiSubmit only queues
+
+static volatile struct SPI_REGS* SpiRegsOf(char spisys) {
+	switch (spisys) {
+		case 'A': return &SpiaRegs;
+		case 'B': return &SpibRegs;
+		default: return 0;
+	}
+}
+
+/**
+ * Hand a pin to a serial port: pull-up on, asynchronous input qualification
+ * (the data input needs it; it does no harm on the others) and the mux setting.
+ * Also used for the McBSP pins by mcbsp_spi.c.
+ */
+void SpiGpioInit(Uint16 gpio, Uint16 muxsel) {
+	Uint32 bit = 1UL << (gpio & 31);
+	Uint32 field = 3UL << 2*(gpio & 15);
+	Uint32 mux = (Uint32)muxsel << 2*(gpio & 15);
+
+	EALLOW;
+	if (gpio < 32) {
+		GpioCtrlRegs.GPAPUD.all &= ~bit;
+	} else {
+		GpioCtrlRegs.GPBPUD.all &= ~bit;
+	}
+	switch (gpio >> 4) {
+		case 0:
+			GpioCtrlRegs.GPAQSEL1.all |= field;
+			GpioCtrlRegs.GPAMUX1.all = (GpioCtrlRegs.GPAMUX1.all & ~field) | mux;
+			break;
+		case 1:
+			GpioCtrlRegs.GPAQSEL2.all |= field;
+			GpioCtrlRegs.GPAMUX2.all = (GpioCtrlRegs.GPAMUX2.all & ~field) | mux;
+			break;
+		case 2:
+			GpioCtrlRegs.GPBQSEL1.all |= field;
+			GpioCtrlRegs.GPBMUX1.all = (GpioCtrlRegs.GPBMUX1.all & ~field) | mux;
+			break;
+		case 3:
+			GpioCtrlRegs.GPBQSEL2.all |= field;
+			GpioCtrlRegs.GPBMUX2.all = (GpioCtrlRegs.GPBMUX2.all & ~field) | mux;
+			break;
+	}
+	EDIS;
+}
+
+/**
+ * Drive a chip select made with SpiCsInit.
+ */
+void SpiCsWrite(Uint16 gpio, Uint16 high) {
+	Uint32 bit = 1UL << (gpio & 31);
+
+	if (gpio < 32) {
+		if (high) GpioDataRegs.GPASET.all = bit;
+		else GpioDataRegs.GPACLEAR.all = bit;
+	} else {
+		if (high) GpioDataRegs.GPBSET.all = bit;
+		else GpioDataRegs.GPBCLEAR.all = bit;
+	}
+}
+
+/**
+ * Set a port up for SpiSubmit: pins, master mode with both FIFOs, and the RX
+ * FIFO interrupt (PIE group 6) with M_INT6 set in IER; interrupts still need
+ * EINT. Mode, clock and word length are set per transfer.
+ *
+ * @param spisys A or B
+ * @param simo, somi, clk Pins of that port
+ */
+void SpiPortInit(char spisys, SPIPIN simo, SPIPIN somi, SPIPIN clk) {
+	volatile struct SPI_REGS* regs = SpiRegsOf(spisys);
+	Uint16 i = spisys == 'B';
+
+	if (!regs) return;
+	EALLOW;
+	if (i) {
+		SysCtrlRegs.PCLKCR0.bit.SPIBENCLK = 1;
+	} else {
+		SysCtrlRegs.PCLKCR0.bit.SPIAENCLK = 1;
+	}
+	EDIS;
+	asm(" NOP");
+	asm(" NOP");
+
+	SpiGpioInit(SpiPinGpio[simo], SpiPinMux[simo]);
+	SpiGpioInit(SpiPinGpio[somi], SpiPinMux[somi]);
+	SpiGpioInit(SpiPinGpio[clk], SpiPinMux[clk]);
+
+	SpiHead[i] = SpiTail[i] = 0;
+	regs->SPICCR.all = 0x0007;//held in reset, 8-bit characters
+	regs->SPICTL.all = 0x0006;//master, talk, no SPIINT (the FIFO interrupt is used)
+	regs->SPIBRR = 127;
+	regs->SPIFFTX.all = 0xE040;//SPI out of reset, FIFOs enabled, TX FIFO running, no TX interrupt
+	regs->SPIFFRX.all = 0x6064;//RX FIFO running, overflow and interrupt cleared, interrupt at 4
+	regs->SPIFFCT.all = 0;//no delay between words
+	regs->SPIPRI.bit.FREE = 1;
+	regs->SPICCR.bit.SPISWRESET = 1;
+
+	EALLOW;
+	if (i) {
+		PieVectTable.SPIRXINTB = &SpibRxIsr;
+	} else {
+		PieVectTable.SPIRXINTA = &SpiaRxIsr;
+	}
+	EDIS;
+	PieCtrlRegs.PIECTRL.bit.ENPIE = 1;
+	if (i) {
+		PieCtrlRegs.PIEIER6.bit.INTx3 = 1;
+	} else {
+		PieCtrlRegs.PIEIER6.bit.INTx1 = 1;
+	}
+	IER |= M_INT6;
+}
+
+/**
+ * Make a GPIO a chip select: an output, driven high until a transfer selects it.
+ */
+void SpiCsInit(Uint16 gpio) {
+	Uint32 bit = 1UL << (gpio & 31);
+	Uint32 field = 3UL << 2*(gpio & 15);
+
+	SpiCsWrite(gpio, 1);
+	EALLOW;
+	switch (gpio >> 4) {
+		case 0: GpioCtrlRegs.GPAMUX1.all &= ~field; break;
+		case 1: GpioCtrlRegs.GPAMUX2.all &= ~field; break;
+		case 2: GpioCtrlRegs.GPBMUX1.all &= ~field; break;
+		case 3: GpioCtrlRegs.GPBMUX2.all &= ~field; break;
+	}
+	if (gpio < 32) {
+		GpioCtrlRegs.GPADIR.all |= bit;
+	} else {
+		GpioCtrlRegs.GPBDIR.all |= bit;
+	}
+	EDIS;
+}
+
+/**
+ * The SPIBRR for a bit rate, at the low-speed clock LOSPCP gives now.
+ *
+ * @param fclk The system clock frequency in MHz, from getfclk
+ * @param baudrate The desired bit rate in kHz; it is rounded to the nearest
+ * one possible, at most LSPCLK/4
+ */
+Uint16 SpiBrr(float32 fclk, float32 baudrate) {
+	Uint16 lospcp = SysCtrlRegs.LOSPCP.bit.LSPCLK;
+	float32 ideal = fclk*1000/(lospcp ? 2*lospcp : 1)/baudrate - 1;
+	return ideal < 3 ? 3 : ideal > 127 ? 127 : (Uint16)(ideal + 0.5f);
+}
+
+//Mode, clock and word length of the head transfer; selects its device.
+static void SpiSetup(Uint16 i, volatile struct SPI_REGS* regs) {
+	SPI_XFER* x = SpiHead[i];
+
+	regs->SPICCR.all = (regs->SPICCR.all & 0x0010) | (x->mode & 2 ? 0x0040 : 0) | ((x->bits - 1) & 0xF);//in reset
+	regs->SPICTL.bit.CLK_PHASE = !(x->mode & 1);//TI's phase 0 is CPHA = 1
+	regs->SPIBRR = x->brr;
+	regs->SPICCR.bit.SPISWRESET = 1;
+
+	SpiSent[i] = 0;
+	SpiReceived[i] = 0;
+	x->status = SPI_ACTIVE;
+	if (x->cs != SPI_NO_CS) SpiCsWrite(x->cs, 0);
+}
+
+/*
+ * Moves the head transfer along: collects what has arrived and keeps up to
+ * four words in flight, which is as many as the RX FIFO can take. While more
+ * remain to be sent the interrupt comes after two, so the FIFO is topped up
+ * before the bus runs dry.
+ * @return 1 once every word has been received, 0 to wait for the interrupt.
+ */
+static char SpiPump(Uint16 i, volatile struct SPI_REGS* regs) {
+	SPI_XFER* x = SpiHead[i];
+	Uint16 shift = 16 - x->bits;
+	Uint16 mask = 0xFFFF >> shift;
+	Uint16 level;
+
+	while (1) {
+		while (regs->SPIFFRX.bit.RXFFST && SpiReceived[i] < x->length) {
+			Uint16 word = regs->SPIRXBUF & mask;
+			if (x->rx) x->rx[SpiReceived[i]] = word;
+			SpiReceived[i]++;
+		}
+		if (SpiReceived[i] == x->length) return 1;
+
+		while (SpiSent[i] < x->length && SpiSent[i] - SpiReceived[i] < 4) {
+			regs->SPITXBUF = (x->tx ? x->tx[SpiSent[i]] : 0xFFFF) << shift;//left-justified
+			SpiSent[i]++;
+		}
+		level = SpiSent[i] < x->length ? 2 : SpiSent[i] - SpiReceived[i];
+		regs->SPIFFRX.bit.RXFFIL = level;
+		regs->SPIFFRX.bit.RXFFINTCLR = 1;
+		if (regs->SPIFFRX.bit.RXFFST < level) return 0;
+	}
+}
+
+//Runs transfers until one has to wait for the bus. INT6 masked or in the ISR.
+static void SpiRun(Uint16 i, volatile struct SPI_REGS* regs) {
+	SpiRunning[i] = 1;
+	while (SpiHead[i] && SpiPump(i, regs)) {
+		SPI_XFER* x = SpiHead[i];
+
+		if (x->cs != SPI_NO_CS) SpiCsWrite(x->cs, 1);
+		SpiHead[i] = x->next;
+		if (!SpiHead[i]) SpiTail[i] = 0;
+		x->next = 0;
+		x->status = SPI_DONE;
+		if (x->done) x->done(x);//may submit more
+		if (SpiHead[i]) SpiSetup(i, regs);
+	}
+	SpiRunning[i] = 0;
+}
+
+/**
+ * Queue a transfer behind any already on the port; it starts at once if the
+ * port is idle. Never waits. The descriptor and its buffers must stay put
+ * until its status is SPI_DONE. Safe to call from done.
+ *
+ * @param spisys A or B, set up with SpiPortInit
+ * @return 1 if queued, 0 if xfer is already queued or active, or not valid.
+ */
+char SpiSubmit(char spisys, SPI_XFER* xfer) {
+	volatile struct SPI_REGS* regs = SpiRegsOf(spisys);
+	Uint16 i = spisys == 'B';
+	Uint16 ier6;
+
+	if (!regs || xfer->bits < 1 || xfer->bits > 16) return 0;
+	ier6 = IER & M_INT6;
+	IER &= ~M_INT6;
+	if (xfer->status == SPI_QUEUED || xfer->status == SPI_ACTIVE) {
+		IER |= ier6;
+		return 0;
+	}
+	xfer->status = SPI_QUEUED;
+	xfer->next = 0;
+	if (SpiTail[i]) {
+		SpiTail[i]->next = xfer;
+		SpiTail[i] = xfer;
+	} else {
+		SpiHead[i] = SpiTail[i] = xfer;
+		if (!SpiRunning[i]) {
+			SpiSetup(i, regs);
+			SpiRun(i, regs);
+		}
+	}
+	IER |= ier6;
+	return 1;
+}
+
+/**
+ * @return 1 while the port has a transfer active or queued.
+ */
+char SpiBusy(char spisys) {
+	return SpiHead[spisys == 'B'] != 0;
+}
+
+/**
+ * SPI-A and SPI-B RX FIFO ISRs, registered by SpiPortInit.
+ */
+__interrupt void SpiaRxIsr(void) {
+	if (SpiHead[0]) {
+		SpiRun(0, &SpiaRegs);
+	} else {
+		SpiaRegs.SPIFFRX.bit.RXFFINTCLR = 1;
+	}
+	PieCtrlRegs.PIEACK.all = PIEACK_GROUP6;
+}
+
+__interrupt void SpibRxIsr(void) {
+	if (SpiHead[1]) {
+		SpiRun(1, &SpibRegs);
+	} else {
+		SpibRegs.SPIFFRX.bit.RXFFINTCLR = 1;
+	}
+	PieCtrlRegs.PIEACK.all = PIEACK_GROUP6;
+}
@@ -2,5 +2,64 @@
 #define SPI_H
 
 void SpiInit(void);
+float32 SetSpiBaudRate(float32 fclk, float32 baudrate);
+
+/*
+ * Transaction engine for SPI-A and SPI-B. Each transfer is a SPI_XFER the
+ * caller owns: chip select, mode, clock, word length and buffers. SpiSubmit
+ * queues it and returns; the RX FIFO interrupt streams it through the 4-level
+ * FIFOs and starts the next queued transfer as soon as one ends, so devices
+ * with different modes and clocks share a port without the CPU waiting on
+ * any of them.
+ *
+ *	SpiPortInit('A', Asimo16, Asomi17, Aclk18);
+ *	SpiCsInit(19);
+ *	EINT;
+ *
+ *	static Uint16 cmd[2] = {0x02, 0x00}, reply[2];
+ *	static SPI_XFER read_id = {19, 3, 0, 8, cmd, reply, 2, 0};
+ *	read_id.brr = SpiBrr(getfclk(), 1000);	//1 MHz
+ *	SpiSubmit('A', &read_id);
+ *	...
+ *	if (read_id.status == SPI_DONE) ...		//or use done, called from the ISR
+ */
+typedef enum {
+    Asimo16,	Asimo54,	Asimo5,
+    Asomi17,	Asomi55,	Asomi3,
+    Aclk18,		Aclk56,
+    Bsimo12,	Bsimo24,
+    Bsomi13,	Bsomi25,
+    Bclk14,		Bclk26
+} SPIPIN;
+
+#define SPI_NO_CS 0xFFFF//cs for a transfer that drives no chip select
+
+#define SPI_IDLE	0//never submitted
+#define SPI_QUEUED	1
+#define SPI_ACTIVE	2
+#define SPI_DONE	3
+
+typedef struct SPI_XFER {
+	Uint16 cs;			//GPIO held low for the whole transfer (SpiCsInit), or SPI_NO_CS
+	Uint16 mode;		//SPI mode 0-3: CPOL << 1 | CPHA
+	Uint16 brr;			//SPIBRR, from SpiBrr
+	Uint16 bits;		//character length, 1-16
+	const Uint16* tx;	//length words to send, right-justified; 0 sends all ones
+	Uint16* rx;			//length words received, or 0 to throw them away
+	Uint16 length;
+	void (*done)(struct SPI_XFER* xfer);//called from the ISR once the chip select is released, or 0
+	volatile Uint16 status;//SPI_IDLE/QUEUED/ACTIVE/DONE, kept by the driver; start at SPI_IDLE
+	struct SPI_XFER* next;//kept by the driver
+} SPI_XFER;
+
+void SpiPortInit(char spisys, SPIPIN simo, SPIPIN somi, SPIPIN clk);
+void SpiCsInit(Uint16 gpio);
+void SpiCsWrite(Uint16 gpio, Uint16 high);
+void SpiGpioInit(Uint16 gpio, Uint16 muxsel);
+Uint16 SpiBrr(float32 fclk, float32 baudrate);
+char SpiSubmit(char spisys, SPI_XFER* xfer);
+char SpiBusy(char spisys);
+__interrupt void SpiaRxIsr(void);
+__interrupt void SpibRxIsr(void);
 
 #endif
@@ -274,20 +274,20 @@ void DMP_get_raw_gyro(int16 data[], Uint16 packet[]) {
  */
 int initialize_DMP() {
 	// Trigger a full device reset:
-	i2c_write_bit(MPU6050_ADDRESS, MPU6050_RA_PWR_MGMT_1, MPU6050_PWR1_DEVICE_RESET_BIT, true);
+	write_MPU_bit(MPU6050_RA_PWR_MGMT_1, MPU6050_PWR1_DEVICE_RESET_BIT, true);
 	Uint16 counter = 0;
 	while(counter < 30000) counter++; // Wait a bit
 
 	//Disable sleep mode
-	i2c_write_bit(MPU6050_ADDRESS, MPU6050_RA_PWR_MGMT_1, MPU6050_PWR1_SLEEP_BIT, false);
+	write_MPU_bit(MPU6050_RA_PWR_MGMT_1, MPU6050_PWR1_SLEEP_BIT, false);
 	// Setting slave 0 address:
-	i2c_write_byte(MPU6050_ADDRESS, MPU6050_RA_I2C_SLV0_ADDR, 0x7F);
+	write_MPU_byte(MPU6050_RA_I2C_SLV0_ADDR, 0x7F);
 	// Disabling I2C Master mode...
-	i2c_write_bit(MPU6050_ADDRESS, MPU6050_RA_USER_CTRL, MPU6050_USERCTRL_I2C_MST_EN_BIT, false);
+	write_MPU_bit(MPU6050_RA_USER_CTRL, MPU6050_USERCTRL_I2C_MST_EN_BIT, false);
 	// Set Slave 0 address to 0x68 (Self)
-	i2c_write_byte(MPU6050_ADDRESS, MPU6050_RA_I2C_SLV0_ADDR, 0x68);
+	write_MPU_byte(MPU6050_RA_I2C_SLV0_ADDR, 0x68);
 	// Resetting I2c Master control...
-	i2c_write_bit(MPU6050_ADDRESS, MPU6050_RA_USER_CTRL, MPU6050_USERCTRL_I2C_MST_RESET_BIT, true);
+	write_MPU_bit(MPU6050_RA_USER_CTRL, MPU6050_USERCTRL_I2C_MST_RESET_BIT, true);
 	counter = 0;
 	while(counter < 30000) counter++; // Wait a bit
 
@@ -295,25 +295,25 @@ int initialize_DMP() {
 		// Now, write DMP configuration.
 		if (write_DMP_configuration(dmpConfig, MPU6050_DMP_CONFIG_SIZE)) {
 			// Set clock source to Z-accelerometer:
-			i2c_write_bits(MPU6050_ADDRESS, MPU6050_RA_PWR_MGMT_1, MPU6050_PWR1_CLKSEL_BIT, MPU6050_PWR1_CLKSEL_LENGTH, MPU6050_CLOCK_PLL_ZGYRO);
+			write_MPU_bits(MPU6050_RA_PWR_MGMT_1, MPU6050_PWR1_CLKSEL_BIT, MPU6050_PWR1_CLKSEL_LENGTH, MPU6050_CLOCK_PLL_ZGYRO);
 			// Enable DMP and FIFO_OFLOW interrupts:
-			i2c_write_byte(MPU6050_ADDRESS, MPU6050_RA_INT_ENABLE, 0x12);
+			write_MPU_byte(MPU6050_RA_INT_ENABLE, 0x12);
 
 			// Set sample rate to 200Hz.
-			i2c_write_byte(MPU6050_ADDRESS, MPU6050_RA_SMPLRT_DIV, 4);
+			write_MPU_byte(MPU6050_RA_SMPLRT_DIV, 4);
 			// Set external frame sync to TEMP_OUT_L[0]
-			i2c_write_bits(MPU6050_ADDRESS, MPU6050_RA_CONFIG, MPU6050_CFG_EXT_SYNC_SET_BIT, MPU6050_CFG_EXT_SYNC_SET_LENGTH, MPU6050_EXT_SYNC_TEMP_OUT_L);
+			write_MPU_bits(MPU6050_RA_CONFIG, MPU6050_CFG_EXT_SYNC_SET_BIT, MPU6050_CFG_EXT_SYNC_SET_LENGTH, MPU6050_EXT_SYNC_TEMP_OUT_L);
 			// Set DLPF bandwidth to 42Hz...
-			i2c_write_bits(MPU6050_ADDRESS, MPU6050_RA_CONFIG, MPU6050_CFG_DLPF_CFG_BIT, MPU6050_CFG_DLPF_CFG_LENGTH, MPU6050_DLPF_BW_42);
+			write_MPU_bits(MPU6050_RA_CONFIG, MPU6050_CFG_DLPF_CFG_BIT, MPU6050_CFG_DLPF_CFG_LENGTH, MPU6050_DLPF_BW_42);
 			//Scale of 500 degrees/sec full scale range.
-			i2c_write_bits(MPU6050_ADDRESS, MPU6050_RA_GYRO_CONFIG, MPU6050_GCONFIG_FS_SEL_BIT, MPU6050_GCONFIG_FS_SEL_LENGTH, MPU6050_GYRO_FS_500);
+			write_MPU_bits(MPU6050_RA_GYRO_CONFIG, MPU6050_GCONFIG_FS_SEL_BIT, MPU6050_GCONFIG_FS_SEL_LENGTH, MPU6050_GYRO_FS_500);
 			//Scale of +/-4g, no DHPF
-			i2c_write_byte(MPU6050_ADDRESS, MPU6050_RA_ACCEL_CONFIG, 0x08);
+			write_MPU_byte(MPU6050_RA_ACCEL_CONFIG, 0x08);
 			// Set DMP config bytes:
-			i2c_write_byte(MPU6050_ADDRESS, MPU6050_RA_DMP_CFG_1, 0x03);
-			i2c_write_byte(MPU6050_ADDRESS, MPU6050_RA_DMP_CFG_2, 0x00);
+			write_MPU_byte(MPU6050_RA_DMP_CFG_1, 0x03);
+			write_MPU_byte(MPU6050_RA_DMP_CFG_2, 0x00);
 			// Clearing OTP bank flag:
-			i2c_write_bit(MPU6050_ADDRESS, MPU6050_RA_XG_OFFS_TC, MPU6050_TC_OTP_BNK_VLD_BIT, false);
+			write_MPU_bit(MPU6050_RA_XG_OFFS_TC, MPU6050_TC_OTP_BNK_VLD_BIT, false);
 
 			// Set gyroscope and accelerometer offsets:
 			set_MPU_gyro_offsets(-46, -15, 21); // In thousandths of deg/sec
@@ -333,23 +333,23 @@ int initialize_DMP() {
 			write_MPU_memory_block(dmpUpdate + 3, (Uint16) dmpUpdate[2], (Uint16) dmpUpdate[0], (Uint16) dmpUpdate[1], true, true);
 
 			// Reset FIFO:
-			i2c_write_bit(MPU6050_ADDRESS, MPU6050_RA_USER_CTRL, MPU6050_USERCTRL_FIFO_RESET_BIT, true);
+			write_MPU_bit(MPU6050_RA_USER_CTRL, MPU6050_USERCTRL_FIFO_RESET_BIT, true);
 			// Set motion detection threshold:
-			i2c_write_byte(MPU6050_ADDRESS, MPU6050_RA_MOT_THR, 2);
+			write_MPU_byte(MPU6050_RA_MOT_THR, 2);
 			// Set zero-motion detection threshold:
-			i2c_write_byte(MPU6050_ADDRESS, MPU6050_RA_ZRMOT_THR, 2);
+			write_MPU_byte(MPU6050_RA_ZRMOT_THR, 2);
 			// Set motion detection duration:
-			i2c_write_byte(MPU6050_ADDRESS, MPU6050_RA_MOT_DUR, 10);
+			write_MPU_byte(MPU6050_RA_MOT_DUR, 10);
 			// Set zero motion detection duration to 0:
-			i2c_write_byte(MPU6050_ADDRESS, MPU6050_RA_ZRMOT_DUR, 10);
+			write_MPU_byte(MPU6050_RA_ZRMOT_DUR, 10);
 			// Reset FIFO again:
-			i2c_write_bit(MPU6050_ADDRESS, MPU6050_RA_USER_CTRL, MPU6050_USERCTRL_FIFO_RESET_BIT, true);
+			write_MPU_bit(MPU6050_RA_USER_CTRL, MPU6050_USERCTRL_FIFO_RESET_BIT, true);
 			// Set FIFO enabled:
-			i2c_write_bit(MPU6050_ADDRESS, MPU6050_RA_USER_CTRL, MPU6050_USERCTRL_FIFO_EN_BIT, true);
+			write_MPU_bit(MPU6050_RA_USER_CTRL, MPU6050_USERCTRL_FIFO_EN_BIT, true);
 			// Enable DMP:
-			i2c_write_bit(MPU6050_ADDRESS, MPU6050_RA_USER_CTRL, MPU6050_USERCTRL_DMP_EN_BIT, true);
+			write_MPU_bit(MPU6050_RA_USER_CTRL, MPU6050_USERCTRL_DMP_EN_BIT, true);
 			// Reset DMP:
-			i2c_write_bit(MPU6050_ADDRESS, MPU6050_RA_USER_CTRL, MPU6050_USERCTRL_DMP_RESET_BIT, true);
+			write_MPU_bit(MPU6050_RA_USER_CTRL, MPU6050_USERCTRL_DMP_RESET_BIT, true);
 
 			// Write memory update 3/7:
 			for (j = 0; j < 4 || j < dmpUpdate[2] + 3; j++, pos++)
@@ -376,11 +376,11 @@ int initialize_DMP() {
 
 			while( get_FIFO_count() < 512 ); // Wait for FIFO count to be >= 512.
 			// Disable DMP:
-			i2c_write_bit(MPU6050_ADDRESS, MPU6050_RA_USER_CTRL, MPU6050_USERCTRL_DMP_EN_BIT, false);
+			write_MPU_bit(MPU6050_RA_USER_CTRL, MPU6050_USERCTRL_DMP_EN_BIT, false);
 			// Reset FIFO again:
-			i2c_write_bit(MPU6050_ADDRESS, MPU6050_RA_USER_CTRL, MPU6050_USERCTRL_FIFO_RESET_BIT, true);
+			write_MPU_bit(MPU6050_RA_USER_CTRL, MPU6050_USERCTRL_FIFO_RESET_BIT, true);
 			// Enable DMP:
-			i2c_write_bit(MPU6050_ADDRESS, MPU6050_RA_USER_CTRL, MPU6050_USERCTRL_DMP_EN_BIT, true);
+			write_MPU_bit(MPU6050_RA_USER_CTRL, MPU6050_USERCTRL_DMP_EN_BIT, true);
 		}
 		else {
 			return false;
@@ -3,11 +3,104 @@
  *
  * @date Nov 11, 2013
  */
+#define LOG_FILE 1
 #include "I2CFuncs.h"
+#include "F2806x_usDelay.h"
+#include "logging.h"
+
+#define I2C_TIMEOUT_US 20000UL//far longer than any transfer: a 42-byte read takes about 1.1 ms at 400 kHz
+
+//I2CSTR/I2CIER bits and I2CISRC codes
+#define I2C_ARBL	0x0001
+#define I2C_NACK	0x0002
+#define I2C_ARDY	0x0004
+#define I2C_RRDY	0x0008
+#define I2C_XRDY	0x0010
+#define I2C_SCD		0x0020
+#define I2C_BB		0x1000
+#define I2C_ARBL_CODE	1
+#define I2C_NACK_CODE	2
+#define I2C_ARDY_CODE	3
+#define I2C_RRDY_CODE	4
+#define I2C_XRDY_CODE	5
+#define I2C_SCD_CODE	6
+//I2CFFTX/I2CFFRX bits
+#define I2C_I2CFFEN		0x4000
+#define I2C_TXFFRST		0x2000
+#define I2C_TXFFINTCLR	0x0040
+#define I2C_TXFFIENA	0x0020
+#define I2C_RXFFRST		0x2000
+#define I2C_RXFFINTCLR	0x0040
+#define I2C_RXFFIENA	0x0020
+//I2CMDR bits
+#define I2C_MST		0x0400
+#define I2C_STP		0x0800
+
+#define I2C_WRITE_TRIES 3//a write the slave NACKs is sent at most this many times
+
+static I2C_XFER* i2c_head;
+static I2C_XFER* i2c_tail;
+static char i2c_running;//a done callback is on the stack: i2c_submit only queues
+static Uint16 i2c_moved;//data bytes of the head transfer written or read
+static Uint16 i2c_result;//status the head transfer gets at its STOP
+static char i2c_reg_phase;//the head is a read still sending its register address
+static char i2c_queue_on;//i2c_queue_init has been called: i2c_read uses the queue
+
+I2C_BENCH i2c_bench;
+static char i2c_bench_on;
+static Uint32 i2c_bench_began;//CpuTimer1 when the head transfer started
+static Uint32 i2c_bench_skip;//cycles spent in done callbacks during this ISR
+
+/*
+ * Submits xfer, which lives on the caller's stack, and waits for it. Each
+ * I2C_TIMEOUT_US without it finishing fails whichever transfer holds the bus,
+ * so xfer has always left the queue on return, even with INT8 masked.
+ * Returns its final status, I2C_XFER_IDLE if it couldn't be queued.
+ */
+static Uint16 i2c_submit_wait(I2C_XFER* xfer)
+{
+	Uint32 waited = 0;
+
+	if (i2c_running) {
+		// From a done callback the queue can't move until we return.
+		LOG0("I2C transfer waited on from a done callback, use i2c_submit");
+		return I2C_XFER_IDLE;
+	}
+	if (!i2c_submit(xfer)) return I2C_XFER_IDLE;
+	while (xfer->status < I2C_XFER_DONE) {
+		if (++waited == I2C_TIMEOUT_US) {
+			i2c_cancel();
+			waited = 0;
+		}
+		DELAY_US(1);
+	}
+	return xfer->status;
+}
+
+/// @brief Polled transfers: waits up to I2C_TIMEOUT_US for (*reg & mask) == value.
+static int i2c_poll(volatile Uint16* reg, Uint16 mask, Uint16 value)
+{
+	Uint32 waited;
 
+	for (waited = 0; (*reg & mask) != value; waited++) {
+		if (waited == I2C_TIMEOUT_US) return 0;
+		DELAY_US(1);
+	}
+	return 1;
+}
+
+/// @brief A polled transfer's wait ran out: resets the module, which lets go of the bus.
+static Uint16 i2c_timed_out(void)
+{
+	I2caRegs.I2CMDR.all = 0; // Reset I2C.
+	I2CA_Init();
+	LOG0("I2C timed out, module reset");
+	return I2C_XFER_FAILED;
+}
 
 /**
  * @brief Use this to write multiple BITS sequentially on a register.
+ @note Reads the register first; for the MPU6050 use write_MPU_bits, which remembers it.
  @note This function CANNOT write more than one byte!
  @details bitStart is the nth bit from the leftmost bit of the register, bit 0.
   length is the number of bits to write, must be <= 8. Measured from the rightmost bit of the data byte.
@@ -15,33 +108,12 @@
   be left-padded with zeros, up to (length), on the register(s).
 */
 int i2c_write_bits(Uint16 slave_address, Uint16 register_address, Uint16 bitStart, Uint16 length, Uint16 data) {
-	Uint16 orig[3] = { 0, 0, 0 };
-	i2c_read(slave_address, register_address, 1, orig);
-	Uint16 tempStore = orig[0];
-
-	//puts("Original:");
-	//printBytes(orig[0], 0);
-	//char string[32];
-	//sprintf(string, "Start:%d Length:%d", bitStart, length);
-	//puts(string);
-	//printBytes(data, 0);
-
-	short bytebits[8];
-	short i;
-	for (i = 0; i <= 7; i++) {
-		bytebits[i] = getBitFromByte(tempStore, 7 - i);
-	}
-
-	data <<= 8 - length; // Cut zeros in front of data.
-	for (i = 0; i < length; i++)
-		bytebits[7 - bitStart + i] = getBitFromByte(data, 7 - i);
-
-	Uint16 finalByte = 128 * bytebits[0] + 64 * bytebits[1] + 32 * bytebits[2]
-			+ 16 * bytebits[3] + 8 * bytebits[4] + 4 * bytebits[5]
-			+ 2 * bytebits[6] + bytebits[7];
+	Uint16 orig[1] = { 0 };
+	Uint16 shift = bitStart + 1 - length;
+	Uint16 mask = ((1 << length) - 1) << shift;
 
-	//puts("Final");
-	//printBytes(finalByte, 0);
+	if (!i2c_read(slave_address, register_address, 1, orig)) return 0;
+	Uint16 finalByte = (orig[0] & ~mask) | ((data << shift) & mask);
 
 	// Save modified bit:
 	return i2c_write_byte(slave_address, register_address, finalByte);
@@ -58,18 +130,16 @@ int i2c_write_byte(Uint16 Slave_address, Uint16 Start_address, Uint16 databyte)
 	return i2c_write(Slave_address, Start_address, 1, b);
 }
 
-/**
-@brief I2C_Write
-@details Return Type: void
- Arguments: Uint16 Slave_address, Uint16 Start_address, Uint16 No_of_databytes, Uint16 Write_Array[]
- Description: I2C Write Driver. Pass Slave Address, Write location, No of databytes and the array with data.'
- Returns 0 if unsuccessful, 1 if successful.
-*/
-int i2c_write(Uint16 Slave_address, Uint16 Start_address, Uint16 no_databytes, Uint16 databytes[])
+/*
+ * One polled write, for before i2c_queue_init. Returns I2C_XFER_DONE,
+ * I2C_XFER_NACKED if the slave didn't acknowledge the register address, or
+ * I2C_XFER_FAILED.
+ */
+static Uint16 i2c_write_polled(Uint16 Slave_address, Uint16 Start_address, Uint16 no_databytes, const Uint16 databytes[])
 {
 	I2caRegs.I2CSAR = Slave_address;
 	//puts("write");
-	while(I2caRegs.I2CMDR.bit.STP != 0);
+	if (!i2c_poll(&I2caRegs.I2CMDR.all, I2C_STP, 0)) return i2c_timed_out();
 
 	// Start bit, write mode, Higher 16 address bits, Master, Repeat mode.
 	//I2caRegs.I2CMDR.bit.TRX = TRANSMIT_MESSAGE; Where is TRANSMIT_MESSAGE defined?????? ERROR!
@@ -81,8 +151,9 @@ int i2c_write(Uint16 Slave_address, Uint16 Start_address, Uint16 no_databytes, U
 	}*/
 	//##################################################//
 
-	while (I2caRegs.I2CSTR.bit.BB != 0) {
+	if (!i2c_poll(&I2caRegs.I2CSTR.all, I2C_BB, 0)) {
 		//puts ("I2C bus is busy, cannot proceed. Could be caused by noise.");
+		return i2c_timed_out();
 	}
 
 	I2caRegs.I2CMDR.all = 0x26A0; // 0010 0110 1010 0000
@@ -101,49 +172,44 @@ int i2c_write(Uint16 Slave_address, Uint16 Start_address, Uint16 no_databytes, U
 	// Sets FDF to 0: free data format mode DISABLED, transfers are using standard addressing format selected by XA bit.
 	// Sets BC to 000: 8 bits per data byte, in the next data byte that is to be transmitted or received by the I2C module
 
-	while(I2caRegs.I2CSTR.bit.ARBL != 0) {
+	if (!i2c_poll(&I2caRegs.I2CSTR.all, I2C_ARBL, 0)) {
 		//puts("Arbitration Problem/Noise on line!"); // The I2C believes there is another master attempting to transmit at this time!
+		return i2c_timed_out();
 	}
 
 	//(Lower 16) address bits
-	while(I2caRegs.I2CSTR.bit.ARDY != 1) {
+	if (!i2c_poll(&I2caRegs.I2CSTR.all, I2C_ARDY, I2C_ARDY)) {
 		//puts("I2C registers are not ready to be accessed." );
+		return i2c_timed_out();
 	}
 
 	if (I2caRegs.I2CSTR.bit.ARDY == 1)
 	{
 		I2caRegs.I2CDXR = Start_address; // Send start address.
 	}
-	while (I2caRegs.I2CSTR.bit.NACK == 1) {
+	if (I2caRegs.I2CSTR.bit.NACK == 1) {
 		//puts("Sent address was not acknowledged! NACK (no acknowledgment bit received)! Aborting write...");
 
 		I2caRegs.I2CMDR.all = 0x0EA0; // 0000 1110 1010 0000
-					// Send stop condition.
-					// Set master mode, transmitter mode
-					// Enable repeat mode, enable i2c
-
-					while(I2caRegs.I2CSTR.bit.SCD != 1) {
-						//puts("Stop condition not detected yet...");
-					}
-					I2caRegs.I2CSTR.bit.SCD = 1; // Clear stop condition
+		// Send stop condition.
+		// Set master mode, transmitter mode
+		// Enable repeat mode, enable i2c
 
-					while (I2caRegs.I2CMDR.bit.MST != 0); // Wait for stop condition to be accepted.
+		if (!i2c_poll(&I2caRegs.I2CSTR.all, I2C_SCD, I2C_SCD)) return i2c_timed_out();
+		I2caRegs.I2CSTR.bit.SCD = 1; // Clear stop condition
+		I2caRegs.I2CSTR.bit.NACK = 1; // Clear NACK for the next try.
 
-	//				I2caRegs.I2CMDR.all = 0; // Reset I2C.
-	//	I2CA_Init();
-		puts("Write error 0, retrying!");
-
-
-		i2c_write(Slave_address, Start_address, no_databytes, databytes);
-		return 0;
+		if (!i2c_poll(&I2caRegs.I2CMDR.all, I2C_MST, 0)) return i2c_timed_out(); // Wait for stop condition to be accepted.
+		return I2C_XFER_NACKED; // i2c_write tries again.
 	}
 	//puts("Send address was acknowledged.");
 
 	Uint16 i = 0;
 	for(i = 0; i < no_databytes; i++) {
 		// Transmit data byte:
-		while(I2caRegs.I2CSTR.bit.ARDY != 1 || I2caRegs.I2CSTR.bit.XRDY != 1) {
+		if (!i2c_poll(&I2caRegs.I2CSTR.all, I2C_ARDY | I2C_XRDY, I2C_ARDY | I2C_XRDY)) {
 			//puts("I2C transmit registers are not ready.");
+			return i2c_timed_out();
 		}
 		// DSP28x_usDelay(5000);
 		if (I2caRegs.I2CSTR.bit.ARDY == 1)
@@ -156,8 +222,8 @@ int i2c_write(Uint16 Slave_address, Uint16 Start_address, Uint16 no_databytes, U
 			//puts("NACK bit received in transmit! Aborting transmit...");
 			I2caRegs.I2CSTR.bit.NACK = 1; // Reset NACK bit.
 			I2caRegs.I2CMDR.all = 0; // Reset I2C.
-			puts("Write Error 1");
-			return 0;
+			I2CA_Init();
+			return I2C_XFER_NACKED;
 		}
 		// Done transmitting.
 	}
@@ -167,12 +233,46 @@ int i2c_write(Uint16 Slave_address, Uint16 Start_address, Uint16 no_databytes, U
 	// Set master mode, transmitter mode
 	// Enable repeat mode, enable i2c
 
-	while(I2caRegs.I2CSTR.bit.SCD != 1) {
+	if (!i2c_poll(&I2caRegs.I2CSTR.all, I2C_SCD, I2C_SCD)) {
 		//puts("Stop condition not detected yet...");
+		return i2c_timed_out();
 	}
 	I2caRegs.I2CSTR.bit.SCD = 1; // Clear stop condition
 
-	while (I2caRegs.I2CMDR.bit.MST != 0); // Wait for stop condition to be accepted.
+	if (!i2c_poll(&I2caRegs.I2CMDR.all, I2C_MST, 0)) return i2c_timed_out(); // Wait for stop condition to be accepted.
+	return I2C_XFER_DONE;
+}
+
+/**
+@brief I2C_Write
+@details Return Type: int
+ Arguments: Uint16 Slave_address, Uint16 Start_address, Uint16 No_of_databytes, Uint16 Write_Array[]
+ Description: I2C Write Driver. Pass Slave Address, Write location, No of databytes and the array with data.'
+ Once i2c_queue_init has been called the write goes through the queue, like i2c_read. A write the
+ slave doesn't acknowledge is tried up to I2C_WRITE_TRIES times.
+ Returns 0 if unsuccessful, 1 if successful.
+*/
+int i2c_write(Uint16 Slave_address, Uint16 Start_address, Uint16 no_databytes, Uint16 databytes[])
+{
+	Uint16 status = I2C_XFER_NACKED;
+	Uint16 tries;
+
+	for (tries = 0; tries < I2C_WRITE_TRIES && status == I2C_XFER_NACKED; tries++) {
+		if (i2c_queue_on) {
+			I2C_XFER xfer = { 0 };
+			xfer.address = Slave_address;
+			xfer.reg = Start_address;
+			xfer.tx = databytes;
+			xfer.length = no_databytes;
+			status = i2c_submit_wait(&xfer);
+		} else {
+			status = i2c_write_polled(Slave_address, Start_address, no_databytes, databytes);
+		}
+	}
+	if (status != I2C_XFER_DONE) {
+		LOG2("I2C write error %u after %u tries", status, tries);
+		return 0;
+	}
 	return 1;
 }
 
@@ -185,13 +285,29 @@ int i2c_read_bit(Uint16 slave_address, Uint16 register_address, short bitNum) {
 
 /**
 @brief I2C_Read
-@details Function Name: void I2C_Read
- Return Type: void
+@details Function Name: int I2C_Read
+ Return Type: int
  Arguments: Uint16 Slave_address, Uint16 Start_address, Uint16 No_of_databytes, Uint16 Read_Array[]
  Description: I2C Read Driver. Pass Slave Address, Write location, No of databytes, Array where received will be copied.
+ Returns 0 if unsuccessful, 1 if successful.
 */
-void i2c_read(Uint16 Slave_address, Uint16 Start_address, Uint16 No_of_databytes, Uint16 Read_Array[])
+int i2c_read(Uint16 Slave_address, Uint16 Start_address, Uint16 No_of_databytes, Uint16 Read_Array[])
 {
+	if (i2c_queue_on) {
+		// Queue it and wait: the bytes stream through the FIFO under interrupts.
+		I2C_XFER xfer = { 0 };
+		Uint16 status;
+		xfer.address = Slave_address;
+		xfer.reg = Start_address;
+		xfer.rx = Read_Array;
+		xfer.length = No_of_databytes;
+		status = i2c_submit_wait(&xfer);
+		if (status != I2C_XFER_DONE) {
+			LOG1("I2C read error %u", status);
+			return 0;
+		}
+		return 1;
+	}
 	I2caRegs.I2CSAR = Slave_address; // This stores the next slave address that
 									 // will be transmitted to by the I2C module.
 	I2caRegs.I2CCNT = No_of_databytes; // When operating in non repeat mode, this
@@ -205,12 +321,16 @@ void i2c_read(Uint16 Slave_address, Uint16 Start_address, Uint16 No_of_databytes
 	// Clearing of this bit by the module is delayed until after the SCD bit is
 	// set. If this bit is not checked prior to initiating a new message, the
 	// I2C could get confused.
-	while (I2caRegs.I2CMDR.bit.STP != 0) {//this should be 0
+	if (!i2c_poll(&I2caRegs.I2CMDR.all, I2C_STP, 0)) {//this should be 0
 		//puts("Waiting to clear stop bit...");
+		i2c_timed_out();
+		return 0;
 	}
 
-	while (I2caRegs.I2CSTR.bit.BB != 0) {
+	if (!i2c_poll(&I2caRegs.I2CSTR.all, I2C_BB, 0)) {
 		//puts ("I2C bus is busy, cannot proceed. Could be caused by noise.");
+		i2c_timed_out();
+		return 0;
 	}
 
 	// Start bit, write mode, Higher 16 address bits, Master, Non Repeat mode.
@@ -242,24 +362,10 @@ void i2c_read(Uint16 Slave_address, Uint16 Start_address, Uint16 No_of_databytes
 	// Sets FDF to 0: free data format mode DISABLED, transfers are using standard addressing format selected by XA bit.
 	// Sets BC to 000: 8 bits per data byte, in the next data byte that is to be transmitted or received by the I2C module
 
-	Uint16 ARDY_wait = 0;
-	while(I2caRegs.I2CSTR.bit.ARDY != 1) { // When ARDY is 0, the I2C module registers are NOT ready to be accessed. 1 means they are.
-		ARDY_wait++;
-		if (ARDY_wait > 65000) {
-			// Timeout.
-			I2caRegs.I2CSTR.bit.ARDY = 1; // Clear ARDY.
-			// Manually send a stop signal.
-			I2caRegs.I2CMDR.bit.STP = 1;
-			I2caRegs.I2CMDR.all = 0; // Reset module.
-			I2CA_Init(); // Re-initialize module.
-			// Wait a bit.
-			Uint16 counter = 0;
-			while(counter < 30000) counter++; // Wait a bit
-			//puts("I2C registers are not ready to be accessed." );
-			puts("Read Error 0!");
-			//i2c_read(Slave_address, Start_address, No_of_databytes, Read_Array);
-			return;
-		}
+	if (!i2c_poll(&I2caRegs.I2CSTR.all, I2C_ARDY, I2C_ARDY)) { // When ARDY is 0, the I2C module registers are NOT ready to be accessed. 1 means they are.
+		//puts("I2C registers are not ready to be accessed." );
+		i2c_timed_out(); // Resets and re-initializes the module.
+		return 0;
 	}
 
 	if (I2caRegs.I2CSTR.bit.ARDY == 1) // Execute only when the registers are ready
@@ -271,8 +377,10 @@ void i2c_read(Uint16 Slave_address, Uint16 Start_address, Uint16 No_of_databytes
 	}
 
 	// Wait for I2C registers to be ready...
-	while(I2caRegs.I2CSTR.bit.ARDY != 1) {
+	if (!i2c_poll(&I2caRegs.I2CSTR.all, I2C_ARDY, I2C_ARDY)) {
 		//puts("I2C registers are not ready to be accessed." );
+		i2c_timed_out();
+		return 0;
 	}
 	//if (I2caRegs.I2CSTR.bit.NACK == 1) {
 	//	//puts("Sent address was not acknowledged! NACK (no acknowledgment bit received)! Aborting read...");
@@ -285,7 +393,10 @@ void i2c_read(Uint16 Slave_address, Uint16 Start_address, Uint16 No_of_databytes
 	// Manually send a stop signal, because we need to change to non repeat mode.
 	I2caRegs.I2CMDR.bit.STP = 1;
 
-	while(I2caRegs.I2CMDR.bit.STP != 0); // Wait till the STOP is detected...
+	if (!i2c_poll(&I2caRegs.I2CMDR.all, I2C_STP, 0)) { // Wait till the STOP is detected...
+		i2c_timed_out();
+		return 0;
+	}
 
 	I2caRegs.I2CMDR.all = 0x2C20; // Sets I2CMDR to 0010110000100 000, so this is the same as the above set except:
 	// Sets STP to 1: A STOP condition is automatically generated when the internal data counter of the I2C module counts down to 0 (all data is read/transmitted).
@@ -296,8 +407,10 @@ void i2c_read(Uint16 Slave_address, Uint16 Start_address, Uint16 No_of_databytes
 	int i = 0;
 	while( i < No_of_databytes ) // i is initially 0.
 	{
-		while(I2caRegs.I2CSTR.bit.RRDY != 1) { // This is 1 when a received FIFO interrupt condition has occurred - for FIFO only! *For Non-FIFO, check if I2CSTR.bit.RRDY
+		if (!i2c_poll(&I2caRegs.I2CSTR.all, I2C_RRDY, I2C_RRDY)) { // This is 1 when a received FIFO interrupt condition has occurred - for FIFO only! *For Non-FIFO, check if I2CSTR.bit.RRDY
 			//puts("Read in progress, no FIFO data received yet...");
+			i2c_timed_out();
+			return 0;
 		}
 
 		*Temp_Pointer++ = I2caRegs.I2CDRR; // Save the read data into the read array.
@@ -310,15 +423,19 @@ void i2c_read(Uint16 Slave_address, Uint16 Start_address, Uint16 No_of_databytes
 		//	return;
 		//}
 	}
-	while (I2caRegs.I2CMDR.bit.MST != 0); // Wait for stop condition to be accepted.
+	if (!i2c_poll(&I2caRegs.I2CMDR.all, I2C_MST, 0)) { // Wait for stop condition to be accepted.
+		i2c_timed_out();
+		return 0;
+	}
+	return 1;
 }
 
 /// @brief This function initializes I2C on the F2806 C2000 microcontroller.
 void I2CA_Init(void)
 {
    // Initialize I2C
-   I2caRegs.I2CPSC.all = 89;		    // The I2C Clock speed is CLOCK/(I2CPSC+1). Set 222 KHz
-   // The current peripheral clock speed is 80MHz/4
+   I2caRegs.I2CPSC.all = 8;		    // The I2C module clock is SYSCLKOUT/(I2CPSC+1), and must be 7-12 MHz: 10 MHz at 90 MHz
+   // SCL is the module clock/(I2CCLKL + 5 + I2CCLKH + 5): 400 kHz fast mode, which a 42-byte DMP packet needs to keep up with 200 Hz
    I2caRegs.I2CCLKL = 10;			// NOTE: must be non zero, the amount of time the SCL clock pin is low
    I2caRegs.I2CCLKH = 5;			// NOTE: must be non zero, the amount of time the SCL is high
    I2caRegs.I2CIER.all = 0x24;		// Enable SCD & ARDY interrupts
@@ -344,6 +461,311 @@ void I2CA_Init(void)
   // I2caRegs.I2CPSC.bit.IPSC = 125;
 }
 
+/**
+ * @brief Sets up I2CINT1A and I2CINT2A for i2c_submit (PIE group 8, with M_INT8
+ * set in IER); interrupts still need EINT. Call after I2CA_Init. From then on
+ * i2c_read goes through the queue too, so it needs interrupts enabled.
+ */
+void i2c_queue_init(void)
+{
+	i2c_head = i2c_tail = 0;
+	i2c_running = 0;
+	I2caRegs.I2CIER.all = 0;
+	I2caRegs.I2CFFTX.all = 0;
+	I2caRegs.I2CFFRX.all = 0;
+
+	EALLOW;
+	PieVectTable.I2CINT1A = &i2c_isr;
+	PieVectTable.I2CINT2A = &i2c_fifo_isr;
+	EDIS;
+	PieCtrlRegs.PIECTRL.bit.ENPIE = 1;
+	PieCtrlRegs.PIEIER8.bit.INTx1 = 1;
+	PieCtrlRegs.PIEIER8.bit.INTx2 = 1;
+	IER |= M_INT8;
+	i2c_queue_on = 1;
+}
+
+//CpuTimer1, counting down from 2^32-1 at SYSCLKOUT while benchmarking.
+static Uint32 i2c_now(void)
+{
+	return CpuTimer1Regs.TIM.all;
+}
+
+/*
+ * Moves data between the head transfer and the FIFOs: tops the TX FIFO up,
+ * or empties the RX FIFO and sets the level for the next interrupt. Until the
+ * last 4 bytes the RX interrupt comes at 3, so one byte can still arrive
+ * while the ISR is held off and the clock isn't stretched.
+ */
+static void i2c_pump(void)
+{
+	I2C_XFER* x = i2c_head;
+	Uint16 left;
+
+	if (x->rx) {
+		if (i2c_reg_phase) return;
+		while (I2caRegs.I2CFFRX.bit.RXFFST && i2c_moved < x->length) {
+			x->rx[i2c_moved++] = I2caRegs.I2CDRR;
+		}
+		left = x->length - i2c_moved;
+		if (left) {
+			I2caRegs.I2CFFRX.all = I2C_RXFFRST | I2C_RXFFINTCLR | I2C_RXFFIENA | (left > 4 ? 3 : left);
+		} else {
+			I2caRegs.I2CFFRX.all = I2C_RXFFRST | I2C_RXFFINTCLR;
+		}
+	} else {
+		while (I2caRegs.I2CFFTX.bit.TXFFST < 4 && i2c_moved < x->length) {
+			I2caRegs.I2CDXR = x->tx[i2c_moved++];
+		}
+		// Interrupt with one byte left in the FIFO, while there is more to load.
+		I2caRegs.I2CFFTX.all = I2C_I2CFFEN | I2C_TXFFRST | I2C_TXFFINTCLR | (i2c_moved < x->length ? I2C_TXFFIENA | 1 : 0);
+	}
+}
+
+//Puts the head transfer on the bus. INT8 masked or in the ISR.
+static void i2c_start(void)
+{
+	I2C_XFER* x = i2c_head;
+	Uint16 reg = x->reg != I2C_NO_REG;
+
+	x->status = I2C_XFER_ACTIVE;
+	i2c_moved = 0;
+	i2c_result = I2C_XFER_DONE;
+	i2c_reg_phase = x->rx && reg;
+	if (i2c_bench_on) i2c_bench_began = i2c_now();
+
+	// FIFOs on, emptied of anything a failed transfer left behind.
+	I2caRegs.I2CFFTX.all = I2C_I2CFFEN;
+	I2caRegs.I2CFFRX.all = 0;
+	I2caRegs.I2CFFTX.all = I2C_I2CFFEN | I2C_TXFFRST | I2C_TXFFINTCLR;
+	I2caRegs.I2CFFRX.all = I2C_RXFFRST | I2C_RXFFINTCLR;
+	I2caRegs.I2CSTR.all = I2C_ARBL | I2C_NACK | I2C_ARDY | I2C_RRDY | I2C_SCD; // Clear what the last transfer left.
+	I2caRegs.I2CSAR = x->address;
+	if (i2c_reg_phase) {
+		// Register address alone, no STOP; ARDY comes when it is acknowledged.
+		I2caRegs.I2CCNT = 1;
+		I2caRegs.I2CDXR = x->reg;
+		I2caRegs.I2CIER.all = I2C_ARBL | I2C_NACK | I2C_ARDY | I2C_SCD;
+		I2caRegs.I2CMDR.all = 0x2620; // STT, MST, TRX, IRS: non-repeat mode
+	} else if (x->rx) {
+		I2caRegs.I2CCNT = x->length;
+		i2c_pump();
+		I2caRegs.I2CIER.all = I2C_ARBL | I2C_NACK | I2C_SCD;
+		I2caRegs.I2CMDR.all = 0x2C20; // STT, STP, MST, IRS: receive length bytes, then STOP
+	} else {
+		// reg and the data in one message, loaded into the TX FIFO as it drains.
+		I2caRegs.I2CCNT = reg + x->length;
+		if (reg) I2caRegs.I2CDXR = x->reg;
+		i2c_pump();
+		I2caRegs.I2CIER.all = I2C_ARBL | I2C_NACK | I2C_SCD;
+		I2caRegs.I2CMDR.all = 0x2E20; // STT, STP, MST, TRX, IRS: send I2CCNT bytes, then STOP
+	}
+}
+
+//Retires the head transfer and starts the next. INT8 masked or in the ISR.
+static void i2c_finish(Uint16 status)
+{
+	I2C_XFER* x = i2c_head;
+	Uint32 t = 0;
+
+	if (i2c_bench_on) {
+		t = i2c_now();
+		i2c_bench.transfers++;
+		i2c_bench.bytes += i2c_moved;
+		i2c_bench.bus_cycles += i2c_bench_began - t;
+	}
+	i2c_head = x->next;
+	if (!i2c_head) i2c_tail = 0;
+	x->next = 0;
+	x->status = status;
+	i2c_running = 1;
+	if (x->done) x->done(x); // May submit more.
+	i2c_running = 0;
+	if (i2c_bench_on) i2c_bench_skip += t - i2c_now(); // The callback's time isn't the driver's.
+	if (i2c_head) {
+		i2c_start();
+	} else {
+		// Idle: interrupts and FIFOs off, as the blocking functions expect.
+		I2caRegs.I2CIER.all = 0;
+		I2caRegs.I2CFFTX.all = 0;
+		I2caRegs.I2CFFRX.all = 0;
+	}
+}
+
+/**
+ * @brief Queues a transfer behind any already on the bus; it starts at once if
+ * the bus is idle. Never waits. The descriptor and its buffers must stay put
+ * until its status is past I2C_XFER_ACTIVE. Safe to call from done.
+ * @return 1 if queued, 0 if xfer is already queued or active, or has nothing to send.
+ */
+int i2c_submit(I2C_XFER* xfer)
+{
+	Uint16 ier8;
+	Uint32 t;
+
+	if (xfer->length == 0 && (xfer->rx || xfer->reg == I2C_NO_REG)) return 0;
+	ier8 = IER & M_INT8;
+	IER &= ~M_INT8;
+	if (xfer->status == I2C_XFER_QUEUED || xfer->status == I2C_XFER_ACTIVE) {
+		IER |= ier8;
+		return 0;
+	}
+	xfer->status = I2C_XFER_QUEUED;
+	xfer->next = 0;
+	if (i2c_tail) {
+		i2c_tail->next = xfer;
+		i2c_tail = xfer;
+	} else {
+		i2c_head = i2c_tail = xfer;
+		if (!i2c_running) {
+			t = i2c_now();
+			i2c_start();
+			if (i2c_bench_on) i2c_bench.cpu_cycles += t - i2c_now();
+		}
+	}
+	IER |= ier8;
+	return 1;
+}
+
+/// @brief Returns 1 while a queued transfer is active or waiting.
+int i2c_busy(void)
+{
+	return i2c_head != 0;
+}
+
+/**
+ * @brief Gives up on the active transfer, say when a slave holding SCL low has
+ * kept it from finishing in time: resets the module, fails the transfer
+ * (I2C_XFER_FAILED, done is called) and starts the next one.
+ */
+void i2c_cancel(void)
+{
+	Uint16 ier8 = IER & M_INT8;
+
+	IER &= ~M_INT8;
+	if (i2c_head && i2c_head->status == I2C_XFER_ACTIVE) {
+		I2caRegs.I2CMDR.all = 0; // Reset I2C.
+		I2CA_Init();
+		i2c_finish(I2C_XFER_FAILED);
+	}
+	IER |= ier8;
+}
+
+/**
+ * @brief I2CINT1A ISR, registered by i2c_queue_init: addressing, errors and
+ * STOP. Reading I2CISRC clears the flag it reports, so it loops until the
+ * module has nothing left to say.
+ */
+__interrupt void i2c_isr(void)
+{
+	Uint32 t = i2c_now();
+	Uint16 code;
+
+	i2c_bench_skip = 0;
+	while ((code = I2caRegs.I2CISRC.bit.INTCODE) != 0) {
+		I2C_XFER* x = i2c_head;
+
+		if (!x) {
+			I2caRegs.I2CIER.all = 0;
+			break;
+		}
+		switch (code) {
+		case I2C_ARBL_CODE:
+			// Another master won the bus and the module is now a slave; its STOP ends this.
+			i2c_result = I2C_XFER_FAILED;
+			I2caRegs.I2CIER.all = I2C_SCD;
+			break;
+		case I2C_NACK_CODE:
+			i2c_result = I2C_XFER_NACKED;
+			i2c_reg_phase = 0;
+			I2caRegs.I2CFFTX.all = I2C_I2CFFEN; // Drop what is still queued to send.
+			I2caRegs.I2CFFRX.all = 0;
+			I2caRegs.I2CIER.all = I2C_ARBL | I2C_SCD;
+			I2caRegs.I2CMDR.bit.STP = 1; // The master has to end it.
+			break;
+		case I2C_ARDY_CODE:
+			if (i2c_reg_phase) {
+				// Register address acknowledged: repeated START, read, STOP.
+				i2c_reg_phase = 0;
+				I2caRegs.I2CCNT = x->length;
+				i2c_pump();
+				I2caRegs.I2CIER.all = I2C_ARBL | I2C_NACK | I2C_SCD;
+				I2caRegs.I2CMDR.all = 0x2C20;
+			}
+			break;
+		case I2C_SCD_CODE:
+			if (i2c_result == I2C_XFER_DONE) i2c_pump(); // The last bytes may beat I2CINT2A here.
+			i2c_finish(i2c_result);
+			break;
+		}
+	}
+	if (i2c_bench_on) i2c_bench.cpu_cycles += t - i2c_now() - i2c_bench_skip;
+	PieCtrlRegs.PIEACK.all = PIEACK_GROUP8;
+}
+
+/**
+ * @brief I2CINT2A ISR, registered by i2c_queue_init: the FIFO levels, so data
+ * moves four bytes an interrupt (three while more are due on a read).
+ */
+__interrupt void i2c_fifo_isr(void)
+{
+	Uint32 t = i2c_now();
+
+	if (i2c_head && i2c_head->status == I2C_XFER_ACTIVE && i2c_result == I2C_XFER_DONE) {
+		i2c_pump();
+	} else {
+		I2caRegs.I2CFFTX.bit.TXFFIENA = 0;
+		I2caRegs.I2CFFRX.bit.RXFFIENA = 0;
+	}
+	if (i2c_bench_on) i2c_bench.cpu_cycles += t - i2c_now();
+	PieCtrlRegs.PIEACK.all = PIEACK_GROUP8;
+}
+
+/**
+ * @brief Starts benchmark mode: zeroes i2c_bench and takes CpuTimer1 (free
+ * running at SYSCLKOUT) to time queued transfers. The counters wrap after
+ * 2^32 cycles of bus time, about 47 s at 90 MHz, so keep runs shorter.
+ */
+void i2c_bench_start(void)
+{
+	Uint16 ier8 = IER & M_INT8;
+
+	IER &= ~M_INT8;
+	CpuTimer1Regs.TCR.bit.TSS = 1;
+	CpuTimer1Regs.PRD.all = 0xFFFFFFFF;
+	CpuTimer1Regs.TPR.all = 0;
+	CpuTimer1Regs.TPRH.all = 0;
+	CpuTimer1Regs.TCR.bit.TIE = 0;
+	CpuTimer1Regs.TCR.bit.TRB = 1;
+	CpuTimer1Regs.TCR.bit.TSS = 0;
+	i2c_bench.transfers = i2c_bench.bytes = 0;
+	i2c_bench.bus_cycles = i2c_bench.cpu_cycles = 0;
+	i2c_bench_on = 1;
+	IER |= ier8;
+}
+
+/// @brief Ends benchmark mode; i2c_bench keeps its totals and CpuTimer1 is free again.
+void i2c_bench_stop(void)
+{
+	i2c_bench_on = 0;
+	CpuTimer1Regs.TCR.bit.TSS = 1;
+}
+
+/**
+ * @brief Logs the benchmark so far: data bytes per second of bus time, from
+ * START to STOP, and CPU cycles per data byte spent in the driver (submit and
+ * both ISRs, without done callbacks or interrupt entry and exit).
+ * @param fclk The system clock frequency in MHz, from getfclk
+ */
+void i2c_bench_report(float32 fclk)
+{
+	float32 rate = 0, cost = 0;
+
+	if (i2c_bench.bus_cycles) rate = i2c_bench.bytes * fclk * 1e6f / i2c_bench.bus_cycles;
+	if (i2c_bench.bytes) cost = (float32)i2c_bench.cpu_cycles / i2c_bench.bytes;
+	LOG4("I2C bench: %u transfers, %u bytes, %f bytes/s, %f cycles/byte", i2c_bench.transfers, i2c_bench.bytes, LOG_FLOAT(rate), LOG_FLOAT(cost));
+}
+
 /// @brief Gets a certain bit from a byte, where 0=RIGHTMOST bit (LSB). Also works for 16-bit words.
 short getBitFromByte(Uint16 byte, short bitNum) {
 	Uint16 one = 1;
@@ -353,18 +775,8 @@ short getBitFromByte(Uint16 byte, short bitNum) {
 	return 0;
 }
 
-/// @brief Prints out two bytes to std output. You can use this for testing.
+/// @brief Logs two bytes in binary. You can use this for testing.
 void printBytes(Uint16 byte, Uint16 byte2) {
-	char string[17];
-	sprintf(string, "%d%d%d%d%d%d%d%d %d%d%d%d%d%d%d%d", (byte & 0x80 ? 1 : 0),
-			(byte & 0x40 ? 1 : 0), (byte & 0x20 ? 1 : 0), (byte & 0x10 ? 1 : 0),
-			(byte & 0x08 ? 1 : 0), (byte & 0x04 ? 1 : 0), (byte & 0x02 ? 1 : 0),
-			(byte & 0x01 ? 1 : 0),
-
-			(byte2 & 0x80 ? 1 : 0), (byte2 & 0x40 ? 1 : 0),
-			(byte2 & 0x20 ? 1 : 0), (byte2 & 0x10 ? 1 : 0),
-			(byte2 & 0x08 ? 1 : 0), (byte2 & 0x04 ? 1 : 0),
-			(byte2 & 0x02 ? 1 : 0), (byte2 & 0x01 ? 1 : 0));
-	puts(string);
+	LOG2("%08b %08b", byte & 0xFF, byte2 & 0xFF);
 }
 
@@ -17,9 +17,76 @@ int i2c_write_byte(Uint16 Slave_address, Uint16 Start_address, Uint16 databyte);
 int i2c_write(Uint16 Slave_address, Uint16 Start_address, Uint16 no_databytes, Uint16 databytes[]);
 
 int i2c_read_bit(Uint16 slave_address, Uint16 register_address, short bitNum);
-void i2c_read(Uint16 Slave_address, Uint16 Start_address, Uint16 No_of_databytes, Uint16 Read_Array[]);
+int i2c_read(Uint16 Slave_address, Uint16 Start_address, Uint16 No_of_databytes, Uint16 Read_Array[]);
 void I2CA_Init(void);
 
+/*
+ * Transaction queue for I2C-A, moved along by I2CINT1A and I2CINT2A.
+ * i2c_submit queues an I2C_XFER the caller owns and returns at once; the ISRs
+ * take each one through START, register address, data and STOP and then start
+ * the next. Data streams through the 4-level FIFOs, so a 42-byte DMP packet
+ * costs about a dozen interrupts instead of the whole transfer in a polling
+ * loop. Once the queue is set up i2c_read and i2c_write (and the functions
+ * built on them) submit and wait, cancelling the transfer on the bus each
+ * time 20 ms pass without it finishing; they fail at once from a done
+ * callback. Before that they poll the module, and give up on any wait that
+ * takes over 20 ms.
+ *
+ *	I2CA_Init();
+ *	i2c_queue_init();
+ *	EINT;
+ *
+ *	static Uint16 packet[42];
+ *	static I2C_XFER fifo = {MPU6050_ADDRESS, MPU6050_RA_FIFO_R_W, 0, packet, 42, 0};
+ *	i2c_submit(&fifo);
+ *	...
+ *	if (fifo.status == I2C_XFER_DONE) ...	//or use done, called from the ISR
+ */
+#define I2C_NO_REG 0xFFFF//reg of a transfer with no register address
+
+#define I2C_XFER_IDLE	0//never submitted
+#define I2C_XFER_QUEUED	1
+#define I2C_XFER_ACTIVE	2
+#define I2C_XFER_DONE	3
+#define I2C_XFER_NACKED	4//the slave didn't acknowledge its address or a byte written
+#define I2C_XFER_FAILED	5//arbitration lost, or i2c_cancel
+
+typedef struct I2C_XFER {
+	Uint16 address;		//7-bit slave address
+	Uint16 reg;			//register address sent first, or I2C_NO_REG
+	const Uint16* tx;	//length bytes written after reg; 0 for a read
+	Uint16* rx;			//length bytes read after a repeated START; 0 for a write
+	Uint16 length;		//0 writes just reg
+	void (*done)(struct I2C_XFER* xfer);//called from the ISR after the STOP, or 0
+	volatile Uint16 status;//I2C_XFER_IDLE/QUEUED/..., kept by the driver; start at I2C_XFER_IDLE
+	struct I2C_XFER* next;//kept by the driver
+} I2C_XFER;
+
+void i2c_queue_init(void);
+int i2c_submit(I2C_XFER* xfer);
+int i2c_busy(void);
+void i2c_cancel(void);
+__interrupt void i2c_isr(void);
+__interrupt void i2c_fifo_isr(void);
+
+/*
+ * Benchmark mode: between i2c_bench_start and i2c_bench_stop every queued
+ * transfer is timed on CpuTimer1. i2c_bench_report logs bytes/s and CPU
+ * cycles/byte; read i2c_bench directly for the raw totals.
+ */
+typedef struct I2C_BENCH {
+	Uint32 transfers;	//finished, whatever their status
+	Uint32 bytes;		//data bytes moved, without addresses
+	Uint32 bus_cycles;	//SYSCLKOUT cycles from START to STOP
+	Uint32 cpu_cycles;	//SYSCLKOUT cycles spent in the driver
+} I2C_BENCH;
+
+extern I2C_BENCH i2c_bench;
+
+void i2c_bench_start(void);
+void i2c_bench_stop(void);
+void i2c_bench_report(float32 fclk);
+
 short getBitFromByte(Uint16 byte, short bitNum);
 void printBytes(Uint16 byte, Uint16 byte2);
 
@@ -25,7 +25,9 @@
       Brian Kuo
 */
 
+#define LOG_FILE 2
 #include "IMU_Interface.h"
+#include "logging.h"
 #include <math.h>
 
 /**
@@ -33,6 +35,7 @@
 @details This function returns the average of some number of IMU samples.
  Details on the return structure are in the header of this file.
  The samples parameter tells how many samples to be taken, and averaged together.
+ If a sample cannot be read, that sample (read_status -1) is returned instead.
  Samples are taken at approximately ~75Hz, but probably can be configured to be faster.
 @note For optimal operation, this function should be called as frequently as possible, since
  infrequent calling would mean dumping the FIFO buffer often!
@@ -42,6 +45,9 @@ imu_read_data imu_subsystem_get_data_samples(int num_samples) {
 	int i;
 	for (i = 0; i < num_samples; i++) {
 		imu_read_data sample = imu_subsystem_current_data_read();
+		if (sample.read_status != 1) {
+			return sample;
+		}
 		sum.roll += sample.roll;
 		sum.pitch += sample.pitch;
 		sum.yaw += sample.yaw;
@@ -69,12 +75,48 @@ imu_read_data imu_subsystem_get_data_samples(int num_samples) {
 	return sum;
 }
 
+//Fills everything but read_status from a DMP packet and a temperature.
+static void imu_decode(imu_read_data* d, Uint16 packet[], float32 temp) {
+	// Get acceleration, minus gravity:
+	float quaternion[4];
+	DMP_get_quaternion(quaternion, packet);
+	int16 accel[3];
+	DMP_get_raw_accel(accel, packet);
+	float gravity[3];
+	DMP_get_gravity(gravity, quaternion);
+	d->x_acc = (float32)accel[0] / 4096.0f - gravity[0]; // NOTE: 8192/2 must be changed if the resolution is changed from +/- 4g
+	d->y_acc = (float32)accel[1] / 4096.0f - gravity[1];
+	d->z_acc = (float32)accel[2] / 4096.0f - gravity[2];
+
+	// Calculate the magnitude of acceleration vector
+	d->lin_acc = sqrt(d->x_acc*d->x_acc + d->y_acc*d->y_acc + d->z_acc*d->z_acc);
+
+	// Retrieve gyroscope information:
+	int16 gyro[3];
+	DMP_get_raw_gyro(gyro, packet);
+	d->roll_ang_vel = (float32)gyro[0] / 65.5f;
+	d->pitch_ang_vel = (float32)gyro[1] / 65.5f;
+	d->yaw_ang_vel = (float32)gyro[2] / 65.5f;
+
+	// Get roll, pitch, and yaw:
+	float ypr[3];
+	DMP_get_yaw_pitch_roll(ypr, quaternion, gravity);
+	d->yaw = ypr[0] / 3.14159265f * 180.0f;
+	d->pitch = ypr[1] / 3.14159265f * 180.0f;
+	d->roll = ypr[2] / 3.14159265f * 180.0f;
+
+	d->temp = temp;
+}
+
 /**
 @brief This function reads one data sample from the IMU.
 @details This function will read current rotation and acceleration data from the IMU, and return it.
  This function returns a struct of 32-bit floats named "imu_read_data".
  NOTE: Make sure to call imu_subsystem_setup first!
  Returns and errors are in the header of this file.
+@note This still waits for the whole 42-byte packet read (about 1.1 ms at 400 kHz), and for the FIFO
+ to fill before that. With i2c_queue_init the bytes move under interrupts, so other ISRs keep running,
+ but the caller doesn't; use imu_subsystem_poll to read without waiting.
  */
 imu_read_data imu_subsystem_current_data_read() {
 	imu_read_data ret_data; // Create the return structure.
@@ -87,50 +129,101 @@ imu_read_data imu_subsystem_current_data_read() {
 		if ((get_MPU_internal_status() & 0x10) || get_FIFO_count() >= 1024) {
 			//puts("FIFO overflow!");
 			// Reset FIFO.
-			i2c_write_bit(MPU6050_ADDRESS, MPU6050_RA_USER_CTRL, MPU6050_USERCTRL_FIFO_RESET_BIT, true);
+			write_MPU_bit(MPU6050_RA_USER_CTRL, MPU6050_USERCTRL_FIFO_RESET_BIT, true);
 		} else {
 			// == We can wait for a DMP data ready interrupt here ==
 			// Or, we can just check for new data, which is what is currently implemented:
 
 			// Read FIFO packet (packet size is default 42):
 			Uint16 FIFO_data[42];
-			i2c_read(MPU6050_ADDRESS, MPU6050_RA_FIFO_R_W, 42, FIFO_data);
+			if (!i2c_read(MPU6050_ADDRESS, MPU6050_RA_FIFO_R_W, 42, FIFO_data)) {
+				LOG0("DMP packet read failed");
+				ret_data.read_status = -1; // The rest of ret_data is not filled in.
+				return ret_data;
+			}
 
 			ret_data.read_status = 1; // Set to "data successfully read"
+			imu_decode(&ret_data, FIFO_data, get_MPU6050_temperature());
+			return ret_data;; // Read operation was successful.
+		}
+	}
+}
 
-			// Get acceleration, minus gravity:
-			float quaternion[4];
-			DMP_get_quaternion(quaternion, FIFO_data);
-			int16 accel[3];
-			DMP_get_raw_accel(accel, FIFO_data);
-			float gravity[3];
-			DMP_get_gravity(gravity, quaternion);
-			ret_data.x_acc = (float32)accel[0] / 4096.0f - gravity[0]; // NOTE: 8192/2 must be changed if the resolution is changed from +/- 4g
-			ret_data.y_acc = (float32)accel[1] / 4096.0f - gravity[1];
-			ret_data.z_acc = (float32)accel[2] / 4096.0f - gravity[2];
-
-			// Calculate the magnitude of acceleration vector
-			ret_data.lin_acc = sqrt(ret_data.x_acc*ret_data.x_acc + ret_data.y_acc*ret_data.y_acc + ret_data.z_acc*ret_data.z_acc);
-
-			// Retrieve gyroscope information:
-			int16 gyro[3];
-			DMP_get_raw_gyro(gyro, FIFO_data);
-			ret_data.roll_ang_vel = (float32)gyro[0] / 65.5f;
-			ret_data.pitch_ang_vel = (float32)gyro[1] / 65.5f;
-			ret_data.yaw_ang_vel = (float32)gyro[2] / 65.5f;
-
-			// Get roll, pitch, and yaw:
-			float ypr[3];
-			DMP_get_yaw_pitch_roll(ypr, quaternion, gravity);
-			ret_data.yaw = ypr[0] / 3.14159265f * 180.0f;
-			ret_data.pitch = ypr[1] / 3.14159265f * 180.0f;
-			ret_data.roll = ypr[2] / 3.14159265f * 180.0f;
-
-			// Get temperature:
-			ret_data.temp = get_MPU6050_temperature();
+/*
+ * Queued packet reading for imu_subsystem_poll. The main loop only submits the
+ * FIFO count read; its done callback, from the I2C ISR, queues the packet and
+ * temperature reads once a whole packet is in, and the temperature read's
+ * callback marks the sample ready.
+ */
+enum {IMU_IDLE, IMU_COUNTING, IMU_READING, IMU_READY, IMU_OVERFLOW};
 
-			return ret_data;; // Read operation was successful.
+#define IMU_STUCK_POLLS 100//polls a read may stay in flight before it is cancelled
+
+static volatile Uint16 imu_state = IMU_IDLE;
+static Uint16 imu_waits;//polls since the current read was submitted
+static Uint16 imu_count[2];
+static Uint16 imu_packet[42];
+static Uint16 imu_temp[2];
+
+static void imu_count_done(I2C_XFER* x);
+static void imu_temp_done(I2C_XFER* x);
+
+static I2C_XFER imu_count_xfer = {MPU6050_ADDRESS, MPU6050_RA_FIFO_COUNTH, 0, imu_count, 2, imu_count_done};
+static I2C_XFER imu_packet_xfer = {MPU6050_ADDRESS, MPU6050_RA_FIFO_R_W, 0, imu_packet, 42, 0};
+static I2C_XFER imu_temp_xfer = {MPU6050_ADDRESS, MPU6050_RA_TEMP_OUT_H, 0, imu_temp, 2, imu_temp_done};
+
+static void imu_count_done(I2C_XFER* x) {
+	Uint16 count = (imu_count[0] << 8) | imu_count[1];
+
+	if (x->status != I2C_XFER_DONE || count < 42) {
+		imu_state = IMU_IDLE; // Nothing yet; the next poll asks again.
+	} else if (count >= 1024) {
+		imu_state = IMU_OVERFLOW;
+	} else {
+		imu_state = IMU_READING;
+		i2c_submit(&imu_packet_xfer);
+		i2c_submit(&imu_temp_xfer);
+	}
+}
+
+static void imu_temp_done(I2C_XFER* x) {
+	imu_state = x->status == I2C_XFER_DONE && imu_packet_xfer.status == I2C_XFER_DONE ? IMU_READY : IMU_IDLE;
+}
+
+/**
+@brief Reads samples like imu_subsystem_current_data_read, but never waits for the bus.
+@details Call it from the main loop at least as often as the DMP makes packets (200 Hz). Each call
+ moves the read along: when nothing is in flight it queues a read of the FIFO count, and the I2C ISRs
+ fetch the packet and the temperature as soon as a whole packet is in. A FIFO overflow is dealt with
+ here by resetting the FIFO, and a read still in flight after IMU_STUCK_POLLS calls is cancelled.
+ Needs i2c_queue_init after imu_subsystem_setup, with interrupts enabled.
+@return 1 with a new sample in *data, 0 if there is none yet.
+*/
+int imu_subsystem_poll(imu_read_data* data) {
+	switch (imu_state) {
+	case IMU_READY:
+		data->read_status = 1;
+		imu_decode(data, imu_packet, MPU6050_temperature(imu_temp));
+		imu_state = IMU_IDLE;
+		return 1;
+	case IMU_OVERFLOW:
+		LOG0("DMP FIFO overflow, resetting it");
+		write_MPU_bit(MPU6050_RA_USER_CTRL, MPU6050_USERCTRL_FIFO_RESET_BIT, true);
+		imu_state = IMU_IDLE;
+		return 0;
+	case IMU_IDLE:
+		imu_waits = 0;
+		imu_state = IMU_COUNTING;
+		if (!i2c_submit(&imu_count_xfer)) imu_state = IMU_IDLE;
+		return 0;
+	default:
+		// In flight. If the bus hangs, fail whatever holds it; the callbacks go back to IMU_IDLE.
+		if (++imu_waits >= IMU_STUCK_POLLS) {
+			LOG1("IMU read stuck in state %u, cancelling", imu_state);
+			imu_waits = 0;
+			i2c_cancel();
 		}
+		return 0;
 	}
 }
 
@@ -146,22 +239,23 @@ imu_read_data imu_subsystem_current_data_read() {
 */
 int imu_subsystem_setup() {
 	I2CA_Init(); // Initialize I2C module
+	forget_MPU_registers(); // The MPU may have been power cycled or set up differently since.
 
 	// Try to connect with MPU6050:
 	Uint16 tries = 600;
 	Uint16 i = 0;
 	for ( i = 0; i <= tries; i++ ) {
 		if (get_MPU6050_status() == 1) break;
-		puts("MPU6050 is not responding. Try restarting microcontroller.");
+		LOG1("MPU6050 is not responding (try %u)", i);
 		if (i == tries) return -1; // Give up.
 	}
-	puts("MPU6050 connection successful.");
+	LOG0("MPU6050 connection successful");
 
 	// Initialize the Digital Motion Processor (DMP) on the MPU6050. This allows for more accurate
 	// measurements of rotation.
-	puts("Setting up DMP...");
+	LOG0("Setting up DMP");
 	if( ! initialize_DMP() ) {
-		puts("DMP setup unsuccessful!");
+		LOG0("DMP setup unsuccessful");
 		return -2;
 	}
 
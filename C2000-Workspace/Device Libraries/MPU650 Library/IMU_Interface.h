@@ -13,7 +13,8 @@
 typedef struct imu_read_data {
 	char read_status;
 	//       1 : Read went OK; data is valid.
-	//      -1 : MPU is not responding! Try disconnecting and restarting, then re-setting-up.
+	//      -1 : MPU is not responding (a read failed); the other fields are not valid.
+	//           Try disconnecting and restarting, then re-setting-up.
 	float32 roll; // (degrees)
 	float32 pitch; // (degrees)
 	float32 yaw; // (degrees)
@@ -29,6 +30,7 @@ typedef struct imu_read_data {
 
 imu_read_data imu_subsystem_get_data_samples(int num_samples);
 imu_read_data imu_subsystem_current_data_read();
+int imu_subsystem_poll(imu_read_data* data);
 int imu_subsystem_setup();
 
 
@@ -4,7 +4,114 @@
  *  @date Nov 18, 2013
  *  @author Alex Popescu
  */
+#define LOG_FILE 3
 #include "MPUFuncs.h"
+#include "logging.h"
+
+/*
+ * Shadow of the MPU6050's configuration registers, so a bit-field write is a
+ * mask on the copy and one byte on the bus instead of a read and a write.
+ * Writes always go through to the device; a register is read only the first
+ * time a bit-field write needs it and nothing is known about it yet. Only a
+ * register that has been read is shadowed: writes keep it up to date after
+ * that, but never put it in, since reserved and read-only bits may not read
+ * back as written.
+ */
+#define MPU_REGISTERS 0x80
+static Uint16 MPU_shadow[MPU_REGISTERS];
+static Uint16 MPU_known[MPU_REGISTERS / 16];//bit set when MPU_shadow holds the register
+
+//Bits that clear themselves once the device has acted on them; the shadow keeps them 0.
+static Uint16 MPU_self_clearing(Uint16 reg) {
+	switch (reg) {
+		case MPU6050_RA_USER_CTRL: return 0x0F;//DMP, FIFO, I2C master and signal path resets
+		case MPU6050_RA_PWR_MGMT_1: return 0x80;//DEVICE_RESET
+		case MPU6050_RA_SIGNAL_PATH_RESET: return 0x07;
+		default: return 0;
+	}
+}
+
+static int MPU_is_known(Uint16 reg) {
+	return (MPU_known[reg >> 4] & (1U << (reg & 15))) != 0;
+}
+
+static void MPU_remember(Uint16 reg, Uint16 value) {
+	MPU_shadow[reg] = value & 0xFF & ~MPU_self_clearing(reg);
+	MPU_known[reg >> 4] |= 1U << (reg & 15);
+}
+
+/// @brief Forgets every shadowed register, say after the MPU6050 may have been power cycled.
+void forget_MPU_registers() {
+	memset(MPU_known, 0, sizeof(MPU_known));
+}
+
+/*
+ * After DEVICE_RESET: forgets everything, then takes the datasheet reset values
+ * of the plain configuration registers (the offset trims in 0x00-0x05 come from
+ * OTP and are left to be read).
+ */
+static void MPU_reset_shadow() {
+	static const Uint16 zeroed[] = {MPU6050_RA_SMPLRT_DIV, MPU6050_RA_CONFIG, MPU6050_RA_GYRO_CONFIG,
+			MPU6050_RA_ACCEL_CONFIG, MPU6050_RA_FIFO_EN, MPU6050_RA_INT_PIN_CFG, MPU6050_RA_INT_ENABLE,
+			MPU6050_RA_USER_CTRL, MPU6050_RA_PWR_MGMT_2};
+	Uint16 i;
+
+	forget_MPU_registers();
+	for (i = 0; i < sizeof(zeroed) / sizeof(zeroed[0]); i++) MPU_remember(zeroed[i], 0);
+	MPU_remember(MPU6050_RA_PWR_MGMT_1, 0x40);//SLEEP
+	MPU_remember(MPU6050_RA_WHO_AM_I, 0x68);
+}
+
+//Makes sure MPU_shadow holds reg, reading the device if it must. Returns 0 if that read failed.
+static int MPU_fetch(Uint16 reg) {
+	Uint16 b[1] = {0};
+
+	if (MPU_is_known(reg)) return 1;
+	if (!i2c_read(MPU6050_ADDRESS, reg, 1, b)) return 0;//stays unknown, to be read next time
+	MPU_remember(reg, b[0]);
+	return 1;
+}
+
+/// @brief Reads a configuration register, from the shadow if it is known there; 0 if the read fails.
+/// Not for data or status registers, which change on their own.
+Uint16 read_MPU_byte(Uint16 reg) {
+	reg &= MPU_REGISTERS - 1;
+	return MPU_fetch(reg) ? MPU_shadow[reg] : 0;
+}
+
+/// @brief Writes a whole register, and updates the shadow if it holds the register. Returns 1 if successful.
+int write_MPU_byte(Uint16 reg, Uint16 data) {
+	reg &= MPU_REGISTERS - 1;
+	if (!i2c_write_byte(MPU6050_ADDRESS, reg, data & 0xFF)) {
+		MPU_known[reg >> 4] &= ~(1U << (reg & 15));//no telling what the device has now
+		return 0;
+	}
+	if (reg == MPU6050_RA_PWR_MGMT_1 && (data & 0x80)) {
+		MPU_reset_shadow();
+	} else if (MPU_is_known(reg)) {
+		MPU_remember(reg, data);
+	}
+	return 1;
+}
+
+/**
+ * @brief Writes a bit field of a register: bits bitStart down to bitStart - length + 1,
+ * from the low length bits of data, as i2c_write_bits does. Only the write goes over
+ * the bus once the register is in the shadow.
+ */
+int write_MPU_bits(Uint16 reg, Uint16 bitStart, Uint16 length, Uint16 data) {
+	Uint16 shift = bitStart + 1 - length;
+	Uint16 mask = ((1 << length) - 1) << shift;
+
+	reg &= MPU_REGISTERS - 1;
+	if (!MPU_fetch(reg)) return 0;//the other bits are unknown: writing would clobber them
+	return write_MPU_byte(reg, (MPU_shadow[reg] & ~mask) | ((data << shift) & mask));
+}
+
+/// @brief Writes a single bit of a register, where bitNum=0=LSB.
+int write_MPU_bit(Uint16 reg, Uint16 bitNum, bool bit) {
+	return write_MPU_bits(reg, bitNum, 1, bit);
+}
 
 /// @brief Sets gyro calibration offsets:
 void set_MPU_gyro_offsets(int16 x, int16 y, int16 z) {
@@ -72,9 +179,9 @@ int write_DMP_configuration(const unsigned char *data, Uint16 dataSize) {
 			Uint16 special = data[i++];
 			if (special == 0x01) {
 				// Enable DMP-related interrupts:
-				i2c_write_byte(MPU6050_ADDRESS, MPU6050_RA_INT_ENABLE, 0x32);
+				write_MPU_byte(MPU6050_RA_INT_ENABLE, 0x32);
 			} else {
-				puts("No special detected!");
+				LOG1("DMP config: unknown special setting %u", special);
 				free(progBuffer);
 				return false;
 			}
@@ -86,6 +193,7 @@ int write_DMP_configuration(const unsigned char *data, Uint16 dataSize) {
 
 /// @brief Write memory block on MPU:
 int write_MPU_memory_block(const unsigned char *data, Uint16 dataSize, Uint16 bank, Uint16 address, bool verify, bool useProgMem) {
+	(void)useProgMem;//no separate program memory to read data from on the C2000
 	set_MPU_memory_bank(bank, false, false);
 	set_MPU_start_address(address);
 	Uint16 chunkSize;
@@ -121,7 +229,7 @@ int write_MPU_memory_block(const unsigned char *data, Uint16 dataSize, Uint16 ba
 			i2c_read(MPU6050_ADDRESS, MPU6050_RA_MEM_R_W, chunkSize, verifyBuffer);
 
 			if (memcmp(progBuffer, verifyBuffer, chunkSize) != 0) {
-				puts("DMP memory chunk NOT copied successfully! Aborting...");
+				LOG2("DMP memory chunk at bank %u address %u not copied, aborting", bank, address);
 				return false;
 			}
 		}
@@ -156,7 +264,12 @@ int get_FIFO_count() {
 float32 get_MPU6050_temperature() {
 	Uint16 buffer[2] = {0, 0};
 	i2c_read(MPU6050_ADDRESS, MPU6050_RA_TEMP_OUT_H, 2, buffer);
-	int16 rawtemp = (int16)((buffer[0] << 8) | buffer[1]);
+	return MPU6050_temperature(buffer);
+}
+
+/// @brief Converts TEMP_OUT_H and TEMP_OUT_L, as read, to farenheight.
+float32 MPU6050_temperature(const Uint16 raw[2]) {
+	int16 rawtemp = (int16)((raw[0] << 8) | raw[1]);
 	float celcius = (float)rawtemp / 340.0f + 36.53f;
 	return celcius*1.8f + 32.0f; // Convert to Fahrenheit
 }
@@ -17,6 +17,13 @@
 void set_MPU_gyro_offsets(int16 x, int16 y, int16 z);
 void set_MPU_accel_offsets(int16 x, int16 y, int16 z);
 
+// Registers through the shadow: bit-field writes cost one bus write once a register is known.
+Uint16 read_MPU_byte(Uint16 reg);
+int write_MPU_byte(Uint16 reg, Uint16 data);
+int write_MPU_bits(Uint16 reg, Uint16 bitStart, Uint16 length, Uint16 data);
+int write_MPU_bit(Uint16 reg, Uint16 bitNum, bool bit);
+void forget_MPU_registers();
+
 int get_MPU6050_status();
 unsigned char get_MPU_internal_status();
 
@@ -28,6 +35,7 @@ void set_MPU_start_address(Uint16 address);
 
 int get_FIFO_count();
 float32 get_MPU6050_temperature();
+float32 MPU6050_temperature(const Uint16 raw[2]);
 
 
 #endif /* MPUFUNCS_H_ */
@@ -0,0 +1,238 @@
+/*
+ * log2txt.c
+ *
+ * PC-side half of deferred logging (28069Common/h/logging.h): reads the
+ * telemetry stream (SCI Library, telemetry.h), takes the frames of type
+ * LOG_TELEMETRY_TYPE and prints each record with its format string from
+ * the logstrings table.
+ *
+ *   log2txt [-b baud] table [file|device|-]
+ *
+ * A record whose call site is not in the table, usually because the table
+ * is older than the firmware, is printed as file:line and raw arguments.
+ *
+ * Build (from this directory):
+ *   gcc -O2 -I../Telemetry -o log2txt log2txt.c ../Telemetry/tlm_decode.c ../Telemetry/tlm_open.c
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "tlm_decode.h"
+#include "tlm_open.h"
+
+#define LOG_TELEMETRY_TYPE 0x7F
+
+typedef struct {
+	unsigned file, line;
+	char* format;
+} call_site;
+
+static call_site* sites;
+static size_t nsites;
+static unsigned long records, unknown;
+
+static char* unescape(char* s) {
+	char* out = s;
+	char* in = s;
+
+	while (*in) {
+		if (*in != '\\' || !in[1]) {
+			*out++ = *in++;
+			continue;
+		}
+		in++;
+		switch (*in++) {
+			case 'n': *out++ = '\n'; break;
+			case 't': *out++ = '\t'; break;
+			case 'r': *out++ = '\r'; break;
+			default: *out++ = in[-1]; break;
+		}
+	}
+	*out = 0;
+	return s;
+}
+
+static int load_table(const char* path) {
+	FILE* f = fopen(path, "r");
+	char line[4096];
+	call_site* grown;
+
+	if (!f) {
+		perror(path);
+		return -1;
+	}
+	while (fgets(line, sizeof(line), f)) {
+		char* tab1 = strchr(line, '\t');
+		char* tab2 = tab1 ? strchr(tab1 + 1, '\t') : 0;
+
+		if (!tab2) continue;
+		line[strcspn(line, "\n")] = 0;
+		grown = realloc(sites, (nsites + 1) * sizeof(*sites));
+		if (!grown) {
+			fprintf(stderr, "%s: out of memory\n", path);
+			fclose(f);
+			return -1;
+		}
+		sites = grown;
+		sites[nsites].file = strtoul(line, 0, 0);
+		sites[nsites].line = strtoul(tab1 + 1, 0, 0);
+		sites[nsites].format = unescape(strdup(tab2 + 1));
+		nsites++;
+	}
+	fclose(f);
+	return 0;
+}
+
+static const char* lookup(unsigned file, unsigned line) {
+	size_t i;
+	for (i = 0; i < nsites; i++) {
+		if (sites[i].file == file && sites[i].line == line) return sites[i].format;
+	}
+	return 0;
+}
+
+static void print_binary(unsigned long v, int width) {
+	char digits[33];
+	int n = 0;
+
+	do {
+		digits[n++] = '0' + (v & 1);
+		v >>= 1;
+	} while (v && n < 32);
+	while (width-- > n) putchar('0');
+	while (n) putchar(digits[--n]);
+}
+
+/* printf for 32-bit arguments: %f %e %g take float bits, %b prints binary */
+static void print_record(const char* fmt, const unsigned long* args, int count) {
+	int next = 0;
+
+	while (*fmt) {
+		char spec[32];
+		size_t n;
+		char conv;
+		unsigned long v;
+
+		if (*fmt != '%') {
+			putchar(*fmt++);
+			continue;
+		}
+		if (fmt[1] == '%') {
+			putchar('%');
+			fmt += 2;
+			continue;
+		}
+		n = 1 + strspn(fmt + 1, "-+ #0123456789.hl");
+		conv = fmt[n];
+		if (!conv || n + 3 > sizeof(spec)) {
+			fputs(fmt, stdout);
+			break;
+		}
+		memcpy(spec, fmt, n);
+		spec[n] = 0;
+		fmt += n + 1;
+		while (spec[n - 1] == 'h' || spec[n - 1] == 'l') spec[--n] = 0;//arguments are all 32-bit
+		v = next < count ? args[next++] : 0;
+
+		switch (conv) {
+			case 'd': case 'i':
+				strcpy(spec + n, "ld");
+				printf(spec, (long)(int)(unsigned int)v);
+				break;
+			case 'u': case 'x': case 'X': case 'o':
+				spec[n] = 'l';
+				spec[n + 1] = conv;
+				spec[n + 2] = 0;
+				printf(spec, v);
+				break;
+			case 'f': case 'e': case 'g': case 'E': case 'G': {
+				union { unsigned int u; float f; } bits;
+				bits.u = (unsigned int)v;
+				spec[n] = conv;
+				spec[n + 1] = 0;
+				printf(spec, bits.f);
+				break;
+			}
+			case 'c':
+				putchar((int)(v & 0xFF));
+				break;
+			case 'b':
+				print_binary(v, atoi(spec + strspn(spec, "%-+ #0")));
+				break;
+			default:
+				printf("%s%c?", spec, conv);
+				break;
+		}
+	}
+	putchar('\n');
+}
+
+static void on_frame(void* ctx, const tlm_frame* f) {
+	size_t at = 0;
+
+	(void)ctx;
+	if (f->type != LOG_TELEMETRY_TYPE) return;
+	while (at + 4 <= f->len) {
+		const unsigned char* r = f->data + at;
+		unsigned file = r[0], count = r[1], line = r[2] << 8 | r[3];
+		unsigned long args[4];
+		const char* fmt;
+		unsigned i;
+
+		if (count > 4 || at + 4 + 4*count > f->len) break;
+		for (i = 0; i < count; i++) {
+			const unsigned char* a = r + 4 + 4*i;
+			args[i] = (unsigned long)a[0] << 24 | a[1] << 16 | a[2] << 8 | a[3];
+		}
+		records++;
+		fmt = lookup(file, line);
+		if (fmt) {
+			print_record(fmt, args, count);
+		} else {
+			unknown++;
+			printf("%u:%u", file, line);
+			for (i = 0; i < count; i++) printf(" 0x%08lx", args[i]);
+			putchar('\n');
+		}
+		at += 4 + 4*count;
+	}
+	fflush(stdout);
+}
+
+int main(int argc, char** argv) {
+	long baud = 115200;
+	const char* path = "-";
+	unsigned char buf[4096];
+	tlm_decoder d;
+	int fd, opt;
+
+	while ((opt = getopt(argc, argv, "b:")) != -1) {
+		if (opt != 'b') {
+			fprintf(stderr, "usage: %s [-b baud] table [file|device|-]\n", argv[0]);
+			return 2;
+		}
+		baud = strtol(optarg, 0, 10);
+	}
+	if (optind >= argc) {
+		fprintf(stderr, "usage: %s [-b baud] table [file|device|-]\n", argv[0]);
+		return 2;
+	}
+	if (load_table(argv[optind])) return 1;
+	if (optind + 1 < argc) path = argv[optind + 1];
+
+	fd = tlm_open(path, baud);
+	if (fd < 0) return 1;
+
+	tlm_decoder_init(&d, on_frame, 0);
+	while (1) {
+		ssize_t n = read(fd, buf, sizeof(buf));
+		if (n < 0 && errno == EINTR) continue;
+		if (n <= 0) break;
+		tlm_decode(&d, buf, n);
+	}
+	fprintf(stderr, "%lu records, %lu not in the table; %lu frames lost, %lu corrupt\n",
+			records, unknown, d.lost, d.crc_errors + d.bad_frames);
+	return 0;
+}
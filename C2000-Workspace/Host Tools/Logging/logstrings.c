@@ -0,0 +1,104 @@
+/*
+ * logstrings.c
+ *
+ * Build-time half of deferred logging (28069Common/h/logging.h): lists the
+ * format string of every LOGn call in the given sources as
+ *
+ *   LOG_FILE <tab> line <tab> format, escapes as written
+ *
+ * Files without a "#define LOG_FILE n" are skipped. Run it over the sources
+ * of each build, e.g. as a post-build step, and keep the table with the
+ * binary:
+ *
+ *   logstrings "../../Device Libraries/MPU650 Library/"*.c > app.logstrings
+ *
+ * Build (from this directory):
+ *   gcc -O2 -o logstrings logstrings.c
+ */
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Format string of a LOGn call starting at p, or 0 */
+static int format_at(const char* p, const char** start, size_t* len) {
+	const char* q;
+
+	if (strncmp(p, "LOG", 3) || p[3] < '0' || p[3] > '4') return 0;
+	q = p + 4;
+	while (*q == ' ' || *q == '\t') q++;
+	if (*q++ != '(') return 0;
+	while (*q == ' ' || *q == '\t') q++;
+	if (*q++ != '"') return 0;
+	*start = q;
+	while (*q && *q != '"') q += (*q == '\\' && q[1]) ? 2 : 1;
+	if (*q != '"') return 0;
+	*len = q - *start;
+	return 1;
+}
+
+static int scan(const char* path) {
+	FILE* f = fopen(path, "r");
+	char line[4096];
+	long file = -1;
+	int number = 0, in_comment = 0, found = 0;
+
+	if (!f) {
+		perror(path);
+		return -1;
+	}
+	while (fgets(line, sizeof(line), f)) {
+		const char* p = line;
+		char* def;
+
+		number++;
+		if ((def = strstr(line, "#define LOG_FILE")) && file < 0) {
+			file = strtol(def + 16, 0, 0);
+		}
+		while (*p) {
+			const char* fmt;
+			size_t len;
+
+			if (in_comment) {
+				const char* end = strstr(p, "*/");
+				if (!end) break;
+				in_comment = 0;
+				p = end + 2;
+			} else if (p[0] == '/' && p[1] == '/') {
+				break;
+			} else if (p[0] == '/' && p[1] == '*') {
+				in_comment = 1;
+				p += 2;
+			} else if (*p == '"') {//skip string literals
+				for (p++; *p && *p != '"'; p += (*p == '\\' && p[1]) ? 2 : 1) {}
+				if (*p) p++;
+			} else if ((p == line || !(isalnum((unsigned char)p[-1]) || p[-1] == '_')) && format_at(p, &fmt, &len)) {
+				if (file < 0) {
+					fprintf(stderr, "%s:%d: LOG call before #define LOG_FILE\n", path, number);
+					fclose(f);
+					return -1;
+				}
+				printf("%ld\t%d\t%.*s\n", file, number, (int)len, fmt);
+				found++;
+				p = fmt + len + 1;
+			} else {
+				p++;
+			}
+		}
+	}
+	fclose(f);
+	return found;
+}
+
+int main(int argc, char** argv) {
+	int i, status = 0;
+
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s source.c...\n", argv[0]);
+		return 2;
+	}
+	for (i = 1; i < argc; i++) {
+		if (scan(argv[i]) < 0) status = 1;
+	}
+	return status;
+}
@@ -0,0 +1,132 @@
+/*
+ * tlm2csv.c
+ *
+ * Turns a telemetry stream (SCI Library, telemetry.h) into CSV on stdout, one
+ * line per good frame: receive time in seconds, type, seq, then the fields.
+ *
+ *   tlm2csv [-b baud] [-t type=format]... [file|device|-]
+ *
+ * format lists the frame's big-endian fields, one letter each:
+ *   b/B int8/uint8, h/H int16/uint16, i/I int32/uint32, f float32
+ * Frames of a type without a format are printed as hex bytes. A serial
+ * device is put in raw mode at the given baud (default 115200). Counts of
+ * good, corrupt and lost frames go to stderr at the end or on Ctrl-C.
+ *
+ * Build (from this directory):
+ *   gcc -O2 -o tlm2csv tlm2csv.c tlm_decode.c tlm_open.c
+ */
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include "tlm_decode.h"
+#include "tlm_open.h"
+
+static const char* formats[256];
+static double start;
+static volatile sig_atomic_t stop;
+
+static double now(void) {
+	struct timeval tv;
+	gettimeofday(&tv, 0);
+	return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static unsigned long be(const unsigned char* p, int n) {
+	unsigned long v = 0;
+	while (n--) v = v << 8 | *p++;
+	return v;
+}
+
+static void print_frame(void* ctx, const tlm_frame* f) {
+	const char* fmt = formats[f->type];
+	size_t at = 0;
+
+	(void)ctx;
+	printf("%.6f,%u,%u", now() - start, f->type, f->seq);
+	if (!fmt) {
+		for (; at < f->len; at++) printf(",%02x", f->data[at]);
+		putchar('\n');
+		return;
+	}
+	for (; *fmt; fmt++) {
+		int size = (*fmt == 'b' || *fmt == 'B') ? 1 : (*fmt == 'h' || *fmt == 'H') ? 2 : 4;
+		unsigned long v;
+
+		if (at + size > f->len) {
+			printf(",");//frame shorter than its format
+			continue;
+		}
+		v = be(f->data + at, size);
+		at += size;
+		switch (*fmt) {
+			case 'b': printf(",%d", (signed char)v); break;
+			case 'h': printf(",%d", (short)v); break;
+			case 'i': printf(",%ld", (long)(int)v); break;
+			case 'f': {
+				union { unsigned int u; float f; } bits;
+				bits.u = (unsigned int)v;
+				printf(",%.7g", bits.f);
+				break;
+			}
+			default: printf(",%lu", v); break;
+		}
+	}
+	putchar('\n');
+}
+
+static void on_signal(int sig) {
+	(void)sig;
+	stop = 1;
+}
+
+int main(int argc, char** argv) {
+	long baud = 115200;
+	const char* path = "-";
+	tlm_decoder d;
+	unsigned char buf[4096];
+	int fd, opt;
+
+	while ((opt = getopt(argc, argv, "b:t:")) != -1) {
+		char* eq;
+		long type;
+
+		switch (opt) {
+			case 'b':
+				baud = strtol(optarg, 0, 10);
+				break;
+			case 't':
+				type = strtol(optarg, &eq, 0);
+				if (*eq != '=' || type < 0 || type > 255 || eq[strspn(eq + 1, "bBhHiIf") + 1]) {
+					fprintf(stderr, "bad format '%s', want type=fields such as 1=Hff\n", optarg);
+					return 2;
+				}
+				formats[type] = eq + 1;
+				break;
+			default:
+				fprintf(stderr, "usage: %s [-b baud] [-t type=format]... [file|device|-]\n", argv[0]);
+				return 2;
+		}
+	}
+	if (optind < argc) path = argv[optind];
+
+	fd = tlm_open(path, baud);
+	if (fd < 0) return 1;
+
+	signal(SIGINT, on_signal);
+	start = now();
+	tlm_decoder_init(&d, print_frame, 0);
+	while (!stop) {
+		ssize_t n = read(fd, buf, sizeof(buf));
+		if (n < 0 && errno == EINTR) continue;
+		if (n <= 0) break;
+		tlm_decode(&d, buf, n);
+		fflush(stdout);
+	}
+	fprintf(stderr, "%lu frames, %lu CRC errors, %lu bad frames, %lu lost\n",
+			d.frames, d.crc_errors, d.bad_frames, d.lost);
+	return 0;
+}
@@ -0,0 +1,84 @@
+/*
+ * tlm_decode.c
+ */
+#include "tlm_decode.h"
+
+unsigned tlm_crc16(const unsigned char* bytes, size_t n) {
+	unsigned crc = 0xFFFF;
+	size_t i;
+	int b;
+
+	for (i = 0; i < n; i++) {
+		crc ^= (unsigned)bytes[i] << 8;
+		for (b = 0; b < 8; b++) {
+			crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+		}
+		crc &= 0xFFFF;
+	}
+	return crc;
+}
+
+/* Undoes COBS in place; returns the decoded length or -1. */
+static long tlm_cobs_decode(unsigned char* buf, size_t n) {
+	size_t in = 0, out = 0;
+
+	while (in < n) {
+		unsigned code = buf[in++];
+		unsigned i;
+
+		if (code == 0 || in + code - 1 > n) return -1;
+		for (i = 1; i < code; i++) buf[out++] = buf[in++];
+		if (code < 0xFF && in < n) buf[out++] = 0;
+	}
+	return (long)out;
+}
+
+static void tlm_frame_end(tlm_decoder* d) {
+	tlm_frame frame;
+	long len;
+
+	if (d->n == 0 && !d->overflow) return; /* back-to-back delimiters */
+	if (d->overflow || (len = tlm_cobs_decode(d->buf, d->n)) < 4) {
+		d->bad_frames++;
+		return;
+	}
+	if (tlm_crc16(d->buf, len - 2) != ((unsigned)d->buf[len - 2] << 8 | d->buf[len - 1])) {
+		d->crc_errors++;
+		return;
+	}
+	frame.type = d->buf[0];
+	frame.seq = d->buf[1];
+	frame.data = d->buf + 2;
+	frame.len = len - 4;
+	if (d->have_seq) d->lost += (frame.seq - d->last_seq - 1) & 0xFF;
+	d->have_seq = 1;
+	d->last_seq = frame.seq;
+	d->frames++;
+	if (d->on_frame) d->on_frame(d->ctx, &frame);
+}
+
+void tlm_decoder_init(tlm_decoder* d, void (*on_frame)(void* ctx, const tlm_frame* frame), void* ctx) {
+	d->n = 0;
+	d->overflow = 0;
+	d->have_seq = 0;
+	d->last_seq = 0;
+	d->on_frame = on_frame;
+	d->ctx = ctx;
+	d->frames = d->crc_errors = d->bad_frames = d->lost = 0;
+}
+
+void tlm_decode(tlm_decoder* d, const unsigned char* bytes, size_t n) {
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		if (bytes[i] == 0) {
+			tlm_frame_end(d);
+			d->n = 0;
+			d->overflow = 0;
+		} else if (d->n < sizeof(d->buf)) {
+			d->buf[d->n++] = bytes[i];
+		} else {
+			d->overflow = 1;
+		}
+	}
+}
@@ -0,0 +1,46 @@
+/*
+ * tlm_decode.h
+ *
+ * PC-side decoder for the SCI telemetry frames of "C2000 Libraries/SCI Library"
+ * (telemetry.h): COBS frames ended by 0x00, each holding
+ * type(1) seq(1) data(0-250) crc(2), crc being CRC-16/CCITT-FALSE.
+ *
+ * Feed it bytes as they arrive, in any chunking; it calls back once per
+ * frame whose CRC checks out and counts everything else. After noise it
+ * picks up again at the next 0x00.
+ */
+#ifndef TLM_DECODE_H
+#define TLM_DECODE_H
+
+#include <stddef.h>
+
+#define TLM_MAX_DATA 250
+#define TLM_MAX_ENCODED (TLM_MAX_DATA + 6)
+
+typedef struct {
+	unsigned type;
+	unsigned seq;
+	const unsigned char* data;
+	size_t len;
+} tlm_frame;
+
+typedef struct {
+	unsigned char buf[TLM_MAX_ENCODED];
+	size_t n;
+	int overflow;				/* current frame outgrew buf: drop it at the next 0x00 */
+	int have_seq;
+	unsigned last_seq;
+	void (*on_frame)(void* ctx, const tlm_frame* frame);
+	void* ctx;
+
+	unsigned long frames;		/* good frames */
+	unsigned long crc_errors;	/* decoded, but the CRC did not match */
+	unsigned long bad_frames;	/* too short, too long or not valid COBS */
+	unsigned long lost;			/* frames missing according to seq */
+} tlm_decoder;
+
+void tlm_decoder_init(tlm_decoder* d, void (*on_frame)(void* ctx, const tlm_frame* frame), void* ctx);
+void tlm_decode(tlm_decoder* d, const unsigned char* bytes, size_t n);
+unsigned tlm_crc16(const unsigned char* bytes, size_t n);
+
+#endif /* TLM_DECODE_H */
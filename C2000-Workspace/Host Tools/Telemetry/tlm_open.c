@@ -0,0 +1,45 @@
+/*
+ * tlm_open.c
+ */
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+#include "tlm_open.h"
+
+static speed_t baud_constant(long baud) {
+	switch (baud) {
+		case 9600: return B9600;
+		case 19200: return B19200;
+		case 38400: return B38400;
+		case 57600: return B57600;
+		case 115200: return B115200;
+		case 230400: return B230400;
+		case 460800: return B460800;
+		case 921600: return B921600;
+		default: return 0;
+	}
+}
+
+int tlm_open(const char* path, long baud) {
+	int fd = strcmp(path, "-") ? open(path, O_RDONLY | O_NOCTTY) : 0;
+
+	if (fd < 0) {
+		perror(path);
+		return -1;
+	}
+	if (isatty(fd)) {
+		struct termios tio;
+		if (!baud_constant(baud) || tcgetattr(fd, &tio)) {
+			fprintf(stderr, "%s: cannot use %ld baud\n", path, baud);
+			if (fd) close(fd);
+			return -1;
+		}
+		cfmakeraw(&tio);
+		cfsetispeed(&tio, baud_constant(baud));
+		cfsetospeed(&tio, baud_constant(baud));
+		tcsetattr(fd, TCSANOW, &tio);
+	}
+	return fd;
+}
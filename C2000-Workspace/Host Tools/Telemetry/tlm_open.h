@@ -0,0 +1,14 @@
+/*
+ * tlm_open.h
+ *
+ * Opens the input of the PC-side telemetry tools: a capture file, a serial
+ * device or "-" for stdin. A serial device is put in raw mode at the given
+ * baud, which has to be one the port can actually be set to.
+ */
+#ifndef TLM_OPEN_H
+#define TLM_OPEN_H
+
+/* Returns the file descriptor, or -1 after saying why on stderr. */
+int tlm_open(const char* path, long baud);
+
+#endif
@@ -0,0 +1,156 @@
+/*
+ * can_transport_loopback.c
+ *
+ * Runs segmented transfers (CAN Library, CAN_transport.h) between two
+ * CAN_TP endpoints on one eCAN in self-test mode on the host simulator, so
+ * every frame goes through the mailboxes, ecan_isr and the callbacks just as
+ * it would on the bus. Checks that a message arrives once, whole and intact:
+ * a single frame, multi-frame messages with and without flow control blocks,
+ * the longest message, st_min pacing, both directions, and a message too long
+ * for the receiver's buffer, which must be refused on both sides.
+ * Prints one line per transfer and exits 1 if any of them is wrong.
+ *
+ * Build and run (from this directory):
+ *   gcc -DDSP28_HOST -I../../28069Common/h -I"../../C2000 Libraries/CAN Library" \
+ *       -o can_transport_loopback can_transport_loopback.c \
+ *       "../../C2000 Libraries/CAN Library/CAN_transport.c" "../../C2000 Libraries/CAN Library/CAN.c" \
+ *       ../../28069Common/c/F2806x_ECan.c ../../28069Common/c/F2806x_Host.c \
+ *       ../../28069Common/c/F2806x_HostModels.c && ./can_transport_loopback
+ */
+#include <stdio.h>
+#include "DSP28x_Project.h"
+#include "CAN_transport.h"
+
+#define A_ID 0x700
+#define B_ID 0x708
+#define B_SIZE CAN_TP_MAX_LENGTH
+#define A_SIZE 64
+#define TICKS_PER_MS 10//HostSimCyclesPerTick = 9000 at 90 MHz
+
+static CAN_TP a, b;
+static Uint16 a_rx[A_SIZE], b_rx[B_SIZE];
+static Uint16 data[CAN_TP_MAX_LENGTH];
+
+static CAN_TP* got_tp;
+static Uint16 got, got_length;
+static Uint32 frames;
+
+static void a_sent(CAN_ID ID, Uint32 dataH, Uint32 dataL, Uint16 length, int mbox_num) {
+	(void)ID; (void)dataH; (void)dataL; (void)length; (void)mbox_num;
+	CAN_tp_on_sent(&a);
+}
+static void a_received(CAN_ID ID, Uint32 dataH, Uint32 dataL, Uint16 length, int mbox_num) {
+	(void)ID; (void)mbox_num;
+	CAN_tp_on_receive(&b, dataH, dataL, length);
+}
+static void b_sent(CAN_ID ID, Uint32 dataH, Uint32 dataL, Uint16 length, int mbox_num) {
+	(void)ID; (void)dataH; (void)dataL; (void)length; (void)mbox_num;
+	CAN_tp_on_sent(&b);
+}
+static void b_received(CAN_ID ID, Uint32 dataH, Uint32 dataL, Uint16 length, int mbox_num) {
+	(void)ID; (void)mbox_num;
+	CAN_tp_on_receive(&a, dataH, dataL, length);
+}
+
+//In self-test mode each frame comes back into whichever receive mailbox has its ID
+static CAN_INFO info[] = {
+	{A_ID, a_sent, a_received},
+	{B_ID, b_sent, b_received}
+};
+
+static void message(CAN_TP* tp, Uint16* buffer, Uint16 length) {
+	(void)buffer;
+	got_tp = tp;
+	got++;
+	got_length = length;
+}
+
+static void frame_out(const HOST_CAN_FRAME* frame) {
+	(void)frame;
+	frames++;
+}
+
+//Runs the simulator and both endpoints' timers for ms milliseconds, or until a message is in
+static Uint32 run(Uint32 ms, int until_message) {
+	Uint32 t;
+
+	for (t = 0; t < ms && !(until_message && got); t++) {
+		HostSimRun(TICKS_PER_MS);
+		CAN_tp_poll(&a, HostSimTicks()/TICKS_PER_MS);
+		CAN_tp_poll(&b, HostSimTicks()/TICKS_PER_MS);
+	}
+	return t;
+}
+
+static int transfer(const char* name, CAN_TP* from, CAN_TP* to, Uint16 length, Uint32 min_ms) {
+	Uint16* rx = to == &b ? b_rx : a_rx;
+	Uint32 a_errors = a.errors, b_errors = b.errors, ms;
+	int errors = 0;
+	Uint16 i;
+
+	got = got_length = 0;
+	got_tp = 0;
+	frames = 0;
+	for (i = 0; i < length; i++) rx[i] = 0xFFFF;
+
+	if (!CAN_tp_send(from, data, length)) errors++;
+	ms = run(3*CAN_TP_TIMEOUT_MS, 1);
+	run(10, 0);//no second copy, no stray frames
+
+	if (got != 1 || got_tp != to || got_length != length) errors++;
+	for (i = 0; i < length; i++) {
+		if (rx[i] != data[i]) errors++;
+	}
+	if (ms < min_ms || from->tx_state != CAN_TP_IDLE || a.errors != a_errors || b.errors != b_errors) errors++;
+	printf("%-28s %s: %u bytes, %lu frames, %lu ms\n", name, errors ? "FAIL" : "ok",
+			got_length, (unsigned long)frames, (unsigned long)ms);
+	return errors != 0;
+}
+
+static int refused(const char* name, Uint16 length) {
+	Uint32 a_errors = a.errors, b_errors = b.errors;
+	int errors = 0;
+
+	got = 0;
+	frames = 0;
+	if (!CAN_tp_send(&b, data, length)) errors++;
+	run(3*CAN_TP_TIMEOUT_MS, 0);
+
+	//First frame, overflow flow control, and each side counts the overflow once
+	if (got || frames != 2 || b.tx_state != CAN_TP_IDLE || a.rx_active) errors++;
+	if (a.errors != a_errors + 1 || b.errors != b_errors + 1) errors++;
+	printf("%-28s %s: %lu frames, errors %lu/%lu\n", name, errors ? "FAIL" : "ok", (unsigned long)frames,
+			(unsigned long)(a.errors - a_errors), (unsigned long)(b.errors - b_errors));
+	return errors != 0;
+}
+
+int main(void) {
+	int failed = 0;
+	Uint16 i;
+
+	for (i = 0; i < CAN_TP_MAX_LENGTH; i++) data[i] = (i*7 + (i >> 8)) & 0xFF;
+
+	HostSimInit();
+	HostSimCyclesPerTick = 9000;
+	HostECanTxHook = frame_out;
+	CAN_init(info, 2, 1);
+	ECanaRegs.CANMC.bit.STM = 1;//self-test: the eCAN receives what it sends
+	EINT;
+	CAN_tp_init(&a, A_ID, B_ID, 10, 11, a_rx, A_SIZE, message);
+	CAN_tp_init(&b, B_ID, A_ID, 12, 13, b_rx, B_SIZE, message);
+
+	failed |= transfer("single frame", &a, &b, 5, 0);
+	failed |= transfer("first frame + 1", &a, &b, 8, 0);
+	failed |= transfer("300 bytes, no blocks", &a, &b, 300, 0);
+	b.block_size = 4;
+	failed |= transfer("300 bytes, blocks of 4", &a, &b, 300, 0);
+	b.block_size = 0;
+	failed |= transfer("longest message", &a, &b, CAN_TP_MAX_LENGTH, 0);
+	b.st_min = 2;
+	failed |= transfer("100 bytes, st_min 2 ms", &a, &b, 100, 13*2);//first frame + 14 consecutive
+	b.st_min = 0;
+	failed |= transfer("B to A", &b, &a, A_SIZE, 0);
+	failed |= refused("too long for the receiver", A_SIZE + 1);
+	failed |= transfer("after the refusal", &a, &b, 300, 0);
+	return failed;
+}
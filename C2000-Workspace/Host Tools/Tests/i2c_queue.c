@@ -0,0 +1,243 @@
+/*
+ * i2c_queue.c
+ *
+ * Runs the I2C-A driver (MPU650 Library, I2CFuncs.h) on the host simulator
+ * against register-file slaves and checks the transaction queue and the
+ * blocking functions on top of it: queued reads and writes, a chain of
+ * transfers finishing in order with their done callbacks, a NACK, a stuck
+ * transfer failed by i2c_cancel, a blocking i2c_read on a stuck bus cancelled
+ * by its own timeout, a blocking call from a done callback being refused, the
+ * retry limit of i2c_write, and the polled functions used before
+ * i2c_queue_init, including giving up on a stuck bus.
+ * A stuck bus is a clock slowed so far that a byte takes seconds; resetting
+ * the module (I2CA_Init) brings the clock back.
+ * Prints one line per case and exits 1 if any of them is wrong.
+ *
+ * Build and run (from this directory):
+ *   gcc -DDSP28_HOST -I../../28069Common/h -I"../../Device Libraries/MPU650 Library" \
+ *       -o i2c_queue i2c_queue.c "../../Device Libraries/MPU650 Library/I2CFuncs.c" \
+ *       ../../28069Common/c/F2806x_Host.c ../../28069Common/c/F2806x_HostModels.c && ./i2c_queue
+ */
+#include <stdio.h>
+#include "F2806x_Device.h"
+#include "F2806x_usDelay.h"
+#include "I2CFuncs.h"
+
+#define DEV 0x68
+#define GRUMPY 0x50//NACKs the first nacks_left bytes written to it
+#define ABSENT 0x23
+
+static Uint16 nacks_left, grumpy_writes;
+
+static Uint16 grumpy_write(HOST_I2C_SLAVE* self, Uint16 data) {
+	(void)self;
+	(void)data;
+	grumpy_writes++;
+	if (nacks_left) {
+		nacks_left--;
+		return 0;
+	}
+	return 1;
+}
+
+static HOST_I2C_SLAVE dev = {DEV, 0, 0, 0, 0, {0}, 0, 0};
+static HOST_I2C_SLAVE grumpy = {GRUMPY, 0, grumpy_write, 0, 0, {0}, 0, 0};
+
+static Uint16 done_order[8], dones;
+
+static void done(I2C_XFER* x) {
+	if (dones < 8) done_order[dones] = x->reg;
+	dones++;
+}
+
+//The driver's LOG calls, not checked here
+void LogWrite(Uint16 file, Uint16 line, Uint16 n, Uint32 a, Uint32 b, Uint32 c, Uint32 d) {
+	(void)file; (void)line; (void)n; (void)a; (void)b; (void)c; (void)d;
+}
+Uint32 LogFloatBits(float32 x) { (void)x; return 0; }
+
+static void stick(void) {
+	I2caRegs.I2CPSC.all = 255;
+	I2caRegs.I2CCLKL = 0xFFFF;
+	I2caRegs.I2CCLKH = 0xFFFF;
+}
+
+//Waits for x to finish, up to ms
+static void wait(I2C_XFER* x, Uint32 ms) {
+	Uint32 t;
+
+	for (t = 0; t < 1000*ms && x->status < I2C_XFER_DONE; t++) DELAY_US(1);
+}
+
+static int report(const char* name, int errors) {
+	printf("%-32s %s\n", name, errors ? "FAIL" : "ok");
+	return errors != 0;
+}
+
+static int polled(void) {
+	Uint16 b[3] = {0x11, 0x22, 0x33}, r[3] = {0};
+	int errors = 0;
+
+	if (!i2c_write(DEV, 0x10, 3, b) || dev.regs[0x10] != 0x11 || dev.regs[0x12] != 0x33) errors++;
+	if (!i2c_read(DEV, 0x10, 3, r) || r[0] != 0x11 || r[1] != 0x22 || r[2] != 0x33) errors++;
+	nacks_left = 100;
+	grumpy_writes = 0;
+	if (i2c_write(GRUMPY, 0x05, 1, b) || grumpy_writes != 3) errors++;//a NACK is tried 3 times, not forever
+	nacks_left = 0;
+	return report("polled write and read", errors);
+}
+
+static int polled_stuck(void) {
+	Uint16 r[1] = {0};
+	int errors = 0;
+	Uint32 t0 = HostSimTicks();
+
+	stick();
+	if (i2c_read(DEV, 0x10, 1, r)) errors++;
+	if (HostSimTicks() - t0 > 200000) errors++;//gave up within the timeouts, not at the byte's end
+	if (!i2c_read(DEV, 0x11, 1, r) || r[0] != 0x22) errors++;//the reset brought the clock back
+	return report("polled, stuck bus gives up", errors);
+}
+
+static int queued(void) {
+	static const Uint16 tx[2] = {0xA5, 0x5A};
+	static Uint16 rx[2];
+	static I2C_XFER w = {DEV, 0x40, tx, 0, 2, done, I2C_XFER_IDLE, 0};
+	static I2C_XFER r = {DEV, 0x40, 0, rx, 2, done, I2C_XFER_IDLE, 0};
+	int errors = 0;
+
+	dones = 0;
+	if (!i2c_submit(&w) || !i2c_submit(&r)) errors++;
+	if (i2c_submit(&w)) errors++;//already queued
+	wait(&r, 10);
+	if (w.status != I2C_XFER_DONE || r.status != I2C_XFER_DONE || i2c_busy()) errors++;
+	if (dev.regs[0x40] != 0xA5 || dev.regs[0x41] != 0x5A || rx[0] != 0xA5 || rx[1] != 0x5A) errors++;
+	if (dones != 2) errors++;
+	return report("queued write then read", errors);
+}
+
+static int chain(void) {
+	static Uint16 rx[3][4];
+	static I2C_XFER x[3] = {
+		{DEV, 0x10, 0, rx[0], 3, done, I2C_XFER_IDLE, 0},
+		{DEV, 0x40, 0, rx[1], 2, done, I2C_XFER_IDLE, 0},
+		{DEV, 0x11, 0, rx[2], 1, done, I2C_XFER_IDLE, 0}
+	};
+	int errors = 0, i;
+
+	dones = 0;
+	for (i = 0; i < 3; i++) {
+		if (!i2c_submit(&x[i])) errors++;
+	}
+	wait(&x[2], 10);
+	for (i = 0; i < 3; i++) {
+		if (x[i].status != I2C_XFER_DONE || done_order[i] != x[i].reg) errors++;
+	}
+	if (dones != 3 || rx[0][2] != 0x33 || rx[1][0] != 0xA5 || rx[2][0] != 0x22) errors++;
+	return report("three transfers in order", errors);
+}
+
+static int nack(void) {
+	static Uint16 rx[1], rx2[1];
+	static I2C_XFER gone = {ABSENT, 0x00, 0, rx, 1, done, I2C_XFER_IDLE, 0};
+	static I2C_XFER next = {DEV, 0x11, 0, rx2, 1, done, I2C_XFER_IDLE, 0};
+	int errors = 0;
+
+	dones = 0;
+	i2c_submit(&gone);
+	i2c_submit(&next);
+	wait(&next, 10);
+	if (gone.status != I2C_XFER_NACKED || next.status != I2C_XFER_DONE || rx2[0] != 0x22 || dones != 2) errors++;
+	return report("NACK, then the next transfer", errors);
+}
+
+static int cancelled(void) {
+	static Uint16 rx[1], rx2[1];
+	static I2C_XFER slow = {DEV, 0x10, 0, rx, 1, done, I2C_XFER_IDLE, 0};
+	static I2C_XFER next = {DEV, 0x11, 0, rx2, 1, done, I2C_XFER_IDLE, 0};
+	int errors = 0;
+
+	dones = 0;
+	i2c_submit(&slow);
+	stick();
+	i2c_submit(&next);
+	wait(&slow, 30);
+	if (slow.status != I2C_XFER_ACTIVE || next.status != I2C_XFER_QUEUED) errors++;
+	i2c_cancel();
+	if (slow.status != I2C_XFER_FAILED || dones != 1) errors++;
+	wait(&next, 10);
+	if (next.status != I2C_XFER_DONE || rx2[0] != 0x22 || dones != 2 || i2c_busy()) errors++;
+	return report("stuck transfer cancelled", errors);
+}
+
+static int read_stuck(void) {
+	Uint16 r[1] = {0};
+	int errors = 0;
+	Uint32 t0 = HostSimTicks();
+
+	stick();
+	if (i2c_read(DEV, 0x10, 1, r)) errors++;
+	if (HostSimTicks() - t0 < 20000 || HostSimTicks() - t0 > 40000) errors++;//one 20 ms timeout, then i2c_cancel
+	if (!i2c_read(DEV, 0x11, 1, r) || r[0] != 0x22 || i2c_busy()) errors++;//the cancel's reset brought the clock back
+	return report("blocking read, stuck bus", errors);
+}
+
+static int nested_read;
+
+static void read_from_done(I2C_XFER* x) {
+	Uint16 r[1];
+
+	(void)x;
+	nested_read = i2c_read(DEV, 0x11, 1, r);//would wait on the transfer that is calling us
+}
+
+static int refused_in_done(void) {
+	static Uint16 rx[1];
+	static I2C_XFER x = {DEV, 0x10, 0, rx, 1, read_from_done, I2C_XFER_IDLE, 0};
+	int errors = 0;
+	Uint32 t0 = HostSimTicks();
+
+	nested_read = -1;
+	i2c_submit(&x);
+	wait(&x, 10);
+	if (x.status != I2C_XFER_DONE || nested_read != 0 || HostSimTicks() - t0 > 5000) errors++;
+	return report("blocking read in a done callback", errors);
+}
+
+static int write_retries(void) {
+	Uint16 b[1] = {0x77};
+	int errors = 0;
+
+	nacks_left = 2;
+	grumpy_writes = 0;
+	if (!i2c_write(GRUMPY, 0x05, 1, b) || nacks_left) errors++;//two NACKs, third try gets through
+	nacks_left = 100;
+	grumpy_writes = 0;
+	if (i2c_write(GRUMPY, 0x05, 1, b) || grumpy_writes != 3) errors++;//gives up after three
+	nacks_left = 0;
+	if (!i2c_write_byte(DEV, 0x30, 0x42) || dev.regs[0x30] != 0x42) errors++;
+	return report("write retries a NACK 3 times", errors);
+}
+
+int main(void) {
+	int failed = 0;
+
+	HostSimInit();
+	HostI2cAddSlave(&dev);
+	HostI2cAddSlave(&grumpy);
+	I2CA_Init();
+	EINT;
+
+	failed |= polled();
+	failed |= polled_stuck();
+
+	i2c_queue_init();
+	failed |= queued();
+	failed |= chain();
+	failed |= nack();
+	failed |= cancelled();
+	failed |= read_stuck();
+	failed |= refused_in_done();
+	failed |= write_retries();
+	return failed;
+}
@@ -0,0 +1,108 @@
+/*
+ * mcbsp_stream.c
+ *
+ * Runs McBSP-A SPI streams (SPI Library, mcbsp_spi.h) on the host simulator
+ * against a slave that answers every word with the word plus one, and checks
+ * that every block arrives whole and in order, with the right data, while
+ * the chip select is low: single and multi-block streams, ping-pong and
+ * fixed transmit buffers, McbspSpiStop and a discarded receive side.
+ * Prints one line per stream and exits 1 if any of them is wrong.
+ *
+ * Build and run (from this directory):
+ *   gcc -DDSP28_HOST -I../../28069Common/h -I"../../C2000 Libraries/SPI Library" \
+ *       -o mcbsp_stream mcbsp_stream.c "../../C2000 Libraries/SPI Library/mcbsp_spi.c" \
+ *       "../../C2000 Libraries/SPI Library/spi.c" ../../28069Common/c/F2806x_Host.c \
+ *       ../../28069Common/c/F2806x_HostModels.c && ./mcbsp_stream
+ */
+#include <stdio.h>
+#include "F2806x_Device.h"
+#include "mcbsp_spi.h"
+
+#define CS_GPIO 19
+#define WORDS 64
+
+#pragma DATA_SECTION(tx, "DMARAML5")
+static Uint16 tx[2][WORDS];
+#pragma DATA_SECTION(rx, "DMARAML5")
+static Uint16 rx[2][WORDS];
+
+static Uint32 words, cs_high, next_block, stop_after;
+static long errors;
+
+static Uint16 slave(char spisys, Uint16 data, Uint16 bits) {
+	words++;
+	if (spisys != 'M' || bits != 16) errors++;
+	if (GpioDataRegs.GPADAT.bit.GPIO19) cs_high++;
+	return data + 1;
+}
+
+static Uint16 pattern(Uint32 block, Uint16 i) {
+	return (Uint16)(block*1000 + i);
+}
+
+static void ready(MCBSP_STREAM* s, const Uint16* data, Uint32 block) {
+	Uint16 i;
+
+	if (block != next_block++) errors++;
+	for (i = 0; data && i < s->block; i++) {
+		Uint16 want = s->tx[0] ? pattern(s->tx[1] ? block : 0, i) + 1 : 0;//all ones + 1
+		if (data[i] != want) errors++;
+	}
+	if (s->tx[1]) {//refill for block + 2
+		for (i = 0; i < s->block; i++) tx[block & 1][i] = pattern(block + 2, i);
+	}
+	if (stop_after && block + 1 == stop_after) McbspSpiStop();
+}
+
+static int run(const char* name, MCBSP_STREAM* s, Uint32 blocks, Uint32 stop, Uint32 expect) {
+	Uint32 t0, i, b;
+
+	for (b = 0; b < 2; b++) {
+		for (i = 0; i < WORDS; i++) tx[b][i] = pattern(b, i);
+	}
+	s->blocks = blocks;
+	s->status = SPI_IDLE;
+	words = cs_high = next_block = 0;
+	errors = 0;
+	stop_after = stop;
+
+	if (!McbspSpiStart(s)) errors++;
+	t0 = HostSimTicks();
+	while (s->status != SPI_DONE && HostSimTicks() - t0 < 1000000) HostSimRun(1);
+	HostSimRun(50);//nothing more may come out
+
+	if (s->status != SPI_DONE || s->received != expect || next_block != expect || s->overrun) errors++;
+	if (words != expect*s->block || cs_high || McbspSpiBusy() || !GpioDataRegs.GPADAT.bit.GPIO19) errors++;
+	printf("%-28s %s: %lu blocks, %lu words\n", name, errors ? "FAIL" : "ok",
+			(unsigned long)s->received, (unsigned long)words);
+	return errors != 0;
+}
+
+int main(void) {
+	static MCBSP_STREAM s = {CS_GPIO, 1, 4, 16, {0, 0}, {rx[0], rx[1]}, 37, 0, ready, SPI_IDLE, 0, 0};
+	int failed = 0;
+
+	HostSimInit();
+	HostSpiTransferHook = slave;
+	McbspSpiInit(Mdx20, Mdr21, Mclkx22);
+	SpiCsInit(CS_GPIO);
+	EINT;
+
+	s.tx[0] = tx[0];
+	s.tx[1] = tx[1];
+	failed |= run("single block", &s, 1, 0, 1);
+	failed |= run("two blocks", &s, 2, 0, 2);
+	failed |= run("seven blocks, ping-pong", &s, 7, 0, 7);
+	failed |= run("until McbspSpiStop", &s, 0, 5, 7);//block 4 is ready as block 5 starts; 6 is the one more
+	s.block = 4;
+	failed |= run("shortest blocks", &s, 3, 0, 3);
+	s.block = WORDS;
+	s.tx[1] = 0;
+	failed |= run("fixed transmit buffer", &s, 4, 0, 4);
+	s.tx[0] = 0;
+	s.rx[1] = 0;
+	failed |= run("all ones, one rx buffer", &s, 3, 0, 3);
+	s.rx[0] = 0;
+	failed |= run("receive thrown away", &s, 3, 0, 3);
+	return failed;
+}
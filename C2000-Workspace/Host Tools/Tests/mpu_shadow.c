@@ -0,0 +1,149 @@
+/*
+ * mpu_shadow.c
+ *
+ * Runs the MPU6050 register shadow (MPU650 Library, MPUFuncs.h) on the host
+ * simulator against a register-file MPU6050 and counts what goes over the bus.
+ * Checks that a bit-field write reads a register once and then only writes it,
+ * that a whole-register write to a register never read does not put it in the
+ * shadow, that self-clearing bits (the FIFO reset in USER_CTRL) are never
+ * cached and so never written again, that a failed write leaves the register
+ * to be read from the device, and that DEVICE_RESET brings back the reset
+ * values without a read.
+ * Prints one line per case and exits 1 if any of them is wrong.
+ *
+ * Build and run (from this directory):
+ *   gcc -DDSP28_HOST -I../../28069Common/h -I"../../Device Libraries/MPU650 Library" \
+ *       -o mpu_shadow mpu_shadow.c "../../Device Libraries/MPU650 Library/MPUFuncs.c" \
+ *       "../../Device Libraries/MPU650 Library/I2CFuncs.c" \
+ *       ../../28069Common/c/F2806x_Host.c ../../28069Common/c/F2806x_HostModels.c && ./mpu_shadow
+ */
+#include <stdio.h>
+#include "F2806x_Device.h"
+#include "MPUFuncs.h"
+
+static Uint16 reads, writes;//register reads and data bytes written
+static Uint16 pointing;//next byte written is the register pointer
+static Uint16 last;//last data byte written
+static Uint16 nacking;//NACK every byte written while set
+
+static void imu_start(HOST_I2C_SLAVE* self, Uint16 read) {
+	(void)self;
+	if (read) reads++;
+	else pointing = 1;
+}
+
+//Register file, but the FIFO reset in USER_CTRL clears itself as on the device
+static Uint16 imu_write(HOST_I2C_SLAVE* self, Uint16 data) {
+	if (nacking) return 0;
+	if (pointing) {
+		pointing = 0;
+		self->pointer = data & 0xFF;
+		return 1;
+	}
+	writes++;
+	last = data & 0xFF;
+	self->regs[self->pointer] = self->pointer == MPU6050_RA_USER_CTRL ? last & ~0x0F : last;
+	self->pointer = (self->pointer + 1) & 0xFF;
+	return 1;
+}
+
+static HOST_I2C_SLAVE imu = {MPU6050_ADDRESS, imu_start, imu_write, 0, 0, {0}, 0, 0};
+
+//The driver's LOG calls, not checked here
+void LogWrite(Uint16 file, Uint16 line, Uint16 n, Uint32 a, Uint32 b, Uint32 c, Uint32 d) {
+	(void)file; (void)line; (void)n; (void)a; (void)b; (void)c; (void)d;
+}
+Uint32 LogFloatBits(float32 x) { (void)x; return 0; }
+
+static int report(const char* name, int errors) {
+	printf("%-36s %s\n", name, errors ? "FAIL" : "ok");
+	return errors != 0;
+}
+
+static void count(void) {
+	reads = writes = 0;
+}
+
+static int bits_read_once(void) {
+	int errors = 0;
+
+	imu.regs[MPU6050_RA_CONFIG] = 0xC5;
+	count();
+	if (!write_MPU_bits(MPU6050_RA_CONFIG, MPU6050_CFG_DLPF_CFG_BIT, MPU6050_CFG_DLPF_CFG_LENGTH, MPU6050_DLPF_BW_42)) errors++;
+	if (reads != 1 || writes != 1 || imu.regs[MPU6050_RA_CONFIG] != 0xC3) errors++;
+	count();
+	if (!write_MPU_bits(MPU6050_RA_CONFIG, MPU6050_CFG_DLPF_CFG_BIT, MPU6050_CFG_DLPF_CFG_LENGTH, MPU6050_DLPF_BW_5)) errors++;
+	if (reads != 0 || writes != 1 || imu.regs[MPU6050_RA_CONFIG] != 0xC6) errors++;
+	if (read_MPU_byte(MPU6050_RA_CONFIG) != 0xC6 || reads != 0) errors++;
+	return report("bit-field writes read once", errors);
+}
+
+static int write_not_shadowed(void) {
+	int errors = 0;
+
+	count();
+	if (!write_MPU_byte(MPU6050_RA_GYRO_CONFIG, 0x18) || writes != 1 || reads != 0) errors++;
+	imu.regs[MPU6050_RA_GYRO_CONFIG] = 0x10;//what the device reads back, not what was written
+	if (read_MPU_byte(MPU6050_RA_GYRO_CONFIG) != 0x10 || reads != 1) errors++;
+	count();
+	if (!write_MPU_byte(MPU6050_RA_GYRO_CONFIG, 0x08) || read_MPU_byte(MPU6050_RA_GYRO_CONFIG) != 0x08 || reads != 0) errors++;
+	return report("write to an unread register", errors);
+}
+
+static int self_clearing(void) {
+	int errors = 0;
+
+	imu.regs[MPU6050_RA_USER_CTRL] = 0x40;//FIFO_EN
+	count();
+	if (!write_MPU_bit(MPU6050_RA_USER_CTRL, MPU6050_USERCTRL_FIFO_RESET_BIT, true) || last != 0x44) errors++;
+	if (read_MPU_byte(MPU6050_RA_USER_CTRL) != 0x40 || reads != 1) errors++;
+	if (!write_MPU_bit(MPU6050_RA_USER_CTRL, MPU6050_USERCTRL_DMP_EN_BIT, true) || last != 0xC0) errors++;//no second FIFO reset
+	if (reads != 1 || writes != 2 || imu.regs[MPU6050_RA_USER_CTRL] != 0xC0) errors++;
+	return report("self-clearing bits not cached", errors);
+}
+
+static int failures_forget(void) {
+	int errors = 0;
+
+	imu.regs[MPU6050_RA_SMPLRT_DIV] = 0x04;
+	nacking = 1;
+	count();
+	if (write_MPU_bits(MPU6050_RA_SMPLRT_DIV, 7, 8, 0x09) || writes) errors++;
+	nacking = 0;
+	count();
+	if (read_MPU_byte(MPU6050_RA_SMPLRT_DIV) != 0x04 || reads != 1) errors++;
+	nacking = 1;
+	if (write_MPU_byte(MPU6050_RA_SMPLRT_DIV, 0x09)) errors++;
+	nacking = 0;
+	count();
+	if (read_MPU_byte(MPU6050_RA_SMPLRT_DIV) != 0x04 || reads != 1) errors++;//the failed write made it unknown
+	return report("failed transfers leave it unknown", errors);
+}
+
+static int device_reset(void) {
+	int errors = 0;
+
+	count();
+	if (!write_MPU_byte(MPU6050_RA_PWR_MGMT_1, 0x80)) errors++;
+	if (read_MPU_byte(MPU6050_RA_PWR_MGMT_1) != 0x40 || read_MPU_byte(MPU6050_RA_CONFIG) != 0) errors++;
+	if (reads != 0) errors++;
+	forget_MPU_registers();
+	imu.regs[MPU6050_RA_CONFIG] = 0x03;
+	if (read_MPU_byte(MPU6050_RA_CONFIG) != 0x03 || reads != 1) errors++;
+	return report("DEVICE_RESET, then forgetting", errors);
+}
+
+int main(void) {
+	int failed = 0;
+
+	HostSimInit();
+	HostI2cAddSlave(&imu);
+	I2CA_Init();//polled, as during imu_subsystem_setup
+
+	failed |= bits_read_once();
+	failed |= write_not_shadowed();
+	failed |= self_clearing();
+	failed |= failures_forget();
+	failed |= device_reset();
+	return failed;
+}